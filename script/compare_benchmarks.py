@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""Compare benchmark results from `make bench` against a stored baseline.
+
+Usage:
+    compare_benchmarks.py BASELINE RESULTS
+    compare_benchmarks.py --relative BASELINE RESULTS
+    compare_benchmarks.py --update BASELINE RESULTS
+
+RESULTS has one JSON object per line, as written by the benchmark runner when
+BENCH_RESULTS is set. BASELINE is a JSON file:
+
+    {
+        "default_tolerance": 0.5,
+        "benchmarks": {
+            "bitfield/getBitField": {"ns_per_op": 4.77, "tolerance": 0.5},
+            ...
+        }
+    }
+
+A benchmark regresses if it is slower than its baseline by more than its
+tolerance (a fraction of the baseline). A table of the results is printed in
+Markdown, so it can be pasted into a review, and the exit status is 1 if
+anything regressed.
+
+Absolute times are only comparable on the computer the baseline was recorded
+on. With --relative, every time is instead divided by the time of the
+reference benchmark (REFERENCE_BENCHMARK) from the same run, so the speed of
+the computer cancels out, and the tolerance is at least RELATIVE_TOLERANCE to
+allow for the rest of the difference between computers. This is the check run
+by `make test`.
+
+With --update, the baseline is rewritten with the new results, keeping any
+per-benchmark tolerances.
+"""
+from __future__ import print_function
+
+import json
+import sys
+
+DEFAULT_TOLERANCE = 0.5
+REFERENCE_BENCHMARK = 'reference/checksum'
+RELATIVE_TOLERANCE = 1.0
+
+
+def load_results(path):
+    results = {}
+    with open(path) as results_file:
+        for line in results_file:
+            line = line.strip()
+            if line:
+                result = json.loads(line)
+                results[result['name']] = result['ns_per_op']
+    return results
+
+
+def load_baseline(path):
+    try:
+        with open(path) as baseline_file:
+            baseline = json.load(baseline_file)
+    except IOError:
+        baseline = {}
+    baseline.setdefault('default_tolerance', DEFAULT_TOLERANCE)
+    baseline.setdefault('benchmarks', {})
+    return baseline
+
+
+def update_baseline(path, baseline, results):
+    for name, ns_per_op in results.items():
+        entry = baseline['benchmarks'].setdefault(name, {})
+        entry['ns_per_op'] = round(ns_per_op, 2)
+    with open(path, 'w') as baseline_file:
+        json.dump(baseline, baseline_file, indent=4, sort_keys=True,
+                separators=(',', ': '))
+        baseline_file.write('\n')
+    print("Updated %d benchmarks in %s" % (len(results), path))
+
+
+def compare(baseline, results, relative=False):
+    """Print a table comparing the results to the baseline. If relative, the
+    times are multiples of the reference benchmark's time instead of ns/op.
+
+    Returns the number of regressions.
+    """
+    unit = "ns/op"
+    time_format = "%.2f"
+    baseline_scale = 1.0
+    results_scale = 1.0
+    if relative:
+        unit = "x reference"
+        time_format = "%.4g"
+        baseline_scale = baseline['benchmarks'][REFERENCE_BENCHMARK]['ns_per_op']
+        results_scale = results[REFERENCE_BENCHMARK]
+
+    rows = []
+    regressions = 0
+    names = sorted(set(baseline['benchmarks']) | set(results))
+    for name in names:
+        entry = baseline['benchmarks'].get(name)
+        current = results.get(name)
+        if current is not None:
+            current /= results_scale
+        if entry is None:
+            rows.append((name, "-", time_format % current, "-", "-", "new"))
+            continue
+
+        tolerance = entry.get('tolerance', baseline['default_tolerance'])
+        if relative:
+            tolerance = max(tolerance, RELATIVE_TOLERANCE)
+        expected = entry['ns_per_op'] / baseline_scale
+        if current is None:
+            rows.append((name, time_format % expected, "-", "-",
+                "%d%%" % (tolerance * 100), "missing"))
+            continue
+
+        change = (current - expected) / expected
+        if change > tolerance:
+            status = "REGRESSION"
+            regressions += 1
+        elif change < -tolerance:
+            status = "faster"
+        else:
+            status = "ok"
+        rows.append((name, time_format % expected, time_format % current,
+            "%+.1f%%" % (change * 100), "%d%%" % (tolerance * 100), status))
+
+    header = ("benchmark", "baseline " + unit, "current " + unit, "change",
+            "tolerance", "status")
+    widths = [max(len(row[i]) for row in rows + [header])
+            for i in range(len(header))]
+
+    def format_row(row):
+        return "| " + " | ".join(cell.ljust(width)
+                for cell, width in zip(row, widths)) + " |"
+
+    print(format_row(header))
+    print("|" + "|".join("-" * (width + 2) for width in widths) + "|")
+    for row in rows:
+        print(format_row(row))
+    return regressions
+
+
+def main(argv):
+    update = '--update' in argv
+    relative = '--relative' in argv
+    arguments = [argument for argument in argv
+            if argument not in ('--update', '--relative')]
+    if len(arguments) != 2:
+        print(__doc__, file=sys.stderr)
+        return 2
+
+    baseline_path, results_path = arguments
+    baseline = load_baseline(baseline_path)
+    results = load_results(results_path)
+    if update:
+        update_baseline(baseline_path, baseline, results)
+        return 0
+
+    if relative and (REFERENCE_BENCHMARK not in baseline['benchmarks'] or
+            REFERENCE_BENCHMARK not in results):
+        print("The baseline and the results must both include %s" %
+                REFERENCE_BENCHMARK, file=sys.stderr)
+        return 2
+
+    regressions = compare(baseline, results, relative)
+    if regressions > 0:
+        print("\n%d benchmark(s) regressed beyond their tolerance" %
+                regressions, file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -1,6 +1,7 @@
 #include "can/canread.h"
 #include <stdlib.h>
 #include "util/log.h"
+#include "statistics.h"
 
 using openxc::util::bitfield::getBitField;
 
@@ -15,12 +16,35 @@ const char* openxc::can::read::EVENT_FIELD_NAME = "event";
  *
  * root - The JSON object to send.
  * pipeline - The pipeline to send on.
+ *
+ * Returns the length of the serialized message.
  */
-void sendJSON(cJSON* root, Pipeline* pipeline) {
+int sendJSON(cJSON* root, Pipeline* pipeline) {
     char* message = cJSON_PrintUnformatted(root);
-    sendMessage(pipeline, (uint8_t*) message, strlen(message));
+    int messageSize = strlen(message);
+    sendMessage(pipeline, (uint8_t*) message, messageSize);
+    ++openxc::statistics::STATISTICS.messagesSerialized;
     cJSON_Delete(root);
-    free(message);
+    openxc::statistics::freeJsonString(message);
+    return messageSize;
+}
+
+/* Private: Update the traffic counters for a signal after it has been
+ * translated. Does nothing unless compiled with __SIGNAL_STATISTICS__.
+ *
+ * signal - The signal that was translated.
+ * sent - True if a message was sent for the signal.
+ * messageSize - The length of the message that was sent.
+ */
+void updateSignalStatistics(CanSignal* signal, bool sent, int messageSize) {
+#ifdef __SIGNAL_STATISTICS__
+    if(sent) {
+        ++signal->messagesSent;
+        signal->bytesSerialized += messageSize;
+    } else {
+        ++signal->messagesSuppressed;
+    }
+#endif // __SIGNAL_STATISTICS__
 }
 
 /* Private: Combine the given name and value into a JSON object (conforming to
@@ -31,8 +55,10 @@ void sendJSON(cJSON* root, Pipeline* pipeline) {
  *     message.
  * event - (Optional) The event for the event field of the OpenXC message.
  * pipeline - The pipeline to send on.
+ *
+ * Returns the length of the serialized message.
  */
-void sendJSONMessage(const char* name, cJSON* value, cJSON* event,
+int sendJSONMessage(const char* name, cJSON* value, cJSON* event,
         Pipeline* pipeline) {
     using openxc::can::read::NAME_FIELD_NAME;
     using openxc::can::read::VALUE_FIELD_NAME;
@@ -44,11 +70,14 @@ void sendJSONMessage(const char* name, cJSON* value, cJSON* event,
     if(event != NULL) {
         cJSON_AddItemToObject(root, EVENT_FIELD_NAME, event);
     }
-    sendJSON(root, pipeline);
+    return sendJSON(root, pipeline);
 }
 
 float openxc::can::read::preTranslate(CanSignal* signal, uint64_t data, bool* send) {
     float value = decodeSignal(signal, data);
+#ifdef __SIGNAL_STATISTICS__
+    ++signal->framesDecoded;
+#endif // __SIGNAL_STATISTICS__
 
     if(!signal->received || signal->sendClock == signal->sendFrequency - 1) {
         if(send && (!signal->received || signal->sendSame ||
@@ -103,34 +132,34 @@ const char* openxc::can::read::stateHandler(CanSignal* signal, CanSignal* signal
     return NULL;
 }
 
-void openxc::can::read::sendNumericalMessage(const char* name, float value, Pipeline* pipeline) {
-    sendJSONMessage(name, cJSON_CreateNumber(value), NULL, pipeline);
+int openxc::can::read::sendNumericalMessage(const char* name, float value, Pipeline* pipeline) {
+    return sendJSONMessage(name, cJSON_CreateNumber(value), NULL, pipeline);
 }
 
-void openxc::can::read::sendBooleanMessage(const char* name, bool value, Pipeline* pipeline) {
-    sendJSONMessage(name, cJSON_CreateBool(value), NULL, pipeline);
+int openxc::can::read::sendBooleanMessage(const char* name, bool value, Pipeline* pipeline) {
+    return sendJSONMessage(name, cJSON_CreateBool(value), NULL, pipeline);
 }
 
-void openxc::can::read::sendStringMessage(const char* name, const char* value,
+int openxc::can::read::sendStringMessage(const char* name, const char* value,
         Pipeline* pipeline) {
-    sendJSONMessage(name, cJSON_CreateString(value), NULL, pipeline);
+    return sendJSONMessage(name, cJSON_CreateString(value), NULL, pipeline);
 }
 
-void openxc::can::read::sendEventedFloatMessage(const char* name, const char* value, float event,
+int openxc::can::read::sendEventedFloatMessage(const char* name, const char* value, float event,
         Pipeline* pipeline) {
-    sendJSONMessage(name, cJSON_CreateString(value), cJSON_CreateNumber(event),
+    return sendJSONMessage(name, cJSON_CreateString(value), cJSON_CreateNumber(event),
             pipeline);
 }
 
-void openxc::can::read::sendEventedBooleanMessage(const char* name, const char* value, bool event,
+int openxc::can::read::sendEventedBooleanMessage(const char* name, const char* value, bool event,
         Pipeline* pipeline) {
-    sendJSONMessage(name, cJSON_CreateString(value), cJSON_CreateBool(event),
+    return sendJSONMessage(name, cJSON_CreateString(value), cJSON_CreateBool(event),
             pipeline);
 }
 
-void openxc::can::read::sendEventedStringMessage(const char* name, const char* value,
+int openxc::can::read::sendEventedStringMessage(const char* name, const char* value,
         const char* event, Pipeline* pipeline) {
-    sendJSONMessage(name, cJSON_CreateString(value), cJSON_CreateString(event),
+    return sendJSONMessage(name, cJSON_CreateString(value), cJSON_CreateString(event),
             pipeline);
 }
 
@@ -166,9 +195,12 @@ void openxc::can::read::translateSignal(Pipeline* pipeline, CanSignal* signal,
     bool send = true;
     float value = preTranslate(signal, data, &send);
     float processedValue = handler(signal, signals, signalCount, value, &send);
+    int messageSize = 0;
     if(send) {
-        sendNumericalMessage(signal->genericName, processedValue, pipeline);
+        messageSize = sendNumericalMessage(signal->genericName, processedValue,
+                pipeline);
     }
+    updateSignalStatistics(signal, send, messageSize);
     postTranslate(signal, value);
 }
 
@@ -180,12 +212,16 @@ void openxc::can::read::translateSignal(Pipeline* pipeline, CanSignal* signal,
     float value = preTranslate(signal, data, &send);
     const char* stringValue = handler(signal, signals, signalCount, value,
             &send);
+    int messageSize = 0;
     if(stringValue == NULL) {
         debug("No valid string returned from handler for %s",
                 signal->genericName);
+        send = false;
     } else if(send) {
-        sendStringMessage(signal->genericName, stringValue, pipeline);
+        messageSize = sendStringMessage(signal->genericName, stringValue,
+                pipeline);
     }
+    updateSignalStatistics(signal, send, messageSize);
     postTranslate(signal, value);
 }
 
@@ -196,9 +232,12 @@ void openxc::can::read::translateSignal(Pipeline* pipeline, CanSignal* signal,
     bool send = true;
     float value = preTranslate(signal, data, &send);
     bool booleanValue = handler(signal, signals, signalCount, value, &send);
+    int messageSize = 0;
     if(send) {
-        sendBooleanMessage(signal->genericName, booleanValue, pipeline);
+        messageSize = sendBooleanMessage(signal->genericName, booleanValue,
+                pipeline);
     }
+    updateSignalStatistics(signal, send, messageSize);
     postTranslate(signal, value);
 }
 
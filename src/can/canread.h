@@ -99,8 +99,10 @@ void translateSignal(Pipeline* pipeline, CanSignal* signal,
  * name - The value for the name field of the OpenXC message.
  * value - The numerical value for the value field of the OpenXC message.
  * pipeline - The pipeline to send on.
+ *
+ * Returns the length of the serialized message, not including the newline.
  */
-void sendNumericalMessage(const char* name, float value, Pipeline* pipeline);
+int sendNumericalMessage(const char* name, float value, Pipeline* pipeline);
 
 /* Public: Send the given name and value out to the pipeline in an OpenXC JSON
  * message followed by a newline.
@@ -108,8 +110,10 @@ void sendNumericalMessage(const char* name, float value, Pipeline* pipeline);
  * name - The value for the name field of the OpenXC message.
  * value - The string value for the value field of the OpenXC message.
  * pipeline - The pipeline to send on.
+ *
+ * Returns the length of the serialized message, not including the newline.
  */
-void sendStringMessage(const char* name, const char* value, Pipeline* pipeline);
+int sendStringMessage(const char* name, const char* value, Pipeline* pipeline);
 
 /* Public: Send the given name and value out to the pipeline in an OpenXC JSON
  * message followed by a newline.
@@ -117,8 +121,10 @@ void sendStringMessage(const char* name, const char* value, Pipeline* pipeline);
  * name - The value for the name field of the OpenXC message.
  * value - The boolean value for the value field of the OpenXC message.
  * pipeline - The pipeline to send on.
+ *
+ * Returns the length of the serialized message, not including the newline.
  */
-void sendBooleanMessage(const char* name, bool value, Pipeline* pipeline);
+int sendBooleanMessage(const char* name, bool value, Pipeline* pipeline);
 
 /* Public: Send the given name, value and event out to the pipeline in an OpenXC
  * JSON message followed by a newline.
@@ -127,8 +133,10 @@ void sendBooleanMessage(const char* name, bool value, Pipeline* pipeline);
  * value - The string value for the value field of the OpenXC message.
  * event - The boolean event for the event field of the OpenXC message.
  * pipeline - The pipeline to send on.
+ *
+ * Returns the length of the serialized message, not including the newline.
  */
-void sendEventedBooleanMessage(const char* name, const char* value, bool event,
+int sendEventedBooleanMessage(const char* name, const char* value, bool event,
         Pipeline* pipeline);
 
 /* Public: Send the given name, value and event out to the pipeline in an OpenXC
@@ -138,8 +146,10 @@ void sendEventedBooleanMessage(const char* name, const char* value, bool event,
  * value - The string value for the value field of the OpenXC message.
  * event - The string event for the event field of the OpenXC message.
  * pipeline - The pipeline to send on.
+ *
+ * Returns the length of the serialized message, not including the newline.
  */
-void sendEventedStringMessage(const char* name, const char* value,
+int sendEventedStringMessage(const char* name, const char* value,
         const char* event, Pipeline* pipeline);
 
 /* Public: Send the given name, value and event out to the pipeline in an OpenXC
@@ -149,8 +159,10 @@ void sendEventedStringMessage(const char* name, const char* value,
  * value - The string value for the value field of the OpenXC message.
  * event - The float event for the event field of the OpenXC message.
  * pipeline - The pipeline to send on.
+ *
+ * Returns the length of the serialized message, not including the newline.
  */
-void sendEventedFloatMessage(const char* name, const char* value, float event,
+int sendEventedFloatMessage(const char* name, const char* value, float event,
         Pipeline* pipeline);
 
 /* Public: Parse a CAN signal from a message and apply required transformation.
@@ -22,6 +22,31 @@ bool openxc::can::busActive(CanBus* bus) {
         time::systemTimeMs() - bus->lastMessageReceived < CAN_ACTIVE_TIMEOUT_S * 1000;
 }
 
+void openxc::can::initializeBusActivity(BusActivity* activity) {
+    activity->startupTime = time::systemTimeMs();
+    activity->active = false;
+}
+
+openxc::can::BusActivityChange openxc::can::updateBusActivity(
+        BusActivity* activity, CanBus* buses, int busCount) {
+    bool active = false;
+    for(int i = 0; i < busCount; i++) {
+        active = active || busActive(&buses[i]);
+    }
+
+    if(!activity->active && active) {
+        activity->active = true;
+        return BUS_ACTIVITY_WOKE;
+    } else if(!active && (activity->active ||
+                time::systemTimeMs() - activity->startupTime >
+                    (unsigned long)CAN_ACTIVE_TIMEOUT_S * 1000)) {
+        // stay awake at least CAN_ACTIVE_TIMEOUT_S after power on
+        activity->active = false;
+        return BUS_ACTIVITY_SILENT;
+    }
+    return BUS_ACTIVITY_UNCHANGED;
+}
+
 int lookup(void* key,
         bool (*comparator)(void* key, int index, void* candidates),
         void* candidates, int candidateCount) {
@@ -12,8 +12,26 @@
 #include "platform/lpc17xx/canutil_lpc17xx.h"
 #endif // __LPC17XX__
 
+#ifdef __HOST__
+#include "platform/host/canutil_host.h"
+#endif // __HOST__
+
 #define BUS_MEMORY_BUFFER_SIZE 2 * 8 * 16
 
+// The most messages on one bus that can have signals written and waiting to be
+// flushed at once
+#define MAX_DIRTY_MESSAGES 8
+
+// The number of standard (11 bit) CAN message IDs, each with a bit in a bus's
+// raw write whitelist
+#define CAN_STANDARD_ID_COUNT 2048
+
+// The largest extended (29 bit) CAN message ID
+#define CAN_MAX_EXTENDED_ID 0x1fffffff
+
+// The most extended message IDs in one bus's raw write whitelist
+#define MAX_RAW_WRITE_EXTENDED_IDS 16
+
 // TODO These structs are defined outside of the openxc::can namespace because
 // we're not able to used namespaced types with emqueue.
 
@@ -56,6 +74,15 @@ typedef struct CanSignalState CanSignalState;
  *                CAN into a uint64_t. If null, the default encoder is used.
  * lastValue   - The last received value of the signal. Defaults to undefined.
  * sendClock   - An internal counter value, don't use this.
+ * framesDecoded - (Only with __SIGNAL_STATISTICS__) The number of times this
+ *               signal has been decoded from a received CAN message.
+ * messagesSent - (Only with __SIGNAL_STATISTICS__) The number of OpenXC
+ *               messages sent for this signal.
+ * messagesSuppressed - (Only with __SIGNAL_STATISTICS__) The number of decoded
+ *               values not sent because of the sendFrequency, sendSame or a
+ *               handler.
+ * bytesSerialized - (Only with __SIGNAL_STATISTICS__) The total size of the
+ *               OpenXC messages sent for this signal.
  */
 struct CanSignal {
     struct CanMessage* message;
@@ -75,6 +102,12 @@ struct CanSignal {
     uint64_t (*writeHandler)(struct CanSignal*, struct CanSignal*, int, cJSON*, bool*);
     float lastValue;
     int sendClock;
+#ifdef __SIGNAL_STATISTICS__
+    unsigned int framesDecoded;
+    unsigned int messagesSent;
+    unsigned int messagesSuppressed;
+    unsigned int bytesSerialized;
+#endif // __SIGNAL_STATISTICS__
 };
 typedef struct CanSignal CanSignal;
 
@@ -82,7 +115,11 @@ typedef struct CanSignal CanSignal;
  *
  * bus - A pointer to the bus this message is on.
  * id - The ID of the message.
- * data  - The message's data field.
+ * data  - The message's data field. For the messages of the active message set
+ *      (as opposed to frames in a queue), this is the shadow payload: the
+ *      last value written to each of the message's signals, in the bit order
+ *      used by encodeSignal(), so writing one signal doesn't clear the
+ *      others.
  */
 struct CanMessage {
     struct CanBus* bus;
@@ -111,6 +148,28 @@ QUEUE_DECLARE(CanMessage, 16);
  * sendQueue - a queue of CanMessage instances that need to be written to CAN.
  * receiveQueue - a queue of messages received from CAN that have yet to be
  *      translated.
+ * messagesReceived - the number of messages pulled from the receiveQueue and
+ *      passed to the decoder since startup.
+ * messagesDropped - the number of messages received by the controller but
+ *      dropped because the receiveQueue was full (incremented from the ISR).
+ * receiveQueueHighWatermark - the most messages ever waiting in the
+ *      receiveQueue at once.
+ * dirtyMessages - the messages on this bus with signals written since their
+ *      shadow payload was last queued to send.
+ * dirtyMessageCount - the number of messages in dirtyMessages.
+ * framesCoalesced - the number of signal writes that were merged into a frame
+ *      already waiting to be flushed, instead of sending a frame of their own.
+ * rawWriteWhitelist - a bit per standard message ID, set if the host may write
+ *      raw frames with that ID to this bus.
+ * rawWriteExtendedIds - the extended message IDs the host may write raw frames
+ *      with to this bus.
+ * rawWriteExtendedIdCount - the number of IDs in rawWriteExtendedIds.
+ * rawWriteWhitelistCount - the number of standard and extended IDs in the
+ *      whitelist. If 0, raw writes with any ID are accepted.
+ * rawWritesRejected - the number of raw writes refused because their ID isn't
+ *      in the whitelist.
+ * writesDropped - the number of frames refused because the send queue was
+ *      full.
  */
 struct CanBus {
     unsigned int speed;
@@ -122,6 +181,18 @@ struct CanBus {
     uint8_t buffer[BUS_MEMORY_BUFFER_SIZE];
     QUEUE_TYPE(CanMessage) sendQueue;
     QUEUE_TYPE(CanMessage) receiveQueue;
+    unsigned int messagesReceived;
+    unsigned int messagesDropped;
+    int receiveQueueHighWatermark;
+    CanMessage* dirtyMessages[MAX_DIRTY_MESSAGES];
+    int dirtyMessageCount;
+    unsigned int framesCoalesced;
+    uint8_t rawWriteWhitelist[CAN_STANDARD_ID_COUNT / 8];
+    uint32_t rawWriteExtendedIds[MAX_RAW_WRITE_EXTENDED_IDS];
+    int rawWriteExtendedIdCount;
+    int rawWriteWhitelistCount;
+    unsigned int rawWritesRejected;
+    unsigned int writesDropped;
 };
 typedef struct CanBus CanBus;
 
@@ -224,6 +295,49 @@ void initializeCommon(CanBus* bus);
  */
 bool busActive(CanBus* bus);
 
+/* Public: A change in the activity on the CAN buses, as found by
+ * updateBusActivity().
+ *
+ * BUS_ACTIVITY_UNCHANGED - Nothing to do.
+ * BUS_ACTIVITY_WOKE - A bus has become active after all were silent.
+ * BUS_ACTIVITY_SILENT - All of the buses are silent, and it's time to sleep.
+ */
+typedef enum {
+    BUS_ACTIVITY_UNCHANGED,
+    BUS_ACTIVITY_WOKE,
+    BUS_ACTIVITY_SILENT
+} BusActivityChange;
+
+/* Public: The activity on the CAN buses, tracked across calls to
+ * updateBusActivity().
+ *
+ * startupTime - The time (in ms) when tracking started.
+ * active - True if any bus was active at the last update.
+ */
+typedef struct {
+    unsigned long startupTime;
+    bool active;
+} BusActivity;
+
+/* Public: Start tracking the activity on the CAN buses from now.
+ */
+void initializeBusActivity(BusActivity* activity);
+
+/* Public: Check whether the CAN buses have woken up or gone silent since the
+ * last update. The buses are never considered silent until at least
+ * CAN_ACTIVE_TIMEOUT_S after tracking started, to give them a chance to wake
+ * up after power on. Once silent, this keeps returning BUS_ACTIVITY_SILENT
+ * until a bus is active again.
+ *
+ * activity - The activity tracked so far.
+ * buses - The list of all CAN buses.
+ * busCount - The length of the buses array.
+ *
+ * Returns the change in activity that the caller should act on.
+ */
+BusActivityChange updateBusActivity(BusActivity* activity, CanBus* buses,
+        int busCount);
+
 /* Public: Look up the CanSignal representation of a signal based on its generic
  * name. The signal may or may not be writable - the first result will be
  * returned.
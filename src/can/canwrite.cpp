@@ -1,10 +1,15 @@
 #include "can/canwrite.h"
+#include "can/periodic.h"
+#include "can/writelimit.h"
+#include "util/timer.h"
 #include "util/log.h"
+#include <string.h>
 
 namespace can = openxc::can;
+namespace writelimit = openxc::can::writelimit;
 
+using openxc::can::writelimit::WriteDecision;
 using openxc::util::bitfield::setBitField;
-using openxc::util::log::debugNoNewline;
 
 QUEUE_DEFINE(CanMessage);
 
@@ -86,10 +91,70 @@ uint64_t openxc::can::write::encodeSignal(CanSignal* signal, float value) {
     return result;
 }
 
-void openxc::can::write::enqueueMessage(CanMessage* message, uint64_t data) {
+bool openxc::can::write::enqueueMessage(CanMessage* message, uint64_t data) {
     CanMessage outgoingMessage = {message->bus, message->id,
         __builtin_bswap64(data)};
-    QUEUE_PUSH(CanMessage, &message->bus->sendQueue, outgoingMessage);
+    if(!QUEUE_PUSH(CanMessage, &message->bus->sendQueue, outgoingMessage)) {
+        ++message->bus->writesDropped;
+        debug("Send queue on bus %d is full, dropping write to 0x%x",
+                message->bus->address, message->id);
+        return false;
+    }
+    return true;
+}
+
+/* Private: Returns true if the writer is one of the built in writers, which
+ * only encode the signal's own bit field.
+ */
+bool builtInWriter(uint64_t (*writer)(CanSignal*, CanSignal*, int, cJSON*,
+            bool*)) {
+    uint64_t (*number)(CanSignal*, CanSignal*, int, cJSON*, bool*) =
+            openxc::can::write::numberWriter;
+    uint64_t (*state)(CanSignal*, CanSignal*, int, cJSON*, bool*) =
+            openxc::can::write::stateWriter;
+    uint64_t (*boolean)(CanSignal*, CanSignal*, int, cJSON*, bool*) =
+            openxc::can::write::booleanWriter;
+    return writer == number || writer == state || writer == boolean;
+}
+
+/* Private: Store the encoded value of a signal in the shadow payload of its
+ * message, and add the message to its bus's dirty list to be flushed.
+ *
+ * wholeFrame - true if the data is the entire payload, as from a custom writer
+ *      that may encode more than its own signal, and replaces the shadow. If
+ *      false, only the signal's bit field is replaced and the values of other
+ *      signals in the message are kept.
+ *
+ * If the dirty list is full, the frame is queued to send right away instead.
+ *
+ * Returns false if the frame had to be queued right away but the send queue
+ * was full.
+ */
+bool writeShadow(CanSignal* signal, uint64_t data, bool wholeFrame) {
+    CanMessage* message = signal->message;
+    if(wholeFrame) {
+        message->data = data;
+    } else {
+        uint64_t otherSignals = ~0ULL;
+        setBitField(&otherSignals, 0, signal->bitPosition, signal->bitSize);
+        message->data = (message->data & otherSignals) | (data & ~otherSignals);
+    }
+
+    CanBus* bus = message->bus;
+    for(int i = 0; i < bus->dirtyMessageCount; i++) {
+        if(bus->dirtyMessages[i] == message) {
+            ++bus->framesCoalesced;
+            return true;
+        }
+    }
+
+    if(bus->dirtyMessageCount < MAX_DIRTY_MESSAGES) {
+        bus->dirtyMessages[bus->dirtyMessageCount++] = message;
+        return true;
+    }
+    debug("Too many messages waiting to be flushed, sending 0x%x now",
+            message->id);
+    return can::write::enqueueMessage(message, message->data);
 }
 
 bool openxc::can::write::sendSignal(CanSignal* signal, cJSON* value, CanSignal* signals,
@@ -123,22 +188,196 @@ bool openxc::can::write::sendSignal(CanSignal* signal, cJSON* value,
     bool send = true;
     uint64_t data = writer(signal, signals, signalCount, value, &send);
     if(force || send) {
-        enqueueMessage(signal->message, data);
+        if(!writeShadow(signal, data, !builtInWriter(writer))) {
+            send = false;
+        }
     } else {
         debug("Writing not allowed for signal with name %s", signal->genericName);
     }
     return send;
 }
 
+/* Private: Combine 4 bytes into a word, with the first byte as the most
+ * significant so that it prints in the same order as the bytes in memory.
+ */
+uint32_t bytesToWord(uint8_t* bytes) {
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) |
+        ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+/* Private: Returns true if the extended ID is in the bus's raw write
+ * whitelist.
+ */
+bool extendedRawWriteAllowed(CanBus* bus, uint32_t id) {
+    for(int i = 0; i < bus->rawWriteExtendedIdCount; i++) {
+        if(bus->rawWriteExtendedIds[i] == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool openxc::can::write::allowRawWrite(CanBus* bus, uint32_t id) {
+    if(id > CAN_MAX_EXTENDED_ID) {
+        debug("0x%x isn't a valid CAN message ID", id);
+        return false;
+    }
+
+    if(id >= CAN_STANDARD_ID_COUNT) {
+        if(extendedRawWriteAllowed(bus, id)) {
+            return true;
+        }
+        if(bus->rawWriteExtendedIdCount >= MAX_RAW_WRITE_EXTENDED_IDS) {
+            debug("No room to allow raw writes to 0x%x on bus %d", id,
+                    bus->address);
+            return false;
+        }
+        bus->rawWriteExtendedIds[bus->rawWriteExtendedIdCount++] = id;
+        ++bus->rawWriteWhitelistCount;
+        return true;
+    }
+
+    uint8_t bit = 1 << (id % 8);
+    if(!(bus->rawWriteWhitelist[id / 8] & bit)) {
+        bus->rawWriteWhitelist[id / 8] |= bit;
+        ++bus->rawWriteWhitelistCount;
+    }
+    return true;
+}
+
+void openxc::can::write::allowRawWritesForSignals(CanSignal* signals,
+        int signalCount) {
+    for(int i = 0; i < signalCount; i++) {
+        if(signals[i].writable && signals[i].message != NULL) {
+            allowRawWrite(signals[i].message->bus, signals[i].message->id);
+        }
+    }
+}
+
+bool openxc::can::write::rawWriteAllowed(CanBus* bus, uint32_t id) {
+    if(bus->rawWriteWhitelistCount == 0) {
+        return true;
+    }
+    if(id >= CAN_STANDARD_ID_COUNT) {
+        return extendedRawWriteAllowed(bus, id);
+    }
+    return bus->rawWriteWhitelist[id / 8] & (1 << (id % 8));
+}
+
+bool openxc::can::write::enqueueRawWrite(CanBus* bus, uint32_t id,
+        uint64_t data) {
+    if(!rawWriteAllowed(bus, id)) {
+        ++bus->rawWritesRejected;
+        debug("Raw writes to 0x%x on bus %d aren't allowed", id,
+                bus->address);
+        return false;
+    }
+
+    CanMessage message = {bus, id};
+    return enqueueMessage(&message, data);
+}
+
+bool openxc::can::write::sendRawWriteRecord(uint8_t* payload, int length,
+        CanBus* buses, int busCount) {
+    if(length != RAW_WRITE_RECORD_SIZE ||
+            payload[0] != RAW_WRITE_RECORD_TYPE) {
+        debug("Binary raw write record is malformed");
+        return false;
+    }
+
+    int busNumber = payload[1];
+    if(busNumber < 1 || busNumber > busCount) {
+        debug("No bus %d to write raw frames to", busNumber);
+        return false;
+    }
+
+    uint32_t id = 0;
+    for(int i = 2; i < 6; i++) {
+        id = (id << 8) | payload[i];
+    }
+    uint64_t data = 0;
+    for(int i = 6; i < RAW_WRITE_RECORD_SIZE; i++) {
+        data = (data << 8) | payload[i];
+    }
+    return enqueueRawWrite(&buses[busNumber - 1], id, data);
+}
+
+int openxc::can::write::writeRecordSize(uint8_t* record, int length) {
+    int size = 0;
+    if(length < 1) {
+        return 0;
+    } else if(record[0] == RAW_WRITE_RECORD_TYPE) {
+        size = RAW_WRITE_RECORD_SIZE;
+    } else if(record[0] == NAMED_WRITE_RECORD_TYPE && length > 1) {
+        size = NAMED_WRITE_RECORD_OVERHEAD + record[1];
+    }
+    return size <= length ? size : 0;
+}
+
+bool openxc::can::write::decodeNamedWriteRecord(uint8_t* record, int length,
+        char* name, int nameSize, float* value) {
+    if(record[0] != NAMED_WRITE_RECORD_TYPE ||
+            length != writeRecordSize(record, length)) {
+        debug("Binary named write record is malformed");
+        return false;
+    }
+
+    int nameLength = record[1];
+    if(nameLength == 0 || nameLength >= nameSize) {
+        debug("Name in binary write record is empty or too long");
+        return false;
+    }
+    memcpy(name, &record[2], nameLength);
+    name[nameLength] = '\0';
+
+    uint32_t bits = 0;
+    for(int i = 0; i < 4; i++) {
+        bits = (bits << 8) | record[2 + nameLength + i];
+    }
+    memcpy(value, &bits, sizeof(*value));
+    return true;
+}
+
+void openxc::can::write::flushDirtyMessages(CanBus* bus) {
+    int flushed = 0;
+    // A message that doesn't fit in the send queue stays dirty until the next
+    // flush, rather than being dropped
+    while(flushed < bus->dirtyMessageCount &&
+            !QUEUE_FULL(CanMessage, &bus->sendQueue)) {
+        CanMessage* message = bus->dirtyMessages[flushed++];
+        enqueueMessage(message, message->data);
+    }
+
+    bus->dirtyMessageCount -= flushed;
+    memmove(bus->dirtyMessages, &bus->dirtyMessages[flushed],
+            bus->dirtyMessageCount * sizeof(CanMessage*));
+}
+
 void openxc::can::write::processWriteQueue(CanBus* bus) {
-    while(!QUEUE_EMPTY(CanMessage, &bus->sendQueue)) {
+    openxc::can::periodic::update(bus, openxc::util::time::systemTimeMs());
+    flushDirtyMessages(bus);
+    writelimit::refill(bus, openxc::util::time::systemTimeUs());
+
+    // Frames held back by a rate limit go to the back of the queue, so each
+    // frame is looked at once per pass and frames with the same ID stay in
+    // order
+    int count = QUEUE_LENGTH(CanMessage, &bus->sendQueue);
+    for(int i = 0; i < count; i++) {
         CanMessage message = QUEUE_POP(CanMessage, &bus->sendQueue);
-        debugNoNewline("Sending CAN message on bus 0x%03x: id = 0x%03x, data = 0x",
-                bus->address, message.id);
-        for(int i = 0; i < 8; i++) {
-            debugNoNewline("%02x ", ((uint8_t*)&message.data)[i]);
+        WriteDecision decision = writelimit::check(bus, message.id);
+        if(decision == writelimit::WRITE_DEFER) {
+            QUEUE_PUSH(CanMessage, &bus->sendQueue, message);
+            continue;
+        } else if(decision == writelimit::WRITE_DROP) {
+            debugDeferred("Dropped CAN message with id = 0x%x, over its "
+                    "write rate limit", message.id);
+            continue;
         }
-        debugNoNewline("\r\n");
+
+        debugDeferred("Sending CAN message on bus 0x%03x: id = 0x%03x, "
+                "data = 0x%08x%08x", bus->address, message.id,
+                bytesToWord((uint8_t*)&message.data),
+                bytesToWord((uint8_t*)&message.data + 4));
         if(bus->writeHandler == NULL) {
             debug("No function available for writing to CAN -- dropped");
         } else if(!bus->writeHandler(bus, message)) {
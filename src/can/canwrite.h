@@ -3,6 +3,21 @@
 
 #include "can/canutil.h"
 
+// The type of a binary raw write record, the first byte of its payload
+#define RAW_WRITE_RECORD_TYPE 0x01
+// The size of a binary raw write record's payload: the type, the bus number, a
+// 4 byte ID and 8 bytes of data
+#define RAW_WRITE_RECORD_SIZE 14
+// The type of a binary record with several raw and named write records after
+// the type, all handled at once
+#define MULTI_WRITE_RECORD_TYPE 0x02
+// The type of a binary record that writes a value to a signal or command by
+// name: the type, the length of the name, the name (with no NULL character)
+// and the value as a 4 byte IEEE 754 float, most significant byte first
+#define NAMED_WRITE_RECORD_TYPE 0x03
+// The size of a named write record, not counting the name
+#define NAMED_WRITE_RECORD_OVERHEAD 6
+
 using openxc::can::CanCommand;
 
 namespace openxc {
@@ -113,6 +128,14 @@ uint64_t booleanWriter(CanSignal* signal, CanSignal* signals,
  * writer function must know how to do this conversion (and return a fully
  * filled out uint64_t).
  *
+ * The value is stored in the shadow payload of the signal's message, keeping
+ * the last values written to its other signals, and the message is marked
+ * dirty. The frame isn't queued until the next flushDirtyMessages() (called
+ * from processWriteQueue()), so a burst of writes to signals in the same
+ * message is sent as one frame with all of the values. A custom writer (any
+ * but numberWriter, stateWriter and booleanWriter) returns the whole payload,
+ * which replaces the shadow instead of being merged into it.
+ *
  * signal - The CanSignal to send.
  * value - The value to send in the signal. This could be a boolean, number or
  *         string (i.e. a state value).
@@ -126,7 +149,8 @@ uint64_t booleanWriter(CanSignal* signal, CanSignal* signals,
  * the 'value' parameter - be sure to call cJSON_Delete() on it after calling
  * this function if you created it with one of the cJSON_Create*() functions.
  *
- * Returns true if the message was sent successfully.
+ * Returns true if the message was sent successfully, or false if the write
+ * wasn't allowed or the send queue was full.
  */
 bool sendSignal(CanSignal* signal, cJSON* value,
         uint64_t (*writer)(CanSignal*, CanSignal*, int, cJSON*, bool*),
@@ -165,10 +189,103 @@ bool sendSignal(CanSignal* signal, cJSON* value, CanSignal* signals,
  *
  * message - the CAN message this data should be sent in.
  * data - the data for the CAN message, byte order will be reversed.
+ *
+ * Returns true if the frame was queued, or false if the bus's send queue was
+ * full. A refused frame is counted in the bus's writesDropped.
+ */
+bool enqueueMessage(CanMessage* message, uint64_t data);
+
+/* Public: Add a message ID to the IDs the host may write raw frames with on a
+ * bus. Once a bus has any ID in its whitelist, raw writes with other IDs are
+ * refused - until then, any ID is accepted. The whitelist is only used if the
+ * message set adds IDs to it, e.g. from its initialize() function.
+ *
+ * bus - The bus to allow writes to.
+ * id - A standard (11 bit) or extended (29 bit) message ID. At most
+ *      MAX_RAW_WRITE_EXTENDED_IDS extended IDs can be added to a bus.
+ *
+ * Returns true if the ID was added, or false if it isn't a valid ID or the
+ * bus has no room for another extended ID.
+ */
+bool allowRawWrite(CanBus* bus, uint32_t id);
+
+/* Public: Add the messages of all writable signals to the raw write whitelists
+ * of their buses, so the whitelist documented for writes covers raw writes
+ * too. A message set may call this from its initialize() function to turn on
+ * the raw write whitelist - it isn't called otherwise.
+ *
+ * signals - An array of all CAN signals.
+ * signalCount - The size of the signals array.
+ */
+void allowRawWritesForSignals(CanSignal* signals, int signalCount);
+
+/* Public: Returns true if the host may write a raw frame with the ID to the
+ * bus.
+ */
+bool rawWriteAllowed(CanBus* bus, uint32_t id);
+
+/* Public: Queue a raw frame from the host to send, if the bus's whitelist
+ * allows its ID.
+ *
+ * bus - The bus to send the frame on.
+ * id - The ID of the frame.
+ * data - The data of the frame, in the order for enqueueMessage().
+ *
+ * Returns true if the frame was queued.
+ */
+bool enqueueRawWrite(CanBus* bus, uint32_t id, uint64_t data);
+
+/* Public: Queue the raw frame in a binary raw write record, with no JSON or
+ * hex string to parse. The payload is RAW_WRITE_RECORD_SIZE bytes:
+ *
+ *      type (RAW_WRITE_RECORD_TYPE), bus number (starting from 1),
+ *      ID (4 bytes, most significant first), data (8 bytes, in the order
+ *      they're sent on the bus)
+ *
+ * payload - The payload of the record.
+ * length - The length of the payload.
+ * buses - An array of all CAN buses.
+ * busCount - The size of the buses array.
+ *
+ * Returns true if the record was valid and the frame was queued.
+ */
+bool sendRawWriteRecord(uint8_t* payload, int length, CanBus* buses,
+        int busCount);
+
+/* Public: Returns the size of the raw or named write record at the start of a
+ * multi-write record's entries, or 0 if it's malformed or doesn't fit in the
+ * length.
+ *
+ * record - The start of the record, its type.
+ * length - The number of bytes left in the multi-write record.
+ */
+int writeRecordSize(uint8_t* record, int length);
+
+/* Public: Decode a named write record.
+ *
+ * record - The record, starting with its type.
+ * length - The size of the record, from writeRecordSize().
+ * name - A buffer for the name, which is NULL terminated.
+ * nameSize - The size of the name buffer.
+ * value - An output argument for the value written.
+ *
+ * Returns true if the record was valid and its name fit in the buffer.
+ */
+bool decodeNamedWriteRecord(uint8_t* record, int length, char* name,
+        int nameSize, float* value);
+
+/* Public: Queue a frame with the shadow payload of each message on the bus
+ * that has had signals written since it was last flushed. Messages that don't
+ * fit in the send queue stay dirty for the next flush.
+ *
+ * bus - The CanBus with the dirty messages.
  */
-void enqueueMessage(CanMessage* message, uint64_t data);
+void flushDirtyMessages(CanBus* bus);
 
-/* Public: Write any queued outgoing messages to the CAN bus.
+/* Public: Queue the periodic frames that are due (see periodic::update()),
+ * flush the dirty messages on the bus (see flushDirtyMessages()) and write the
+ * queued outgoing messages to the CAN bus. Frames over a write rate limit (see
+ * writelimit::check()) are dropped or left in the queue for a later call.
  *
  * bus - The CanBus instance that has a queued to be flushed out to CAN.
  */
@@ -0,0 +1,160 @@
+#include "can/emulator.h"
+#include "can/trace.h"
+#include "util/bitfield.h"
+#include "util/tokenbucket.h"
+#include "util/log.h"
+#include <stdlib.h>
+#include <string.h>
+
+using openxc::can::emulator::FrameEmulator;
+using openxc::can::trace::TraceFrame;
+using openxc::util::bitfield::setBitField;
+
+namespace tokenbucket = openxc::util::tokenbucket;
+
+/* Private: Returns 64 random bits - rand() only guarantees 15 at a time. */
+static uint64_t randomData() {
+    uint64_t data = 0;
+    for(int i = 0; i < 5; i++) {
+        data = (data << 15) ^ rand();
+    }
+    return data;
+}
+
+/* Private: Build a frame for the message of a randomly chosen signal. */
+static bool nextSyntheticFrame(CanBus* buses, int busCount,
+        CanSignal* signals, int signalCount, CanMessage* frame) {
+    if(signalCount == 0 || busCount == 0) {
+        return false;
+    }
+
+    CanSignal* signal = &signals[rand() % signalCount];
+    if(signal->message == NULL) {
+        return false;
+    }
+    frame->bus = signal->message->bus != NULL ? signal->message->bus : buses;
+    frame->id = signal->message->id;
+    frame->data = randomData();
+    if(signal->stateCount > 0) {
+        // Signal fields are numbered from the most significant bit, but
+        // received data is in the controller's byte order
+        uint64_t data = __builtin_bswap64(frame->data);
+        setBitField(&data, signal->states[rand() % signal->stateCount].value,
+                signal->bitPosition, signal->bitSize);
+        frame->data = __builtin_bswap64(data);
+    }
+    return true;
+}
+
+/* Private: Returns the bus a trace frame was captured from - the bus with the
+ * matching address, or for traces that only record the interface name, the
+ * bus at the index in the name (e.g. "can1" is the second bus). Anything else
+ * goes to the first bus.
+ */
+static CanBus* busForFrame(TraceFrame* traceFrame, CanBus* buses,
+        int busCount) {
+    for(int i = 0; i < busCount; i++) {
+        if(traceFrame->busAddress != 0 &&
+                buses[i].address == traceFrame->busAddress) {
+            return &buses[i];
+        }
+    }
+
+    int nameLength = strlen(traceFrame->interfaceName);
+    if(nameLength > 0) {
+        int index = traceFrame->interfaceName[nameLength - 1] - '0';
+        if(index >= 0 && index < busCount) {
+            return &buses[index];
+        }
+    }
+    return &buses[0];
+}
+
+/* Private: Read the next valid frame from the trace, starting again from the
+ * beginning at the end of the trace.
+ */
+static bool nextTraceFrame(FrameEmulator* emulator, CanBus* buses,
+        int busCount, CanMessage* frame) {
+    if(emulator->trace == NULL || busCount == 0) {
+        return false;
+    }
+
+    // Give up after going through the whole trace once without a valid line
+    bool wrapped = false;
+    TraceFrame traceFrame;
+    while(true) {
+        if(*emulator->traceCursor == '\0') {
+            if(wrapped) {
+                return false;
+            }
+            emulator->traceCursor = emulator->trace;
+            wrapped = true;
+        }
+
+        const char* line = emulator->traceCursor;
+        const char* end = strchr(line, '\n');
+        if(end == NULL) {
+            end = line + strlen(line);
+            emulator->traceCursor = end;
+        } else {
+            emulator->traceCursor = end + 1;
+        }
+
+        if(openxc::can::trace::parseLine(line, end - line, &traceFrame)) {
+            frame->bus = busForFrame(&traceFrame, buses, busCount);
+            frame->id = traceFrame.id;
+            frame->data = traceFrame.data;
+            return true;
+        }
+    }
+}
+
+void openxc::can::emulator::initialize(FrameEmulator* emulator,
+        EmulatorSource source, unsigned int framesPerSecond,
+        const char* trace) {
+    memset(emulator, 0, sizeof(FrameEmulator));
+    emulator->source = source;
+    emulator->trace = trace;
+    emulator->traceCursor = trace;
+    tokenbucket::initialize(&emulator->pacing, framesPerSecond,
+            EMULATOR_MAX_BURST_FRAMES);
+}
+
+bool openxc::can::emulator::nextFrame(FrameEmulator* emulator,
+        CanBus* buses, int busCount, CanSignal* signals, int signalCount,
+        CanMessage* frame) {
+    if(emulator->source == EMULATOR_TRACE) {
+        return nextTraceFrame(emulator, buses, busCount, frame);
+    }
+    return nextSyntheticFrame(buses, busCount, signals, signalCount, frame);
+}
+
+int openxc::can::emulator::update(FrameEmulator* emulator, CanBus* buses,
+        int busCount, CanSignal* signals, int signalCount,
+        unsigned long nowUs) {
+    tokenbucket::refill(&emulator->pacing, nowUs);
+
+    int framesPushed = 0;
+    CanMessage frame;
+    while(tokenbucket::take(&emulator->pacing)) {
+        if(!nextFrame(emulator, buses, busCount, signals, signalCount,
+                    &frame)) {
+            break;
+        }
+
+        if(QUEUE_PUSH(CanMessage, &frame.bus->receiveQueue, frame)) {
+            ++emulator->framesGenerated;
+            ++framesPushed;
+        } else {
+            ++frame.bus->messagesDropped;
+            ++emulator->framesDropped;
+        }
+    }
+    return framesPushed;
+}
+
+bool openxc::can::emulator::discardWrite(CanBus* bus, CanMessage message) {
+    debug("Ignoring write of CAN message with id 0x%x -- running an emulator",
+            message.id);
+    return true;
+}
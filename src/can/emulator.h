@@ -0,0 +1,115 @@
+#ifndef _EMULATOR_H_
+#define _EMULATOR_H_
+
+#include <stdint.h>
+#include "can/canutil.h"
+#include "util/tokenbucket.h"
+
+// The most frames generated at once to catch up on a late call, so a long
+// pause in the main loop doesn't turn into a burst that floods the queues
+#define EMULATOR_MAX_BURST_FRAMES 16
+
+namespace openxc {
+namespace can {
+namespace emulator {
+
+/* Public: Where the emulator gets the frames it feeds to the receive queues.
+ *
+ * EMULATOR_SYNTHETIC - Frames for the messages of randomly chosen signals from
+ *      the active message set, with random data. State based signals are
+ *      always set to one of their valid states.
+ * EMULATOR_TRACE - Frames replayed from a trace compiled into the firmware,
+ *      in any format accepted by trace::parseLine(). The trace starts again
+ *      from the beginning when it runs out.
+ */
+typedef enum {
+    EMULATOR_SYNTHETIC,
+    EMULATOR_TRACE
+} EmulatorSource;
+
+/* Public: The state of a CAN frame emulator.
+ *
+ * source - Where the frames come from.
+ * trace - The NULL terminated trace text, for EMULATOR_TRACE.
+ * traceCursor - The start of the next line of the trace to replay.
+ * pacing - Paces the frames to the rate across all buses. If the rate is 0,
+ *      the emulator is stopped.
+ * framesGenerated - The number of frames pushed to a receive queue.
+ * framesDropped - The number of frames dropped because the receive queue was
+ *      full.
+ */
+typedef struct {
+    EmulatorSource source;
+    const char* trace;
+    const char* traceCursor;
+    openxc::util::tokenbucket::TokenBucket pacing;
+    unsigned long framesGenerated;
+    unsigned long framesDropped;
+} FrameEmulator;
+
+/* Public: The trace compiled into the firmware for EMULATOR_TRACE, defined in
+ * emulator_trace.cpp (see emulator_trace.cpp.example). It's only required
+ * when building with FRAME_EMULATOR_TRACE=1.
+ */
+extern const char EMBEDDED_TRACE[];
+
+/* Public: Set up an emulator. No frames are generated until the first call to
+ * update(), which starts the clock.
+ *
+ * emulator - The emulator to initialize.
+ * source - Where to get the frames from.
+ * framesPerSecond - The rate to generate frames at, across all buses.
+ * trace - The trace to replay for EMULATOR_TRACE, as NULL terminated text with
+ *      one frame per line. Ignored for EMULATOR_SYNTHETIC.
+ */
+void initialize(FrameEmulator* emulator, EmulatorSource source,
+        unsigned int framesPerSecond, const char* trace);
+
+/* Public: Build the next emulated frame, without queueing it.
+ *
+ * emulator - The emulator to get the frame from.
+ * buses - The buses of the active message set.
+ * busCount - The length of the buses array.
+ * signals - The signals of the active message set, to choose messages from for
+ *      synthetic frames.
+ * signalCount - The length of the signals array.
+ * frame - The frame to fill in. Its bus is the bus it should be received on.
+ *
+ * Returns true if a frame was built, or false if there are no signals (for
+ *      synthetic frames) or no valid lines in the trace.
+ */
+bool nextFrame(FrameEmulator* emulator, CanBus* buses, int busCount,
+        CanSignal* signals, int signalCount, CanMessage* frame);
+
+/* Public: Push as many frames to the receive queues as the configured rate
+ * allows for the time since the last update, as if they had been received by
+ * the CAN controllers. Like the receive interrupt handlers, a frame is dropped
+ * and counted in the bus's messagesDropped if its receive queue is full.
+ *
+ * Call this regularly from the main loop - the rate is only as smooth as the
+ * calls are frequent.
+ *
+ * emulator - The emulator to update.
+ * buses - The buses of the active message set.
+ * busCount - The length of the buses array.
+ * signals - The signals of the active message set.
+ * signalCount - The length of the signals array.
+ * nowUs - The current system time in microseconds.
+ *
+ * Returns the number of frames pushed to the receive queues.
+ */
+int update(FrameEmulator* emulator, CanBus* buses, int busCount,
+        CanSignal* signals, int signalCount, unsigned long nowUs);
+
+/* Public: A CanBus writeHandler for emulated buses, which have no controller
+ * to write to. The message is discarded.
+ *
+ * Returns true, as if the message was sent.
+ */
+bool discardWrite(CanBus* bus, CanMessage message);
+
+} // namespace emulator
+} // namespace can
+} // namespace openxc
+
+#endif // _EMULATOR_H_
@@ -0,0 +1,263 @@
+#include "can/loopback.h"
+#include "can/canwrite.h"
+#include "util/timer.h"
+#include "util/log.h"
+#include <string.h>
+
+// Any non-zero seed works - a fixed one makes the losses the same every run
+#define LOOPBACK_RANDOM_SEED 0x2545f491
+
+namespace time = openxc::util::time;
+
+using openxc::can::loopback::Loopback;
+using openxc::can::loopback::LoopbackFrame;
+using openxc::can::loopback::LatencyStatistics;
+using openxc::can::loopback::LOOPBACK_FRAME_WAITING;
+using openxc::can::loopback::LOOPBACK_FRAME_DELIVERED;
+using openxc::can::loopback::LOOPBACK_FRAME_DONE;
+
+const char* openxc::can::loopback::LOOPBACK_COMMAND_NAME = "loopback";
+
+Loopback openxc::can::loopback::LOOPBACK;
+
+/* Private: Returns the next value of a xorshift random number generator. */
+static uint32_t nextRandom(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/* Private: Returns the frame at the given position in the ring buffer, counting
+ * from the oldest.
+ */
+static LoopbackFrame* frameAt(Loopback* loopback, int position) {
+    return &loopback->frames[(loopback->head + position) % LOOPBACK_MAX_FRAMES];
+}
+
+/* Private: Remove the finished frames from the front of the ring buffer. */
+static void removeDoneFrames(Loopback* loopback) {
+    while(loopback->frameCount > 0 &&
+            frameAt(loopback, 0)->state == LOOPBACK_FRAME_DONE) {
+        loopback->head = (loopback->head + 1) % LOOPBACK_MAX_FRAMES;
+        --loopback->frameCount;
+    }
+}
+
+/* Private: Returns the bus that frames written to the bus are received on, or
+ * NULL if it's not looped back.
+ */
+static CanBus* targetFor(Loopback* loopback, CanBus* bus) {
+    for(int i = 0; i < loopback->busCount; i++) {
+        if(loopback->sources[i] == bus) {
+            return loopback->targets[i];
+        }
+    }
+    return NULL;
+}
+
+static void recordLatency(LatencyStatistics* statistics,
+        unsigned long latency) {
+    if(statistics->count == 0 || latency < statistics->minimum) {
+        statistics->minimum = latency;
+    }
+    if(latency > statistics->maximum) {
+        statistics->maximum = latency;
+    }
+    statistics->total += latency;
+    ++statistics->count;
+}
+
+static cJSON* serializeLatency(LatencyStatistics* statistics) {
+    cJSON* latency = cJSON_CreateObject();
+    cJSON_AddNumberToObject(latency, "count", statistics->count);
+    cJSON_AddNumberToObject(latency, "min", statistics->minimum);
+    cJSON_AddNumberToObject(latency, "average", statistics->count > 0 ?
+            statistics->total / statistics->count : 0);
+    cJSON_AddNumberToObject(latency, "max", statistics->maximum);
+    return latency;
+}
+
+void openxc::can::loopback::initialize(bool selfTest) {
+    memset(&LOOPBACK, 0, sizeof(LOOPBACK));
+    LOOPBACK.selfTest = selfTest;
+    LOOPBACK.randomState = LOOPBACK_RANDOM_SEED;
+}
+
+bool openxc::can::loopback::attach(CanBus* bus, CanBus* target) {
+    if(LOOPBACK.busCount >= LOOPBACK_MAX_BUSES) {
+        debug("Unable to loop back bus 0x%x, already have %d",
+                bus->address, LOOPBACK_MAX_BUSES);
+        return false;
+    }
+
+    LOOPBACK.sources[LOOPBACK.busCount] = bus;
+    LOOPBACK.targets[LOOPBACK.busCount] = LOOPBACK.selfTest ? bus : target;
+    ++LOOPBACK.busCount;
+    bus->writeHandler = write;
+    return true;
+}
+
+void openxc::can::loopback::setTarget(CanBus* target) {
+    if(LOOPBACK.selfTest) {
+        debug("The controller receives its own frames in self test mode, "
+                "can't change the target");
+        return;
+    }
+
+    for(int i = 0; i < LOOPBACK.busCount; i++) {
+        LOOPBACK.targets[i] = target;
+    }
+}
+
+void openxc::can::loopback::configure(unsigned int delayUs,
+        unsigned int lossPercent) {
+    LOOPBACK.delayUs = delayUs;
+    LOOPBACK.lossPercent = lossPercent > 100 ? 100 : lossPercent;
+}
+
+void openxc::can::loopback::resetStatistics() {
+    LOOPBACK.framesWritten = 0;
+    LOOPBACK.framesLost = 0;
+    LOOPBACK.framesDropped = 0;
+    LOOPBACK.framesEchoed = 0;
+    memset(&LOOPBACK.writeLatency, 0, sizeof(LOOPBACK.writeLatency));
+    memset(&LOOPBACK.requestLatency, 0, sizeof(LOOPBACK.requestLatency));
+}
+
+void openxc::can::loopback::recordRequest(unsigned long nowUs) {
+    LOOPBACK.requested = true;
+    LOOPBACK.lastRequestTime = nowUs;
+}
+
+bool openxc::can::loopback::write(CanBus* bus, CanMessage message) {
+    CanBus* target = targetFor(&LOOPBACK, bus);
+    if(target == NULL) {
+        return false;
+    }
+
+    ++LOOPBACK.framesWritten;
+    if(LOOPBACK.selfTest) {
+        if(!openxc::can::write::sendMessage(bus, message)) {
+            return false;
+        }
+    } else if(nextRandom(&LOOPBACK.randomState) % 100 <
+            LOOPBACK.lossPercent) {
+        ++LOOPBACK.framesLost;
+        return true;
+    }
+
+    if(LOOPBACK.frameCount >= LOOPBACK_MAX_FRAMES) {
+        ++LOOPBACK.framesDropped;
+        // The controller has it either way, it just won't be measured
+        return LOOPBACK.selfTest;
+    }
+
+    LoopbackFrame* frame = frameAt(&LOOPBACK, LOOPBACK.frameCount);
+    frame->message = message;
+    frame->message.bus = target;
+    frame->requestTime = LOOPBACK.lastRequestTime;
+    frame->writeTime = time::systemTimeUs();
+    frame->state = LOOPBACK.selfTest ? LOOPBACK_FRAME_DELIVERED :
+            LOOPBACK_FRAME_WAITING;
+    ++LOOPBACK.frameCount;
+    return true;
+}
+
+int openxc::can::loopback::update(unsigned long nowUs) {
+    int delivered = 0;
+    for(int i = 0; i < LOOPBACK.frameCount; i++) {
+        LoopbackFrame* frame = frameAt(&LOOPBACK, i);
+        if(frame->state == LOOPBACK_FRAME_DELIVERED) {
+            if(nowUs - frame->writeTime >=
+                    LOOPBACK.delayUs + LOOPBACK_ECHO_TIMEOUT_US) {
+                frame->state = LOOPBACK_FRAME_DONE;
+                ++LOOPBACK.framesDropped;
+            }
+            continue;
+        } else if(frame->state != LOOPBACK_FRAME_WAITING) {
+            continue;
+        }
+
+        // Unsigned subtraction, so the system time wrapping around is harmless
+        if(nowUs - frame->writeTime < LOOPBACK.delayUs) {
+            // Frames come back in the order they were written
+            break;
+        }
+
+        CanBus* bus = frame->message.bus;
+        if(QUEUE_PUSH(CanMessage, &bus->receiveQueue, frame->message)) {
+            frame->state = LOOPBACK_FRAME_DELIVERED;
+            ++delivered;
+        } else {
+            frame->state = LOOPBACK_FRAME_DONE;
+            ++bus->messagesDropped;
+            ++LOOPBACK.framesDropped;
+        }
+    }
+    removeDoneFrames(&LOOPBACK);
+    return delivered;
+}
+
+bool openxc::can::loopback::framesWaiting() {
+    for(int i = 0; i < LOOPBACK.frameCount; i++) {
+        if(frameAt(&LOOPBACK, i)->state == LOOPBACK_FRAME_WAITING) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool openxc::can::loopback::recordReceive(CanBus* bus, CanMessage* message,
+        unsigned long nowUs) {
+    for(int i = 0; i < LOOPBACK.frameCount; i++) {
+        LoopbackFrame* frame = frameAt(&LOOPBACK, i);
+        if(frame->state != LOOPBACK_FRAME_DELIVERED ||
+                frame->message.bus != bus ||
+                frame->message.id != message->id ||
+                frame->message.data != message->data) {
+            continue;
+        }
+
+        // The receive queue is first in, first out, so the older frames
+        // delivered to this bus will never come back
+        for(int j = 0; j < i; j++) {
+            LoopbackFrame* skipped = frameAt(&LOOPBACK, j);
+            if(skipped->state == LOOPBACK_FRAME_DELIVERED &&
+                    skipped->message.bus == bus) {
+                skipped->state = LOOPBACK_FRAME_DONE;
+                ++LOOPBACK.framesDropped;
+            }
+        }
+
+        recordLatency(&LOOPBACK.writeLatency, nowUs - frame->writeTime);
+        if(LOOPBACK.requested) {
+            recordLatency(&LOOPBACK.requestLatency,
+                    nowUs - frame->requestTime);
+        }
+        ++LOOPBACK.framesEchoed;
+        frame->state = LOOPBACK_FRAME_DONE;
+        removeDoneFrames(&LOOPBACK);
+        return true;
+    }
+    return false;
+}
+
+cJSON* openxc::can::loopback::serialize() {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "command_response", LOOPBACK_COMMAND_NAME);
+    cJSON_AddItemToObject(root, "self_test",
+            cJSON_CreateBool(LOOPBACK.selfTest));
+    cJSON_AddNumberToObject(root, "delay_us", LOOPBACK.delayUs);
+    cJSON_AddNumberToObject(root, "loss_percent", LOOPBACK.lossPercent);
+    cJSON_AddNumberToObject(root, "written", LOOPBACK.framesWritten);
+    cJSON_AddNumberToObject(root, "lost", LOOPBACK.framesLost);
+    cJSON_AddNumberToObject(root, "dropped", LOOPBACK.framesDropped);
+    cJSON_AddNumberToObject(root, "echoed", LOOPBACK.framesEchoed);
+    cJSON_AddNumberToObject(root, "in_flight", LOOPBACK.frameCount);
+    cJSON_AddItemToObject(root, "write_latency_us",
+            serializeLatency(&LOOPBACK.writeLatency));
+    cJSON_AddItemToObject(root, "request_latency_us",
+            serializeLatency(&LOOPBACK.requestLatency));
+    return root;
+}
@@ -0,0 +1,223 @@
+#ifndef _LOOPBACK_H_
+#define _LOOPBACK_H_
+
+#include <stdint.h>
+#include "can/canutil.h"
+#include "cJSON.h"
+
+// The most buses that can be looped back
+#define LOOPBACK_MAX_BUSES 4
+// The most frames that can be on their way back at once, waiting for their
+// delay or to be decoded
+#define LOOPBACK_MAX_FRAMES 32
+// How long a frame can be in the receive queue (or, in self test mode, in the
+// controller) before its echo is given up on, e.g. because the receive
+// interrupt dropped it
+#define LOOPBACK_ECHO_TIMEOUT_US 1000000
+
+namespace openxc {
+namespace can {
+namespace loopback {
+
+extern const char* LOOPBACK_COMMAND_NAME;
+
+/* Public: How far a looped back frame has got.
+ *
+ * LOOPBACK_FRAME_WAITING - Written, and waiting for its delay to pass.
+ * LOOPBACK_FRAME_DELIVERED - In the receive queue, waiting to be decoded.
+ * LOOPBACK_FRAME_DONE - Decoded, or dropped because the receive queue was
+ *      full or its echo never came back.
+ */
+typedef enum {
+    LOOPBACK_FRAME_WAITING,
+    LOOPBACK_FRAME_DELIVERED,
+    LOOPBACK_FRAME_DONE
+} LoopbackFrameState;
+
+/* Public: A frame written to a looped back bus, on its way to be decoded.
+ *
+ * message - The frame. Its bus is the bus it will be received on.
+ * requestTime - The system time (in us) of the last write request received
+ *      before the frame was written.
+ * writeTime - The system time (in us) when the frame was written.
+ * state - How far the frame has got.
+ */
+typedef struct {
+    CanMessage message;
+    unsigned long requestTime;
+    unsigned long writeTime;
+    LoopbackFrameState state;
+} LoopbackFrame;
+
+/* Public: The spread of a latency, in microseconds.
+ *
+ * count - The number of samples.
+ * minimum - The smallest sample.
+ * maximum - The largest sample.
+ * total - The sum of all samples, for the average.
+ */
+typedef struct {
+    unsigned long count;
+    unsigned long minimum;
+    unsigned long maximum;
+    uint64_t total;
+} LatencyStatistics;
+
+/* Public: The state of the CAN loopback.
+ *
+ * selfTest - If true, frames are written to the CAN controller, which is in a
+ *      self test mode that receives its own frames. If false, frames are
+ *      delivered to the receive queue of the target bus in software.
+ * sources - The buses whose writes are looped back.
+ * targets - The bus that frames written to each of the sources are received
+ *      on.
+ * busCount - The length of the sources and targets arrays.
+ * delayUs - How long a frame takes to come back, in microseconds. Only for
+ *      software loopback.
+ * lossPercent - The chance that a frame is lost and never comes back. Only
+ *      for software loopback.
+ * randomState - The state of the random number generator for losses.
+ * requested - True once a write request has been received.
+ * lastRequestTime - The system time (in us) of the last write request.
+ * frames - A ring buffer of the frames on their way back.
+ * head - The index of the oldest frame in the frames ring buffer.
+ * frameCount - The number of frames in the ring buffer.
+ * framesWritten - The number of frames written to a looped back bus.
+ * framesLost - The number of frames deliberately lost.
+ * framesDropped - The number of frames dropped because there was no room for
+ *      them in the frames ring buffer or a receive queue, or whose echo never
+ *      came back.
+ * framesEchoed - The number of frames that came back and were decoded.
+ * writeLatency - The time from writing a frame to decoding it.
+ * requestLatency - The time from the last write request to decoding a frame.
+ */
+typedef struct {
+    bool selfTest;
+    CanBus* sources[LOOPBACK_MAX_BUSES];
+    CanBus* targets[LOOPBACK_MAX_BUSES];
+    int busCount;
+    unsigned int delayUs;
+    unsigned int lossPercent;
+    uint32_t randomState;
+    bool requested;
+    unsigned long lastRequestTime;
+    LoopbackFrame frames[LOOPBACK_MAX_FRAMES];
+    int head;
+    int frameCount;
+    unsigned long framesWritten;
+    unsigned long framesLost;
+    unsigned long framesDropped;
+    unsigned long framesEchoed;
+    LatencyStatistics writeLatency;
+    LatencyStatistics requestLatency;
+} Loopback;
+
+/* Public: The global loopback state. A CanBus writeHandler has no context
+ * argument, so there is only one.
+ */
+extern Loopback LOOPBACK;
+
+/* Public: Reset the loopback, with no buses attached, no delay and no losses.
+ *
+ * selfTest - True if the CAN controllers are in self test mode, and receive
+ *      their own frames.
+ */
+void initialize(bool selfTest);
+
+/* Public: Loop back the frames written to a bus, by replacing its
+ * writeHandler.
+ *
+ * bus - The bus to loop back.
+ * target - The bus to receive the frames on, for software loopback. Ignored
+ *      in self test mode, where the controller receives its own frames.
+ *
+ * Returns true if the bus was attached, or false if LOOPBACK_MAX_BUSES are
+ *      already attached.
+ */
+bool attach(CanBus* bus, CanBus* target);
+
+/* Public: Change the target of every attached bus.
+ *
+ * target - The bus to receive all looped back frames on.
+ */
+void setTarget(CanBus* target);
+
+/* Public: Change the delay and losses of the software loopback.
+ *
+ * delayUs - How long a frame takes to come back, in microseconds.
+ * lossPercent - The chance (0 - 100) that a frame is lost.
+ */
+void configure(unsigned int delayUs, unsigned int lossPercent);
+
+/* Public: Clear the frame counters and latency statistics.
+ */
+void resetStatistics();
+
+/* Public: Note that a write request was received, to measure the latency from
+ * the request to the decoded echo of the frames it causes.
+ *
+ * nowUs - The current system time in microseconds.
+ */
+void recordRequest(unsigned long nowUs);
+
+/* Public: A CanBus writeHandler for looped back buses. For software loopback,
+ * the frame may be lost, otherwise it waits for the configured delay before
+ * update() delivers it. In self test mode, the frame is sent to the CAN
+ * controller.
+ *
+ * Returns true if the frame was written (even if it's deliberately lost), or
+ *      false if there was no room for it.
+ */
+bool write(CanBus* bus, CanMessage message);
+
+/* Public: Push the frames whose delay has passed to the receive queue of their
+ * target bus. A frame is dropped and counted in the bus's messagesDropped if
+ * the receive queue is full, like a real CAN controller.
+ *
+ * This pushes to the receive queues from the main loop, so software loopback
+ * must not be used at the same time as a real controller on the target bus.
+ *
+ * A frame whose echo hasn't been decoded LOOPBACK_ECHO_TIMEOUT_US after it was
+ * due back is given up on and counted in framesDropped, so a lost echo doesn't
+ * hold its place in the ring buffer forever.
+ *
+ * nowUs - The current system time in microseconds.
+ *
+ * Returns the number of frames delivered.
+ */
+int update(unsigned long nowUs);
+
+/* Public: Returns true if any frames are waiting for their delay to pass
+ * before update() delivers them.
+ */
+bool framesWaiting();
+
+/* Public: Check a frame that was just decoded against the frames on their way
+ * back, and record the latency if it's one of them. Frames that aren't
+ * echoes are ignored.
+ *
+ * Echoes come back in the order their frames were written, so if the frame
+ * matches a newer frame than the oldest one on its way back to the bus, the
+ * echoes of the older frames were lost (e.g. the receive interrupt dropped
+ * them). They're given up on and counted in framesDropped.
+ *
+ * bus - The bus the frame was received on.
+ * message - The frame.
+ * nowUs - The current system time in microseconds.
+ *
+ * Returns true if the frame was a looped back frame.
+ */
+bool recordReceive(CanBus* bus, CanMessage* message, unsigned long nowUs);
+
+/* Public: Build a report of the loopback settings, frame counters and
+ * latencies.
+ *
+ * Returns a JSON object the caller must free.
+ */
+cJSON* serialize();
+
+} // namespace loopback
+} // namespace can
+} // namespace openxc
+
+#endif // _LOOPBACK_H_
@@ -0,0 +1,251 @@
+#include "can/periodic.h"
+#include "can/canwrite.h"
+#include "util/log.h"
+#include <string.h>
+
+#define WHEEL_MASK (PERIODIC_WHEEL_SLOTS - 1)
+#define NO_FRAME -1
+
+using openxc::can::periodic::PERIODIC;
+using openxc::can::periodic::PeriodicFrame;
+using openxc::can::periodic::PeriodicFrames;
+using openxc::can::periodic::TimerWheel;
+
+const char* openxc::can::periodic::PERIODIC_COMMAND_NAME = "periodic";
+
+PeriodicFrames openxc::can::periodic::PERIODIC;
+
+/* Private: Returns the timer wheel for a bus, or NULL if it doesn't have one.
+ * If create is true, an unused wheel is given to the bus if it doesn't have
+ * one yet.
+ */
+static TimerWheel* wheelFor(CanBus* bus, bool create) {
+    TimerWheel* unused = NULL;
+    for(int i = 0; i < PERIODIC_MAX_BUSES; i++) {
+        TimerWheel* wheel = &PERIODIC.wheels[i];
+        if(wheel->bus == bus) {
+            return wheel;
+        } else if(wheel->bus == NULL && unused == NULL) {
+            unused = wheel;
+        }
+    }
+
+    if(create && unused != NULL) {
+        unused->bus = bus;
+    }
+    return create ? unused : NULL;
+}
+
+/* Private: Add a frame to the front of a slot of the wheel. */
+static void link(TimerWheel* wheel, int index, int slot) {
+    PeriodicFrame* frame = &PERIODIC.frames[index];
+    frame->slot = slot;
+    frame->previous = NO_FRAME;
+    frame->next = wheel->slots[frame->slot];
+    if(frame->next != NO_FRAME) {
+        PERIODIC.frames[frame->next].previous = index;
+    }
+    wheel->slots[frame->slot] = index;
+}
+
+/* Private: Add a frame to the slot of the wheel that comes up after the delay,
+ * with enough rounds to wait for any whole turns of the wheel.
+ *
+ * delayMs - The time from the wheel's current tick, at least 1ms.
+ */
+static void insert(TimerWheel* wheel, int index, unsigned long delayMs) {
+    PERIODIC.frames[index].rounds = (delayMs - 1) / PERIODIC_WHEEL_SLOTS;
+    link(wheel, index, (wheel->currentTick + delayMs) & WHEEL_MASK);
+}
+
+/* Private: Remove a frame from its slot of the wheel. */
+static void unlink(TimerWheel* wheel, int index) {
+    PeriodicFrame* frame = &PERIODIC.frames[index];
+    if(frame->previous == NO_FRAME) {
+        wheel->slots[frame->slot] = frame->next;
+    } else {
+        PERIODIC.frames[frame->previous].next = frame->next;
+    }
+
+    if(frame->next != NO_FRAME) {
+        PERIODIC.frames[frame->next].previous = frame->previous;
+    }
+}
+
+/* Private: Send the frames due in the slot of the wheel's current tick, and
+ * put them back in the wheel for their next period. Frames that are due on a
+ * later turn of the wheel just count down their rounds.
+ *
+ * Returns the number of frames queued.
+ */
+static int processSlot(TimerWheel* wheel) {
+    int slot = wheel->currentTick & WHEEL_MASK;
+    int index = wheel->slots[slot];
+    wheel->slots[slot] = NO_FRAME;
+
+    int queued = 0;
+    while(index != NO_FRAME) {
+        PeriodicFrame* frame = &PERIODIC.frames[index];
+        int next = frame->next;
+        if(frame->rounds > 0) {
+            --frame->rounds;
+            link(wheel, index, slot);
+        } else {
+            if(QUEUE_FULL(CanMessage, &wheel->bus->sendQueue)) {
+                ++frame->missed;
+            } else {
+                openxc::can::write::enqueueMessage(&frame->message,
+                        frame->message.data);
+                ++frame->sent;
+                ++queued;
+            }
+            // From when it was due, so it doesn't drift
+            insert(wheel, index, frame->periodMs);
+        }
+        index = next;
+    }
+    return queued;
+}
+
+void openxc::can::periodic::initialize() {
+    memset(&PERIODIC, 0, sizeof(PERIODIC));
+    for(int i = 0; i < PERIODIC_MAX_FRAMES; i++) {
+        PERIODIC.frames[i].next = i + 1 < PERIODIC_MAX_FRAMES ? i + 1 :
+                NO_FRAME;
+    }
+    PERIODIC.freeFrames = 0;
+
+    for(int i = 0; i < PERIODIC_MAX_BUSES; i++) {
+        for(int j = 0; j < PERIODIC_WHEEL_SLOTS; j++) {
+            PERIODIC.wheels[i].slots[j] = NO_FRAME;
+        }
+    }
+}
+
+PeriodicFrame* openxc::can::periodic::lookup(CanBus* bus, uint32_t id) {
+    for(int i = 0; i < PERIODIC_MAX_FRAMES; i++) {
+        PeriodicFrame* frame = &PERIODIC.frames[i];
+        if(frame->active && frame->message.bus == bus &&
+                frame->message.id == id) {
+            return frame;
+        }
+    }
+    return NULL;
+}
+
+bool openxc::can::periodic::start(CanBus* bus, uint32_t id, uint64_t data,
+        unsigned int periodMs, unsigned long nowMs) {
+    if(periodMs < PERIODIC_MIN_PERIOD_MS) {
+        debug("Period of %dms for 0x%x is too short", periodMs, id);
+        return false;
+    }
+
+    TimerWheel* wheel = wheelFor(bus, true);
+    if(wheel == NULL) {
+        debug("Unable to send 0x%x periodically, already have %d buses", id,
+                PERIODIC_MAX_BUSES);
+        return false;
+    }
+    if(wheel->frameCount == 0) {
+        wheel->currentTick = nowMs;
+    }
+
+    int index;
+    PeriodicFrame* frame = lookup(bus, id);
+    if(frame != NULL) {
+        index = frame - PERIODIC.frames;
+        unlink(wheel, index);
+    } else if(PERIODIC.freeFrames != NO_FRAME) {
+        index = PERIODIC.freeFrames;
+        frame = &PERIODIC.frames[index];
+        PERIODIC.freeFrames = frame->next;
+        memset(frame, 0, sizeof(PeriodicFrame));
+        frame->message.bus = bus;
+        frame->message.id = id;
+        frame->active = true;
+        ++wheel->frameCount;
+    } else {
+        debug("Unable to send 0x%x periodically, already have %d frames", id,
+                PERIODIC_MAX_FRAMES);
+        return false;
+    }
+
+    frame->message.data = data;
+    frame->periodMs = periodMs;
+    if(!QUEUE_FULL(CanMessage, &bus->sendQueue)) {
+        openxc::can::write::enqueueMessage(&frame->message, data);
+        ++frame->sent;
+    } else {
+        ++frame->missed;
+    }
+    // The wheel may not have caught up to now yet
+    insert(wheel, index, periodMs + (nowMs - wheel->currentTick));
+    return true;
+}
+
+bool openxc::can::periodic::stop(CanBus* bus, uint32_t id) {
+    PeriodicFrame* frame = lookup(bus, id);
+    if(frame == NULL) {
+        return false;
+    }
+
+    int index = frame - PERIODIC.frames;
+    TimerWheel* wheel = wheelFor(bus, false);
+    unlink(wheel, index);
+    --wheel->frameCount;
+    frame->active = false;
+    frame->next = PERIODIC.freeFrames;
+    PERIODIC.freeFrames = index;
+    return true;
+}
+
+int openxc::can::periodic::update(CanBus* bus, unsigned long nowMs) {
+    TimerWheel* wheel = wheelFor(bus, false);
+    if(wheel == NULL) {
+        return 0;
+    }
+
+    if(wheel->frameCount == 0) {
+        wheel->currentTick = nowMs;
+        return 0;
+    }
+
+    // Unsigned subtraction, so the system time wrapping around is harmless
+    if(nowMs - wheel->currentTick > PERIODIC_WHEEL_SLOTS) {
+        wheel->currentTick = nowMs - PERIODIC_WHEEL_SLOTS;
+    }
+
+    int queued = 0;
+    while(wheel->currentTick != nowMs) {
+        ++wheel->currentTick;
+        queued += processSlot(wheel);
+    }
+    return queued;
+}
+
+cJSON* openxc::can::periodic::serialize() {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "command_response", PERIODIC_COMMAND_NAME);
+
+    int freeCount = PERIODIC_MAX_FRAMES;
+    cJSON* frames = cJSON_CreateArray();
+    for(int i = 0; i < PERIODIC_MAX_FRAMES; i++) {
+        PeriodicFrame* frame = &PERIODIC.frames[i];
+        if(!frame->active) {
+            continue;
+        }
+
+        --freeCount;
+        cJSON* frameObject = cJSON_CreateObject();
+        cJSON_AddNumberToObject(frameObject, "bus",
+                frame->message.bus->address);
+        cJSON_AddNumberToObject(frameObject, "id", frame->message.id);
+        cJSON_AddNumberToObject(frameObject, "period_ms", frame->periodMs);
+        cJSON_AddNumberToObject(frameObject, "sent", frame->sent);
+        cJSON_AddNumberToObject(frameObject, "missed", frame->missed);
+        cJSON_AddItemToArray(frames, frameObject);
+    }
+    cJSON_AddItemToObject(root, "frames", frames);
+    cJSON_AddNumberToObject(root, "free", freeCount);
+    return root;
+}
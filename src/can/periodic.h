@@ -0,0 +1,149 @@
+#ifndef _PERIODIC_H_
+#define _PERIODIC_H_
+
+#include <stdint.h>
+#include "can/canutil.h"
+#include "cJSON.h"
+
+// The most frames that can be sent periodically at once, across all buses
+#define PERIODIC_MAX_FRAMES 32
+// The most buses with periodic frames
+#define PERIODIC_MAX_BUSES 4
+// The number of slots in each bus's timer wheel, one per millisecond. Must be
+// a power of 2. Frames with a longer period go around the wheel more than
+// once before they're sent.
+#define PERIODIC_WHEEL_SLOTS 64
+// A frame can't be sent more often than this
+#define PERIODIC_MIN_PERIOD_MS 1
+
+namespace openxc {
+namespace can {
+namespace periodic {
+
+extern const char* PERIODIC_COMMAND_NAME;
+
+/* Public: A frame sent over and over with a fixed period.
+ *
+ * message - The frame to send. The data is in the same order as for
+ *      write::enqueueMessage(), which swaps it.
+ * periodMs - How often to send the frame, in milliseconds.
+ * slot - The slot of the timer wheel the frame is in.
+ * rounds - The number of times the wheel must still go around before the
+ *      frame is due, once its slot comes up.
+ * previous - The index of the previous frame in the same slot, or -1 if it's
+ *      the first.
+ * next - The index of the next frame in the same slot (or in the free list),
+ *      or -1 if it's the last.
+ * active - True if the frame is in a timer wheel, false if it's free.
+ * sent - The number of times the frame has been queued to send.
+ * missed - The number of times the frame was due but the send queue was full.
+ */
+typedef struct {
+    CanMessage message;
+    unsigned int periodMs;
+    uint8_t slot;
+    unsigned int rounds;
+    int16_t previous;
+    int16_t next;
+    bool active;
+    unsigned long sent;
+    unsigned long missed;
+} PeriodicFrame;
+
+/* Public: A hashed timer wheel with the periodic frames of one bus.
+ *
+ * Each slot holds a list of the frames due at a time that is the slot's index
+ * modulo the wheel size. Every millisecond, only the frames in one slot are
+ * looked at, so the cost doesn't grow with the number of periodic frames on
+ * other slots.
+ *
+ * bus - The bus the frames are sent on, or NULL if the wheel isn't used.
+ * slots - The index of the first frame in each slot, or -1 if it's empty.
+ * currentTick - The system time (in ms) of the last slot that was processed.
+ * frameCount - The number of frames in the wheel.
+ */
+typedef struct {
+    CanBus* bus;
+    int16_t slots[PERIODIC_WHEEL_SLOTS];
+    unsigned long currentTick;
+    int frameCount;
+} TimerWheel;
+
+/* Public: All periodic frames.
+ *
+ * frames - A fixed pool of frames, shared by all buses.
+ * freeFrames - The index of the first unused frame in the pool, or -1 if the
+ *      pool is empty.
+ * wheels - A timer wheel per bus with periodic frames.
+ */
+typedef struct {
+    PeriodicFrame frames[PERIODIC_MAX_FRAMES];
+    int16_t freeFrames;
+    TimerWheel wheels[PERIODIC_MAX_BUSES];
+} PeriodicFrames;
+
+extern PeriodicFrames PERIODIC;
+
+/* Public: Stop all periodic frames.
+ */
+void initialize();
+
+/* Public: Start sending a frame periodically. It's queued to send once right
+ * away, and then every periodMs. If the frame is already being sent
+ * periodically on the bus, its data and period are changed and its schedule
+ * starts over.
+ *
+ * bus - The bus to send the frame on.
+ * id - The ID of the frame.
+ * data - The data of the frame, in the order for write::enqueueMessage().
+ * periodMs - How often to send it, in milliseconds (at least
+ *      PERIODIC_MIN_PERIOD_MS).
+ * nowMs - The current system time in milliseconds.
+ *
+ * Returns true if the frame was started, or false if the period is too short
+ *      or there's no room for another frame or bus.
+ */
+bool start(CanBus* bus, uint32_t id, uint64_t data, unsigned int periodMs,
+        unsigned long nowMs);
+
+/* Public: Stop sending a frame periodically.
+ *
+ * bus - The bus the frame is sent on.
+ * id - The ID of the frame.
+ *
+ * Returns true if the frame was stopped, or false if it wasn't being sent.
+ */
+bool stop(CanBus* bus, uint32_t id);
+
+/* Public: Returns the periodic frame with the ID on the bus, or NULL if there
+ * isn't one.
+ */
+PeriodicFrame* lookup(CanBus* bus, uint32_t id);
+
+/* Public: Queue the periodic frames of a bus that have come due since the last
+ * update. Called by write::processWriteQueue().
+ *
+ * A frame is rescheduled from the time it was due, not the time it was sent,
+ * so a late update doesn't make it drift - it's only ever sent late by the
+ * delay of the update. If the updates fall behind by more than a whole turn of
+ * the wheel, the missed turns are skipped. A frame that's due when the send
+ * queue is full is counted as missed and tries again next period.
+ *
+ * bus - The bus to update.
+ * nowMs - The current system time in milliseconds.
+ *
+ * Returns the number of frames queued.
+ */
+int update(CanBus* bus, unsigned long nowMs);
+
+/* Public: Build a report of the periodic frames.
+ *
+ * Returns a JSON object the caller must free.
+ */
+cJSON* serialize();
+
+} // namespace periodic
+} // namespace can
+} // namespace openxc
+
+#endif // _PERIODIC_H_
@@ -0,0 +1,204 @@
+#include "can/trace.h"
+#include <stddef.h>
+#include <string.h>
+
+using openxc::can::trace::TraceFrame;
+
+/* Private: Returns the value of a single hex digit, or -1 if it's not one. */
+static int hexDigit(char character) {
+    if(character >= '0' && character <= '9') {
+        return character - '0';
+    } else if(character >= 'a' && character <= 'f') {
+        return character - 'a' + 10;
+    } else if(character >= 'A' && character <= 'F') {
+        return character - 'A' + 10;
+    }
+    return -1;
+}
+
+/* Private: Parse a run of decimal digits, with an optional fraction that is
+ * converted to microseconds.
+ *
+ * Returns a pointer to the first character after the number.
+ */
+static const char* parseDecimal(const char* position, const char* end,
+        uint64_t* whole, uint64_t* fractionUs) {
+    *whole = 0;
+    while(position < end && *position >= '0' && *position <= '9') {
+        *whole = *whole * 10 + (*position++ - '0');
+    }
+
+    *fractionUs = 0;
+    if(position < end && *position == '.') {
+        ++position;
+        int digits = 0;
+        while(position < end && *position >= '0' && *position <= '9') {
+            if(digits < 6) {
+                *fractionUs = *fractionUs * 10 + (*position - '0');
+                ++digits;
+            }
+            ++position;
+        }
+        for(; digits < 6; ++digits) {
+            *fractionUs *= 10;
+        }
+    }
+    return position;
+}
+
+/* Private: Parse up to 8 bytes of hex encoded payload into the frame, in the
+ * same byte order as a message received from a controller.
+ *
+ * Returns a pointer to the first character after the payload.
+ */
+static const char* parsePayload(const char* position, const char* end,
+        TraceFrame* frame) {
+    frame->data = 0;
+    frame->length = 0;
+    while(position + 1 < end && frame->length < 8) {
+        int high = hexDigit(position[0]);
+        int low = hexDigit(position[1]);
+        if(high == -1 || low == -1) {
+            break;
+        }
+        frame->data |= ((uint64_t)((high << 4) | low)) << (frame->length * 8);
+        ++frame->length;
+        position += 2;
+    }
+    return position;
+}
+
+/* Private: Find the value of a field in a flat JSON object.
+ *
+ * Returns a pointer to the first character of the value, or NULL if the field
+ * isn't in the line.
+ */
+static const char* findField(const char* line, const char* end,
+        const char* name) {
+    int nameLength = strlen(name);
+    for(const char* position = line; position + nameLength + 2 <= end;
+            ++position) {
+        if(position[0] == '"' && !strncmp(position + 1, name, nameLength)
+                && position[nameLength + 1] == '"') {
+            position += nameLength + 2;
+            while(position < end && (*position == ' ' || *position == ':')) {
+                ++position;
+            }
+            return position;
+        }
+    }
+    return NULL;
+}
+
+bool openxc::can::trace::parseCandumpLine(const char* line, int length,
+        TraceFrame* frame) {
+    const char* position = line;
+    const char* end = line + length;
+
+    if(position == end || *position != '(') {
+        return false;
+    }
+    ++position;
+
+    // candump always writes 6 decimal places, but handle other precisions
+    uint64_t seconds, fractionUs;
+    position = parseDecimal(position, end, &seconds, &fractionUs);
+    if(position == end || *position++ != ')') {
+        return false;
+    }
+    frame->timestampUs = seconds * 1000000 + fractionUs;
+    frame->busAddress = 0;
+
+    while(position < end && *position == ' ') {
+        ++position;
+    }
+    int nameLength = 0;
+    while(position < end && *position != ' ') {
+        if(nameLength == MAX_TRACE_INTERFACE_NAME_LENGTH - 1) {
+            return false;
+        }
+        frame->interfaceName[nameLength++] = *position++;
+    }
+    frame->interfaceName[nameLength] = '\0';
+    if(nameLength == 0) {
+        return false;
+    }
+
+    while(position < end && *position == ' ') {
+        ++position;
+    }
+    frame->id = 0;
+    int idDigits = 0;
+    for(int digit; position < end && (digit = hexDigit(*position)) != -1;
+            ++position, ++idDigits) {
+        frame->id = (frame->id << 4) | digit;
+    }
+    if(idDigits == 0 || idDigits > 8 || position == end
+            || *position++ != '#') {
+        return false;
+    }
+
+    position = parsePayload(position, end, frame);
+
+    // Anything left over is a remote frame, CAN FD or garbage
+    while(position < end && (*position == ' ' || *position == '\r')) {
+        ++position;
+    }
+    return position == end;
+}
+
+bool openxc::can::trace::parseJsonLine(const char* line, int length,
+        TraceFrame* frame) {
+    const char* end = line + length;
+    const char* idValue = findField(line, end, "id");
+    const char* dataValue = findField(line, end, "data");
+    if(idValue == NULL || dataValue == NULL) {
+        return false;
+    }
+
+    uint64_t whole, fractionUs;
+    if(parseDecimal(idValue, end, &whole, &fractionUs) == idValue) {
+        return false;
+    }
+    frame->id = whole;
+
+    if(dataValue + 3 > end || strncmp(dataValue, "\"0x", 3)) {
+        return false;
+    }
+    const char* position = parsePayload(dataValue + 3, end, frame);
+    if(position == end || *position != '"') {
+        return false;
+    }
+
+    const char* busValue = findField(line, end, "bus");
+    frame->busAddress = 0;
+    if(busValue != NULL) {
+        parseDecimal(busValue, end, &whole, &fractionUs);
+        frame->busAddress = whole;
+    }
+
+    const char* timestampValue = findField(line, end, "timestamp");
+    frame->timestampUs = 0;
+    if(timestampValue != NULL) {
+        parseDecimal(timestampValue, end, &whole, &fractionUs);
+        frame->timestampUs = whole * 1000000 + fractionUs;
+    }
+
+    frame->interfaceName[0] = '\0';
+    return true;
+}
+
+bool openxc::can::trace::parseLine(const char* line, int length,
+        TraceFrame* frame) {
+    while(length > 0 && *line == ' ') {
+        ++line;
+        --length;
+    }
+
+    if(length > 0 && *line == '(') {
+        return parseCandumpLine(line, length, frame);
+    } else if(length > 0 && *line == '{') {
+        return parseJsonLine(line, length, frame);
+    }
+    return false;
+}
@@ -0,0 +1,74 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+
+#define MAX_TRACE_INTERFACE_NAME_LENGTH 16
+
+namespace openxc {
+namespace can {
+namespace trace {
+
+/* Public: A single CAN frame read from a recorded trace.
+ *
+ * timestampUs - The time the frame was captured, in microseconds.
+ * interfaceName - The name of the interface the frame was captured from,
+ *      e.g. "can0", or an empty string if the trace doesn't record it.
+ * busAddress - The address of the bus the frame was captured from, or 0 if the
+ *      trace doesn't record it.
+ * id - The arbitration ID of the frame.
+ * data - The frame's payload, stored in the same byte order as the data of a
+ *      CanMessage received from a controller.
+ * length - The number of data bytes in the frame.
+ */
+typedef struct {
+    uint64_t timestampUs;
+    char interfaceName[MAX_TRACE_INTERFACE_NAME_LENGTH];
+    int busAddress;
+    uint32_t id;
+    uint64_t data;
+    uint8_t length;
+} TraceFrame;
+
+/* Public: Parse one line of a candump log file (as written by "candump -l"),
+ * e.g.:
+ *
+ *      (1436509052.249713) can0 101#0011223344556677
+ *
+ * Remote frames and CAN FD frames are not supported and are rejected.
+ *
+ * line - The line to parse. It doesn't need to be NULL terminated.
+ * length - The length of the line, not including any newline.
+ * frame - The frame to fill in.
+ *
+ * Returns true if the line held a valid frame.
+ */
+bool parseCandumpLine(const char* line, int length, TraceFrame* frame);
+
+/* Public: Parse one line of an OpenXC raw JSON trace, the same format as the
+ * firmware's raw CAN passthrough output, e.g.:
+ *
+ *      {"timestamp": 1351176963.426318, "bus": 1, "id": 42, "data": "0x12"}
+ *
+ * The "id" and "data" fields are required, "bus" and "timestamp" are optional.
+ *
+ * line - The line to parse. It doesn't need to be NULL terminated.
+ * length - The length of the line, not including any newline.
+ * frame - The frame to fill in.
+ *
+ * Returns true if the line held a valid frame.
+ */
+bool parseJsonLine(const char* line, int length, TraceFrame* frame);
+
+/* Public: Parse one line of a trace in either of the supported formats,
+ * detected from the first character of the line.
+ *
+ * Returns true if the line held a valid frame.
+ */
+bool parseLine(const char* line, int length, TraceFrame* frame);
+
+} // namespace trace
+} // namespace can
+} // namespace openxc
+
+#endif // _TRACE_H_
@@ -0,0 +1,175 @@
+#include "can/writelimit.h"
+#include "util/log.h"
+#include <string.h>
+
+namespace tokenbucket = openxc::util::tokenbucket;
+
+using openxc::can::writelimit::WRITE_LIMITS;
+using openxc::can::writelimit::LimitPolicy;
+using openxc::can::writelimit::WriteDecision;
+using openxc::can::writelimit::WriteLimit;
+using openxc::can::writelimit::WriteLimits;
+
+const char* openxc::can::writelimit::WRITE_LIMITS_COMMAND_NAME =
+        "write_limits";
+
+WriteLimits openxc::can::writelimit::WRITE_LIMITS;
+
+/* Private: Set up a limit with a full bucket, and reset its counters.
+ */
+static void configure(WriteLimit* limit, CanBus* bus, uint32_t id,
+        unsigned int framesPerSecond, unsigned int burst,
+        LimitPolicy policy) {
+    memset(limit, 0, sizeof(WriteLimit));
+    limit->bus = bus;
+    limit->id = id;
+    limit->policy = policy;
+    tokenbucket::initialize(&limit->bucket, framesPerSecond,
+            burst > 0 ? burst : 1);
+    tokenbucket::fill(&limit->bucket);
+}
+
+void openxc::can::writelimit::initialize() {
+    memset(&WRITE_LIMITS, 0, sizeof(WRITE_LIMITS));
+}
+
+WriteLimit* openxc::can::writelimit::lookupBus(CanBus* bus) {
+    for(int i = 0; i < WRITE_LIMITS.busCount; i++) {
+        if(WRITE_LIMITS.buses[i].bus == bus) {
+            return &WRITE_LIMITS.buses[i];
+        }
+    }
+    return NULL;
+}
+
+WriteLimit* openxc::can::writelimit::lookupMessage(CanBus* bus, uint32_t id) {
+    for(int i = 0; i < WRITE_LIMITS.messageCount; i++) {
+        WriteLimit* limit = &WRITE_LIMITS.messages[i];
+        if(limit->bus == bus && limit->id == id) {
+            return limit;
+        }
+    }
+    return NULL;
+}
+
+bool openxc::can::writelimit::limitBus(CanBus* bus,
+        unsigned int framesPerSecond, unsigned int burst,
+        LimitPolicy policy) {
+    WriteLimit* limit = lookupBus(bus);
+    if(limit == NULL) {
+        if(WRITE_LIMITS.busCount >= WRITE_LIMIT_MAX_BUSES) {
+            debug("Unable to limit writes to bus %d, already have %d limits",
+                    bus->address, WRITE_LIMIT_MAX_BUSES);
+            return false;
+        }
+        limit = &WRITE_LIMITS.buses[WRITE_LIMITS.busCount++];
+    }
+
+    configure(limit, bus, 0, framesPerSecond, burst, policy);
+    return true;
+}
+
+bool openxc::can::writelimit::limitMessage(CanBus* bus, uint32_t id,
+        unsigned int framesPerSecond, unsigned int burst,
+        LimitPolicy policy) {
+    WriteLimit* limit = lookupMessage(bus, id);
+    if(limit == NULL) {
+        if(WRITE_LIMITS.messageCount >= WRITE_LIMIT_MAX_MESSAGES) {
+            debug("Unable to limit writes of 0x%x, already have %d limits",
+                    id, WRITE_LIMIT_MAX_MESSAGES);
+            return false;
+        }
+        limit = &WRITE_LIMITS.messages[WRITE_LIMITS.messageCount++];
+    }
+
+    configure(limit, bus, id, framesPerSecond, burst, policy);
+    return true;
+}
+
+void openxc::can::writelimit::refill(CanBus* bus, unsigned long nowUs) {
+    WriteLimit* limit = lookupBus(bus);
+    if(limit != NULL) {
+        tokenbucket::refill(&limit->bucket, nowUs);
+    }
+
+    for(int i = 0; i < WRITE_LIMITS.messageCount; i++) {
+        if(WRITE_LIMITS.messages[i].bus == bus) {
+            tokenbucket::refill(&WRITE_LIMITS.messages[i].bucket, nowUs);
+        }
+    }
+}
+
+WriteDecision openxc::can::writelimit::check(CanBus* bus, uint32_t id) {
+    if(WRITE_LIMITS.busCount == 0 && WRITE_LIMITS.messageCount == 0) {
+        return WRITE_SEND;
+    }
+
+    WriteLimit* busLimit = lookupBus(bus);
+    WriteLimit* messageLimit = lookupMessage(bus, id);
+
+    // Look before taking, so a frame held back by one limit doesn't use up a
+    // token of the other
+    WriteLimit* exceeded = NULL;
+    if(messageLimit != NULL &&
+            tokenbucket::available(&messageLimit->bucket) == 0) {
+        exceeded = messageLimit;
+    } else if(busLimit != NULL &&
+            tokenbucket::available(&busLimit->bucket) == 0) {
+        exceeded = busLimit;
+    }
+
+    if(exceeded != NULL) {
+        if(exceeded->policy == LIMIT_DROP) {
+            ++exceeded->dropped;
+            return WRITE_DROP;
+        }
+        ++exceeded->deferred;
+        return WRITE_DEFER;
+    }
+
+    if(messageLimit != NULL) {
+        tokenbucket::take(&messageLimit->bucket);
+        ++messageLimit->sent;
+    }
+    if(busLimit != NULL) {
+        tokenbucket::take(&busLimit->bucket);
+        ++busLimit->sent;
+    }
+    return WRITE_SEND;
+}
+
+static cJSON* serializeLimit(WriteLimit* limit) {
+    cJSON* limitObject = cJSON_CreateObject();
+    cJSON_AddNumberToObject(limitObject, "bus", limit->bus->address);
+    cJSON_AddNumberToObject(limitObject, "rate", limit->bucket.ratePerSecond);
+    cJSON_AddNumberToObject(limitObject, "burst", limit->bucket.burst);
+    cJSON_AddStringToObject(limitObject, "policy",
+            limit->policy == openxc::can::writelimit::LIMIT_DROP ?
+                "drop" : "queue");
+    cJSON_AddNumberToObject(limitObject, "sent", limit->sent);
+    cJSON_AddNumberToObject(limitObject, "deferred", limit->deferred);
+    cJSON_AddNumberToObject(limitObject, "dropped", limit->dropped);
+    return limitObject;
+}
+
+cJSON* openxc::can::writelimit::serialize() {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "command_response",
+            WRITE_LIMITS_COMMAND_NAME);
+
+    cJSON* buses = cJSON_CreateArray();
+    for(int i = 0; i < WRITE_LIMITS.busCount; i++) {
+        cJSON_AddItemToArray(buses, serializeLimit(&WRITE_LIMITS.buses[i]));
+    }
+    cJSON_AddItemToObject(root, "buses", buses);
+
+    cJSON* messages = cJSON_CreateArray();
+    for(int i = 0; i < WRITE_LIMITS.messageCount; i++) {
+        WriteLimit* limit = &WRITE_LIMITS.messages[i];
+        cJSON* limitObject = serializeLimit(limit);
+        cJSON_AddNumberToObject(limitObject, "id", limit->id);
+        cJSON_AddItemToArray(messages, limitObject);
+    }
+    cJSON_AddItemToObject(root, "messages", messages);
+    return root;
+}
@@ -0,0 +1,159 @@
+#ifndef _WRITELIMIT_H_
+#define _WRITELIMIT_H_
+
+#include <stdint.h>
+#include "can/canutil.h"
+#include "util/tokenbucket.h"
+#include "cJSON.h"
+
+// The most buses with a write rate limit
+#define WRITE_LIMIT_MAX_BUSES 4
+// The most message IDs with a write rate limit of their own, across all buses
+#define WRITE_LIMIT_MAX_MESSAGES 16
+
+namespace openxc {
+namespace can {
+namespace writelimit {
+
+extern const char* WRITE_LIMITS_COMMAND_NAME;
+
+/* Public: What to do with a frame written faster than its limit allows.
+ *
+ * LIMIT_QUEUE - Keep it in the send queue until a token is earned. Frames
+ *      with other IDs aren't held up behind it, and frames with the same ID
+ *      stay in order. Once the send queue is full, new writes are refused.
+ * LIMIT_DROP - Drop it.
+ */
+typedef enum {
+    LIMIT_QUEUE,
+    LIMIT_DROP,
+} LimitPolicy;
+
+/* Public: What to do with a frame at the front of the send queue.
+ *
+ * WRITE_SEND - Send it now, it's within all of its limits.
+ * WRITE_DEFER - Leave it in the send queue for a later pass.
+ * WRITE_DROP - Drop it.
+ */
+typedef enum {
+    WRITE_SEND,
+    WRITE_DEFER,
+    WRITE_DROP,
+} WriteDecision;
+
+/* Public: A rate limit on the frames written to a bus, or to one message ID on
+ * a bus.
+ *
+ * bus - The bus the limit applies to.
+ * id - The message ID the limit applies to. Not used for a bus limit.
+ * bucket - The tokens for the limit, one per frame.
+ * policy - What to do with frames over the limit.
+ * sent - The number of frames sent within the limit.
+ * deferred - The number of times a frame over the limit was left in the send
+ *      queue. A frame held back for several passes counts more than once.
+ * dropped - The number of frames dropped because they were over the limit.
+ */
+typedef struct {
+    CanBus* bus;
+    uint32_t id;
+    openxc::util::tokenbucket::TokenBucket bucket;
+    LimitPolicy policy;
+    unsigned long sent;
+    unsigned long deferred;
+    unsigned long dropped;
+} WriteLimit;
+
+/* Public: All write rate limits.
+ *
+ * buses - The limits on the total frames written to each bus.
+ * busCount - The number of limits in buses.
+ * messages - The limits on the frames written with one ID.
+ * messageCount - The number of limits in messages.
+ */
+typedef struct {
+    WriteLimit buses[WRITE_LIMIT_MAX_BUSES];
+    int busCount;
+    WriteLimit messages[WRITE_LIMIT_MAX_MESSAGES];
+    int messageCount;
+} WriteLimits;
+
+extern WriteLimits WRITE_LIMITS;
+
+/* Public: Remove all write rate limits.
+ */
+void initialize();
+
+/* Public: Limit the rate of frames written to a bus. Meant to be called from
+ * the message set's signals::initialize(), so a host can't write frames fast
+ * enough to hold up the vehicle's own traffic. If the bus already has a limit,
+ * it's replaced.
+ *
+ * The limit starts full, so a burst of frames can be sent right away.
+ *
+ * bus - The bus to limit.
+ * framesPerSecond - The most frames to send per second, on average.
+ * burst - The most frames to send at once after a quiet period (at least 1).
+ * policy - What to do with frames over the limit.
+ *
+ * Returns true if the limit was added, or false if there's no room for it.
+ */
+bool limitBus(CanBus* bus, unsigned int framesPerSecond, unsigned int burst,
+        LimitPolicy policy);
+
+/* Public: Limit the rate of frames written with one ID on a bus, in addition
+ * to any limit on the whole bus. If the message already has a limit, it's
+ * replaced.
+ *
+ * bus - The bus the message is written to.
+ * id - The ID of the message.
+ * framesPerSecond - The most frames to send per second, on average.
+ * burst - The most frames to send at once after a quiet period (at least 1).
+ * policy - What to do with frames over the limit.
+ *
+ * Returns true if the limit was added, or false if there's no room for it.
+ */
+bool limitMessage(CanBus* bus, uint32_t id, unsigned int framesPerSecond,
+        unsigned int burst, LimitPolicy policy);
+
+/* Public: Returns the limit on a bus, or NULL if it doesn't have one.
+ */
+WriteLimit* lookupBus(CanBus* bus);
+
+/* Public: Returns the limit on a message ID on a bus, or NULL if it doesn't
+ * have one.
+ */
+WriteLimit* lookupMessage(CanBus* bus, uint32_t id);
+
+/* Public: Add the tokens earned since the last refill to all of the limits of
+ * a bus. Called by write::processWriteQueue() before it sends anything.
+ *
+ * bus - The bus to refill.
+ * nowUs - The current system time in microseconds.
+ */
+void refill(CanBus* bus, unsigned long nowUs);
+
+/* Public: Decide whether a frame can be sent to a bus, and take a token from
+ * each of its limits if it can.
+ *
+ * A frame is sent only if both its message and bus limits have a token. If
+ * the message limit is out of tokens its policy applies, otherwise the bus
+ * limit's policy does.
+ *
+ * bus - The bus the frame is for.
+ * id - The ID of the frame.
+ *
+ * Returns what to do with the frame.
+ */
+WriteDecision check(CanBus* bus, uint32_t id);
+
+/* Public: Build a report of the write rate limits and their counters.
+ *
+ * Returns a JSON object the caller must free.
+ */
+cJSON* serialize();
+
+} // namespace writelimit
+} // namespace can
+} // namespace openxc
+
+#endif // _WRITELIMIT_H_
@@ -6,28 +6,88 @@
 #include "interface/network.h"
 #include "util/log.h"
 #include "util/timer.h"
+#include "util/tokenbucket.h"
 #include "signals.h"
+#include "scheduler.h"
+#include "statistics.h"
+#include "cJSON.h"
 #include <stdlib.h>
 
 #define NUMERICAL_SIGNAL_COUNT 11
 #define BOOLEAN_SIGNAL_COUNT 5
 #define STATE_SIGNAL_COUNT 2
 #define EVENT_SIGNAL_COUNT 1
-#define EMULATOR_SEND_FREQUENCY 1000
+#define SIGNAL_TYPE_COUNT 4
+
+// The default output rate in messages per second, if not set at build time
+// with EMULATOR_RATE
+#ifndef EMULATOR_RATE
+#define EMULATOR_RATE 100
+#endif // EMULATOR_RATE
+
+// The most messages generated in one pass of the main loop to catch up, so
+// the output and USB tasks still get a turn at high rates
+#define EMULATOR_MAX_BURST_MESSAGES 32
+#define EMULATOR_REPORT_PERIOD_MS 10000
 
 namespace uart = openxc::interface::uart;
 namespace network = openxc::interface::network;
 namespace usb = openxc::interface::usb;
+namespace time = openxc::util::time;
+namespace tokenbucket = openxc::util::tokenbucket;
+namespace statistics = openxc::statistics;
 
 using openxc::can::read::sendNumericalMessage;
 using openxc::can::read::sendBooleanMessage;
 using openxc::can::read::sendStringMessage;
 using openxc::can::read::sendEventedBooleanMessage;
-
-int emulatorRateLimiter = 0;
+using openxc::pipeline::MESSAGE_TYPE_COUNT;
+using openxc::pipeline::MESSAGE_TYPE_NAMES;
+using openxc::pipeline::PipelineStatistics;
+using openxc::util::tokenbucket::TokenBucket;
 
 extern Pipeline pipeline;
 
+const char* EMULATOR_COMMAND_NAME = "emulator";
+
+/* Private: The kinds of message the emulator sends, used to index the mix. */
+typedef enum {
+    NUMERICAL,
+    BOOLEAN,
+    STATE,
+    EVENT
+} EmulatedSignalType;
+
+const char* SIGNAL_TYPE_NAMES[SIGNAL_TYPE_COUNT] = {
+    "numerical",
+    "boolean",
+    "state",
+    "event",
+};
+
+/* Private: The output settings and counters of the emulator.
+ *
+ * pacing - Paces the messages to the requested rate.
+ * mix - The relative weight of each kind of message, indexed by
+ *      EmulatedSignalType.
+ * mixTotal - The sum of the weights in mix.
+ * messagesGenerated - The number of messages generated since the settings were
+ *      last changed.
+ * startTime - The system time (in ms) when the settings were last changed.
+ * startStatistics - A copy of the pipeline statistics when the settings were
+ *      last changed, to find the rate and drops for each interface since.
+ */
+typedef struct {
+    TokenBucket pacing;
+    unsigned int mix[SIGNAL_TYPE_COUNT];
+    unsigned int mixTotal;
+    unsigned long messagesGenerated;
+    unsigned long startTime;
+    PipelineStatistics startStatistics[MESSAGE_TYPE_COUNT];
+} Emulator;
+
+Emulator emulator;
+
 const char* NUMERICAL_SIGNALS[NUMERICAL_SIGNAL_COUNT] = {
     "steering_wheel_angle",
     "torque_at_transmission",
@@ -73,42 +133,223 @@ Event EVENT_SIGNAL_STATES[EVENT_SIGNAL_COUNT][3] = {
     { {"driver", false}, {"passenger", true}, {"rear_right", true}},
 };
 
-void setup() {
-    srand(42);
+/* Private: Start counting the achieved rate and drops again, after the
+ * settings change.
+ */
+void restartCounters() {
+    emulator.messagesGenerated = 0;
+    emulator.startTime = time::systemTimeMs();
+    memcpy(emulator.startStatistics, pipeline.statistics,
+            sizeof(emulator.startStatistics));
 }
 
-bool usbWriteStub(uint8_t* buffer) {
-    debug("Ignoring write request -- running an emulator");
-    return true;
-}
+/* Private: Send one random message, of a kind chosen by the mix. */
+void sendRandomMessage() {
+    unsigned int choice = rand() % emulator.mixTotal;
+    int type = 0;
+    while(choice >= emulator.mix[type]) {
+        choice -= emulator.mix[type];
+        ++type;
+    }
 
-void loop() {
-    ++emulatorRateLimiter;
-    if(emulatorRateLimiter == EMULATOR_SEND_FREQUENCY / 2) {
+    switch(type) {
+    case NUMERICAL:
         sendNumericalMessage(
                 NUMERICAL_SIGNALS[rand() % NUMERICAL_SIGNAL_COUNT],
                 rand() % 50 + rand() % 100 * .1, &pipeline);
+        break;
+    case BOOLEAN:
         sendBooleanMessage(BOOLEAN_SIGNALS[rand() % BOOLEAN_SIGNAL_COUNT],
                 rand() % 2 == 1 ? true : false, &pipeline);
-    } else if(emulatorRateLimiter == EMULATOR_SEND_FREQUENCY) {
-        emulatorRateLimiter = 0;
-
+        break;
+    case STATE:
+    {
         int stateSignalIndex = rand() % STATE_SIGNAL_COUNT;
         sendStringMessage(STATE_SIGNALS[stateSignalIndex],
                 EMULATED_SIGNAL_STATES[stateSignalIndex][rand() % 3], &pipeline);
-
+        break;
+    }
+    case EVENT:
+    {
         int eventSignalIndex = rand() % EVENT_SIGNAL_COUNT;
         Event randomEvent = EVENT_SIGNAL_STATES[eventSignalIndex][rand() % 3];
         sendEventedBooleanMessage(EVENT_SIGNALS[eventSignalIndex],
                 randomEvent.value, randomEvent.event, &pipeline);
+        break;
+    }
+    }
+    ++emulator.messagesGenerated;
+}
+
+/* Private: Returns the number of events per second, given a count over a
+ * period in milliseconds.
+ */
+float ratePerSecond(unsigned long count, unsigned long elapsedMs) {
+    if(elapsedMs == 0) {
+        return 0;
+    }
+    return count * 1000.0 / elapsedMs;
+}
+
+/* Private: Build a report of the requested and achieved output rate, and the
+ * rate and drops for each output interface, since the settings last changed.
+ *
+ * Returns a JSON object the caller must free.
+ */
+cJSON* serializeReport() {
+    unsigned long elapsedMs = time::systemTimeMs() - emulator.startTime;
+
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "command_response", EMULATOR_COMMAND_NAME);
+    cJSON_AddNumberToObject(root, "requested_rate",
+            emulator.pacing.ratePerSecond);
+    cJSON_AddNumberToObject(root, "achieved_rate",
+            ratePerSecond(emulator.messagesGenerated, elapsedMs));
+    cJSON_AddNumberToObject(root, "generated", emulator.messagesGenerated);
+    cJSON_AddNumberToObject(root, "elapsed_ms", elapsedMs);
+
+    cJSON* mix = cJSON_CreateObject();
+    for(int i = 0; i < SIGNAL_TYPE_COUNT; i++) {
+        cJSON_AddNumberToObject(mix, SIGNAL_TYPE_NAMES[i], emulator.mix[i]);
     }
+    cJSON_AddItemToObject(root, "mix", mix);
 
-    usb::read(pipeline.usb, usbWriteStub);
-    uart::read(pipeline.uart, usbWriteStub);
+    cJSON* interfaces = cJSON_CreateObject();
+    for(int i = 0; i < MESSAGE_TYPE_COUNT; i++) {
+        unsigned int sent = pipeline.statistics[i].messagesSent -
+                emulator.startStatistics[i].messagesSent;
+        cJSON* interfaceObject = cJSON_CreateObject();
+        cJSON_AddNumberToObject(interfaceObject, "sent", sent);
+        cJSON_AddNumberToObject(interfaceObject, "rate",
+                ratePerSecond(sent, elapsedMs));
+        cJSON_AddNumberToObject(interfaceObject, "dropped",
+                pipeline.statistics[i].messagesDropped -
+                emulator.startStatistics[i].messagesDropped);
+        cJSON_AddItemToObject(interfaces, MESSAGE_TYPE_NAMES[i],
+                interfaceObject);
+    }
+    cJSON_AddItemToObject(root, "interfaces", interfaces);
+    return root;
+}
+
+/* Private: Apply any new rate and mix in an emulator command, e.g.:
+ *
+ *      {"command": "emulator", "rate": 5000,
+ *          "mix": {"numerical": 4, "boolean": 2, "state": 1, "event": 1}}
+ *
+ * Both fields are optional - kinds of message missing from the mix keep their
+ * weight. The response is a report of the achieved rate since the settings
+ * last changed, so a command with no fields just reads the report.
+ */
+void receiveEmulatorCommand(cJSON* root) {
+    bool changed = false;
+    cJSON* rateObject = cJSON_GetObjectItem(root, "rate");
+    if(rateObject != NULL && rateObject->type == cJSON_Number &&
+            rateObject->valueint >= 0) {
+        tokenbucket::setRate(&emulator.pacing, rateObject->valueint);
+        changed = true;
+    }
+
+    cJSON* mixObject = cJSON_GetObjectItem(root, "mix");
+    if(mixObject != NULL) {
+        unsigned int mix[SIGNAL_TYPE_COUNT];
+        unsigned int mixTotal = 0;
+        for(int i = 0; i < SIGNAL_TYPE_COUNT; i++) {
+            cJSON* weight = cJSON_GetObjectItem(mixObject, SIGNAL_TYPE_NAMES[i]);
+            mix[i] = emulator.mix[i];
+            if(weight != NULL && weight->type == cJSON_Number &&
+                    weight->valueint >= 0) {
+                mix[i] = weight->valueint;
+            }
+            mixTotal += mix[i];
+        }
+
+        if(mixTotal > 0) {
+            memcpy(emulator.mix, mix, sizeof(mix));
+            emulator.mixTotal = mixTotal;
+            changed = true;
+        } else {
+            debug("Ignoring emulator mix with no messages");
+        }
+    }
+
+    if(changed) {
+        restartCounters();
+    }
+
+    cJSON* response = serializeReport();
+    char* message = cJSON_PrintUnformatted(response);
+    sendMessage(&pipeline, (uint8_t*) message, strlen(message));
+    cJSON_Delete(response);
+    statistics::freeJsonString(message);
+}
+
+bool receiveCommand(uint8_t* message, int length) {
+    cJSON *root = cJSON_Parse((char*)message);
+    if(root == NULL) {
+        debug("Unable to parse incoming command -- "
+                "if it's valid, may be out of memory");
+        return false;
+    }
+
+    cJSON* commandObject = cJSON_GetObjectItem(root, "command");
+    if(commandObject != NULL && commandObject->valuestring != NULL &&
+            !strcmp(commandObject->valuestring, EMULATOR_COMMAND_NAME)) {
+        receiveEmulatorCommand(root);
+    } else {
+        debug("Ignoring write request -- running an emulator");
+    }
+    cJSON_Delete(root);
+    return true;
+}
+
+bool emulatorTask() {
+    tokenbucket::refill(&emulator.pacing, time::systemTimeUs());
+    while(tokenbucket::take(&emulator.pacing)) {
+        sendRandomMessage();
+    }
+    return false;
+}
+
+bool readInputTask() {
+    usb::read(pipeline.usb, receiveCommand);
+    uart::read(pipeline.uart, receiveCommand);
+    return false;
+}
+
+bool reportTask() {
+    unsigned long elapsedMs = time::systemTimeMs() - emulator.startTime;
+    debug("Emulator sent %d messages/s of %d requested",
+            (int) ratePerSecond(emulator.messagesGenerated, elapsedMs),
+            emulator.pacing.ratePerSecond);
+    return false;
+}
+
+void setup() {
+    srand(42);
+    tokenbucket::initialize(&emulator.pacing, EMULATOR_RATE,
+            EMULATOR_MAX_BURST_MESSAGES);
+    for(int i = 0; i < SIGNAL_TYPE_COUNT; i++) {
+        emulator.mix[i] = 1;
+    }
+    emulator.mixTotal = SIGNAL_TYPE_COUNT;
+    restartCounters();
+
+    openxc::scheduler::registerTask("emulator", emulatorTask,
+            openxc::scheduler::PRIORITY_HIGH, 0, 0);
+    openxc::scheduler::registerTask("input", readInputTask,
+            openxc::scheduler::PRIORITY_LOW, 0, 0);
+    openxc::scheduler::registerTask("emulator_report", reportTask,
+            openxc::scheduler::PRIORITY_LOW, EMULATOR_REPORT_PERIOD_MS, 0);
 }
 
 void reset() { }
 
+bool idle() {
+    // The emulator always has more messages to generate
+    return false;
+}
+
 const int MESSAGE_SET_COUNT = 1;
 CanMessageSet MESSAGE_SETS[MESSAGE_SET_COUNT] = {
     { 0, "emulator", 0, 0, 0 }
@@ -2,8 +2,12 @@
 
 #include "interface/usb.h"
 #include "can/canread.h"
+#include "can/periodic.h"
+#include "can/writelimit.h"
 #include "interface/uart.h"
 #include "interface/network.h"
+#include "util/bytebuffer.h"
+#include "util/writeparser.h"
 #include "signals.h"
 #include "util/log.h"
 #include "cJSON.h"
@@ -13,9 +17,33 @@
 #include "power.h"
 #include "bluetooth.h"
 #include "platform/platform.h"
+#include "statistics.h"
+#include "scheduler.h"
+#include "profiler.h"
+#ifdef FRAME_EMULATOR
+#include "can/emulator.h"
+#endif // FRAME_EMULATOR
+#ifdef CAN_LOOPBACK
+#include "can/loopback.h"
+#endif // CAN_LOOPBACK
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 
+// Keep decoding CAN messages for up to this long per pass while the receive
+// queues are backed up, before giving the rest of the tasks a turn
+#define CAN_READ_BUDGET_US 2000
+#define DATA_LIGHTS_PERIOD_MS 50
+// The longest signal or command name in a binary named write record, including
+// the NULL character
+#define MAX_WRITE_NAME_LENGTH 64
+// The longest batch acknowledgment, including the NULL character
+#define MAX_BATCH_RESPONSE_LENGTH 80
+
+#ifndef FRAME_EMULATOR_RATE
+#define FRAME_EMULATOR_RATE 1000
+#endif // FRAME_EMULATOR_RATE
+
 namespace uart = openxc::interface::uart;
 namespace network = openxc::interface::network;
 namespace usb = openxc::interface::usb;
@@ -24,6 +52,10 @@ namespace can = openxc::can;
 namespace platform = openxc::platform;
 namespace time = openxc::util::time;
 namespace signals = openxc::signals;
+namespace statistics = openxc::statistics;
+namespace scheduler = openxc::scheduler;
+namespace profiler = openxc::profiler;
+namespace writeparser = openxc::util::writeparser;
 
 using openxc::can::lookupCommand;
 using openxc::can::lookupSignal;
@@ -35,150 +67,809 @@ using openxc::signals::getCommandCount;
 using openxc::signals::getSignals;
 using openxc::signals::getSignalCount;
 using openxc::signals::decodeCanMessage;
+using openxc::scheduler::registerTask;
+
+const char* BATCH_RESPONSE_NAME = "batch";
 
 extern Pipeline pipeline;
 
+openxc::can::BusActivity busActivity;
+
+#ifdef FRAME_EMULATOR
+namespace emulator = openxc::can::emulator;
+
+emulator::FrameEmulator frameEmulator;
+#endif // FRAME_EMULATOR
+
+#ifdef CAN_LOOPBACK
+namespace loopback = openxc::can::loopback;
+#endif // CAN_LOOPBACK
+
 /* Forward declarations */
 
-void receiveCan(Pipeline*, CanBus*);
+bool receiveCan(Pipeline*, CanBus*);
 void initializeAllCan();
-bool receiveWriteRequest(uint8_t*);
+bool receiveWriteRequest(uint8_t*, int);
 void updateDataLights();
 
-void setup() {
-    initializeAllCan();
-    signals::initialize();
-}
-
-void loop() {
+/* Private: Scheduler task to decode messages from all CAN receive queues.
+ *
+ * Returns true if any of the queues still have messages waiting.
+ */
+bool receiveCanTask() {
+    bool moreWork = false;
     for(int i = 0; i < getCanBusCount(); i++) {
-        receiveCan(&pipeline, &getCanBuses()[i]);
+        if(receiveCan(&pipeline, &getCanBuses()[i])) {
+            moreWork = true;
+        }
     }
+    return moreWork;
+}
 
+bool readInputTask() {
     usb::read(pipeline.usb, receiveWriteRequest);
-    uart::read(pipeline.uart, receiveWriteRequest);
     network::read(pipeline.network, receiveWriteRequest);
+    return false;
+}
 
+/* Private: Scheduler task to handle writes from UART. It's separate from the
+ * other interfaces so the time spent reading UART shows up on its own in the
+ * task statistics.
+ */
+bool readUartTask() {
+    uart::read(pipeline.uart, receiveWriteRequest);
+    return false;
+}
+
+bool writeCanTask() {
     for(int i = 0; i < getCanBusCount(); i++) {
         can::write::processWriteQueue(&getCanBuses()[i]);
     }
+    return false;
+}
 
-    updateDataLights();
+bool signalsTask() {
     openxc::signals::loop();
+    return false;
 }
 
-/* Public: Update the color and status of a board's light that shows the status
- * of the CAN bus. This function is intended to be called each time through the
- * main program loop.
+bool updateDataLightsTask() {
+    updateDataLights();
+    return false;
+}
+
+#ifdef FRAME_EMULATOR
+/* Private: Scheduler task to feed emulated frames into the CAN receive queues,
+ * in place of the CAN controllers.
  */
-void updateDataLights() {
-    static unsigned long startupTime = time::systemTimeMs();
-    static bool busWasActive;
-    bool busActive = false;
+bool emulateCanTask() {
+    emulator::update(&frameEmulator, getCanBuses(), getCanBusCount(),
+            getSignals(), getSignalCount(), time::systemTimeUs());
+    return false;
+}
+#endif // FRAME_EMULATOR
+
+#ifdef CAN_LOOPBACK
+/* Private: Scheduler task to deliver looped back frames to the CAN receive
+ * queues once their delay has passed.
+ */
+bool loopbackTask() {
+    loopback::update(time::systemTimeUs());
+    return false;
+}
+#endif // CAN_LOOPBACK
+
+/* Public: Check if there is any CAN or input work waiting, to decide if the main
+ * loop can sleep until the next interrupt. This is called with interrupts
+ * disabled, so it must be quick.
+ *
+ * A signal write only marks its message dirty, so a bus with dirty messages
+ * isn't idle - otherwise the write would wait for the next timer tick before
+ * it's flushed.
+ */
+bool idle() {
+#ifdef FRAME_EMULATOR
+    if(frameEmulator.pacing.ratePerSecond > 0) {
+        // The emulator always has more frames to generate
+        return false;
+    }
+#endif // FRAME_EMULATOR
+
+#ifdef CAN_LOOPBACK
+    if(loopback::framesWaiting()) {
+        return false;
+    }
+#endif // CAN_LOOPBACK
+
     for(int i = 0; i < getCanBusCount(); i++) {
-        busActive = busActive || can::busActive(&getCanBuses()[i]);
+        CanBus* bus = &getCanBuses()[i];
+        if(!QUEUE_EMPTY(CanMessage, &bus->receiveQueue) ||
+                !QUEUE_EMPTY(CanMessage, &bus->sendQueue) ||
+                bus->dirtyMessageCount > 0) {
+            return false;
+        }
+    }
+
+    if(uart::connected(pipeline.uart) &&
+            !QUEUE_EMPTY(uint8_t, &pipeline.uart->receiveQueue)) {
+        return false;
     }
+    return true;
+}
+
+void setup() {
+    initializeAllCan();
+    // Before the message set, which may add limits, and not in reset() so they
+    // are kept
+    can::writelimit::initialize();
+    signals::initialize();
+    can::initializeBusActivity(&busActivity);
+
+    registerTask("can_read", receiveCanTask, scheduler::PRIORITY_CRITICAL, 0,
+            CAN_READ_BUDGET_US);
+    registerTask("can_write", writeCanTask, scheduler::PRIORITY_HIGH, 0, 0);
+    registerTask("input", readInputTask, scheduler::PRIORITY_LOW, 0, 0);
+    registerTask("uart_input", readUartTask, scheduler::PRIORITY_LOW, 0, 0);
+    registerTask("signals", signalsTask, scheduler::PRIORITY_NORMAL, 0, 0);
+    registerTask("data_lights", updateDataLightsTask, scheduler::PRIORITY_LOW,
+            DATA_LIGHTS_PERIOD_MS, 0);
+
+#ifdef FRAME_EMULATOR
+#ifdef FRAME_EMULATOR_TRACE
+    emulator::initialize(&frameEmulator, emulator::EMULATOR_TRACE,
+            FRAME_EMULATOR_RATE, emulator::EMBEDDED_TRACE);
+#else
+    emulator::initialize(&frameEmulator, emulator::EMULATOR_SYNTHETIC,
+            FRAME_EMULATOR_RATE, NULL);
+#endif // FRAME_EMULATOR_TRACE
+    registerTask("emulator", emulateCanTask, scheduler::PRIORITY_HIGH, 0, 0);
+#endif // FRAME_EMULATOR
+
+#ifdef CAN_LOOPBACK
+    registerTask("loopback", loopbackTask, scheduler::PRIORITY_HIGH, 0, 0);
+#endif // CAN_LOOPBACK
+}
 
-    if(!busWasActive && busActive) {
+/* Public: Update the color and status of a board's light that shows the status
+ * of the CAN bus. This function is intended to be called periodically from the
+ * main program loop.
+ */
+void updateDataLights() {
+    switch(can::updateBusActivity(&busActivity, getCanBuses(),
+                getCanBusCount())) {
+    case can::BUS_ACTIVITY_WOKE:
         debug("CAN woke up - enabling LED");
         lights::enable(lights::LIGHT_A, lights::COLORS.blue);
-        busWasActive = true;
-    } else if(!busActive && (busWasActive || time::systemTimeMs() - startupTime >
-            (unsigned long)openxc::can::CAN_ACTIVE_TIMEOUT_S * 1000)) {
-        // stay awake at least CAN_ACTIVE_TIMEOUT_S after power on
+        break;
+    case can::BUS_ACTIVITY_SILENT:
 #ifndef TRANSMITTER
 #ifndef __DEBUG__
-        busWasActive = false;
         platform::suspend(&pipeline);
 #endif
 #endif
+        break;
+    default:
+        break;
     }
 }
 
 void initializeAllCan() {
+    can::periodic::initialize();
+#ifdef CAN_LOOPBACK
+#ifdef CAN_LOOPBACK_SELF_TEST
+    loopback::initialize(true);
+#else
+    loopback::initialize(false);
+#endif // CAN_LOOPBACK_SELF_TEST
+#endif // CAN_LOOPBACK
+
     for(int i = 0; i < getCanBusCount(); i++) {
+#ifdef FRAME_EMULATOR
+        // Leave the controllers off - the emulator stands in for them
+        can::initializeCommon(&(getCanBuses()[i]));
+        getCanBuses()[i].writeHandler = emulator::discardWrite;
+        debug("Done, emulated.");
+#elif defined(CAN_LOOPBACK) && !defined(CAN_LOOPBACK_SELF_TEST)
+        // Leave the controllers off - writes come straight back in software
+        can::initializeCommon(&(getCanBuses()[i]));
+        loopback::attach(&getCanBuses()[i], &getCanBuses()[i]);
+        debug("Done, looped back.");
+#else
         can::initialize(&(getCanBuses()[i]));
+#ifdef CAN_LOOPBACK_SELF_TEST
+        loopback::attach(&getCanBuses()[i], &getCanBuses()[i]);
+#endif // CAN_LOOPBACK_SELF_TEST
+#endif // FRAME_EMULATOR
     }
 }
 
-void receiveRawWriteRequest(cJSON* idObject, cJSON* root) {
+/* Private: Returns the bus with a number starting from 1, or NULL if there's
+ * no bus with the number.
+ */
+CanBus* lookupBusNumber(int number) {
+    if(number > 0 && number <= getCanBusCount()) {
+        return &getCanBuses()[number - 1];
+    }
+
+    debug("No bus %d in the active message set", number);
+    return NULL;
+}
+
+/* Private: Returns the bus selected by the optional "bus" field of a request,
+ * the number of the bus starting from 1. If there's no "bus", returns the first
+ * bus, and if "bus" isn't a number or there's no bus with the number returns
+ * NULL.
+ */
+CanBus* lookupRequestBus(cJSON* root) {
+    cJSON* busObject = cJSON_GetObjectItem(root, "bus");
+    if(busObject == NULL) {
+        return &getCanBuses()[0];
+    }
+    if(busObject->type != cJSON_Number) {
+        debug("Request has a bus that isn't a number");
+        return NULL;
+    }
+    return lookupBusNumber(busObject->valueint);
+}
+
+/* Private: Write a raw frame to a bus, e.g.:
+ *
+ *      {"bus": 2, "id": 291, "data": "0x1234"}
+ *
+ * "bus" is optional and defaults to the first bus. The ID must be in the
+ * bus's raw write whitelist, if it has one.
+ */
+bool receiveRawWriteRequest(cJSON* idObject, cJSON* root) {
     uint32_t id = idObject->valueint;
     cJSON* dataObject = cJSON_GetObjectItem(root, "data");
-    if(dataObject == NULL) {
-        debug("Raw write request missing data", id);
-        return;
+    if(dataObject == NULL || dataObject->valuestring == NULL) {
+        debug("Raw write request for 0x%x missing data", id);
+        return false;
+    }
+
+    CanBus* bus = lookupRequestBus(root);
+    if(bus == NULL) {
+        return false;
     }
 
-    char* dataString = dataObject->valuestring;
     char* end;
-    // TODO hard coding bus 0 right now, but it should support sending on either
-    CanMessage message = {&getCanBuses()[0], id};
-    can::write::enqueueMessage(&message, strtoull(dataString, &end, 16));
+    return can::write::enqueueRawWrite(bus, id,
+            strtoull(dataObject->valuestring, &end, 16));
 }
 
-void receiveTranslatedWriteRequest(cJSON* nameObject, cJSON* root) {
-    char* name = nameObject->valuestring;
-    cJSON* value = cJSON_GetObjectItem(root, "value");
-
-    // Optional, may be NULL
-    cJSON* event = cJSON_GetObjectItem(root, "event");
-
+/* Private: Write a value to the signal with the name, or pass it to the
+ * command with the name if there's no writable signal.
+ *
+ * event - The optional event for a command, or NULL.
+ *
+ * Returns true if the write was accepted.
+ */
+bool writeNamed(const char* name, cJSON* value, cJSON* event) {
     CanSignal* signal = lookupSignal(name, getSignals(), getSignalCount(),
             true);
     if(signal != NULL) {
         if(value == NULL) {
             debug("Write request for %s missing value", name);
-            return;
+            return false;
         }
-        can::write::sendSignal(signal, value, getSignals(), getSignalCount());
-    } else {
-        CanCommand* command = lookupCommand(name, getCommands(),
-                getCommandCount());
-        if(command != NULL) {
-            command->handler(name, value, event, getSignals(),
-                    getSignalCount());
+        return can::write::sendSignal(signal, value, getSignals(),
+                getSignalCount());
+    }
+
+    CanCommand* command = lookupCommand(name, getCommands(),
+            getCommandCount());
+    if(command != NULL) {
+        return command->handler(name, value, event, getSignals(),
+                getSignalCount());
+    }
+
+    debug("Writing not allowed for signal with name %s", name);
+    return false;
+}
+
+bool receiveTranslatedWriteRequest(cJSON* nameObject, cJSON* root) {
+    cJSON* value = cJSON_GetObjectItem(root, "value");
+    // Optional, may be NULL
+    cJSON* event = cJSON_GetObjectItem(root, "event");
+    return writeNamed(nameObject->valuestring, value, event);
+}
+
+/* Private: Handle one raw or translated write request.
+ *
+ * Returns true if the write was accepted.
+ */
+bool receiveWrite(cJSON* root) {
+    // cJSON can only look up the fields of an object
+    if(root->type != cJSON_Object) {
+        debug("Write request is malformed, not an object");
+        return false;
+    }
+
+    cJSON* nameObject = cJSON_GetObjectItem(root, "name");
+    if(nameObject != NULL && nameObject->valuestring != NULL) {
+        return receiveTranslatedWriteRequest(nameObject, root);
+    }
+
+    cJSON* idObject = cJSON_GetObjectItem(root, "id");
+    if(idObject != NULL) {
+        return receiveRawWriteRequest(idObject, root);
+    }
+
+    debug("Write request is malformed, missing name or id");
+    return false;
+}
+
+/* Private: Serialize a command response and send it to the pipeline.
+ *
+ * response - The JSON response to send. It is freed by this function.
+ */
+void sendCommandResponse(cJSON* response) {
+    char* message = cJSON_PrintUnformatted(response);
+    sendMessage(&pipeline, (uint8_t*) message, strlen(message));
+    cJSON_Delete(response);
+    statistics::freeJsonString(message);
+}
+
+/* Private: Acknowledge a batch of writes with a single response, e.g.:
+ *
+ *      {"command_response": "batch", "written": 3, "failed": 0}
+ *
+ * The response is formatted without the JSON library, so handling a batch
+ * doesn't use the heap.
+ */
+void sendBatchResponse(int written, int failed) {
+    char response[MAX_BATCH_RESPONSE_LENGTH];
+    int length = snprintf(response, sizeof(response),
+            "{\"command_response\":\"%s\",\"written\":%d,\"failed\":%d}",
+            BATCH_RESPONSE_NAME, written, failed);
+    sendMessage(&pipeline, (uint8_t*) response, length);
+}
+
+/* Private: Fill in a JSON value on the stack from a field of a parsed write
+ * request, so it can be passed to signal writers and command handlers without
+ * allocating. The value must not be freed.
+ *
+ * Returns json, or NULL if the request didn't have the field.
+ */
+cJSON* wrapValue(writeparser::WriteValue* value, cJSON* json) {
+    memset(json, 0, sizeof(cJSON));
+    switch(value->type) {
+    case writeparser::VALUE_NULL:
+        json->type = cJSON_NULL;
+        break;
+    case writeparser::VALUE_FALSE:
+        json->type = cJSON_False;
+        break;
+    case writeparser::VALUE_TRUE:
+        json->type = cJSON_True;
+        json->valueint = 1;
+        break;
+    case writeparser::VALUE_NUMBER:
+        json->type = cJSON_Number;
+        json->valuedouble = value->number;
+        json->valueint = (int)value->number;
+        break;
+    case writeparser::VALUE_STRING:
+        json->type = cJSON_String;
+        json->valuestring = value->string;
+        break;
+    default:
+        return NULL;
+    }
+    return json;
+}
+
+/* Private: Handle one raw or translated write request from the streaming
+ * parser, the same way as receiveWrite().
+ *
+ * Returns true if the write was accepted.
+ */
+bool receiveParsedWrite(writeparser::WriteRequest* request) {
+    if(request->name.type == writeparser::VALUE_STRING) {
+        cJSON value;
+        cJSON event;
+        return writeNamed(request->name.string,
+                wrapValue(&request->value, &value),
+                wrapValue(&request->event, &event));
+    }
+
+    if(request->id.type == writeparser::VALUE_NUMBER) {
+        uint32_t id = (uint32_t)request->id.number;
+        if(request->data.type != writeparser::VALUE_STRING) {
+            debug("Raw write request for 0x%x missing data", id);
+            return false;
+        }
+
+        CanBus* bus = &getCanBuses()[0];
+        if(request->bus.type == writeparser::VALUE_NUMBER) {
+            bus = lookupBusNumber((int)request->bus.number);
+        } else if(request->bus.type != writeparser::VALUE_NONE) {
+            debug("Raw write request for 0x%x has a bus that isn't a number",
+                    id);
+            return false;
+        }
+        if(bus == NULL) {
+            return false;
+        }
+
+        char* end;
+        return can::write::enqueueRawWrite(bus, id,
+                strtoull(request->data.string, &end, 16));
+    }
+
+    debug("Write request is malformed, missing name or id");
+    return false;
+}
+
+/* Private: Handle a named write record, the binary equivalent of a translated
+ * write request.
+ *
+ * Returns true if the write was accepted.
+ */
+bool receiveNamedWriteRecord(uint8_t* record, int length) {
+    char name[MAX_WRITE_NAME_LENGTH];
+    float value;
+    if(!can::write::decodeNamedWriteRecord(record, length, name,
+                sizeof(name), &value)) {
+        return false;
+    }
+
+    writeparser::WriteValue number;
+    number.type = writeparser::VALUE_NUMBER;
+    number.number = value;
+    cJSON valueObject;
+    return writeNamed(name, wrapValue(&number, &valueObject), NULL);
+}
+
+/* Private: Handle a multi-write record, a series of raw and named write
+ * records handled at once, with a single response like a batch.
+ */
+void receiveMultiWriteRecord(uint8_t* payload, int length) {
+    int written = 0;
+    int failed = 0;
+    // Skip the type
+    int offset = 1;
+    while(offset < length) {
+        uint8_t* record = &payload[offset];
+        int size = can::write::writeRecordSize(record, length - offset);
+        if(size == 0) {
+            debug("Malformed record in multi-write at byte %d", offset);
+            ++failed;
+            break;
+        }
+
+        bool accepted;
+        if(record[0] == RAW_WRITE_RECORD_TYPE) {
+            accepted = can::write::sendRawWriteRecord(record, size,
+                    getCanBuses(), getCanBusCount());
+        } else {
+            accepted = receiveNamedWriteRecord(record, size);
+        }
+
+        if(accepted) {
+            ++written;
         } else {
-            debug("Writing not allowed for signal with name %s", name);
+            ++failed;
         }
+        offset += size;
     }
+    sendBatchResponse(written, failed);
 }
 
-bool receiveWriteRequest(uint8_t* message) {
-    cJSON *root = cJSON_Parse((char*)message);
-    bool foundMessage = false;
-    if(root != NULL) {
-        foundMessage = true;
-        cJSON* nameObject = cJSON_GetObjectItem(root, "name");
-        if(nameObject == NULL) {
-            cJSON* idObject = cJSON_GetObjectItem(root, "id");
-            if(idObject == NULL) {
-                debug("Write request is malformed, "
-                        "missing name or id: %s", message);
-            } else {
-                receiveRawWriteRequest(idObject, root);
+/* Private: Handle a binary record from the host (see BINARY_RECORD_MARKER).
+ *
+ * Returns true if the record was recognized.
+ */
+bool receiveBinaryRecord(uint8_t* record) {
+    uint8_t* payload = &record[BINARY_RECORD_HEADER_SIZE];
+    int length = record[1];
+    if(length == 0) {
+        return false;
+    }
+
+    switch(payload[0]) {
+    case RAW_WRITE_RECORD_TYPE:
+        can::write::sendRawWriteRecord(payload, length, getCanBuses(),
+                getCanBusCount());
+        return true;
+    case NAMED_WRITE_RECORD_TYPE:
+        receiveNamedWriteRecord(payload, length);
+        return true;
+    case MULTI_WRITE_RECORD_TYPE:
+        receiveMultiWriteRecord(payload, length);
+        return true;
+    default:
+        return false;
+    }
+}
+
+void sendSignalStatistics(cJSON* root) {
+#ifdef __SIGNAL_STATISTICS__
+    int limit = MAX_SIGNAL_STATISTICS_REPORT_LENGTH;
+    cJSON* limitObject = cJSON_GetObjectItem(root, "limit");
+    if(limitObject != NULL && limitObject->valueint > 0 &&
+            limitObject->valueint < limit) {
+        limit = limitObject->valueint;
+    }
+
+    CanSignal* sorted[MAX_SIGNAL_STATISTICS_REPORT_LENGTH];
+    int count = statistics::sortSignalsByTraffic(getSignals(),
+            getSignalCount(), sorted, limit);
+    for(int i = 0; i < count; i++) {
+        sendCommandResponse(statistics::serialize(sorted[i], i + 1));
+    }
+#else
+    debug("Signal statistics are disabled - compile with SIGNAL_STATISTICS=1");
+#endif // __SIGNAL_STATISTICS__
+}
+
+/* Private: Start or stop sending a frame periodically, e.g.:
+ *
+ *      {"command": "periodic", "action": "start", "bus": 1, "id": 291,
+ *          "data": "0x1234", "period_ms": 100}
+ *      {"command": "periodic", "action": "stop", "bus": 1, "id": 291}
+ *
+ * "bus" is the number (starting from 1) of the bus to send the frame on, and
+ * defaults to the first bus. Starting a frame that's already being sent
+ * changes its data and period. The response is a report of all periodic
+ * frames - so a command with no action just reads the report.
+ */
+void receivePeriodicCommand(cJSON* root) {
+    cJSON* actionObject = cJSON_GetObjectItem(root, "action");
+    if(actionObject != NULL && actionObject->valuestring != NULL) {
+        CanBus* bus = lookupRequestBus(root);
+        if(bus == NULL) {
+            return;
+        }
+
+        cJSON* idObject = cJSON_GetObjectItem(root, "id");
+        if(idObject == NULL) {
+            debug("Periodic frame request is missing the id");
+            return;
+        }
+
+        if(!strcmp(actionObject->valuestring, "start")) {
+            cJSON* dataObject = cJSON_GetObjectItem(root, "data");
+            cJSON* periodObject = cJSON_GetObjectItem(root, "period_ms");
+            if(dataObject == NULL || dataObject->valuestring == NULL ||
+                    periodObject == NULL) {
+                debug("Periodic frame request is missing data or period_ms");
+                return;
+            }
+
+            if(!can::write::rawWriteAllowed(bus, idObject->valueint)) {
+                debug("Raw writes to 0x%x aren't allowed", idObject->valueint);
+                return;
+            }
+
+            char* end;
+            can::periodic::start(bus, idObject->valueint,
+                    strtoull(dataObject->valuestring, &end, 16),
+                    periodObject->valueint, time::systemTimeMs());
+        } else if(!strcmp(actionObject->valuestring, "stop")) {
+            if(!can::periodic::stop(bus, idObject->valueint)) {
+                debug("0x%x isn't being sent periodically",
+                        idObject->valueint);
             }
         } else {
-            receiveTranslatedWriteRequest(nameObject, root);
+            debug("Unrecognized periodic action: %s",
+                    actionObject->valuestring);
         }
-        cJSON_Delete(root);
+    }
+    sendCommandResponse(can::periodic::serialize());
+}
+
+/* Private: Report the main loop latency profile, e.g.:
+ *
+ *      {"command": "loop_statistics", "slow_us": 500, "reset": true}
+ *
+ * Both fields are optional. "slow_us" changes the time above which an
+ * iteration is slow, which also clears the profile. "reset" clears the
+ * profile after the report is sent, to start measuring a new load.
+ */
+void receiveLoopStatisticsCommand(cJSON* root) {
+    cJSON* slowObject = cJSON_GetObjectItem(root, "slow_us");
+    if(slowObject != NULL && slowObject->valueint > 0) {
+        profiler::setSlowIterationThreshold(slowObject->valueint);
+    }
+
+    sendCommandResponse(profiler::serialize(scheduler::getTasks(),
+                scheduler::getTaskCount()));
+
+    cJSON* resetObject = cJSON_GetObjectItem(root, "reset");
+    if(resetObject != NULL && resetObject->type == cJSON_True) {
+        profiler::reset();
+    }
+}
+
+#ifdef CAN_LOOPBACK
+/* Private: Change the loopback settings, e.g.:
+ *
+ *      {"command": "loopback", "delay_us": 500, "loss_percent": 5, "bus": 2}
+ *
+ * All fields are optional. "bus" is the number (starting from 1) of the bus to
+ * receive the looped back frames on. Any change clears the statistics, and
+ * the response is a report of the loopback statistics - so a command with no
+ * fields just reads the report.
+ */
+void receiveLoopbackCommand(cJSON* root) {
+    bool changed = false;
+    unsigned int delayUs = loopback::LOOPBACK.delayUs;
+    unsigned int lossPercent = loopback::LOOPBACK.lossPercent;
+    cJSON* delayObject = cJSON_GetObjectItem(root, "delay_us");
+    if(delayObject != NULL && delayObject->valueint >= 0) {
+        delayUs = delayObject->valueint;
+        changed = true;
+    }
+
+    cJSON* lossObject = cJSON_GetObjectItem(root, "loss_percent");
+    if(lossObject != NULL && lossObject->valueint >= 0) {
+        lossPercent = lossObject->valueint;
+        changed = true;
+    }
+
+    cJSON* busObject = cJSON_GetObjectItem(root, "bus");
+    if(busObject != NULL) {
+        if(busObject->valueint > 0 &&
+                busObject->valueint <= getCanBusCount()) {
+            loopback::setTarget(&getCanBuses()[busObject->valueint - 1]);
+            changed = true;
+        } else {
+            debug("No bus %d to loop back to", busObject->valueint);
+        }
+    }
+
+    if(changed) {
+        loopback::configure(delayUs, lossPercent);
+        loopback::resetStatistics();
+    }
+    sendCommandResponse(loopback::serialize());
+}
+#endif // CAN_LOOPBACK
+
+void receiveCommandRequest(cJSON* commandObject, cJSON* root) {
+    char* command = commandObject->valuestring;
+    if(command == NULL) {
+        debug("Command request is malformed, command must be a string");
+    } else if(!strcmp(command, statistics::STATISTICS_COMMAND_NAME)) {
+        sendCommandResponse(statistics::serialize(getCanBuses(),
+                getCanBusCount(), &pipeline));
+    } else if(!strcmp(command, statistics::SIGNAL_STATISTICS_COMMAND_NAME)) {
+        sendSignalStatistics(root);
+    } else if(!strcmp(command, statistics::TASK_STATISTICS_COMMAND_NAME)) {
+        for(int i = 0; i < scheduler::getTaskCount(); i++) {
+            sendCommandResponse(statistics::serialize(
+                        &scheduler::getTasks()[i]));
+        }
+    } else if(!strcmp(command, profiler::LOOP_STATISTICS_COMMAND_NAME)) {
+        receiveLoopStatisticsCommand(root);
+    } else if(!strcmp(command, can::periodic::PERIODIC_COMMAND_NAME)) {
+        receivePeriodicCommand(root);
+    } else if(!strcmp(command,
+                can::writelimit::WRITE_LIMITS_COMMAND_NAME)) {
+        sendCommandResponse(can::writelimit::serialize());
+#ifdef CAN_LOOPBACK
+    } else if(!strcmp(command, loopback::LOOPBACK_COMMAND_NAME)) {
+        receiveLoopbackCommand(root);
+#endif // CAN_LOOPBACK
+    } else {
+        debug("Unrecognized command: %s", command);
+    }
+}
+
+/* Private: Handle a command, or a write the streaming parser can't represent,
+ * with the full JSON parser.
+ *
+ * message - A complete JSON object. Anything after it is ignored.
+ */
+void receiveJsonRequest(char* message) {
+    cJSON *root = cJSON_Parse(message);
+    if(root == NULL) {
+        debug("Unable to parse write request -- may be out of memory");
+        return;
+    }
+
+    cJSON* commandObject = cJSON_GetObjectItem(root, "command");
+    if(commandObject != NULL) {
+        receiveCommandRequest(commandObject, root);
     } else {
-        debug("No valid JSON in incoming buffer yet -- "
-                "if it's valid, may be out of memory");
+        receiveWrite(root);
+    }
+    cJSON_Delete(root);
+}
+
+/* Private: Handle a message from the host. Raw and translated writes are
+ * handled without using the heap, and a batch is acknowledged once, after its
+ * last request.
+ *
+ * message - A complete, NULL terminated message or a binary record.
+ * length - The length of the message.
+ *
+ * Returns true if the message was handled, or false if it's malformed or
+ * unrecognized.
+ */
+bool receiveWriteRequest(uint8_t* message, int length) {
+#ifdef CAN_LOOPBACK
+    loopback::recordRequest(time::systemTimeUs());
+#endif // CAN_LOOPBACK
+    if(message[0] == BINARY_RECORD_MARKER) {
+        return receiveBinaryRecord(message);
+    }
+
+    writeparser::WriteParser parser;
+    writeparser::initialize(&parser);
+    int written = 0;
+    int failed = 0;
+    while(true) {
+        writeparser::ParseStatus status = writeparser::parse(&parser,
+                &message[parser.consumed], length - parser.consumed);
+        if(status == writeparser::PARSE_INCOMPLETE) {
+            // Nothing but whitespace is fine, e.g. the CR of a CRLF
+            if(writeparser::started(&parser)) {
+                debug("Write request is incomplete");
+                if(parser.batch) {
+                    // Writes before the cut off one were already queued
+                    sendBatchResponse(written, failed + 1);
+                }
+                return false;
+            }
+            return true;
+        } else if(status == writeparser::PARSE_ERROR) {
+            debug("Write request is malformed");
+            if(parser.batch) {
+                sendBatchResponse(written, failed + 1);
+            }
+            return false;
+        } else if(status == writeparser::PARSE_DONE) {
+            if(parser.batch) {
+                sendBatchResponse(written, failed);
+            }
+            return true;
+        }
+
+        bool accepted;
+        if(!parser.request.complex) {
+            accepted = receiveParsedWrite(&parser.request);
+        } else if(parser.batch) {
+            debug("Commands and nested values aren't allowed in a batch");
+            accepted = false;
+        } else {
+            receiveJsonRequest((char*)message);
+            accepted = true;
+        }
+
+        if(accepted) {
+            ++written;
+        } else {
+            ++failed;
+        }
     }
-    return foundMessage;
 }
 
 /*
  * Check to see if a packet has been received. If so, read the packet and print
  * the packet payload to the uart monitor.
+ *
+ * Returns true if there are more messages waiting in the receive queue.
  */
-void receiveCan(Pipeline* pipeline, CanBus* bus) {
+bool receiveCan(Pipeline* pipeline, CanBus* bus) {
     // TODO what happens if we process until the queue is empty?
     if(!QUEUE_EMPTY(CanMessage, &bus->receiveQueue)) {
+        int queueLength = QUEUE_LENGTH(CanMessage, &bus->receiveQueue);
+        if(queueLength > bus->receiveQueueHighWatermark) {
+            bus->receiveQueueHighWatermark = queueLength;
+        }
+
         CanMessage message = QUEUE_POP(CanMessage, &bus->receiveQueue);
+        statistics::recordDecode();
         decodeCanMessage(pipeline, bus, message.id, message.data);
+#ifdef CAN_LOOPBACK
+        loopback::recordReceive(bus, &message, time::systemTimeUs());
+#endif // CAN_LOOPBACK
+        ++bus->messagesReceived;
         bus->lastMessageReceived = time::systemTimeMs();
     }
+    return !QUEUE_EMPTY(CanMessage, &bus->receiveQueue);
 }
 
 void reset() {
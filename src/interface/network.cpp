@@ -6,6 +6,7 @@ void openxc::interface::network::initializeCommon(NetworkDevice* device) {
     if(device != NULL) {
         debug("Initializing Network...");
         QUEUE_INIT(uint8_t, &device->receiveQueue);
+        openxc::util::bytebuffer::initializeFramer(&device->framer);
         QUEUE_INIT(uint8_t, &device->sendQueue);
     }
 }
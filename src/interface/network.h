@@ -26,6 +26,7 @@ namespace network {
  * sendQueue - A queue of bytes that need to be sent out over an IP network.
  * receiveQueue - A queue of bytes that have been received via an IP network but
  *      not yet processed.
+ * framer - Splits the receiveQueue into messages.
  */
 typedef struct {
     uint8_t ipAddress[4];
@@ -35,6 +36,7 @@ typedef struct {
     QUEUE_TYPE(uint8_t) sendQueue;
     // host to device
     QUEUE_TYPE(uint8_t) receiveQueue;
+    openxc::util::bytebuffer::Framer framer;
 #ifdef __USE_NETWORK__
     Server* server;
 #endif // __USE_NETWORK__
@@ -54,7 +56,7 @@ void initialize(NetworkDevice* device);
  */
 void processSendQueue(NetworkDevice* device);
 
-void read(NetworkDevice* device, bool (*callback)(uint8_t*));
+void read(NetworkDevice* device, bool (*callback)(uint8_t*, int));
 
 } // namespace network
 } // namespace interface
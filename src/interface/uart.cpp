@@ -10,6 +10,7 @@ void openxc::interface::uart::initializeCommon(UartDevice* device) {
     if(device != NULL) {
         debugNoNewline("Initializing UART.....");
         QUEUE_INIT(uint8_t, &device->receiveQueue);
+        openxc::util::bytebuffer::initializeFramer(&device->framer);
         QUEUE_INIT(uint8_t, &device->sendQueue);
     }
 }
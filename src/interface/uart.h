@@ -15,6 +15,7 @@ extern const int MAX_MESSAGE_SIZE;
  * sendQueue - A queue of bytes that need to be sent out over UART.
  * receiveQueue - A queue of bytes that have been received via UART but not yet
  *      processed.
+ * framer - Splits the receiveQueue into messages.
  * device - A pointer to the hardware UART device to use for OpenXC messages.
  */
 typedef struct {
@@ -22,6 +23,7 @@ typedef struct {
     QUEUE_TYPE(uint8_t) sendQueue;
     // host to device
     QUEUE_TYPE(uint8_t) receiveQueue;
+    openxc::util::bytebuffer::Framer framer;
     void* controller;
 } UartDevice;
 
@@ -32,7 +34,7 @@ typedef struct {
  * device - The UART device to check for incoming data.
  * callback - A function to call with any received data.
  */
-void read(UartDevice* device, bool (*callback)(uint8_t*));
+void read(UartDevice* device, bool (*callback)(uint8_t*, int));
 
 /* Public: Perform platform-agnostic UART initialization.
  */
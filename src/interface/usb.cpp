@@ -2,10 +2,65 @@
 #include "util/log.h"
 
 using openxc::util::log::debugNoNewline;
+using openxc::util::bytebuffer::peekContiguousAfter;
+using openxc::util::bytebuffer::discardFront;
 
 void openxc::interface::usb::initializeCommon(UsbDevice* usbDevice) {
     debugNoNewline("Initializing USB.....");
     QUEUE_INIT(uint8_t, &usbDevice->sendQueue);
     QUEUE_INIT(uint8_t, &usbDevice->receiveQueue);
+    openxc::util::bytebuffer::initializeFramer(&usbDevice->framer);
+    cancelInTransfers(usbDevice);
     usbDevice->configured = false;
 }
+
+int openxc::interface::usb::startInTransfer(UsbDevice* usbDevice,
+        int maxLength, uint8_t** data, int* length) {
+    if(usbDevice->inTransferCount == USB_IN_TRANSFER_COUNT) {
+        return -1;
+    }
+
+    int inFlight = 0;
+    for(int i = 0; i < usbDevice->inTransferCount; i++) {
+        inFlight += usbDevice->inTransferLengths[
+                (usbDevice->firstInTransfer + i) % USB_IN_TRANSFER_COUNT];
+    }
+
+    *data = peekContiguousAfter(&usbDevice->sendQueue, inFlight, length);
+    if(*length == 0) {
+        return -1;
+    }
+    if(*length > maxLength) {
+        *length = maxLength;
+    }
+
+    int index = (usbDevice->firstInTransfer + usbDevice->inTransferCount)
+            % USB_IN_TRANSFER_COUNT;
+    usbDevice->inTransferLengths[index] = *length;
+    ++usbDevice->inTransferCount;
+    return index;
+}
+
+int openxc::interface::usb::oldestInTransfer(UsbDevice* usbDevice) {
+    if(usbDevice->inTransferCount == 0) {
+        return -1;
+    }
+    return usbDevice->firstInTransfer;
+}
+
+void openxc::interface::usb::finishInTransfer(UsbDevice* usbDevice) {
+    if(usbDevice->inTransferCount == 0) {
+        return;
+    }
+
+    discardFront(&usbDevice->sendQueue,
+            usbDevice->inTransferLengths[usbDevice->firstInTransfer]);
+    usbDevice->firstInTransfer = (usbDevice->firstInTransfer + 1)
+            % USB_IN_TRANSFER_COUNT;
+    --usbDevice->inTransferCount;
+}
+
+void openxc::interface::usb::cancelInTransfers(UsbDevice* usbDevice) {
+    usbDevice->firstInTransfer = 0;
+    usbDevice->inTransferCount = 0;
+}
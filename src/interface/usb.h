@@ -10,8 +10,10 @@
 #include "util/bytebuffer.h"
 
 #define USB_BUFFER_SIZE 64
-#define USB_SEND_BUFFER_SIZE 512
 #define MAX_USB_PACKET_SIZE_BYTES USB_BUFFER_SIZE
+// The number of IN transfers that can be in flight at once - while the host
+// reads one, the next is already prepared (ping-pong buffering)
+#define USB_IN_TRANSFER_COUNT 2
 
 namespace openxc {
 namespace interface {
@@ -30,6 +32,13 @@ namespace usb {
  *      reset.
  * sendQueue - A queue of bytes to send over the IN endpoint.
  * receiveQueue - A queue of unprocessed bytes received from the OUT endpoint.
+ * framer - Splits the receiveQueue into messages.
+ * inTransferLengths - The number of bytes in each IN transfer in flight. The
+ *      bytes are sent straight from the front of the sendQueue, and stay there
+ *      until the transfer is finished.
+ * firstInTransfer - The index in inTransferLengths of the oldest transfer in
+ *      flight.
+ * inTransferCount - The number of IN transfers in flight.
  * device - The UsbDevice attached to the host - only used on PIC32.
  */
 typedef struct {
@@ -40,13 +49,14 @@ typedef struct {
     bool configured;
     QUEUE_TYPE(uint8_t) sendQueue;
     QUEUE_TYPE(uint8_t) receiveQueue;
-    // This buffer MUST be non-local, so it doesn't get invalidated when it
-    // falls off the stack
-    uint8_t sendBuffer[USB_SEND_BUFFER_SIZE];
+    openxc::util::bytebuffer::Framer framer;
+    int inTransferLengths[USB_IN_TRANSFER_COUNT];
+    int firstInTransfer;
+    int inTransferCount;
 #ifdef __PIC32__
     char receiveBuffer[MAX_USB_PACKET_SIZE_BYTES];
     USBDevice device;
-    USB_HANDLE deviceToHostHandle;
+    USB_HANDLE deviceToHostHandles[USB_IN_TRANSFER_COUNT];
     USB_HANDLE hostToDeviceHandle;
 #endif // __PIC32__
 } UsbDevice;
@@ -55,6 +65,39 @@ typedef struct {
  */
 void initializeCommon(UsbDevice*);
 
+/* Public: Start the next IN transfer from the sendQueue, if one isn't already
+ * in flight in each buffer. The transfer takes the contiguous bytes that follow
+ * the ones already in flight, so they can be handed to the USB controller
+ * without copying them.
+ *
+ * device - The USB device to send on.
+ * maxLength - The most bytes to send in the transfer, e.g. the packet size.
+ * data - Set to the first byte of the transfer in the sendQueue. The bytes
+ *      stay valid until the transfer is finished with finishInTransfer().
+ * length - Set to the number of bytes in the transfer.
+ *
+ * Returns the index of the transfer in device->inTransferLengths, for keeping
+ * track of the controller's handle, or -1 if there's nothing more to send or
+ * no free buffer.
+ */
+int startInTransfer(UsbDevice* device, int maxLength, uint8_t** data,
+        int* length);
+
+/* Public: Returns the index of the oldest IN transfer in flight, or -1 if there
+ * aren't any.
+ */
+int oldestInTransfer(UsbDevice* device);
+
+/* Public: Finish the oldest IN transfer in flight and remove its bytes from the
+ * sendQueue. Transfers on an endpoint finish in the order they were started.
+ */
+void finishInTransfer(UsbDevice* device);
+
+/* Public: Forget any IN transfers in flight, e.g. when the host disconnects.
+ * Their bytes stay in the sendQueue and are sent again.
+ */
+void cancelInTransfers(UsbDevice* device);
+
 /* Public: Initializes the USB controller as a full-speed device with the
  * configuration specified in usb_descriptors.c. Must be called before
  * any other USB fuctions are used.
@@ -71,7 +114,7 @@ void initialize(UsbDevice*);
  * callback - A function that handles USB in requests. The callback should
  *      return true if a message was properly received and parsed.
  */
-void read(UsbDevice* device, bool (*callback)(uint8_t*));
+void read(UsbDevice* device, bool (*callback)(uint8_t*, int));
 
 /* Public: Send any bytes in the outgoing data queue over the IN endpoint to the
  * host.
@@ -83,11 +126,12 @@ void processSendQueue(UsbDevice* device);
 /* Public: Send a USB control message on EP0 (the endponit used only for control
  * transfers).
  *
- * data - An array of up bytes up to the total size of the endpoint (64 bytes
- *      for USB 2.0)
+ * data - An array of bytes to send. Responses longer than the endpoint size
+ *      (64 bytes for USB 2.0) are split across multiple packets by the USB
+ *      stack, so the array must remain valid until the transfer completes.
  * length - The length of the data array.
  */
-void sendControlMessage(uint8_t* data, uint8_t length);
+void sendControlMessage(uint8_t* data, uint16_t length);
 
 /* Public: Disconnect from host and turn off the USB peripheral
  *           (minimal power draw).
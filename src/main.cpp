@@ -10,10 +10,21 @@
 #include "bluetooth.h"
 #include "power.h"
 #include "platform/platform.h"
+#include "statistics.h"
+#include "scheduler.h"
+#include "profiler.h"
 #include <stdlib.h>
 
 #define VERSION_CONTROL_COMMAND 0x80
 #define RESET_CONTROL_COMMAND 0x81
+#define STATISTICS_CONTROL_COMMAND 0x82
+
+#define MAX_STATISTICS_RESPONSE_LENGTH 1024
+// Sent instead of the statistics if they're longer than the response buffer
+#define STATISTICS_TOO_LONG_RESPONSE "{\"command_response\": \"statistics\", " \
+        "\"error\": \"too_long\"}"
+
+#define INTERFACE_LIGHT_PERIOD_MS 50
 
 // USB
 #define DATA_IN_ENDPOINT 1
@@ -27,14 +38,21 @@ namespace lights = openxc::lights;
 namespace platform = openxc::platform;
 namespace power = openxc::power;
 namespace time = openxc::util::time;
+namespace statistics = openxc::statistics;
+namespace scheduler = openxc::scheduler;
+namespace profiler = openxc::profiler;
 
 using openxc::interface::uart::UartDevice;
 using openxc::interface::usb::sendControlMessage;
 using openxc::signals::getActiveMessageSet;
+using openxc::signals::getCanBuses;
+using openxc::signals::getCanBusCount;
+using openxc::statistics::STATISTICS;
+using openxc::scheduler::registerTask;
 
 extern void reset();
 extern void setup();
-extern void loop();
+extern bool idle();
 
 const char* VERSION = "4.0.1";
 
@@ -55,7 +73,7 @@ Pipeline pipeline = {&USB_DEVICE,
 };
 
 /* Public: Update the color and status of a board's light that shows the output
- * interface status. This function is intended to be called each time through
+ * interface status. This function is intended to be called periodically from
  * the main program loop.
  */
 void updateInterfaceLight() {
@@ -68,8 +86,32 @@ void updateInterfaceLight() {
     }
 }
 
+bool processPipelineTask() {
+    process(&pipeline);
+    return false;
+}
+
+bool updateInterfaceLightTask() {
+    updateInterfaceLight();
+    return false;
+}
+
+/* Private: Returns true if there is no work at all waiting - nothing to decode
+ * from CAN, nothing to write to CAN and nothing left to send to the host.
+ */
+bool systemIdle() {
+    return idle() && openxc::pipeline::sendQueuesEmpty(&pipeline);
+}
+
+bool flushLogTask() {
+    openxc::util::log::flush();
+    return false;
+}
+
 int main(void) {
     platform::initialize();
+    statistics::initialize();
+    profiler::initialize();
     openxc::util::log::initialize();
     time::initialize();
     power::initialize();
@@ -80,12 +122,27 @@ int main(void) {
     bluetooth::initialize();
 
     debug("Initializing as %s", getActiveMessageSet()->name);
+    scheduler::initialize();
     setup();
 
+    // Must always process USB, because it runs the USB task that handles
+    // SETUP and enumeration - so this is never shed under load
+    registerTask("pipeline", processPipelineTask, scheduler::PRIORITY_NORMAL,
+            0, 0);
+    registerTask("interface_light", updateInterfaceLightTask,
+            scheduler::PRIORITY_LOW, INTERFACE_LIGHT_PERIOD_MS, 0);
+    registerTask("log", flushLogTask, scheduler::PRIORITY_LOW, 0, 0);
+
     for (;;) {
-        loop();
-        process(&pipeline);
-        updateInterfaceLight();
+        // Only the time spent running tasks is part of an iteration's
+        // latency, not the time asleep waiting for more work
+        profiler::beginIteration();
+        bool busy = scheduler::run();
+        profiler::endIteration();
+        if(!busy && systemIdle() && power::waitForInterrupt(systemIdle)) {
+            statistics::recordWake();
+        }
+        ++STATISTICS.loopIterations;
     }
 
     return 0;
@@ -93,11 +150,13 @@ int main(void) {
 
 /* Private: Handle an incoming USB control request.
  *
- * There are two accepted control requests:
+ * There are three accepted control requests:
  *
  *  - VERSION_CONTROL_COMMAND - return the version of the firmware as a string,
  *      including the vehicle it is built to translate.
  *  - RESET_CONTROL_COMMAND - reset the device.
+ *  - STATISTICS_CONTROL_COMMAND - return a JSON snapshot of the runtime
+ *      statistics counters.
  *
  *  TODO This function is defined in main.cpp because it needs to reference the
  *  version and message set, which aren't declared in any header files at the
@@ -119,6 +178,22 @@ bool handleControlRequest(uint8_t request) {
         debug("Resetting...");
         reset();
         return true;
+    case STATISTICS_CONTROL_COMMAND:
+    {
+        // The control transfer completes asynchronously, so the response must
+        // outlive this function
+        static char response[MAX_STATISTICS_RESPONSE_LENGTH];
+        int length = statistics::serialize(getCanBuses(), getCanBusCount(),
+                &pipeline, response, sizeof(response));
+        if(length < 0) {
+            debug("Statistics don't fit in the %d byte control response",
+                    MAX_STATISTICS_RESPONSE_LENGTH);
+            strcpy(response, STATISTICS_TOO_LONG_RESPONSE);
+            length = strlen(response);
+        }
+        usb::sendControlMessage((uint8_t*)response, length);
+        return true;
+    }
     default:
         return false;
     }
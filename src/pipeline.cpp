@@ -11,44 +11,58 @@ namespace usb = openxc::interface::usb;
 namespace network = openxc::interface::network;
 
 using openxc::util::bytebuffer::conditionalEnqueue;
+using openxc::pipeline::Pipeline;
+using openxc::pipeline::MessageType;
+using openxc::pipeline::PipelineStatistics;
 
-typedef enum {
-    USB = 0,
-    UART = 1,
-    NETWORK = 2
-} MessageType;
-
-const char messageTypeNames[][9] = {
+const char* openxc::pipeline::MESSAGE_TYPE_NAMES[] = {
     "USB",
     "UART",
     "Network",
 };
 
-int droppedMessages[3];
+/* Private: Add the message to the send queue for one interface of the
+ * pipeline, updating that interface's statistics.
+ *
+ * Returns true if the message was queued.
+ */
+bool enqueueForInterface(Pipeline* pipeline, MessageType type,
+        QUEUE_TYPE(uint8_t)* queue, uint8_t* message, int messageSize) {
+    PipelineStatistics* statistics = &pipeline->statistics[type];
+    if(!conditionalEnqueue(queue, message, messageSize)) {
+        ++statistics->messagesDropped;
+        if(statistics->messagesDropped % DROPPED_MESSAGE_LOGGING_THRESHOLD == 0) {
+            debug("%s send queue full, dropped another %d messages",
+                    openxc::pipeline::MESSAGE_TYPE_NAMES[type],
+                    DROPPED_MESSAGE_LOGGING_THRESHOLD);
+        }
+        return false;
+    }
 
-void droppedMessage(MessageType type) {
-    droppedMessages[type]++;
-    if(droppedMessages[type] > DROPPED_MESSAGE_LOGGING_THRESHOLD) {
-        droppedMessages[type] = 0;
-        debug("%s send queue full, dropped another %d messages",
-                messageTypeNames[type], DROPPED_MESSAGE_LOGGING_THRESHOLD);
+    ++statistics->messagesSent;
+    // Includes the CRLF added by conditionalEnqueue
+    statistics->bytesSent += messageSize + 2;
+    int queueLength = QUEUE_LENGTH(uint8_t, queue);
+    if(queueLength > statistics->queueHighWatermark) {
+        statistics->queueHighWatermark = queueLength;
     }
+    return true;
 }
 
 void openxc::pipeline::sendMessage(Pipeline* pipeline, uint8_t* message, int messageSize) {
-    if(pipeline->usb->configured && !conditionalEnqueue(
-                &pipeline->usb->sendQueue, message, messageSize)) {
-        droppedMessage(USB);
+    if(pipeline->usb->configured) {
+        enqueueForInterface(pipeline, USB, &pipeline->usb->sendQueue, message,
+                messageSize);
     }
 
-    if(uart::connected(pipeline->uart) && !conditionalEnqueue(
-                &pipeline->uart->sendQueue, message, messageSize)) {
-        droppedMessage(UART);
+    if(uart::connected(pipeline->uart)) {
+        enqueueForInterface(pipeline, UART, &pipeline->uart->sendQueue,
+                message, messageSize);
     }
 
-    if(pipeline->network != NULL && !conditionalEnqueue(
-                &pipeline->network->sendQueue, message, messageSize)) {
-        droppedMessage(NETWORK);
+    if(pipeline->network != NULL) {
+        enqueueForInterface(pipeline, NETWORK, &pipeline->network->sendQueue,
+                message, messageSize);
     }
 }
 
@@ -64,3 +78,21 @@ void openxc::pipeline::process(Pipeline* pipeline) {
        network::processSendQueue(pipeline->network);
     }
 }
+
+bool openxc::pipeline::sendQueuesEmpty(Pipeline* pipeline) {
+    if(pipeline->usb->configured &&
+            !QUEUE_EMPTY(uint8_t, &pipeline->usb->sendQueue)) {
+        return false;
+    }
+
+    if(uart::connected(pipeline->uart) &&
+            !QUEUE_EMPTY(uint8_t, &pipeline->uart->sendQueue)) {
+        return false;
+    }
+
+    if(pipeline->network != NULL &&
+            !QUEUE_EMPTY(uint8_t, &pipeline->network->sendQueue)) {
+        return false;
+    }
+    return true;
+}
@@ -12,6 +12,35 @@ using openxc::interface::network::NetworkDevice;
 namespace openxc {
 namespace pipeline {
 
+/* Public: The output interfaces attached to a pipeline, used to index the
+ * per-interface statistics.
+ */
+typedef enum {
+    USB = 0,
+    UART = 1,
+    NETWORK = 2
+} MessageType;
+
+// The number of MessageType values, defined here so it can size arrays
+const int MESSAGE_TYPE_COUNT = 3;
+extern const char* MESSAGE_TYPE_NAMES[];
+
+/* Public: Running counters for a single output interface of a pipeline. All
+ * of the counters are monotonic, they are never reset while running.
+ *
+ * messagesSent - The number of messages successfully queued to send.
+ * bytesSent - The number of bytes queued to send, including delimiters.
+ * messagesDropped - The number of messages dropped because the send queue for
+ *      the interface was full.
+ * queueHighWatermark - The most bytes ever waiting in the send queue at once.
+ */
+typedef struct {
+    unsigned int messagesSent;
+    unsigned int bytesSent;
+    unsigned int messagesDropped;
+    int queueHighWatermark;
+} PipelineStatistics;
+
 /* Public: A container for all output devices that want to be notified of new
  *      messages from the CAN bus.
  *
@@ -19,6 +48,8 @@ namespace pipeline {
  * updates from CAN. Right now, this means USB and UART, but it can be extended
  * to output over another UART, Network, WiFi, etc.
  *
+ * statistics - Counters for each output interface, indexed by MessageType.
+ *
  * TODO This file could most likely be refactored and improved. Ideally these
  * output interfaces would all have the same type, so this could just be a list
  * of "receiver" functions. maybe instead of the devices, this is a list of the
@@ -28,6 +59,7 @@ typedef struct {
     UsbDevice* usb;
     UartDevice* uart;
     NetworkDevice* network;
+    PipelineStatistics statistics[MESSAGE_TYPE_COUNT];
 } Pipeline;
 
 /* Public: Queue the message to send on all of the interfaces registered with
@@ -52,6 +84,15 @@ void sendMessage(Pipeline* pipeline, uint8_t* message, int messageSize);
  */
 void process(Pipeline* pipeline);
 
+/* Public: Check if any of the output interfaces still have data waiting to be
+ *      sent.
+ *
+ * pipeline - Pipeline instance with the interface queues to check.
+ *
+ * Returns true if all of the active interface send queues are empty.
+ */
+bool sendQueuesEmpty(Pipeline* pipeline);
+
 } // namespace interface
 } // namespace openxc
 
@@ -0,0 +1,5 @@
+#include "bluetooth.h"
+
+void openxc::bluetooth::initialize() { }
+
+void openxc::bluetooth::deinitialize() { }
@@ -0,0 +1,65 @@
+#include "can/canread.h"
+#include "canutil_host.h"
+#include "power_host.h"
+#include "util/log.h"
+#include <linux/can.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define MAX_CAN_CONTROLLER_COUNT 2
+
+static pthread_t receiveThreads[MAX_CAN_CONTROLLER_COUNT];
+
+/* Private: Queue a received message, as the controller's receive interrupt
+ * would.
+ *
+ * Returns false if the receive queue was full and the message was dropped.
+ */
+static bool receiveMessage(CanBus* bus, CanMessage message) {
+    beginInterrupt();
+    bool queued = QUEUE_PUSH(CanMessage, &bus->receiveQueue, message);
+    if(!queued) {
+        ++bus->messagesDropped;
+    }
+    endInterrupt();
+    return queued;
+}
+
+/* Private: Read frames from a SocketCAN interface until the bus is
+ * deinitialized. Like the controller, this drops frames when the receive queue
+ * is full.
+ */
+static void* receiveFromSocket(void* argument) {
+    CanBus* bus = (CanBus*) argument;
+    struct can_frame frame;
+    while(::read(CAN_CONTROLLER(bus)->socket, &frame, sizeof(frame))
+            == sizeof(frame)) {
+        CanMessage message = {bus, frame.can_id & CAN_EFF_MASK, 0};
+        for(int i = 0; i < frame.can_dlc && i < 8; i++) {
+            message.data |= ((uint64_t)frame.data[i]) << (i * 8);
+        }
+
+        if(!receiveMessage(bus, message)) {
+            debugDeferred("Dropped CAN message with ID 0x%02x -- queue is full",
+                    message.id);
+        }
+    }
+    return NULL;
+}
+
+/* Private: Returns the receive thread for the bus's controller. */
+static pthread_t* receiveThread(CanBus* bus) {
+    return &receiveThreads[CAN_CONTROLLER(bus) - HOST_CAN_CONTROLLERS];
+}
+
+void startReceiving(CanBus* bus) {
+    registerInterruptSource();
+    pthread_create(receiveThread(bus), NULL, receiveFromSocket, bus);
+}
+
+void stopReceiving(CanBus* bus) {
+    // The thread spends its time blocked in read(), a cancellation point
+    pthread_cancel(*receiveThread(bus));
+    pthread_join(*receiveThread(bus), NULL);
+    unregisterInterruptSource();
+}
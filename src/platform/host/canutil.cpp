@@ -0,0 +1,105 @@
+#include "can/canutil.h"
+#include "canutil_host.h"
+#include "signals.h"
+#include "util/log.h"
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using openxc::signals::getCanBusCount;
+using openxc::signals::getCanBuses;
+using openxc::signals::initializeFilters;
+
+// The default interface names match what candump records for the first two
+// controllers on a typical Linux system
+HostCanController HOST_CAN_CONTROLLERS[] = {
+    {"OPENXC_CAN1", "can0", -1},
+    {"OPENXC_CAN2", "can1", -1},
+};
+
+/* Private: Load the acceptance filters for the bus into the socket, so the
+ * kernel drops everything else like the controller hardware would.
+ */
+static void configureFilters(CanBus* bus, CanFilter* filters,
+        int filterCount) {
+    if(filterCount > 0) {
+        struct can_filter socketFilters[filterCount];
+        for(int i = 0; i < filterCount; i++) {
+            socketFilters[i].can_id = filters[i].value;
+            socketFilters[i].can_mask = CAN_SFF_MASK;
+        }
+        if(setsockopt(CAN_CONTROLLER(bus)->socket, SOL_CAN_RAW, CAN_RAW_FILTER,
+                    socketFilters, sizeof(socketFilters)) < 0) {
+            debug("Couldn't add message filters");
+        }
+    } else {
+        debug("No filters configured, receiving all messages");
+    }
+}
+
+/* Private: Open a raw SocketCAN socket bound to the named interface.
+ *
+ * Returns the socket, or -1 if the interface couldn't be opened.
+ */
+static int openSocket(const char* interfaceName) {
+    int canSocket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if(canSocket < 0) {
+        return -1;
+    }
+
+    struct ifreq request;
+    memset(&request, 0, sizeof(request));
+    strncpy(request.ifr_name, interfaceName, IFNAMSIZ - 1);
+    struct sockaddr_can address;
+    memset(&address, 0, sizeof(address));
+    address.can_family = AF_CAN;
+    if(ioctl(canSocket, SIOCGIFINDEX, &request) < 0) {
+        close(canSocket);
+        return -1;
+    }
+    address.can_ifindex = request.ifr_ifindex;
+
+    if(bind(canSocket, (struct sockaddr*) &address, sizeof(address)) < 0) {
+        close(canSocket);
+        return -1;
+    }
+    return canSocket;
+}
+
+void openxc::can::deinitialize(CanBus* bus) {
+    HostCanController* controller = CAN_CONTROLLER(bus);
+    if(controller->socket >= 0) {
+        stopReceiving(bus);
+        close(controller->socket);
+        controller->socket = -1;
+    }
+}
+
+void openxc::can::initialize(CanBus* bus) {
+    can::initializeCommon(bus);
+    HostCanController* controller = CAN_CONTROLLER(bus);
+
+    const char* interfaceName = getenv(controller->environmentVariable);
+    if(interfaceName != NULL && controller->socket < 0) {
+        strncpy(controller->interfaceName, interfaceName,
+                MAX_TRACE_INTERFACE_NAME_LENGTH - 1);
+        controller->socket = openSocket(interfaceName);
+        if(controller->socket < 0) {
+            debug("Unable to open CAN interface %s", interfaceName);
+        } else {
+            int filterCount;
+            CanFilter* filters = initializeFilters(bus->address, &filterCount);
+            configureFilters(bus, filters, filterCount);
+            startReceiving(bus);
+            debug("Receiving CAN from %s", interfaceName);
+        }
+    }
+
+    if(bus == &getCanBuses()[getCanBusCount() - 1]) {
+        startTraceReplay();
+    }
+}
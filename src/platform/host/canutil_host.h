@@ -0,0 +1,50 @@
+#ifndef __CANUTIL_HOST__
+#define __CANUTIL_HOST__
+
+#include "can/trace.h"
+
+/* Public: Stands in for a CAN controller when running on a development
+ * computer. Frames come from a SocketCAN interface (e.g. a "vcan" virtual
+ * interface) and/or a candump log file replayed by the trace thread.
+ *
+ * environmentVariable - The name of the environment variable that selects the
+ *      SocketCAN interface for this controller.
+ * interfaceName - The name of the SocketCAN interface and the interface name
+ *      of trace frames that belong to this controller.
+ * socket - The open SocketCAN socket, or -1 if no interface is attached.
+ */
+typedef struct {
+    const char* environmentVariable;
+    char interfaceName[MAX_TRACE_INTERFACE_NAME_LENGTH];
+    int socket;
+} HostCanController;
+
+extern HostCanController HOST_CAN_CONTROLLERS[];
+
+#define CAN_CONTROLLER(bus) ((HostCanController*)bus->controller)
+
+// Generated signal definitions refer to the controllers by these names
+#define can1 (&HOST_CAN_CONTROLLERS[0])
+#define can2 (&HOST_CAN_CONTROLLERS[1])
+
+/* Public: Start a thread receiving frames from the controller's SocketCAN
+ * interface, standing in for the controller's receive interrupt.
+ */
+void startReceiving(struct CanBus* bus);
+
+/* Public: Stop the thread started by startReceiving().
+ */
+void stopReceiving(struct CanBus* bus);
+
+/* Public: Start replaying the trace file (candump log or OpenXC raw JSON)
+ * named by the OPENXC_TRACE environment variable, if set. OPENXC_TRACE_SPEED
+ * sets the speed as a multiple of real time, or "max" (the default) to replay
+ * as fast as the firmware can go. The throughput is printed when the firmware
+ * exits.
+ *
+ * This must be called after all of the buses are initialized, since frames are
+ * routed to them by bus address or interface name.
+ */
+void startTraceReplay();
+
+#endif // __CANUTIL_HOST__
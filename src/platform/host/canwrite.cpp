@@ -0,0 +1,25 @@
+#include "can/canwrite.h"
+#include "canutil_host.h"
+#include "util/log.h"
+#include <linux/can.h>
+#include <unistd.h>
+
+bool openxc::can::write::sendMessage(CanBus* bus, CanMessage request) {
+    if(CAN_CONTROLLER(bus)->socket < 0) {
+        // No bus attached, so the frame goes nowhere - like a controller with
+        // no other nodes, that's not an error
+        debugDeferred("Discarding CAN message with ID 0x%02x", request.id);
+        return true;
+    }
+
+    struct can_frame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.can_id = request.id;
+    frame.can_dlc = 8;
+    for(int i = 0; i < 8; i++) {
+        frame.data[i] = ((uint8_t*)&request.data)[i];
+    }
+
+    return ::write(CAN_CONTROLLER(bus)->socket, &frame, sizeof(frame))
+        == sizeof(frame);
+}
@@ -0,0 +1,45 @@
+# Runs the firmware as a normal program on a Linux development computer, for
+# debugging and performance work without any hardware - see
+# docs/platforms/host.rst.
+
+LIBS_PATH = libs
+INCLUDE_PATHS = -I. -I./$(LIBS_PATH)/cJSON -I./$(LIBS_PATH)/emqueue
+
+CC = gcc
+CPP = g++
+LD = g++
+CC_FLAGS = -c -fno-common -fmessage-length=0 -Wall -fno-exceptions \
+		   -Wno-char-subscripts -Wno-unused-but-set-variable
+ONLY_C_FLAGS = -std=gnu99
+ONLY_CPP_FLAGS = -std=gnu++0x
+CC_SYMBOLS += -D__HOST__
+LD_SYS_LIBS = -lm -lpthread
+
+HOST_C_SRCS = $(CROSSPLATFORM_C_SRCS)
+HOST_CPP_SRCS = $(CROSSPLATFORM_CPP_SRCS) $(wildcard platform/host/*.cpp)
+HOST_OBJ_FILES = $(HOST_C_SRCS:.c=.o) $(HOST_CPP_SRCS:.cpp=.o)
+OBJECTS = $(patsubst %,$(OBJDIR)/%,$(HOST_OBJ_FILES))
+
+TARGET_BIN = $(OBJDIR)/$(TARGET)
+
+ifdef DEBUG
+CC_FLAGS += -g -ggdb
+else
+CC_FLAGS += -O2 -Wno-uninitialized
+endif
+
+all: $(TARGET_BIN)
+
+run: all
+	@./$(TARGET_BIN)
+
+$(OBJDIR)/%.o: %.c
+	@mkdir -p $(dir $@)
+	$(CC) $(CC_FLAGS) $(CC_SYMBOLS) $(ONLY_C_FLAGS) $(INCLUDE_PATHS) -o $@ $<
+
+$(OBJDIR)/%.o: %.cpp
+	@mkdir -p $(dir $@)
+	$(CPP) $(CC_FLAGS) $(CC_SYMBOLS) $(ONLY_CPP_FLAGS) $(INCLUDE_PATHS) -o $@ $<
+
+$(TARGET_BIN): $(OBJECTS)
+	$(LD) -o $@ $^ $(LD_SYS_LIBS)
@@ -0,0 +1,8 @@
+#include "lights.h"
+
+// There are no lights on a development computer - the interface and CAN status
+// is in the debug log instead
+
+void openxc::lights::enable(Light light, RGB color) { }
+
+void openxc::lights::initialize() { }
@@ -0,0 +1,15 @@
+#include "util/log.h"
+#include <stdio.h>
+#include <stdarg.h>
+
+void openxc::util::log::debugNoNewline(const char* format, ...) {
+#ifdef __DEBUG__
+    // stdout carries the USB output stream, so keep logging out of it
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+#endif // __DEBUG__
+}
+
+void openxc::util::log::initialize() { }
@@ -0,0 +1,8 @@
+#include "platform/platform.h"
+#include <signal.h>
+
+void openxc::platform::initialize() {
+    // A disconnected UART client or closed output pipe must not kill the
+    // firmware - the write fails and is handled like any other
+    signal(SIGPIPE, SIG_IGN);
+}
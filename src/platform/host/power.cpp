@@ -0,0 +1,98 @@
+#include "power.h"
+#include "power_host.h"
+#include "util/log.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Wake up at least this often while waiting for an interrupt, the same as the
+// SysTick interrupt on the microcontroller, so periodic tasks keep running
+#define SYSTICK_PERIOD_NS 1000000
+
+static pthread_mutex_t interruptMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t interruptCondition = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idleCondition = PTHREAD_COND_INITIALIZER;
+static unsigned long idleCount;
+static bool interruptPending;
+static int interruptSources;
+
+void beginInterrupt() {
+    pthread_mutex_lock(&interruptMutex);
+}
+
+void endInterrupt() {
+    interruptPending = true;
+    pthread_cond_signal(&interruptCondition);
+    pthread_mutex_unlock(&interruptMutex);
+}
+
+void disableInterrupts() {
+    pthread_mutex_lock(&interruptMutex);
+}
+
+void enableInterrupts() {
+    pthread_mutex_unlock(&interruptMutex);
+}
+
+void registerInterruptSource() {
+    beginInterrupt();
+    ++interruptSources;
+    endInterrupt();
+}
+
+void unregisterInterruptSource() {
+    beginInterrupt();
+    --interruptSources;
+    endInterrupt();
+}
+
+void waitForIdle() {
+    pthread_mutex_lock(&interruptMutex);
+    // Wake the main loop in case it's already waiting, so it checks for work
+    // again after anything this thread just queued
+    interruptPending = true;
+    pthread_cond_signal(&interruptCondition);
+    unsigned long count = idleCount;
+    while(idleCount == count) {
+        pthread_cond_wait(&idleCondition, &interruptMutex);
+    }
+    pthread_mutex_unlock(&interruptMutex);
+}
+
+void openxc::power::initialize() { }
+
+void openxc::power::handleWake() { }
+
+void openxc::power::suspend() {
+    // There's no low power mode to drop into, so the closest thing is to stop
+    debug("Suspending - exiting");
+    exit(EXIT_SUCCESS);
+}
+
+bool openxc::power::waitForInterrupt(bool (*idle)()) {
+    pthread_mutex_lock(&interruptMutex);
+    bool sleep = idle();
+    if(sleep) {
+        ++idleCount;
+        pthread_cond_broadcast(&idleCondition);
+        if(interruptSources == 0) {
+            pthread_mutex_unlock(&interruptMutex);
+            debug("All input finished - exiting");
+            exit(EXIT_SUCCESS);
+        }
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += SYSTICK_PERIOD_NS;
+        if(deadline.tv_nsec >= 1000000000) {
+            deadline.tv_nsec -= 1000000000;
+            ++deadline.tv_sec;
+        }
+
+        interruptPending = false;
+        while(!interruptPending && pthread_cond_timedwait(&interruptCondition,
+                    &interruptMutex, &deadline) == 0);
+    }
+    pthread_mutex_unlock(&interruptMutex);
+    return sleep;
+}
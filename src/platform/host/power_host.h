@@ -0,0 +1,36 @@
+#ifndef __POWER_HOST__
+#define __POWER_HOST__
+
+/* The host platform runs each input device on its own thread. Those threads
+ * stand in for interrupt handlers - they must call beginInterrupt() before
+ * touching any queue shared with the main loop, and endInterrupt() when done,
+ * which wakes up the main loop if it's waiting for an interrupt.
+ */
+
+void beginInterrupt();
+
+void endInterrupt();
+
+/* Public: Block the device threads while the main loop touches state they
+ * share, the same as disabling interrupts on the microcontroller.
+ */
+void disableInterrupts();
+
+void enableInterrupts();
+
+/* Public: Register or unregister a device thread that may deliver more input.
+ * Once all of them are finished (e.g. a replayed trace has ended) and there is
+ * no work left, the firmware exits instead of waiting for an interrupt that
+ * will never come.
+ */
+void registerInterruptSource();
+
+void unregisterInterruptSource();
+
+/* Public: Block a device thread until the main loop has run out of work and is
+ * about to wait for an interrupt, i.e. everything queued so far has been
+ * handled.
+ */
+void waitForIdle();
+
+#endif // __POWER_HOST__
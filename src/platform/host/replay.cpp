@@ -0,0 +1,247 @@
+#include "canutil_host.h"
+#include "power_host.h"
+#include "can/trace.h"
+#include "pipeline.h"
+#include "signals.h"
+#include "statistics.h"
+#include "util/log.h"
+#include "util/timer.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TRACE_ENVIRONMENT_VARIABLE "OPENXC_TRACE"
+#define TRACE_SPEED_ENVIRONMENT_VARIABLE "OPENXC_TRACE_SPEED"
+#define TRACE_QUEUE_FULL_DELAY_US 50
+
+using openxc::can::trace::TraceFrame;
+using openxc::can::trace::parseLine;
+using openxc::pipeline::Pipeline;
+using openxc::signals::getCanBusCount;
+using openxc::signals::getCanBuses;
+using openxc::statistics::STATISTICS;
+using openxc::util::time::setVirtualTimeUs;
+using openxc::util::time::virtualClockEnabled;
+using openxc::util::time::virtualTimeUs;
+
+extern Pipeline pipeline;
+
+/* Private: The state of a trace being replayed.
+ *
+ * contents - The memory mapped trace file.
+ * length - The size of the trace file in bytes.
+ * speed - The multiple of real time to replay at, or 0 to replay as fast as
+ *      the firmware can take the frames.
+ * frames - The number of frames replayed so far.
+ * invalidLines - The number of lines that didn't hold a valid frame.
+ * startTime - When the replay started.
+ * firstTimestampUs - The timestamp of the first frame in the trace, or 0
+ *      before the first frame.
+ * clockStartUs - The time of the virtual clock when the replay started, if
+ *      the trace is driving it.
+ */
+typedef struct {
+    const char* contents;
+    size_t length;
+    double speed;
+    unsigned long frames;
+    unsigned long invalidLines;
+    struct timespec startTime;
+    uint64_t firstTimestampUs;
+    uint64_t clockStartUs;
+} TraceReplay;
+
+static TraceReplay replay;
+static pthread_t replayThread;
+
+/* Private: Returns the number of nanoseconds from start to end. */
+static long long elapsedNs(struct timespec* start, struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) * 1000000000LL +
+        (end->tv_nsec - start->tv_nsec);
+}
+
+/* Private: Returns the bus that the trace frame was captured from, matched by
+ * bus address or interface name, falling back to the first bus so single bus
+ * traces work whatever the interface was called.
+ */
+static CanBus* busForFrame(TraceFrame* frame) {
+    for(int i = 0; i < getCanBusCount(); i++) {
+        CanBus* bus = &getCanBuses()[i];
+        if(frame->busAddress != 0 ? bus->address == frame->busAddress :
+                !strcmp(CAN_CONTROLLER(bus)->interfaceName,
+                    frame->interfaceName)) {
+            return bus;
+        }
+    }
+    return &getCanBuses()[0];
+}
+
+/* Private: Sleep until the frame is due, relative to the first frame of the
+ * trace and scaled by the replay speed.
+ */
+static void waitForFrame(TraceFrame* frame) {
+    if(frame->timestampUs > replay.firstTimestampUs) {
+        long long offsetNs = (frame->timestampUs - replay.firstTimestampUs) *
+            1000 / replay.speed;
+        struct timespec due = replay.startTime;
+        due.tv_sec += offsetNs / 1000000000;
+        due.tv_nsec += offsetNs % 1000000000;
+        if(due.tv_nsec >= 1000000000) {
+            due.tv_nsec -= 1000000000;
+            ++due.tv_sec;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+    }
+}
+
+/* Private: Move the virtual clock to the time of the frame, relative to the
+ * first frame of the trace. Before the clock moves on, the firmware is left to
+ * finish with the frames already queued, so each frame is decoded at the time
+ * it was received and the output is the same on every run.
+ */
+static void advanceClock(TraceFrame* frame) {
+    uint64_t timeUs = replay.clockStartUs;
+    if(frame->timestampUs > replay.firstTimestampUs) {
+        timeUs += frame->timestampUs - replay.firstTimestampUs;
+    }
+
+    if(timeUs > virtualTimeUs()) {
+        waitForIdle();
+        setVirtualTimeUs(timeUs);
+    }
+}
+
+/* Private: Queue a frame from the trace. At full speed this waits for room
+ * in the receive queue, so nothing is lost. When paced, the frame is dropped
+ * if the queue is full, the same as a real bus, to show whether the firmware
+ * keeps up at that rate.
+ */
+static void injectFrame(TraceFrame* frame) {
+    CanBus* bus = busForFrame(frame);
+    CanMessage message = {bus, frame->id, frame->data};
+    beginInterrupt();
+    while(!QUEUE_PUSH(CanMessage, &bus->receiveQueue, message)) {
+        if(replay.speed != 0) {
+            ++bus->messagesDropped;
+            break;
+        }
+        endInterrupt();
+        usleep(TRACE_QUEUE_FULL_DELAY_US);
+        beginInterrupt();
+    }
+    endInterrupt();
+}
+
+/* Private: Replay every frame in the trace, one line at a time. */
+static void* replayTrace(void* argument) {
+    const char* position = replay.contents;
+    const char* end = replay.contents + replay.length;
+    while(position < end) {
+        const char* lineEnd = (const char*) memchr(position, '\n',
+                end - position);
+        if(lineEnd == NULL) {
+            lineEnd = end;
+        }
+
+        TraceFrame frame;
+        if(parseLine(position, lineEnd - position, &frame)) {
+            if(replay.firstTimestampUs == 0) {
+                replay.firstTimestampUs = frame.timestampUs;
+            }
+            if(replay.speed != 0) {
+                waitForFrame(&frame);
+            }
+            if(virtualClockEnabled()) {
+                advanceClock(&frame);
+            }
+            injectFrame(&frame);
+            ++replay.frames;
+        } else if(lineEnd > position) {
+            ++replay.invalidLines;
+        }
+        position = lineEnd + 1;
+    }
+
+    debug("Trace replay finished after %lu frames (%lu invalid lines)",
+            replay.frames, replay.invalidLines);
+    unregisterInterruptSource();
+    return NULL;
+}
+
+/* Private: Print the throughput of the replay, measured from the start of the
+ * replay until the firmware has finished with the last of its output.
+ */
+static void reportReplay() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double seconds = elapsedNs(&replay.startTime, &now) / 1e9;
+
+    unsigned long long bytesSent = 0;
+    for(int i = 0; i < openxc::pipeline::MESSAGE_TYPE_COUNT; i++) {
+        bytesSent += pipeline.statistics[i].bytesSent;
+    }
+    unsigned long dropped = 0;
+    for(int i = 0; i < getCanBusCount(); i++) {
+        dropped += getCanBuses()[i].messagesDropped;
+    }
+
+    fprintf(stderr, "Replayed %lu frames in %.3f s: %.0f frames/s, "
+            "%.0f messages/s, %llu output bytes (%.0f bytes/s), "
+            "%lu frames dropped\n",
+            replay.frames, seconds, replay.frames / seconds,
+            STATISTICS.messagesSerialized / seconds, bytesSent,
+            bytesSent / seconds, dropped);
+}
+
+void startTraceReplay() {
+    static bool started = false;
+    const char* tracePath = getenv(TRACE_ENVIRONMENT_VARIABLE);
+    if(started || tracePath == NULL) {
+        return;
+    }
+
+    int traceFile = open(tracePath, O_RDONLY);
+    struct stat traceStatus;
+    if(traceFile < 0 || fstat(traceFile, &traceStatus) < 0) {
+        debug("Unable to open trace file %s", tracePath);
+        return;
+    }
+
+    replay.length = traceStatus.st_size;
+    if(replay.length > 0) {
+        replay.contents = (const char*) mmap(NULL, replay.length, PROT_READ,
+                MAP_PRIVATE, traceFile, 0);
+        if(replay.contents == MAP_FAILED) {
+            debug("Unable to map trace file %s", tracePath);
+            close(traceFile);
+            return;
+        }
+        madvise((void*) replay.contents, replay.length, MADV_SEQUENTIAL);
+    }
+    close(traceFile);
+
+    const char* speed = getenv(TRACE_SPEED_ENVIRONMENT_VARIABLE);
+    replay.speed = speed == NULL || !strcmp(speed, "max") ? 0 : atof(speed);
+    if(replay.speed < 0) {
+        replay.speed = 0;
+    }
+
+    started = true;
+    registerInterruptSource();
+    atexit(reportReplay);
+    clock_gettime(CLOCK_MONOTONIC, &replay.startTime);
+    replay.clockStartUs = virtualTimeUs();
+    pthread_create(&replayThread, NULL, replayTrace, NULL);
+    if(replay.speed == 0) {
+        debug("Replaying CAN trace from %s at full speed", tracePath);
+    } else {
+        debug("Replaying CAN trace from %s at %gx real time", tracePath,
+                replay.speed);
+    }
+}
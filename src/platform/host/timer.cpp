@@ -0,0 +1,65 @@
+#include "util/timer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Set to "trace" to run on a virtual clock that follows the timestamps of the
+// replayed trace, instead of the real time
+#define CLOCK_ENVIRONMENT_VARIABLE "OPENXC_CLOCK"
+
+// Start the virtual clock after 0, so a frame received at the very start isn't
+// mistaken for no frame at all
+#define VIRTUAL_CLOCK_START_US 1000000
+
+static struct timespec startTime;
+
+/* Private: Returns the time since the timer was initialized, in microseconds,
+ * or the time of the virtual clock if it's in use.
+ */
+static unsigned long long elapsedUs() {
+    if(openxc::util::time::virtualClockEnabled()) {
+        return openxc::util::time::virtualTimeUs();
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - startTime.tv_sec) * 1000000ULL +
+        (now.tv_nsec - startTime.tv_nsec) / 1000;
+}
+
+void openxc::util::time::delayMs(int delayInMs) {
+    if(virtualClockEnabled()) {
+        advanceVirtualTimeUs(delayInMs * 1000ULL);
+        return;
+    }
+
+    struct timespec delay = {delayInMs / 1000, (delayInMs % 1000) * 1000000};
+    nanosleep(&delay, NULL);
+}
+
+unsigned long openxc::util::time::systemTimeMs() {
+    return elapsedUs() / 1000;
+}
+
+unsigned long openxc::util::time::systemTimeUs() {
+    return elapsedUs();
+}
+
+uint32_t openxc::util::time::cycleCount() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+uint32_t openxc::util::time::cyclesPerUs() {
+    return 1000;
+}
+
+void openxc::util::time::initialize() {
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    const char* clock = getenv(CLOCK_ENVIRONMENT_VARIABLE);
+    if(clock != NULL && !strcmp(clock, "trace")) {
+        useVirtualClock(VIRTUAL_CLOCK_START_US);
+    }
+}
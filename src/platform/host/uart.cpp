@@ -0,0 +1,140 @@
+#include "interface/uart.h"
+#include "util/bytebuffer.h"
+#include "util/log.h"
+#include "power_host.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// UART is a TCP server on the loopback interface listening on this port - a
+// single client at a time stands in for the Bluetooth module's host. UART is
+// disabled if the variable isn't set.
+#define UART_PORT_ENVIRONMENT_VARIABLE "OPENXC_UART_PORT"
+#define UART_READ_CHUNK_SIZE 64
+#define UART_FLOW_CONTROL_DELAY_US 100
+
+using openxc::interface::uart::UartDevice;
+using openxc::util::bytebuffer::processQueue;
+using openxc::util::bytebuffer::drainQueue;
+
+static int serverSocket = -1;
+static volatile int clientSocket = -1;
+static pthread_t serverThread;
+
+/* Private: Push received bytes into the receive queue, waiting for the main
+ * loop to make room if it's full - the same as holding RTS inactive.
+ */
+static void receiveBytes(UartDevice* device, uint8_t* bytes, int length) {
+    int received = 0;
+    while(received < length) {
+        beginInterrupt();
+        while(received < length &&
+                QUEUE_PUSH(uint8_t, &device->receiveQueue, bytes[received])) {
+            ++received;
+        }
+        endInterrupt();
+
+        if(received < length) {
+            usleep(UART_FLOW_CONTROL_DELAY_US);
+        }
+    }
+}
+
+/* Private: Accept one client at a time and read from it until it disconnects.
+ */
+static void* serve(void* argument) {
+    UartDevice* device = (UartDevice*) argument;
+    for(;;) {
+        int client = accept(serverSocket, NULL, NULL);
+        if(client < 0) {
+            break;
+        }
+
+        debug("UART client connected");
+        clientSocket = client;
+        uint8_t buffer[UART_READ_CHUNK_SIZE];
+        ssize_t received;
+        while((received = recv(client, buffer, sizeof(buffer), 0)) > 0) {
+            receiveBytes(device, buffer, received);
+        }
+
+        debug("UART client disconnected");
+        clientSocket = -1;
+        close(client);
+    }
+
+    unregisterInterruptSource();
+    return NULL;
+}
+
+void openxc::interface::uart::read(UartDevice* device,
+        bool (*callback)(uint8_t*, int)) {
+    if(device != NULL && !QUEUE_EMPTY(uint8_t, &device->receiveQueue)) {
+        // processQueue moves the front of the queue and writes to it in place,
+        // so keep the server thread out
+        disableInterrupts();
+        processQueue(&device->receiveQueue, &device->framer, callback);
+        enableInterrupts();
+    }
+}
+
+void openxc::interface::uart::initialize(UartDevice* device) {
+    uart::initializeCommon(device);
+
+    const char* port = getenv(UART_PORT_ENVIRONMENT_VARIABLE);
+    if(device == NULL || port == NULL) {
+        debug("disabled.");
+        return;
+    }
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(atoi(port));
+
+    int reuse = 1;
+    serverSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if(serverSocket < 0 || setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR,
+                &reuse, sizeof(reuse)) < 0
+            || bind(serverSocket, (struct sockaddr*) &address,
+                sizeof(address)) < 0
+            || listen(serverSocket, 1) < 0) {
+        debug("unable to listen on port %s", port);
+        return;
+    }
+
+    registerInterruptSource();
+    pthread_create(&serverThread, NULL, serve, device);
+    debug("listening on port %s.", port);
+}
+
+/* Private: Send as many bytes to the client as the socket will take without
+ * blocking.
+ *
+ * Returns the number of bytes sent.
+ */
+static int sendToClient(const uint8_t* bytes, int length) {
+    ssize_t sent = send(clientSocket, bytes, length,
+            MSG_DONTWAIT | MSG_NOSIGNAL);
+    return sent > 0 ? sent : 0;
+}
+
+void openxc::interface::uart::processSendQueue(UartDevice* device) {
+    if(clientSocket < 0) {
+        return;
+    }
+
+    // Like the UART transmit interrupt, send whatever the socket will take
+    // right now straight from the queue, and leave the rest for later
+    drainQueue(&device->sendQueue, QUEUE_LENGTH(uint8_t, &device->sendQueue),
+            sendToClient);
+}
+
+bool openxc::interface::uart::connected(UartDevice* device) {
+    return device != NULL && clientSocket >= 0;
+}
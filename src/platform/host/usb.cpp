@@ -0,0 +1,118 @@
+#include "interface/usb.h"
+#include "util/log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// The USB IN endpoint is written to this file (or stdout), and there is no
+// host to device data.
+#define USB_OUTPUT_ENVIRONMENT_VARIABLE "OPENXC_USB_OUTPUT"
+// The most bytes the simulated host reads from the IN endpoint at once. If it's
+// set, the USB throughput is reported at exit.
+#define USB_READ_SIZE_ENVIRONMENT_VARIABLE "OPENXC_USB_READ_SIZE"
+#define DEFAULT_USB_READ_SIZE 512
+
+static FILE* outputFile;
+static int readSize;
+// The first byte of each IN transfer in flight, by its index in the device's
+// inTransferLengths
+static uint8_t* transferData[USB_IN_TRANSFER_COUNT];
+
+static struct {
+    unsigned long long bytes;
+    unsigned long transfers;
+    unsigned long long sendNs;
+} throughput;
+
+static void reportThroughput() {
+    double seconds = throughput.sendNs / 1e9;
+    fprintf(stderr, "USB sent %llu bytes in %lu transfers of up to %d bytes "
+            "in %.3f s: %.2f MB/s\n", throughput.bytes, throughput.transfers,
+            readSize, seconds,
+            seconds > 0 ? throughput.bytes / seconds / 1e6 : 0);
+}
+
+void openxc::interface::usb::initialize(UsbDevice* usbDevice) {
+    usb::initializeCommon(usbDevice);
+
+    outputFile = stdout;
+    const char* outputPath = getenv(USB_OUTPUT_ENVIRONMENT_VARIABLE);
+    if(outputPath != NULL) {
+        outputFile = fopen(outputPath, "w");
+        if(outputFile == NULL) {
+            debug("Unable to open %s, using stdout", outputPath);
+            outputFile = stdout;
+        }
+    }
+
+    readSize = DEFAULT_USB_READ_SIZE;
+    const char* readSizeValue = getenv(USB_READ_SIZE_ENVIRONMENT_VARIABLE);
+    if(readSizeValue != NULL) {
+        readSize = atoi(readSizeValue);
+        if(readSize <= 0) {
+            debug("Invalid USB read size %s, using %d", readSizeValue,
+                    DEFAULT_USB_READ_SIZE);
+            readSize = DEFAULT_USB_READ_SIZE;
+        }
+        atexit(reportThroughput);
+    }
+
+    usbDevice->configured = true;
+    debug("Done.");
+}
+
+void openxc::interface::usb::processSendQueue(UsbDevice* usbDevice) {
+    if(!usbDevice->configured || QUEUE_EMPTY(uint8_t, &usbDevice->sendQueue)) {
+        return;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while(true) {
+        // Like the controller, prepare the next transfer from the queue while
+        // the host reads the oldest one
+        uint8_t* data;
+        int length;
+        int index;
+        while((index = startInTransfer(usbDevice, readSize, &data,
+                        &length)) != -1) {
+            transferData[index] = data;
+        }
+
+        index = oldestInTransfer(usbDevice);
+        if(index == -1) {
+            break;
+        }
+
+        length = usbDevice->inTransferLengths[index];
+        if(fwrite(transferData[index], 1, length, outputFile)
+                != (size_t)length) {
+            debug("USB output is closed, disabling USB");
+            usbDevice->configured = false;
+            cancelInTransfers(usbDevice);
+            return;
+        }
+        finishInTransfer(usbDevice);
+        throughput.bytes += length;
+        ++throughput.transfers;
+    }
+    // Don't leave anything sitting in stdio's buffer, the same as handing it
+    // to the USB controller
+    fflush(outputFile);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    throughput.sendNs += (end.tv_sec - start.tv_sec) * 1000000000ULL
+            + end.tv_nsec - start.tv_nsec;
+}
+
+void openxc::interface::usb::read(UsbDevice* usbDevice,
+        bool (*callback)(uint8_t*, int)) { }
+
+void openxc::interface::usb::sendControlMessage(uint8_t* data,
+        uint16_t length) {
+    debug("Control response: %.*s", length, data);
+}
+
+void openxc::interface::usb::deinitialize(UsbDevice* usbDevice) {
+    fflush(outputFile);
+}
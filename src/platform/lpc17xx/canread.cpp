@@ -32,14 +32,10 @@ void CAN_IRQHandler() {
         if((CAN_IntGetStatus(CAN_CONTROLLER(bus)) & 0x01) == 1) {
             CanMessage message = receiveCanMessage(bus);
             if(!QUEUE_PUSH(CanMessage, &bus->receiveQueue, message)) {
-                // An exception to the "don't leave commented out code" rule,
-                // this log statement is useful for debugging performance issues
-                // but if left enabled all of the time, it can can slown down
-                // the interrupt handler so much that it locks up the device in
-                // permanent interrupt handling land.
-                //
-                // debug("Dropped CAN message with ID 0x%02x -- queue is full",
-                // message.id);
+                ++bus->messagesDropped;
+
+                debugDeferred("Dropped CAN message with ID 0x%02x -- queue is full",
+                        message.id);
             }
         }
     }
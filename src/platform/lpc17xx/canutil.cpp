@@ -79,6 +79,13 @@ void openxc::can::initialize(CanBus* bus) {
         CAN_CONTROLLER_INITIALIZED = true;
     }
     CAN_ModeConfig(CAN_CONTROLLER(bus), CAN_OPERATING_MODE, ENABLE);
+#ifdef CAN_LOOPBACK_SELF_TEST
+    // In self test mode, a transmitted message doesn't need to be acknowledged
+    // by another node, and a self reception request receives it back. It's
+    // still sent on the bus, so the build is refused unless
+    // CAN_LOOPBACK_SELF_TEST_ON_BUS is set (see lpc17xx.mk).
+    CAN_ModeConfig(CAN_CONTROLLER(bus), CAN_SELFTEST_MODE, ENABLE);
+#endif // CAN_LOOPBACK_SELF_TEST
 
     // enable receiver interrupt
     CAN_IRQCmd(CAN_CONTROLLER(bus), CANINT_RIE, ENABLE);
@@ -12,6 +12,36 @@ void copyToMessageBuffer(uint64_t source, uint8_t* a, uint8_t* b) {
     }
 }
 
+#ifdef CAN_LOOPBACK_SELF_TEST
+// Status register: transmit buffer 1 is free
+#define CAN_SR_TBS1_FREE (1 << 2)
+// Command register: self reception request from transmit buffer 1
+#define CAN_CMR_SELF_RECEPTION_BUFFER1 0x30
+
+/* Private: Send a message from transmit buffer 1 with a self reception
+ * request, which the controller receives back itself in self test mode. The
+ * driver's CAN_SendMsg() only makes regular transmission requests.
+ *
+ * Returns SUCCESS if the message was queued, or ERROR if the buffer is busy.
+ */
+Status sendSelfReceptionMessage(LPC_CAN_TypeDef* controller,
+        CAN_MSG_Type* message) {
+    if(!(controller->SR & CAN_SR_TBS1_FREE)) {
+        return ERROR;
+    }
+
+    // standard ID data frame, with the data length in bits 16-19
+    controller->TFI1 = (message->len & 0x0f) << 16;
+    controller->TID1 = message->id;
+    controller->TDA1 = message->dataA[0] | (message->dataA[1] << 8) |
+        (message->dataA[2] << 16) | (message->dataA[3] << 24);
+    controller->TDB1 = message->dataB[0] | (message->dataB[1] << 8) |
+        (message->dataB[2] << 16) | (message->dataB[3] << 24);
+    controller->CMR = CAN_CMR_SELF_RECEPTION_BUFFER1;
+    return SUCCESS;
+}
+#endif // CAN_LOOPBACK_SELF_TEST
+
 bool openxc::can::write::sendMessage(CanBus* bus, CanMessage request) {
     CAN_MSG_Type message;
     message.id =  request.id;
@@ -20,5 +50,9 @@ bool openxc::can::write::sendMessage(CanBus* bus, CanMessage request) {
     message.format = STD_ID_FORMAT;
     copyToMessageBuffer(request.data, message.dataA, message.dataB);
 
+#ifdef CAN_LOOPBACK_SELF_TEST
+    return sendSelfReceptionMessage(CAN_CONTROLLER(bus), &message) == SUCCESS;
+#else
     return CAN_SendMsg(CAN_CONTROLLER(bus), &message) == SUCCESS;
+#endif // CAN_LOOPBACK_SELF_TEST
 }
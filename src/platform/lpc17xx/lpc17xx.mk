@@ -31,6 +31,17 @@ ONLY_C_FLAGS = -std=gnu99
 ONLY_CPP_FLAGS = -std=gnu++0x
 CC_SYMBOLS += -DTOOLCHAIN_GCC_ARM -DUSB_DEVICE_ONLY -D__LPC17XX__ -DBOARD=9
 
+# Unlike the PIC32's internal loopback, the LPC17xx self test mode still
+# transmits every frame on the physical bus - it only doesn't need another node
+# to acknowledge it. Don't let it be built for a board that might be connected
+# to a vehicle by accident.
+ifdef CAN_LOOPBACK_SELF_TEST
+ifndef CAN_LOOPBACK_SELF_TEST_ON_BUS
+$(error The LPC17xx CAN self test transmits on the bus - only use it on a \
+	bench with nothing else connected, and set CAN_LOOPBACK_SELF_TEST_ON_BUS=1)
+endif
+endif
+
 ifeq ($(PLATFORM), BLUEBOARD)
 CC_SYMBOLS += -DBLUEBOARD
 else
@@ -101,6 +101,18 @@ void openxc::power::suspend() {
     CLKPWR_DeepSleep();
 }
 
+bool openxc::power::waitForInterrupt(bool (*idle)()) {
+    // WFI still wakes up for an interrupt that becomes pending while they are
+    // disabled, and the handler runs as soon as they are enabled again
+    __disable_irq();
+    bool sleep = idle();
+    if(sleep) {
+        __WFI();
+    }
+    __enable_irq();
+    return sleep;
+}
+
 extern "C" {
 
 void CANActivity_IRQHandler(void) {
@@ -5,7 +5,15 @@
 
 #define DELAY_TIMER LPC_TIM0
 
-unsigned int SYSTEM_TICK_COUNT;
+// The cycle counter of the Cortex-M3 data watchpoint and trace unit, which
+// must be enabled through the debug exception and monitor control register
+#define DWT_CONTROL (*(volatile uint32_t*) 0xE0001000)
+#define DWT_CYCLE_COUNT (*(volatile uint32_t*) 0xE0001004)
+#define DEBUG_MONITOR_CONTROL (*(volatile uint32_t*) 0xE000EDFC)
+#define DWT_CONTROL_CYCLE_COUNT_ENABLE 0x1
+#define DEBUG_MONITOR_CONTROL_TRACE_ENABLE (1 << 24)
+
+volatile unsigned int SYSTEM_TICK_COUNT;
 
 extern "C" {
 
@@ -35,7 +43,31 @@ unsigned long openxc::util::time::systemTimeMs() {
     return SYSTEM_TICK_COUNT;
 }
 
+unsigned long openxc::util::time::systemTimeUs() {
+    unsigned int ticks;
+    uint32_t count;
+    // Sample again if the SysTick interrupt fired in between reading the tick
+    // count and the current value of the down counter
+    do {
+        ticks = SYSTEM_TICK_COUNT;
+        count = SysTick->VAL;
+    } while(ticks != SYSTEM_TICK_COUNT);
+    return ticks * 1000 + (SysTick->LOAD - count) / (SystemCoreClock / 1000000);
+}
+
+uint32_t openxc::util::time::cycleCount() {
+    return DWT_CYCLE_COUNT;
+}
+
+uint32_t openxc::util::time::cyclesPerUs() {
+    return SystemCoreClock / 1000000;
+}
+
 void openxc::util::time::initialize() {
     // Configure for 1ms tick
     SysTick_Config(SystemCoreClock / 1000);
+
+    DEBUG_MONITOR_CONTROL |= DEBUG_MONITOR_CONTROL_TRACE_ENABLE;
+    DWT_CYCLE_COUNT = 0;
+    DWT_CONTROL |= DWT_CONTROL_CYCLE_COUNT_ENABLE;
 }
@@ -43,6 +43,7 @@ namespace gpio = openxc::gpio;
 
 using openxc::pipeline::Pipeline;
 using openxc::util::bytebuffer::processQueue;
+using openxc::util::bytebuffer::drainQueue;
 using openxc::gpio::GpioValue;
 using openxc::gpio::GpioDirection;
 
@@ -95,19 +96,27 @@ void handleReceiveInterrupt() {
     }
 }
 
+/* Private: Write bytes straight into the transmit FIFO, which must have room
+ * for them.
+ *
+ * Returns the number of bytes written, always length.
+ */
+int writeToTransmitFifo(const uint8_t* bytes, int length) {
+    for(int i = 0; i < length; i++) {
+        UART_SendByte(UART1_DEVICE, bytes[i]);
+    }
+    return length;
+}
+
+/* Private: Refill the transmit FIFO from the send queue. This must only be
+ * called when the FIFO is empty, i.e. from the THRE interrupt or when THRE is
+ * set, so the whole FIFO can be filled without checking for room.
+ */
 void handleTransmitInterrupt() {
     disableTransmitInterrupt();
 
-    while(UART_CheckBusy(UART1_DEVICE) == SET);
-
-    while(!QUEUE_EMPTY(uint8_t, &pipeline.uart->sendQueue)) {
-        uint8_t byte = QUEUE_PEEK(uint8_t, &pipeline.uart->sendQueue);
-        if(UART_Send(UART1_DEVICE, &byte, 1, NONE_BLOCKING)) {
-            QUEUE_POP(uint8_t, &pipeline.uart->sendQueue);
-        } else {
-            break;
-        }
-    }
+    drainQueue(&pipeline.uart->sendQueue, UART_TX_FIFO_SIZE,
+            writeToTransmitFifo);
 
     if(QUEUE_EMPTY(uint8_t, &pipeline.uart->sendQueue)) {
         disableTransmitInterrupt();
@@ -152,10 +161,10 @@ void UART1_IRQHandler() {
 
 }
 
-void openxc::interface::uart::read(UartDevice* device, bool (*callback)(uint8_t*)) {
+void openxc::interface::uart::read(UartDevice* device, bool (*callback)(uint8_t*, int)) {
     if(device != NULL) {
         if(!QUEUE_EMPTY(uint8_t, &device->receiveQueue)) {
-            processQueue(&device->receiveQueue, callback);
+            processQueue(&device->receiveQueue, &device->framer, callback);
             if(!QUEUE_FULL(uint8_t, &device->receiveQueue)) {
                 resumeReceive();
             }
@@ -252,7 +261,10 @@ void openxc::interface::uart::initialize(UartDevice* device) {
 
 void openxc::interface::uart::processSendQueue(UartDevice* device) {
     if(!QUEUE_EMPTY(uint8_t, &device->sendQueue)) {
-        if(TRANSMIT_INTERRUPT_STATUS == RESET) {
+        // If the FIFO is still sending the end of the last burst, the THRE
+        // interrupt will refill it once it's empty
+        if(TRANSMIT_INTERRUPT_STATUS == RESET &&
+                (UART1_DEVICE->LSR & UART_LSR_THRE)) {
             handleTransmitInterrupt();
         } else {
             enableTransmitInterrupt();
@@ -29,6 +29,7 @@ namespace gpio = openxc::gpio;
 
 using openxc::interface::usb::UsbDevice;
 using openxc::util::bytebuffer::processQueue;
+using openxc::util::bytebuffer::drainQueue;
 using openxc::gpio::GPIO_VALUE_HIGH;
 using openxc::gpio::GPIO_VALUE_LOW;
 
@@ -66,7 +67,21 @@ void EVENT_USB_Device_ConfigurationChanged(void) {
 
 }
 
-/* Private: Flush any queued data out to the USB host. */
+/* Private: Copy bytes from the send queue into the selected IN endpoint's
+ * bank.
+ */
+static int writeToEndpoint(const uint8_t* bytes, int length) {
+    Endpoint_Write_Stream_LE(bytes, length, NULL);
+    return length;
+}
+
+/* Private: Flush any queued data out to the USB host.
+ *
+ * The IN endpoint has two banks, so one packet is prepared while the host reads
+ * the other. Each packet is written straight from the send queue, in up to two
+ * pieces if it wraps around the end of the queue, instead of being copied out
+ * of the queue into another buffer first.
+ */
 static void sendToHost(UsbDevice* usbDevice) {
     if(!usbDevice->configured) {
         return;
@@ -74,21 +89,12 @@ static void sendToHost(UsbDevice* usbDevice) {
 
     uint8_t previousEndpoint = Endpoint_GetCurrentEndpoint();
     Endpoint_SelectEndpoint(IN_ENDPOINT_NUMBER);
-    if(!Endpoint_IsINReady() || QUEUE_EMPTY(uint8_t, &usbDevice->sendQueue)) {
-        return;
-    }
-
-    // get bytes from transmit FIFO into intermediate buffer
-    int byteCount = 0;
-    while(!QUEUE_EMPTY(uint8_t, &usbDevice->sendQueue)
-            && byteCount < USB_SEND_BUFFER_SIZE) {
-        usbDevice->sendBuffer[byteCount++] = QUEUE_POP(uint8_t, &usbDevice->sendQueue);
-    }
-
-    if(byteCount > 0) {
-        Endpoint_Write_Stream_LE(usbDevice->sendBuffer, byteCount, NULL);
+    while(Endpoint_IsINReady()
+            && !QUEUE_EMPTY(uint8_t, &usbDevice->sendQueue)) {
+        drainQueue(&usbDevice->sendQueue, DATA_ENDPOINT_SIZE,
+                writeToEndpoint);
+        Endpoint_ClearIN();
     }
-    Endpoint_ClearIN();
     Endpoint_SelectEndpoint(previousEndpoint);
 }
 
@@ -146,7 +152,7 @@ void configureUsbDetection() {
     PINSEL_ConfigPin(&hostDetectPinConfig);
 }
 
-void openxc::interface::usb::sendControlMessage(uint8_t* data, uint8_t length) {
+void openxc::interface::usb::sendControlMessage(uint8_t* data, uint16_t length) {
     uint8_t previousEndpoint = Endpoint_GetCurrentEndpoint();
     Endpoint_SelectEndpoint(ENDPOINT_CONTROLEP);
 
@@ -178,7 +184,7 @@ void openxc::interface::usb::initialize(UsbDevice* usbDevice) {
     debug("Done.");
 }
 
-void openxc::interface::usb::read(UsbDevice* usbDevice, bool (*callback)(uint8_t*)) {
+void openxc::interface::usb::read(UsbDevice* usbDevice, bool (*callback)(uint8_t*, int)) {
     uint8_t previousEndpoint = Endpoint_GetCurrentEndpoint();
     Endpoint_SelectEndpoint(OUT_ENDPOINT_NUMBER);
 
@@ -189,7 +195,8 @@ void openxc::interface::usb::read(UsbDevice* usbDevice, bool (*callback)(uint8_t
                 debug("Dropped write from host -- queue is full");
             }
         }
-        processQueue(&usbDevice->receiveQueue, callback);
+        processQueue(&usbDevice->receiveQueue, &usbDevice->framer,
+                callback);
         Endpoint_ClearOUT();
     }
     Endpoint_SelectEndpoint(previousEndpoint);
@@ -147,9 +147,16 @@ void openxc::can::initialize(CanBus* bus) {
     gpio::setValue(0, CAN1_TRANSCEIVER_ENABLE_PIN, value);
     #endif
 
+#ifdef CAN_LOOPBACK_SELF_TEST
+    // move CAN module to LOOPBACK state, where transmitted messages are
+    // received internally and nothing goes on the bus
+    CAN_CONTROLLER(bus)->setOperatingMode(CAN::LOOPBACK);
+    while(CAN_CONTROLLER(bus)->getOperatingMode() != CAN::LOOPBACK);
+#else
     // move CAN module to OPERATIONAL state (go on bus)
     CAN_CONTROLLER(bus)->setOperatingMode(CAN::NORMAL_OPERATION);
     while(CAN_CONTROLLER(bus)->getOperatingMode() != CAN::NORMAL_OPERATION);
+#endif // CAN_LOOPBACK_SELF_TEST
 
     CAN_CONTROLLER(bus)->attachInterrupt(bus->interruptHandler);
 
@@ -53,7 +53,7 @@ void openxc::interface::network::processSendQueue(NetworkDevice* device) {
     }
 }
 
-void openxc::interface::network::read(NetworkDevice* device, bool (*callback)(uint8_t*)) {
+void openxc::interface::network::read(NetworkDevice* device, bool (*callback)(uint8_t*, int)) {
     Client client = device->server->available();
     if(client) {
         uint8_t byte;
@@ -61,13 +61,13 @@ void openxc::interface::network::read(NetworkDevice* device, bool (*callback)(ui
                 !QUEUE_FULL(uint8_t, &device->receiveQueue)) {
             QUEUE_PUSH(uint8_t, &device->receiveQueue, byte);
         }
-        processQueue(&device->receiveQueue, callback);
+        processQueue(&device->receiveQueue, &device->framer, callback);
     }
 }
 
 #else
 
-void openxc::interface::network::read(NetworkDevice* device, bool (*callback)(uint8_t*)) { }
+void openxc::interface::network::read(NetworkDevice* device, bool (*callback)(uint8_t*, int)) { }
 void openxc::interface::network::initialize(NetworkDevice* device) { }
 void openxc::interface::network::processSendQueue(NetworkDevice* device) { }
 
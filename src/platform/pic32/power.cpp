@@ -33,3 +33,15 @@ void openxc::power::suspend() {
 void openxc::power::handleWake() {
     SoftReset();
 }
+
+bool openxc::power::waitForInterrupt(bool (*idle)()) {
+    unsigned int interruptStatus = INTDisableInterrupts();
+    bool sleep = idle();
+    INTRestoreInterrupts(interruptStatus);
+    if(sleep) {
+        // An interrupt between re-enabling and the wait instruction is still
+        // caught by the next core timer tick
+        asm volatile("wait");
+    }
+    return sleep;
+}
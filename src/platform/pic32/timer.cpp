@@ -1,6 +1,9 @@
 #include "util/timer.h"
 #include "WProgram.h"
 
+// The core timer counts every second system clock cycle
+#define CORE_TIMER_TICKS_PER_US (F_CPU / 2 / 1000000)
+
 void openxc::util::time::delayMs(int delayInMs) {
     delay(delayInMs);
 }
@@ -9,4 +12,16 @@ unsigned long openxc::util::time::systemTimeMs() {
     return millis();
 }
 
+unsigned long openxc::util::time::systemTimeUs() {
+    return micros();
+}
+
+uint32_t openxc::util::time::cycleCount() {
+    return _CP0_GET_COUNT();
+}
+
+uint32_t openxc::util::time::cyclesPerUs() {
+    return CORE_TIMER_TICKS_PER_US;
+}
+
 void openxc::util::time::initialize() { }
@@ -15,6 +15,18 @@
  * minimize additional programming. U3A's CTS/RTS lines conflict with CAN1, so
  * that's out; that leaves U1A.
  *
+ * Received bytes are moved straight from the UART into the receive queue by a
+ * DMA channel, triggered by the UART's receive interrupt flag, so the main loop
+ * doesn't have to poll for them. The DMA channel is only allowed to fill the
+ * free space in the queue - once it's used up, the UART's receive FIFO fills
+ * and the hardware drops RTS until read() makes room again. The queue's head
+ * only moves in read(), so the main loop may go to sleep with bytes waiting -
+ * they're picked up after the next core timer tick at the latest.
+ *
+ * Bytes are sent by another DMA channel, one contiguous region of the send
+ * queue at a time, so sending doesn't block the main loop. The UART holds the
+ * channel off while CTS is inactive.
+ *
  * Pin 0 - U1ARX, connect this to the TX line of the receiver.
  * Pin 1 - U1ATX, connect this to the RX line of the receiver.
  * Pin 18 - U1ARTS, connect this to the CTS line of the receiver.
@@ -26,6 +38,7 @@
 #include "HardwareSerial.h"
 #include "gpio.h"
 #include "WProgram.h"
+#include <plib.h>
 
 #if defined(CROSSCHASM_C5)
 
@@ -48,25 +61,97 @@
 // bit 8 in the uxMode register controls hardware flow control
 #define _UARTMODE_FLOWCONTROL 8
 
+// Nothing else uses DMA, so these channels are free
+#define UART_RECEIVE_DMA_CHANNEL DMA_CHANNEL1
+#define UART_TRANSMIT_DMA_CHANNEL DMA_CHANNEL2
+
 namespace gpio = openxc::gpio;
 
 using openxc::util::bytebuffer::processQueue;
+using openxc::util::bytebuffer::peekContiguous;
+using openxc::util::bytebuffer::discardFront;
 
 extern HardwareSerial Serial;
 
-// TODO see if we can do this with interrupts on the chipKIT
-// http://www.chipkit.org/forum/viewtopic.php?f=7&t=1088
+/* Private: The part of the receive queue's storage the DMA channel is filling.
+ *
+ * start - The index of the first byte of the block, the queue's head when it
+ *      was started.
+ * length - The length of the block, or 0 if the DMA channel is stopped because
+ *      the queue is full.
+ */
+static int receiveBlockStart;
+static int receiveBlockLength;
+
+// The number of bytes at the front of the send queue the DMA channel is
+// sending, or 0 if it's idle. They stay in the queue until they've been sent.
+static int transmitBlockLength;
+
+/* Private: Start the DMA channel on the contiguous free space after the head
+ * of the receive queue, up to the end of its storage or one byte before the
+ * tail. If there's no free space, leave the channel stopped so the UART holds
+ * off the sender with RTS.
+ */
+static void startReceiveBlock(UartDevice* device) {
+    QUEUE_TYPE(uint8_t)* queue = &device->receiveQueue;
+    int start = queue->head;
+    int length;
+    if(queue->tail > start) {
+        length = queue->tail - start - 1;
+    } else {
+        length = queue_uint8_t_max_internal_length - start;
+        if(queue->tail == 0) {
+            // Leave the empty slot the queue needs to tell full from empty
+            --length;
+        }
+    }
+
+    receiveBlockStart = start;
+    receiveBlockLength = length;
+    if(length > 0) {
+        DmaChnSetTxfer(UART_RECEIVE_DMA_CHANNEL, (void*)&U1RXREG,
+                &queue->elements[start], 1, length, 1);
+        DmaChnEnable(UART_RECEIVE_DMA_CHANNEL);
+    }
+}
+
+/* Private: Move the head of the receive queue past the bytes the DMA channel
+ * has written, and start a new block if the last one is finished.
+ */
+static void updateReceiveQueue(UartDevice* device) {
+    if(receiveBlockLength == 0) {
+        startReceiveBlock(device);
+        return;
+    }
+
+    // Read the pointer before the flag - the pointer goes back to 0 when the
+    // block finishes
+    int received = DmaChnGetDstPnt(UART_RECEIVE_DMA_CHANNEL);
+    bool finished = DmaChnGetEvFlags(UART_RECEIVE_DMA_CHANNEL) &
+            DMA_EV_BLOCK_DONE;
+    if(finished) {
+        received = receiveBlockLength;
+    }
+
+    QUEUE_TYPE(uint8_t)* queue = &device->receiveQueue;
+    queue->head = (receiveBlockStart + received) %
+            queue_uint8_t_max_internal_length;
+    if(finished) {
+        DmaChnClrEvFlags(UART_RECEIVE_DMA_CHANNEL, DMA_EV_BLOCK_DONE);
+        startReceiveBlock(device);
+    }
+}
+
 void openxc::interface::uart::read(UartDevice* device,
-        bool (*callback)(uint8_t*)) {
+        bool (*callback)(uint8_t*, int)) {
     if(device != NULL) {
-        int bytesAvailable = ((HardwareSerial*)device->controller)->available();
-        if(bytesAvailable > 0) {
-            for(int i = 0; i < bytesAvailable &&
-                    !QUEUE_FULL(uint8_t, &device->receiveQueue); i++) {
-                char byte = ((HardwareSerial*)device->controller)->read();
-                QUEUE_PUSH(uint8_t, &device->receiveQueue, (uint8_t) byte);
+        updateReceiveQueue(device);
+        if(!QUEUE_EMPTY(uint8_t, &device->receiveQueue)) {
+            processQueue(&device->receiveQueue, &device->framer, callback);
+            if(receiveBlockLength == 0) {
+                // Resume receiving now that there may be room
+                startReceiveBlock(device);
             }
-            processQueue(&device->receiveQueue, callback);
         }
     }
 }
@@ -93,25 +178,44 @@ void openxc::interface::uart::initialize(UartDevice* device) {
     // bit of a mess.
     ((p32_uart*)_UART1_BASE_ADDRESS)->uxMode.reg |= 2 << _UARTMODE_FLOWCONTROL;
 
+    // The DMA channel takes the received bytes instead of the HardwareSerial
+    // interrupt handler, which would drop them once its small buffer filled up
+    // without ever dropping RTS
+    INTEnable(INT_U1RX, INT_DISABLED);
+    DmaChnOpen(UART_RECEIVE_DMA_CHANNEL, DMA_CHN_PRI2, DMA_OPEN_DEFAULT);
+    DmaChnSetEventControl(UART_RECEIVE_DMA_CHANNEL,
+            DMA_EV_START_IRQ_EN | DMA_EV_START_IRQ(_UART1_RX_IRQ));
+    startReceiveBlock(device);
+
+    DmaChnOpen(UART_TRANSMIT_DMA_CHANNEL, DMA_CHN_PRI2, DMA_OPEN_DEFAULT);
+    DmaChnSetEventControl(UART_TRANSMIT_DMA_CHANNEL,
+            DMA_EV_START_IRQ_EN | DMA_EV_START_IRQ(_UART1_TX_IRQ));
+    transmitBlockLength = 0;
+
     gpio::setDirection(UART_STATUS_PORT, UART_STATUS_PIN,
             gpio::GPIO_DIRECTION_INPUT);
 
     debug("Done.");
 }
 
-// The chipKIT version of this function is blocking. It will entirely flush the
-// send queue before returning.
 void openxc::interface::uart::processSendQueue(UartDevice* device) {
-    int byteCount = 0;
-    char sendBuffer[MAX_MESSAGE_SIZE];
-    while(!QUEUE_EMPTY(uint8_t, &device->sendQueue) &&
-                    byteCount < MAX_MESSAGE_SIZE) {
-        sendBuffer[byteCount++] = QUEUE_POP(uint8_t, &device->sendQueue);
+    if(transmitBlockLength > 0) {
+        if(!(DmaChnGetEvFlags(UART_TRANSMIT_DMA_CHANNEL) &
+                    DMA_EV_BLOCK_DONE)) {
+            return;
+        }
+        DmaChnClrEvFlags(UART_TRANSMIT_DMA_CHANNEL, DMA_EV_BLOCK_DONE);
+        discardFront(&device->sendQueue, transmitBlockLength);
+        transmitBlockLength = 0;
     }
 
-    if(byteCount > 0) {
-        ((HardwareSerial*)device->controller)->write((const uint8_t*)sendBuffer,
-                byteCount);
+    int length;
+    uint8_t* bytes = peekContiguous(&device->sendQueue, &length);
+    if(length > 0) {
+        DmaChnSetTxfer(UART_TRANSMIT_DMA_CHANNEL, bytes, (void*)&U1TXREG,
+                length, 1, 1);
+        DmaChnStartTxfer(UART_TRANSMIT_DMA_CHANNEL, DMA_WAIT_NOT, 0);
+        transmitBlockLength = length;
     }
 }
 
@@ -9,13 +9,12 @@
 
 #endif
 
-#define USB_HANDLE_MAX_WAIT_COUNT 35000
-
 namespace gpio = openxc::gpio;
 
 using openxc::interface::usb::UsbDevice;
 using openxc::gpio::GPIO_DIRECTION_INPUT;
 using openxc::util::bytebuffer::processQueue;
+using openxc::interface::usb::cancelInTransfers;
 
 // This is a reference to the last packet read
 extern volatile CTRL_TRF_SETUP SetupPkt;
@@ -31,6 +30,8 @@ boolean usbCallback(USB_EVENT event, void *pdata, word size) {
     case EVENT_CONFIGURED:
         debug("USB Configured");
         USB_DEVICE.configured = true;
+        // Anything in flight before a reset will never finish
+        cancelInTransfers(&USB_DEVICE);
         USB_DEVICE.device.EnableEndpoint(USB_DEVICE.inEndpoint,
                 USB_IN_ENABLED|USB_HANDSHAKE_ENABLED|USB_DISALLOW_SETUP);
         USB_DEVICE.device.EnableEndpoint(USB_DEVICE.outEndpoint,
@@ -46,7 +47,7 @@ boolean usbCallback(USB_EVENT event, void *pdata, word size) {
     }
 }
 
-void openxc::interface::usb::sendControlMessage(uint8_t* data, uint8_t length) {
+void openxc::interface::usb::sendControlMessage(uint8_t* data, uint16_t length) {
     USB_DEVICE.device.EP0SendRAMPtr(data, length, USB_EP0_INCLUDE_ZERO);
 }
 
@@ -58,73 +59,36 @@ bool vbusEnabled() {
 #endif
 }
 
-bool waitForHandle(UsbDevice* usbDevice) {
-    int i = 0;
-    while(usbDevice->configured &&
-            usbDevice->device.HandleBusy(usbDevice->deviceToHostHandle)) {
-        ++i;
-        if(i > USB_HANDLE_MAX_WAIT_COUNT) {
-            // The reason we want to exit this loop early is that if USB is
-            // attached and configured, but the host isn't sending an IN
-            // requests, we will block here forever. As it is, it still slows
-            // down UART transfers quite a bit, so setting configured = false
-            // ASAP is important.
-
-            // This can get really noisy when running but I want to leave it in
-            // because it' useful to enable when debugging.
-            // debug("USB most likely not connected or at least not requesting "
-                    // "IN transfers - bailing out of handle waiting");
-            return false;
-        }
-    }
-    return true;
-}
-
-
 void openxc::interface::usb::processSendQueue(UsbDevice* usbDevice) {
     if(usbDevice->configured && !vbusEnabled()) {
         debug("USB no longer detected - marking unconfigured");
         usbDevice->configured = false;
     }
 
-    // Don't touch usbDevice->sendBuffer if there's still a pending transfer
-    if(!waitForHandle(usbDevice)) {
+    if(!usbDevice->configured) {
         return;
     }
 
-    while(usbDevice->configured &&
-            !QUEUE_EMPTY(uint8_t, &usbDevice->sendQueue)) {
-        int byteCount = 0;
-        while(!QUEUE_EMPTY(uint8_t, &usbDevice->sendQueue) &&
-                byteCount < USB_SEND_BUFFER_SIZE) {
-            usbDevice->sendBuffer[byteCount++] = QUEUE_POP(uint8_t,
-                    &usbDevice->sendQueue);
-        }
-
-        int nextByteIndex = 0;
-        while(nextByteIndex < byteCount) {
-            // Make sure the USB write is 100% complete before messing with this
-            // buffer after we copy the message into it - the Microchip library
-            // doesn't copy the data to its own internal buffer. See #171 for
-            // background on this issue.
-            // TODO instead of dropping, replace POP above with a SNAPSHOT
-            // and POP off only exactly how many bytes were sent after the
-            // fact.
-            // TODO in order for this not to fail too often I had to increase
-            // the USB_HANDLE_MAX_WAIT_COUNT. that may be OK since now we have
-            // VBUS detection.
-            if(!waitForHandle(usbDevice)) {
-                debug("USB not responding in a timely fashion, dropped data");
-                return;
-            }
+    // The Microchip library doesn't copy the data to its own internal buffer
+    // (see #171 for background), so the bytes of a transfer stay in the queue
+    // until its handle isn't busy anymore
+    int oldest;
+    while((oldest = oldestInTransfer(usbDevice)) != -1 &&
+            !usbDevice->device.HandleBusy(
+                usbDevice->deviceToHostHandles[oldest])) {
+        finishInTransfer(usbDevice);
+    }
 
-            int bytesToTransfer = min(MAX_USB_PACKET_SIZE_BYTES,
-                    byteCount - nextByteIndex);
-            usbDevice->deviceToHostHandle = usbDevice->device.GenWrite(
-                    usbDevice->inEndpoint,
-                    &usbDevice->sendBuffer[nextByteIndex], bytesToTransfer);
-            nextByteIndex += bytesToTransfer;
-        }
+    // With ping-pong buffering the controller takes the next transfer while
+    // the host is still reading the last one, so keep both buffers armed
+    // instead of waiting for the handle
+    uint8_t* data;
+    int length;
+    int index;
+    while((index = startInTransfer(usbDevice, MAX_USB_PACKET_SIZE_BYTES,
+                    &data, &length)) != -1) {
+        usbDevice->deviceToHostHandles[index] = usbDevice->device.GenWrite(
+                usbDevice->inEndpoint, data, length);
     }
 }
 
@@ -166,7 +130,7 @@ void armForRead(UsbDevice* usbDevice, char* buffer) {
             usbDevice->outEndpointSize);
 }
 
-void openxc::interface::usb::read(UsbDevice* usbDevice, bool (*callback)(uint8_t*)) {
+void openxc::interface::usb::read(UsbDevice* usbDevice, bool (*callback)(uint8_t*, int)) {
     if(!usbDevice->device.HandleBusy(usbDevice->hostToDeviceHandle)) {
         if(usbDevice->receiveBuffer[0] != NULL) {
             for(int i = 0; i < usbDevice->outEndpointSize; i++) {
@@ -175,7 +139,8 @@ void openxc::interface::usb::read(UsbDevice* usbDevice, bool (*callback)(uint8_t
                     debug("Dropped write from host -- queue is full");
                 }
             }
-            processQueue(&usbDevice->receiveQueue, callback);
+            processQueue(&usbDevice->receiveQueue, &usbDevice->framer,
+                    callback);
         }
         armForRead(usbDevice, usbDevice->receiveBuffer);
     }
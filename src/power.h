@@ -27,6 +27,20 @@ void suspend();
  */
 void handleWake();
 
+/* Public: Put the CPU into a light sleep until the next interrupt, if there is
+ * still no work to do.
+ *
+ * The idle check is made again with interrupts disabled, so an interrupt that
+ * queues new work after the caller decided to sleep can't be missed. All
+ * peripherals stay active and the system timer tick still wakes the CPU (at
+ * least every millisecond), so any polled work is delayed by at most one tick.
+ *
+ * idle - A function that returns true if there is no work waiting.
+ *
+ * Returns true if the CPU went to sleep, or false if there was work waiting.
+ */
+bool waitForInterrupt(bool (*idle)());
+
 } // namespace power
 } // namespace openxc
 
@@ -0,0 +1,244 @@
+#include "profiler.h"
+#include "util/timer.h"
+#include <string.h>
+
+namespace time = openxc::util::time;
+
+using openxc::profiler::LoopProfile;
+using openxc::profiler::ProfilerEvent;
+using openxc::profiler::WorstIteration;
+using openxc::scheduler::Task;
+
+const char* openxc::profiler::LOOP_STATISTICS_COMMAND_NAME =
+        "loop_statistics";
+
+LoopProfile openxc::profiler::PROFILE;
+
+/* Private: Returns the microseconds between two cycle counts. Unsigned
+ * subtraction, so the counter wrapping around is harmless.
+ */
+static uint32_t elapsedUs(uint32_t start, uint32_t end) {
+    return (end - start) / time::cyclesPerUs();
+}
+
+/* Private: Save the current iteration as the worst one, with the times of the
+ * iterations before it from the history.
+ */
+static void recordWorst(LoopProfile* profile, uint32_t durationUs) {
+    WorstIteration* worst = &profile->worst;
+    worst->iteration = profile->iterations;
+    worst->durationUs = durationUs;
+    memcpy(worst->events, profile->events,
+            profile->eventCount * sizeof(ProfilerEvent));
+    worst->eventCount = profile->eventCount;
+    worst->eventsDropped = profile->eventsDropped;
+
+    // The history doesn't include this iteration yet
+    worst->beforeCount = profile->iterations < PROFILER_HISTORY_LENGTH ?
+            profile->iterations : PROFILER_HISTORY_LENGTH;
+    for(int i = 0; i < worst->beforeCount; i++) {
+        worst->before[i] = profile->history[(profile->iterations -
+                worst->beforeCount + i) % PROFILER_HISTORY_LENGTH];
+    }
+    worst->afterCount = 0;
+}
+
+void openxc::profiler::initialize() {
+    memset(&PROFILE, 0, sizeof(PROFILE));
+    PROFILE.slowIterationUs = PROFILER_DEFAULT_SLOW_ITERATION_US;
+}
+
+void openxc::profiler::reset() {
+    uint32_t slowIterationUs = PROFILE.slowIterationUs;
+    initialize();
+    PROFILE.slowIterationUs = slowIterationUs;
+}
+
+void openxc::profiler::setSlowIterationThreshold(uint32_t thresholdUs) {
+    reset();
+    PROFILE.slowIterationUs = thresholdUs;
+}
+
+int openxc::profiler::bucketFor(uint32_t durationUs) {
+    if(durationUs < PROFILER_LINEAR_BUCKETS) {
+        return durationUs;
+    }
+
+    int exponent = 31;
+    while(!(durationUs & (1UL << exponent))) {
+        --exponent;
+    }
+    if(exponent > PROFILER_MAX_EXPONENT) {
+        return PROFILER_HISTOGRAM_BUCKETS - 1;
+    }
+
+    // The top bit is always set, the next 3 pick the slice
+    int slice = (durationUs >> (exponent - 3)) - PROFILER_SUB_BUCKETS;
+    return PROFILER_LINEAR_BUCKETS + (exponent - 4) * PROFILER_SUB_BUCKETS +
+            slice;
+}
+
+uint32_t openxc::profiler::bucketLimit(int bucket) {
+    if(bucket < PROFILER_LINEAR_BUCKETS) {
+        return bucket;
+    }
+    if(bucket >= PROFILER_HISTOGRAM_BUCKETS - 1) {
+        return 0xffffffff;
+    }
+
+    int exponent = (bucket - PROFILER_LINEAR_BUCKETS) / PROFILER_SUB_BUCKETS
+            + 4;
+    int slice = (bucket - PROFILER_LINEAR_BUCKETS) % PROFILER_SUB_BUCKETS;
+    return ((PROFILER_SUB_BUCKETS + slice + 1) << (exponent - 3)) - 1;
+}
+
+uint32_t openxc::profiler::percentile(float fraction) {
+    if(PROFILE.iterations == 0) {
+        return 0;
+    }
+
+    // The rank of the iteration at the percentile, rounded up
+    float exactRank = fraction * PROFILE.iterations;
+    unsigned long rank = exactRank;
+    if(rank < exactRank || rank == 0) {
+        ++rank;
+    }
+
+    unsigned long count = 0;
+    for(int i = 0; i < PROFILER_HISTOGRAM_BUCKETS; i++) {
+        count += PROFILE.histogram[i];
+        if(count >= rank) {
+            uint32_t limit = bucketLimit(i);
+            return limit < PROFILE.maxUs ? limit : PROFILE.maxUs;
+        }
+    }
+    return PROFILE.maxUs;
+}
+
+void openxc::profiler::beginIteration() {
+    PROFILE.running = true;
+    PROFILE.eventCount = 0;
+    PROFILE.eventsDropped = 0;
+    PROFILE.iterationStart = time::cycleCount();
+}
+
+void openxc::profiler::endIteration() {
+    if(!PROFILE.running) {
+        return;
+    }
+    PROFILE.running = false;
+
+    uint32_t duration = elapsedUs(PROFILE.iterationStart, time::cycleCount());
+    ++PROFILE.histogram[bucketFor(duration)];
+    PROFILE.totalUs += duration;
+
+    bool slow = duration > PROFILE.slowIterationUs;
+    if(slow) {
+        ++PROFILE.slowIterations;
+    }
+    for(int i = 0; i < MAX_TASK_COUNT; i++) {
+        if(PROFILE.taskUs[i] > PROFILE.taskMaxUs[i]) {
+            PROFILE.taskMaxUs[i] = PROFILE.taskUs[i];
+        }
+        if(slow) {
+            PROFILE.taskSlowUs[i] += PROFILE.taskUs[i];
+        }
+        PROFILE.taskUs[i] = 0;
+    }
+
+    if(PROFILE.iterations == 0 || duration > PROFILE.maxUs) {
+        PROFILE.maxUs = duration;
+        recordWorst(&PROFILE, duration);
+    } else if(PROFILE.worst.afterCount < PROFILER_HISTORY_LENGTH) {
+        PROFILE.worst.after[PROFILE.worst.afterCount++] = duration;
+    }
+
+    PROFILE.history[PROFILE.iterations % PROFILER_HISTORY_LENGTH] = duration;
+    ++PROFILE.iterations;
+}
+
+void openxc::profiler::beginTask() {
+    PROFILE.taskStart = time::cycleCount();
+}
+
+void openxc::profiler::endTask(int task) {
+    if(!PROFILE.running || task < 0 || task >= MAX_TASK_COUNT) {
+        return;
+    }
+
+    uint32_t duration = elapsedUs(PROFILE.taskStart, time::cycleCount());
+    PROFILE.taskUs[task] += duration;
+    if(PROFILE.eventCount < PROFILER_MAX_EVENTS) {
+        ProfilerEvent* event = &PROFILE.events[PROFILE.eventCount++];
+        event->task = task;
+        event->startUs = elapsedUs(PROFILE.iterationStart, PROFILE.taskStart);
+        event->durationUs = duration;
+    } else {
+        ++PROFILE.eventsDropped;
+    }
+}
+
+static cJSON* serializeTimes(uint32_t* times, int count) {
+    cJSON* array = cJSON_CreateArray();
+    for(int i = 0; i < count; i++) {
+        cJSON_AddItemToArray(array, cJSON_CreateNumber(times[i]));
+    }
+    return array;
+}
+
+static cJSON* serializeWorst(WorstIteration* worst, Task* tasks,
+        int taskCount) {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "iteration", worst->iteration);
+    cJSON_AddNumberToObject(root, "us", worst->durationUs);
+
+    cJSON* events = cJSON_CreateArray();
+    for(int i = 0; i < worst->eventCount; i++) {
+        ProfilerEvent* event = &worst->events[i];
+        cJSON* eventObject = cJSON_CreateObject();
+        if(event->task < taskCount) {
+            cJSON_AddStringToObject(eventObject, "task",
+                    tasks[event->task].name);
+        }
+        cJSON_AddNumberToObject(eventObject, "start_us", event->startUs);
+        cJSON_AddNumberToObject(eventObject, "us", event->durationUs);
+        cJSON_AddItemToArray(events, eventObject);
+    }
+    cJSON_AddItemToObject(root, "events", events);
+    cJSON_AddNumberToObject(root, "events_dropped", worst->eventsDropped);
+    cJSON_AddItemToObject(root, "before_us",
+            serializeTimes(worst->before, worst->beforeCount));
+    cJSON_AddItemToObject(root, "after_us",
+            serializeTimes(worst->after, worst->afterCount));
+    return root;
+}
+
+cJSON* openxc::profiler::serialize(Task* tasks, int taskCount) {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "command_response",
+            LOOP_STATISTICS_COMMAND_NAME);
+    cJSON_AddNumberToObject(root, "iterations", PROFILE.iterations);
+    cJSON_AddNumberToObject(root, "average_us", PROFILE.iterations > 0 ?
+            PROFILE.totalUs / PROFILE.iterations : 0);
+    cJSON_AddNumberToObject(root, "p99_us", percentile(0.99));
+    cJSON_AddNumberToObject(root, "p999_us", percentile(0.999));
+    cJSON_AddNumberToObject(root, "max_us", PROFILE.maxUs);
+    cJSON_AddNumberToObject(root, "slow_threshold_us", PROFILE.slowIterationUs);
+    cJSON_AddNumberToObject(root, "slow", PROFILE.slowIterations);
+
+    cJSON* tasksArray = cJSON_CreateArray();
+    for(int i = 0; i < taskCount && i < MAX_TASK_COUNT; i++) {
+        cJSON* taskObject = cJSON_CreateObject();
+        cJSON_AddStringToObject(taskObject, "name", tasks[i].name);
+        cJSON_AddNumberToObject(taskObject, "max_us", PROFILE.taskMaxUs[i]);
+        cJSON_AddNumberToObject(taskObject, "slow_us", PROFILE.taskSlowUs[i]);
+        cJSON_AddItemToArray(tasksArray, taskObject);
+    }
+    cJSON_AddItemToObject(root, "tasks", tasksArray);
+
+    if(PROFILE.iterations > 0) {
+        cJSON_AddItemToObject(root, "worst",
+                serializeWorst(&PROFILE.worst, tasks, taskCount));
+    }
+    return root;
+}
@@ -0,0 +1,189 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <stdint.h>
+#include "scheduler.h"
+#include "cJSON.h"
+
+// Iteration times below this are counted exactly, one microsecond per bucket
+#define PROFILER_LINEAR_BUCKETS 16
+// Above that, each doubling of the time is split into this many buckets, so
+// a percentile is never off by more than 1/8th
+#define PROFILER_SUB_BUCKETS 8
+// The longest iteration time with its own bucket is about 2^23us (8 seconds),
+// anything longer is counted in the last bucket
+#define PROFILER_MAX_EXPONENT 23
+#define PROFILER_HISTOGRAM_BUCKETS (PROFILER_LINEAR_BUCKETS + \
+        (PROFILER_MAX_EXPONENT - 3) * PROFILER_SUB_BUCKETS)
+
+// The most task runs recorded in one iteration, for the worst iteration
+#define PROFILER_MAX_EVENTS 16
+// The number of iterations before and after the worst one to keep the time of
+#define PROFILER_HISTORY_LENGTH 8
+// An iteration taking longer than this is slow, and the time each task spent
+// in it is added to the task's slow time
+#define PROFILER_DEFAULT_SLOW_ITERATION_US 1000
+
+namespace openxc {
+namespace profiler {
+
+extern const char* LOOP_STATISTICS_COMMAND_NAME;
+
+/* Public: A task run during a main loop iteration.
+ *
+ * task - The index of the task in the scheduler's task table.
+ * startUs - When the run started, in microseconds from the start of the
+ *      iteration.
+ * durationUs - How long the run took, in microseconds.
+ */
+typedef struct {
+    uint8_t task;
+    uint32_t startUs;
+    uint32_t durationUs;
+} ProfilerEvent;
+
+/* Public: The longest main loop iteration and what happened around it.
+ *
+ * iteration - The number of the iteration, counting from the last reset.
+ * durationUs - How long the iteration took, in microseconds.
+ * events - The task runs in the iteration, in the order they happened.
+ * eventCount - The number of runs in the events array.
+ * eventsDropped - The number of runs that didn't fit in the events array.
+ * before - The time of the iterations just before this one, oldest first.
+ * beforeCount - The number of times in the before array.
+ * after - The time of the iterations just after this one, oldest first.
+ * afterCount - The number of times in the after array.
+ */
+typedef struct {
+    unsigned long iteration;
+    uint32_t durationUs;
+    ProfilerEvent events[PROFILER_MAX_EVENTS];
+    int eventCount;
+    int eventsDropped;
+    uint32_t before[PROFILER_HISTORY_LENGTH];
+    int beforeCount;
+    uint32_t after[PROFILER_HISTORY_LENGTH];
+    int afterCount;
+} WorstIteration;
+
+/* Public: The main loop latency profile. The loop only counts the time spent
+ * running tasks - an idle wait for an interrupt is not part of an iteration.
+ *
+ * histogram - The number of iterations that took each range of times (see
+ *      bucketFor()).
+ * iterations - The number of iterations recorded.
+ * totalUs - The total time of all iterations, for the average.
+ * maxUs - The longest iteration.
+ * slowIterationUs - An iteration longer than this is slow.
+ * slowIterations - The number of slow iterations.
+ * taskSlowUs - The time each task (by index in the scheduler's task table)
+ *      spent in slow iterations.
+ * taskMaxUs - The longest time each task spent in a single iteration.
+ * taskUs - The time each task has spent in the current iteration.
+ * running - True between beginIteration() and endIteration().
+ * iterationStart - The cycleCount() at the start of the current iteration.
+ * taskStart - The cycleCount() at the start of the current task run.
+ * events - The task runs in the current iteration.
+ * eventCount - The number of runs in the events array.
+ * eventsDropped - The number of runs in the current iteration that didn't fit
+ *      in the events array.
+ * history - A ring buffer of the times of the most recent iterations.
+ * worst - The longest iteration since the last reset.
+ */
+typedef struct {
+    uint32_t histogram[PROFILER_HISTOGRAM_BUCKETS];
+    unsigned long iterations;
+    uint64_t totalUs;
+    uint32_t maxUs;
+    uint32_t slowIterationUs;
+    unsigned long slowIterations;
+    uint64_t taskSlowUs[MAX_TASK_COUNT];
+    uint32_t taskMaxUs[MAX_TASK_COUNT];
+    uint32_t taskUs[MAX_TASK_COUNT];
+    bool running;
+    uint32_t iterationStart;
+    uint32_t taskStart;
+    ProfilerEvent events[PROFILER_MAX_EVENTS];
+    int eventCount;
+    int eventsDropped;
+    uint32_t history[PROFILER_HISTORY_LENGTH];
+    WorstIteration worst;
+} LoopProfile;
+
+extern LoopProfile PROFILE;
+
+/* Public: Clear the profile, and set the slow iteration threshold back to
+ * PROFILER_DEFAULT_SLOW_ITERATION_US.
+ */
+void initialize();
+
+/* Public: Clear the histogram, task times and worst iteration, keeping the
+ * slow iteration threshold.
+ */
+void reset();
+
+/* Public: Change the time above which an iteration is slow, and reset the
+ * profile so the slow times all use the same threshold.
+ *
+ * thresholdUs - The new threshold in microseconds.
+ */
+void setSlowIterationThreshold(uint32_t thresholdUs);
+
+/* Public: Returns the histogram bucket that counts an iteration time.
+ *
+ * Times up to PROFILER_LINEAR_BUCKETS have a bucket each. Above that, the
+ * buckets for each power of two are PROFILER_SUB_BUCKETS equal slices.
+ *
+ * durationUs - The iteration time in microseconds.
+ */
+int bucketFor(uint32_t durationUs);
+
+/* Public: Returns the longest iteration time counted in a histogram bucket.
+ *
+ * bucket - The histogram bucket.
+ */
+uint32_t bucketLimit(int bucket);
+
+/* Public: Returns the iteration time that the given fraction of iterations
+ * took no longer than, from the histogram. The time is rounded up to the
+ * limit of its bucket, but never beyond the longest iteration.
+ *
+ * fraction - The percentile as a fraction, e.g. 0.999 for p99.9.
+ */
+uint32_t percentile(float fraction);
+
+/* Public: Mark the start of a main loop iteration.
+ */
+void beginIteration();
+
+/* Public: Mark the end of a main loop iteration, and record its time in the
+ * histogram. Nothing is recorded if beginIteration() wasn't called first.
+ */
+void endIteration();
+
+/* Public: Mark the start of a task run. Called by the scheduler.
+ */
+void beginTask();
+
+/* Public: Mark the end of a task run, and record it as an event in the current
+ * iteration. Called by the scheduler.
+ *
+ * task - The index of the task in the scheduler's task table.
+ */
+void endTask(int task);
+
+/* Public: Build a JSON command response with the iteration time percentiles,
+ * the time each task spent in slow iterations, and the worst iteration.
+ *
+ * tasks - The scheduler's task table, for the task names.
+ * taskCount - The length of the tasks array.
+ *
+ * Returns a new cJSON object - the caller is responsible for calling
+ * cJSON_Delete() on it.
+ */
+cJSON* serialize(openxc::scheduler::Task* tasks, int taskCount);
+
+} // namespace profiler
+} // namespace openxc
+
+#endif // _PROFILER_H_
@@ -0,0 +1,108 @@
+#include "scheduler.h"
+#include "profiler.h"
+#include "util/log.h"
+#include "util/timer.h"
+#include <string.h>
+
+namespace time = openxc::util::time;
+namespace profiler = openxc::profiler;
+
+using openxc::scheduler::Task;
+
+// In the order the tasks were registered, so a pointer to a task stays valid
+static Task tasks[MAX_TASK_COUNT];
+static int taskCount;
+// The indexes of the tasks, sorted by priority
+static int runOrder[MAX_TASK_COUNT];
+
+/* Private: Run a single task, repeating while it has more work and budget
+ * left, and update its run time accounting.
+ *
+ * Returns true if the task still has more work.
+ */
+bool runTask(Task* task) {
+    profiler::beginTask();
+    unsigned long startTime = time::systemTimeUs();
+    unsigned long elapsed;
+    int runs = 0;
+    bool moreWork;
+    do {
+        moreWork = task->run();
+        ++runs;
+        elapsed = time::systemTimeUs() - startTime;
+    } while(moreWork && elapsed < task->budgetUs &&
+            runs < MAX_TASK_RUNS_PER_PASS);
+
+    profiler::endTask(task - tasks);
+    task->runs += runs;
+    task->totalTimeUs += elapsed;
+    if(elapsed > task->maxTimeUs) {
+        task->maxTimeUs = elapsed;
+    }
+    return moreWork;
+}
+
+void openxc::scheduler::initialize() {
+    memset(tasks, 0, sizeof(tasks));
+    taskCount = 0;
+}
+
+Task* openxc::scheduler::registerTask(const char* name, bool (*run)(),
+        TaskPriority priority, unsigned int periodMs, unsigned int budgetUs) {
+    if(taskCount == MAX_TASK_COUNT) {
+        debug("Unable to register task %s, scheduler is full", name);
+        return NULL;
+    }
+
+    // Keep the run order sorted by priority, after any tasks of equal priority
+    int position = taskCount;
+    while(position > 0 &&
+            tasks[runOrder[position - 1]].priority > priority) {
+        runOrder[position] = runOrder[position - 1];
+        --position;
+    }
+    runOrder[position] = taskCount;
+
+    Task* task = &tasks[taskCount++];
+    memset(task, 0, sizeof(Task));
+    task->name = name;
+    task->run = run;
+    task->priority = priority;
+    task->periodMs = periodMs;
+    task->budgetUs = budgetUs;
+    return task;
+}
+
+bool openxc::scheduler::run() {
+    bool busy = false;
+    for(int i = 0; i < taskCount; i++) {
+        Task* task = &tasks[runOrder[i]];
+        unsigned long now = time::systemTimeMs();
+        if(task->periodMs > 0 && task->runs > 0 &&
+                now - task->lastRunTime < task->periodMs) {
+            continue;
+        }
+
+        if(busy && task->priority == PRIORITY_LOW &&
+                task->consecutiveSkips < MAX_CONSECUTIVE_SKIPS) {
+            ++task->skipped;
+            ++task->consecutiveSkips;
+            continue;
+        }
+
+        task->consecutiveSkips = 0;
+        task->lastRunTime = now;
+        if(runTask(task)) {
+            busy = true;
+        }
+    }
+    return busy;
+}
+
+Task* openxc::scheduler::getTasks() {
+    return tasks;
+}
+
+int openxc::scheduler::getTaskCount() {
+    return taskCount;
+}
@@ -0,0 +1,108 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#define MAX_TASK_COUNT 16
+
+// Upper limit on the number of times a task with remaining work is run in one
+// pass, in case its time budget can't be measured (e.g. in the unit tests)
+#define MAX_TASK_RUNS_PER_PASS 32
+
+// A sheddable task is run anyway after being skipped this many times in a row,
+// so it can be delayed under load but never starved completely
+#define MAX_CONSECUTIVE_SKIPS 16
+
+namespace openxc {
+namespace scheduler {
+
+/* Public: The priority of a task. Tasks are run in priority order each pass
+ * through the main loop.
+ *
+ * PRIORITY_CRITICAL - Work that must keep up with the hardware, e.g. draining
+ *      the CAN receive queues.
+ * PRIORITY_HIGH - Important but can tolerate some delay.
+ * PRIORITY_NORMAL - Regular housekeeping.
+ * PRIORITY_LOW - Work that can be skipped (shed) while a higher priority task
+ *      still has work left, e.g. updating lights.
+ */
+typedef enum {
+    PRIORITY_CRITICAL,
+    PRIORITY_HIGH,
+    PRIORITY_NORMAL,
+    PRIORITY_LOW,
+} TaskPriority;
+
+/* Public: A unit of work run cooperatively from the main loop.
+ *
+ * name - A short name for the task, used in statistics.
+ * run - The function to call. It must do a bounded amount of work and return
+ *      true if it has more work waiting (e.g. its input queue isn't empty).
+ * priority - The priority of the task (see TaskPriority).
+ * periodMs - Run the task at most this often. Use 0 to run it on every pass.
+ * budgetUs - While the task has more work, keep running it until this much
+ *      time has been spent in the current pass. Use 0 to run it only once per
+ *      pass.
+ * lastRunTime - The system time (in ms) when the task was last run.
+ * runs - The total number of times the task has been run.
+ * totalTimeUs - The total time spent running the task.
+ * maxTimeUs - The longest time spent running the task in one pass.
+ * skipped - The total number of times the task was due to run but was shed
+ *      because a higher priority task had more work.
+ * consecutiveSkips - An internal counter, don't use this.
+ */
+typedef struct {
+    const char* name;
+    bool (*run)();
+    TaskPriority priority;
+    unsigned int periodMs;
+    unsigned int budgetUs;
+    unsigned long lastRunTime;
+    unsigned int runs;
+    unsigned long totalTimeUs;
+    unsigned int maxTimeUs;
+    unsigned int skipped;
+    unsigned int consecutiveSkips;
+} Task;
+
+/* Public: Remove all registered tasks.
+ */
+void initialize();
+
+/* Public: Register a new task with the scheduler.
+ *
+ * Tasks with equal priority are run in the order they were registered.
+ * Registering a task doesn't move the tasks already registered, so the
+ * returned pointer stays valid until initialize() is called.
+ *
+ * name - A short name for the task, used in statistics.
+ * run - The function to call (see Task).
+ * priority - The priority of the task.
+ * periodMs - Run the task at most this often, or 0 to run it on every pass.
+ * budgetUs - The maximum time to keep running the task in one pass while it
+ *      has more work, or 0 to run it only once per pass.
+ *
+ * Returns a pointer to the new task, or NULL if the task table is full.
+ */
+Task* registerTask(const char* name, bool (*run)(), TaskPriority priority,
+        unsigned int periodMs, unsigned int budgetUs);
+
+/* Public: Make one pass through all registered tasks that are due, in priority
+ * order. Low priority tasks are skipped if a higher priority task still has
+ * more work at the end of its budget.
+ *
+ * Returns true if any task reported that it has more work waiting.
+ */
+bool run();
+
+/* Public: Return the registered tasks, in the order they were registered.
+ * They are run in priority order.
+ */
+Task* getTasks();
+
+/* Public: Return the number of registered tasks.
+ */
+int getTaskCount();
+
+} // namespace scheduler
+} // namespace openxc
+
+#endif // _SCHEDULER_H_
@@ -0,0 +1,259 @@
+#include "statistics.h"
+#include "util/timer.h"
+#include "util/log.h"
+#include <stdlib.h>
+#include <string.h>
+
+namespace time = openxc::util::time;
+
+using openxc::pipeline::MESSAGE_TYPE_COUNT;
+using openxc::pipeline::MESSAGE_TYPE_NAMES;
+using openxc::pipeline::PipelineStatistics;
+using openxc::util::bytebuffer::Framer;
+
+// Keeps the allocation returned to the caller aligned for any type
+#define HEAP_HEADER_SIZE 8
+
+const char* openxc::statistics::STATISTICS_COMMAND_NAME = "statistics";
+const char* openxc::statistics::SIGNAL_STATISTICS_COMMAND_NAME =
+        "signal_statistics";
+const char* openxc::statistics::TASK_STATISTICS_COMMAND_NAME =
+        "task_statistics";
+
+openxc::statistics::Statistics openxc::statistics::STATISTICS;
+
+static bool hooksInstalled = false;
+
+/* Private: malloc() replacement for the JSON library that tracks the current
+ * and peak number of bytes allocated. The size of each allocation is stored in
+ * a small header in front of the returned block.
+ */
+void* countingMalloc(size_t size) {
+    uint8_t* block = (uint8_t*) malloc(size + HEAP_HEADER_SIZE);
+    if(block == NULL) {
+        return NULL;
+    }
+
+    *(size_t*)block = size;
+    openxc::statistics::Statistics* statistics =
+            &openxc::statistics::STATISTICS;
+    statistics->heapUsed += size;
+    if(statistics->heapUsed > statistics->heapPeak) {
+        statistics->heapPeak = statistics->heapUsed;
+    }
+    return block + HEAP_HEADER_SIZE;
+}
+
+void countingFree(void* pointer) {
+    if(pointer == NULL) {
+        return;
+    }
+
+    uint8_t* block = (uint8_t*)pointer - HEAP_HEADER_SIZE;
+    openxc::statistics::STATISTICS.heapUsed -= *(size_t*)block;
+    free(block);
+}
+
+void openxc::statistics::initialize() {
+    cJSON_Hooks hooks = {countingMalloc, countingFree};
+    cJSON_InitHooks(&hooks);
+    hooksInstalled = true;
+}
+
+void openxc::statistics::recordWake() {
+    ++STATISTICS.wakeups;
+    STATISTICS.lastWakeTime = time::systemTimeUs();
+    STATISTICS.wakePending = true;
+}
+
+void openxc::statistics::recordDecode() {
+    if(STATISTICS.wakePending) {
+        STATISTICS.wakePending = false;
+        unsigned int latency = time::systemTimeUs() - STATISTICS.lastWakeTime;
+        if(latency > STATISTICS.wakeLatencyMaxUs) {
+            STATISTICS.wakeLatencyMaxUs = latency;
+        }
+        STATISTICS.wakeLatencyTotalUs += latency;
+        ++STATISTICS.wakeLatencySamples;
+    }
+}
+
+void openxc::statistics::freeJsonString(char* string) {
+    if(hooksInstalled) {
+        countingFree(string);
+    } else {
+        free(string);
+    }
+}
+
+/* Private: Returns the framer of an interface's receive queue, or NULL if the
+ * pipeline doesn't have the interface.
+ */
+static Framer* lookupFramer(Pipeline* pipeline, int type) {
+    switch(type) {
+    case openxc::pipeline::USB:
+        return pipeline->usb != NULL ? &pipeline->usb->framer : NULL;
+    case openxc::pipeline::UART:
+        return pipeline->uart != NULL ? &pipeline->uart->framer : NULL;
+    case openxc::pipeline::NETWORK:
+        return pipeline->network != NULL ? &pipeline->network->framer : NULL;
+    default:
+        return NULL;
+    }
+}
+
+cJSON* openxc::statistics::serialize(CanBus* buses, int busCount,
+        Pipeline* pipeline) {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "command_response", STATISTICS_COMMAND_NAME);
+
+    cJSON* busesArray = cJSON_CreateArray();
+    for(int i = 0; i < busCount; i++) {
+        CanBus* bus = &buses[i];
+        cJSON* busObject = cJSON_CreateObject();
+        cJSON_AddNumberToObject(busObject, "bus", bus->address);
+        cJSON_AddNumberToObject(busObject, "received", bus->messagesReceived);
+        cJSON_AddNumberToObject(busObject, "dropped", bus->messagesDropped);
+        cJSON_AddNumberToObject(busObject, "queue_max",
+                bus->receiveQueueHighWatermark);
+        cJSON_AddNumberToObject(busObject, "coalesced", bus->framesCoalesced);
+        cJSON_AddNumberToObject(busObject, "raw_rejected",
+                bus->rawWritesRejected);
+        cJSON_AddNumberToObject(busObject, "write_dropped", bus->writesDropped);
+        cJSON_AddItemToArray(busesArray, busObject);
+    }
+    cJSON_AddItemToObject(root, "can", busesArray);
+
+    cJSON_AddNumberToObject(root, "serialized", STATISTICS.messagesSerialized);
+
+    cJSON* interfaces = cJSON_CreateObject();
+    for(int i = 0; i < MESSAGE_TYPE_COUNT; i++) {
+        PipelineStatistics* interfaceStatistics = &pipeline->statistics[i];
+        cJSON* interfaceObject = cJSON_CreateObject();
+        cJSON_AddNumberToObject(interfaceObject, "sent",
+                interfaceStatistics->messagesSent);
+        cJSON_AddNumberToObject(interfaceObject, "bytes",
+                interfaceStatistics->bytesSent);
+        cJSON_AddNumberToObject(interfaceObject, "dropped",
+                interfaceStatistics->messagesDropped);
+        cJSON_AddNumberToObject(interfaceObject, "queue_max",
+                interfaceStatistics->queueHighWatermark);
+        Framer* framer = lookupFramer(pipeline, i);
+        if(framer != NULL) {
+            cJSON_AddNumberToObject(interfaceObject, "received",
+                    framer->framesReceived);
+            cJSON_AddNumberToObject(interfaceObject, "rejected",
+                    framer->framesRejected);
+            cJSON_AddNumberToObject(interfaceObject, "oversize",
+                    framer->framesOversize);
+        }
+        cJSON_AddItemToObject(interfaces, MESSAGE_TYPE_NAMES[i],
+                interfaceObject);
+    }
+    cJSON_AddItemToObject(root, "interfaces", interfaces);
+
+    unsigned long now = time::systemTimeMs();
+    unsigned long elapsed = now - STATISTICS.lastReportTime;
+    unsigned int iterations = STATISTICS.loopIterations -
+            STATISTICS.lastReportLoopIterations;
+    cJSON_AddNumberToObject(root, "heap_used", STATISTICS.heapUsed);
+    cJSON_AddNumberToObject(root, "heap_peak", STATISTICS.heapPeak);
+    cJSON_AddNumberToObject(root, "log_dropped",
+            openxc::util::log::deferredMessagesDropped());
+    cJSON_AddNumberToObject(root, "loops", STATISTICS.loopIterations);
+    cJSON_AddNumberToObject(root, "loop_rate",
+            elapsed > 0 ? iterations * 1000.0 / elapsed : 0);
+    cJSON_AddNumberToObject(root, "wakeups", STATISTICS.wakeups);
+    cJSON_AddNumberToObject(root, "wake_latency_max_us",
+            STATISTICS.wakeLatencyMaxUs);
+    cJSON_AddNumberToObject(root, "wake_latency_avg_us",
+            STATISTICS.wakeLatencySamples > 0 ? STATISTICS.wakeLatencyTotalUs /
+                STATISTICS.wakeLatencySamples : 0);
+    STATISTICS.lastReportTime = now;
+    STATISTICS.lastReportLoopIterations = STATISTICS.loopIterations;
+    return root;
+}
+
+int openxc::statistics::serialize(CanBus* buses, int busCount,
+        Pipeline* pipeline, char* buffer, int bufferSize) {
+    cJSON* root = serialize(buses, busCount, pipeline);
+    char* message = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+
+    int length = -1;
+    if(message != NULL && (int)strlen(message) < bufferSize) {
+        strcpy(buffer, message);
+        length = strlen(buffer);
+    } else if(bufferSize > 0) {
+        buffer[0] = '\0';
+    }
+    freeJsonString(message);
+    return length;
+}
+
+cJSON* openxc::statistics::serialize(Task* task) {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "command_response",
+            TASK_STATISTICS_COMMAND_NAME);
+    cJSON_AddStringToObject(root, "name", task->name);
+    cJSON_AddNumberToObject(root, "priority", task->priority);
+    cJSON_AddNumberToObject(root, "runs", task->runs);
+    cJSON_AddNumberToObject(root, "time_us", task->totalTimeUs);
+    cJSON_AddNumberToObject(root, "max_us", task->maxTimeUs);
+    cJSON_AddNumberToObject(root, "skipped", task->skipped);
+    return root;
+}
+
+#ifdef __SIGNAL_STATISTICS__
+
+/* Private: Returns true if signal a has generated more traffic than b.
+ */
+bool busier(CanSignal* a, CanSignal* b) {
+    if(a->bytesSerialized != b->bytesSerialized) {
+        return a->bytesSerialized > b->bytesSerialized;
+    }
+    return a->framesDecoded > b->framesDecoded;
+}
+
+int openxc::statistics::sortSignalsByTraffic(CanSignal* signals,
+        int signalCount, CanSignal** sorted, int maxCount) {
+    int count = 0;
+    for(int i = 0; i < signalCount; i++) {
+        CanSignal* signal = &signals[i];
+        if(signal->framesDecoded == 0) {
+            continue;
+        }
+
+        // Insertion sort that only keeps the top maxCount signals
+        int position = count < maxCount ? count : maxCount;
+        while(position > 0 && busier(signal, sorted[position - 1])) {
+            if(position < maxCount) {
+                sorted[position] = sorted[position - 1];
+            }
+            --position;
+        }
+
+        if(position < maxCount) {
+            sorted[position] = signal;
+            if(count < maxCount) {
+                ++count;
+            }
+        }
+    }
+    return count;
+}
+
+cJSON* openxc::statistics::serialize(CanSignal* signal, int rank) {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "command_response",
+            SIGNAL_STATISTICS_COMMAND_NAME);
+    cJSON_AddNumberToObject(root, "rank", rank);
+    cJSON_AddStringToObject(root, "name", signal->genericName);
+    cJSON_AddNumberToObject(root, "decoded", signal->framesDecoded);
+    cJSON_AddNumberToObject(root, "sent", signal->messagesSent);
+    cJSON_AddNumberToObject(root, "suppressed", signal->messagesSuppressed);
+    cJSON_AddNumberToObject(root, "bytes", signal->bytesSerialized);
+    return root;
+}
+
+#endif // __SIGNAL_STATISTICS__
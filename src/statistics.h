@@ -0,0 +1,159 @@
+#ifndef _STATISTICS_H_
+#define _STATISTICS_H_
+
+#include "can/canutil.h"
+#include "pipeline.h"
+#include "scheduler.h"
+#include "cJSON.h"
+
+using openxc::pipeline::Pipeline;
+using openxc::scheduler::Task;
+
+namespace openxc {
+namespace statistics {
+
+#define MAX_SIGNAL_STATISTICS_REPORT_LENGTH 20
+
+extern const char* STATISTICS_COMMAND_NAME;
+extern const char* SIGNAL_STATISTICS_COMMAND_NAME;
+extern const char* TASK_STATISTICS_COMMAND_NAME;
+
+/* Public: Firmware-wide runtime counters that don't belong to a single CAN bus
+ * or output interface (those are stored in the CanBus and Pipeline structs).
+ *
+ * All counters are monotonic and are only ever incremented on the hot path, so
+ * they are cheap to keep enabled all of the time.
+ *
+ * messagesSerialized - The number of OpenXC messages serialized to send to the
+ *      pipeline.
+ * loopIterations - The number of times through the main firmware loop.
+ * heapUsed - The number of bytes currently allocated by the JSON library.
+ * heapPeak - The most bytes ever allocated by the JSON library at once.
+ * lastReportTime - The system time (in ms) when statistics were last
+ *      serialized, used to calculate rates.
+ * lastReportLoopIterations - The value of loopIterations when statistics were
+ *      last serialized.
+ * wakeups - The number of times the main loop woke up from an idle wait.
+ * wakeLatencyMaxUs - The longest time from waking up to decoding the first CAN
+ *      message.
+ * wakeLatencyTotalUs - The total of all wake up to decode latencies, to
+ *      calculate the average.
+ * wakeLatencySamples - The number of wakeups followed by a decoded message.
+ * lastWakeTime - The system time (in us) of the last wakeup.
+ * wakePending - True if a wakeup hasn't been followed by a decoded message
+ *      yet.
+ */
+typedef struct {
+    unsigned int messagesSerialized;
+    unsigned int loopIterations;
+    unsigned int heapUsed;
+    unsigned int heapPeak;
+    unsigned long lastReportTime;
+    unsigned int lastReportLoopIterations;
+    unsigned int wakeups;
+    unsigned int wakeLatencyMaxUs;
+    unsigned long wakeLatencyTotalUs;
+    unsigned int wakeLatencySamples;
+    unsigned long lastWakeTime;
+    bool wakePending;
+} Statistics;
+
+extern Statistics STATISTICS;
+
+/* Public: Install the heap accounting hooks in the JSON library. This must be
+ * called before any JSON objects are allocated.
+ */
+void initialize();
+
+/* Public: Record that the main loop woke up from an idle wait, to start
+ * measuring the wake up to decode latency.
+ */
+void recordWake();
+
+/* Public: Record that a CAN message was decoded. If this is the first message
+ * since a wakeup, the wake up to decode latency is recorded.
+ */
+void recordDecode();
+
+/* Public: Release a string returned by cJSON_Print() or
+ * cJSON_PrintUnformatted(), using the same allocator that created it.
+ *
+ * string - The string to free.
+ */
+void freeJsonString(char* string);
+
+/* Public: Build a JSON command response containing a snapshot of all runtime
+ * statistics.
+ *
+ * The main loop rate is calculated from the number of loop iterations since
+ * the last time this function was called.
+ *
+ * buses - An array of all active CAN buses.
+ * busCount - The length of the buses array.
+ * pipeline - The pipeline with the output interface statistics.
+ *
+ * Returns a new cJSON object - the caller is responsible for calling
+ * cJSON_Delete() on it.
+ */
+cJSON* serialize(CanBus* buses, int busCount, Pipeline* pipeline);
+
+/* Public: Serialize all runtime statistics (see serialize()) into a buffer as
+ * an unformatted JSON string.
+ *
+ * buffer - The destination for the NUL terminated string.
+ * bufferSize - The length of the buffer. The statistics grow with the number
+ *      of CAN buses, and are never cut off to fit - a partial JSON object
+ *      isn't useful to the host.
+ *
+ * Returns the length of the string written to buffer, not including the NUL,
+ * or -1 if the statistics didn't fit (or couldn't be serialized) and nothing
+ * was written.
+ */
+int serialize(CanBus* buses, int busCount, Pipeline* pipeline, char* buffer,
+        int bufferSize);
+
+/* Public: Build a JSON command response with the run time accounting for a
+ * single scheduler task.
+ *
+ * task - The task to serialize.
+ *
+ * Returns a new cJSON object - the caller is responsible for calling
+ * cJSON_Delete() on it.
+ */
+cJSON* serialize(Task* task);
+
+#ifdef __SIGNAL_STATISTICS__
+
+/* Public: Find the signals generating the most output traffic.
+ *
+ * Signals are ranked by the number of bytes serialized, then by the number of
+ * times they were decoded (a signal that is decoded often but always
+ * suppressed still costs CPU time).
+ *
+ * signals - An array of all CAN signals.
+ * signalCount - The length of the signals array.
+ * sorted - An array to fill with pointers to the top signals, busiest first.
+ * maxCount - The length of the sorted array.
+ *
+ * Returns the number of signals stored in sorted.
+ */
+int sortSignalsByTraffic(CanSignal* signals, int signalCount,
+        CanSignal** sorted, int maxCount);
+
+/* Public: Build a JSON command response with the traffic counters for a
+ * single signal.
+ *
+ * signal - The signal to serialize.
+ * rank - The position of the signal in the sorted report, starting at 1.
+ *
+ * Returns a new cJSON object - the caller is responsible for calling
+ * cJSON_Delete() on it.
+ */
+cJSON* serialize(CanSignal* signal, int rank);
+
+#endif // __SIGNAL_STATISTICS__
+
+} // namespace statistics
+} // namespace openxc
+
+#endif // _STATISTICS_H_
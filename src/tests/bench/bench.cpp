@@ -0,0 +1,68 @@
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+volatile uint64_t openxc::bench::SINK;
+
+/* Private: Returns the current time from the monotonic clock, in
+ * nanoseconds.
+ */
+static uint64_t nowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/* Private: Returns the time taken to run the operation in a batch of the given
+ * size, in nanoseconds.
+ */
+static uint64_t timeBatch(void (*operation)(), unsigned long batchSize) {
+    uint64_t start = nowNs();
+    for(unsigned long i = 0; i < batchSize; i++) {
+        operation();
+    }
+    return nowNs() - start;
+}
+
+double openxc::bench::run(const char* name, void (*operation)()) {
+    static bool headerPrinted = false;
+    if(!headerPrinted) {
+        printf("%-48s %12s %14s\n", "benchmark", "ns/op", "ops/s");
+        headerPrinted = true;
+    }
+
+    timeBatch(operation, BENCH_WARMUP_ITERATIONS);
+
+    unsigned long batchSize = 1000;
+    while(timeBatch(operation, batchSize) < BENCH_MIN_BATCH_NS) {
+        batchSize *= 2;
+    }
+
+    // Interruptions only ever make a batch slower, so the fastest batch is
+    // the most repeatable measure
+    uint64_t fastestBatchNs = timeBatch(operation, batchSize);
+    for(int i = 1; i < BENCH_REPETITIONS; i++) {
+        uint64_t batchNs = timeBatch(operation, batchSize);
+        if(batchNs < fastestBatchNs) {
+            fastestBatchNs = batchNs;
+        }
+    }
+    double nsPerOperation = (double)fastestBatchNs / batchSize;
+
+    printf("%-48s %12.2f %14.0f\n", name, nsPerOperation,
+            1e9 / nsPerOperation);
+    fflush(stdout);
+
+    const char* resultsPath = getenv(BENCH_RESULTS_ENVIRONMENT_VARIABLE);
+    if(resultsPath != NULL) {
+        FILE* results = fopen(resultsPath, "a");
+        if(results != NULL) {
+            fprintf(results, "{\"name\": \"%s\", \"ns_per_op\": %.3f, "
+                    "\"ops_per_s\": %.0f}\n", name, nsPerOperation,
+                    1e9 / nsPerOperation);
+            fclose(results);
+        }
+    }
+    return nsPerOperation;
+}
@@ -0,0 +1,50 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <stdint.h>
+
+// Run each operation this many times before measuring, to warm up caches and
+// branch predictors
+#define BENCH_WARMUP_ITERATIONS 10000
+// Grow the batch size until one batch takes at least this long, so the clock
+// resolution doesn't matter
+#define BENCH_MIN_BATCH_NS 20000000
+// Time this many batches and report the fastest
+#define BENCH_REPETITIONS 9
+// If set, results are also appended to this file as one JSON object per line
+#define BENCH_RESULTS_ENVIRONMENT_VARIABLE "BENCH_RESULTS"
+
+namespace openxc {
+namespace bench {
+
+/* Public: Write results here to stop the compiler from optimizing away an
+ * operation that has no other side effects.
+ */
+extern volatile uint64_t SINK;
+
+/* Public: Measure an operation and print the result as one line, in a fixed
+ * format:
+ *
+ *      <benchmark name>    <ns/op>    <ops/s>
+ *
+ * The operation is run BENCH_WARMUP_ITERATIONS times first, then in batches
+ * large enough to take at least BENCH_MIN_BATCH_NS each. The fastest of
+ * BENCH_REPETITIONS batches is reported.
+ *
+ * If the BENCH_RESULTS environment variable names a file, the result is also
+ * appended to it as a JSON object for script/compare_benchmarks.py, e.g.:
+ *
+ *      {"name": "bitfield/getBitField", "ns_per_op": 4.770, "ops_per_s": 209592259}
+ *
+ * name - The name of the benchmark, e.g. "bitfield/getBitField".
+ * operation - The operation to measure. The time includes the cost of the
+ *      function call.
+ *
+ * Returns the time per operation in nanoseconds.
+ */
+double run(const char* name, void (*operation)());
+
+} // namespace bench
+} // namespace openxc
+
+#endif // _BENCH_H_
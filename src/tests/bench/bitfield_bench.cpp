@@ -0,0 +1,32 @@
+#include "bench.h"
+#include "util/bitfield.h"
+
+namespace bench = openxc::bench;
+
+using openxc::util::bitfield::getBitField;
+using openxc::util::bitfield::setBitField;
+
+const uint64_t BIG_ENDIAN_TEST_DATA = __builtin_bswap64(0xEB00000000000000);
+
+uint64_t data = BIG_ENDIAN_TEST_DATA;
+
+void benchGetBitField() {
+    bench::SINK = getBitField(data, 2, 4, true);
+}
+
+void benchGetBitFieldOffByteBoundary() {
+    bench::SINK = getBitField(data, 12, 17, true);
+}
+
+void benchSetBitField() {
+    setBitField(&data, 0x7f, 3, 10);
+    bench::SINK = data;
+}
+
+int main(void) {
+    bench::run("bitfield/getBitField", benchGetBitField);
+    bench::run("bitfield/getBitField_off_byte_boundary",
+            benchGetBitFieldOffByteBoundary);
+    bench::run("bitfield/setBitField", benchSetBitField);
+    return 0;
+}
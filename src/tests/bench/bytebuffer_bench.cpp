@@ -0,0 +1,69 @@
+#include "bench.h"
+#include "util/bytebuffer.h"
+#include <string.h>
+
+namespace bench = openxc::bench;
+
+using openxc::util::bytebuffer::conditionalEnqueue;
+using openxc::util::bytebuffer::processQueue;
+using openxc::util::bytebuffer::Framer;
+using openxc::util::bytebuffer::drainQueue;
+
+// The size of the LPC17xx UART transmit FIFO
+#define TRANSMIT_FIFO_SIZE 16
+
+const char* MESSAGE = "{\"name\":\"vehicle_speed\",\"value\":42.000000}";
+
+QUEUE_TYPE(uint8_t) queue;
+QUEUE_TYPE(uint8_t) receiveQueue;
+Framer framer;
+int messageLength = strlen(MESSAGE);
+
+bool countMessage(uint8_t* message, int length) {
+    bench::SINK += length;
+    return true;
+}
+
+void benchConditionalEnqueue() {
+    if(!conditionalEnqueue(&queue, (uint8_t*)MESSAGE, messageLength)) {
+        QUEUE_INIT(uint8_t, &queue);
+    }
+}
+
+/* Private: Receive one message and its separator, as the interfaces do, and
+ * frame it. The queue wraps around, so some messages are copied.
+ */
+void benchProcessQueue() {
+    for(int i = 0; i <= messageLength; i++) {
+        QUEUE_PUSH(uint8_t, &receiveQueue, (uint8_t)MESSAGE[i]);
+    }
+    processQueue(&receiveQueue, &framer, countMessage);
+}
+
+int writeToFifo(const uint8_t* bytes, int length) {
+    bench::SINK += bytes[0];
+    return length;
+}
+
+/* Private: Refill a UART transmit FIFO from the send queue, as the transmit
+ * interrupt does, topping the queue up with messages when it runs low.
+ */
+void benchDrainQueue() {
+    if(QUEUE_LENGTH(uint8_t, &queue) < TRANSMIT_FIFO_SIZE) {
+        conditionalEnqueue(&queue, (uint8_t*)MESSAGE, messageLength);
+    }
+    drainQueue(&queue, TRANSMIT_FIFO_SIZE, writeToFifo);
+}
+
+int main(void) {
+    QUEUE_INIT(uint8_t, &queue);
+    bench::run("bytebuffer/conditionalEnqueue", benchConditionalEnqueue);
+
+    QUEUE_INIT(uint8_t, &receiveQueue);
+    openxc::util::bytebuffer::initializeFramer(&framer);
+    bench::run("bytebuffer/processQueue", benchProcessQueue);
+
+    QUEUE_INIT(uint8_t, &queue);
+    bench::run("bytebuffer/drainQueue", benchDrainQueue);
+    return 0;
+}
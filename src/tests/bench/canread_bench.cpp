@@ -0,0 +1,110 @@
+#include "bench.h"
+#include "can/canutil.h"
+#include "can/canread.h"
+
+namespace bench = openxc::bench;
+namespace usb = openxc::interface::usb;
+namespace can = openxc::can;
+
+using openxc::can::read::booleanHandler;
+using openxc::can::read::passthroughHandler;
+using openxc::can::read::stateHandler;
+
+const uint64_t BIG_ENDIAN_TEST_DATA = __builtin_bswap64(0xEB00000000000000);
+
+CanMessage MESSAGES[3] = {
+    {NULL, 0},
+    {NULL, 1},
+    {NULL, 2},
+};
+
+CanSignalState SIGNAL_STATES[1][10] = {
+    { {1, "reverse"}, {2, "third"}, {3, "sixth"}, {4, "seventh"},
+        {5, "neutral"}, {6, "second"}, },
+};
+
+const int SIGNAL_COUNT = 3;
+CanSignal SIGNALS[SIGNAL_COUNT] = {
+    {&MESSAGES[0], "torque_at_transmission", 2, 4, 1001.0, -30000.000000,
+        -5000.000000, 33522.000000, 1, true, false, NULL, 0, true},
+    {&MESSAGES[1], "transmission_gear_position", 1, 3, 1.000000, 0.000000,
+        0.000000, 0.000000, 1, true, false, SIGNAL_STATES[0], 6, true},
+    {&MESSAGES[2], "brake_pedal_status", 0, 1, 1.000000, 0.000000, 0.000000,
+        0.000000, 1, true, false, NULL, 0, true},
+};
+
+Pipeline pipeline;
+UsbDevice usbDevice;
+
+/* Private: Throw away queued output before it fills up, so every operation
+ * does the full amount of work.
+ */
+void drainOutput() {
+    if(QUEUE_AVAILABLE(uint8_t, &usbDevice.sendQueue) < 256) {
+        QUEUE_INIT(uint8_t, &usbDevice.sendQueue);
+    }
+}
+
+void benchDecodeSignal() {
+    bench::SINK = can::read::decodeSignal(&SIGNALS[0], BIG_ENDIAN_TEST_DATA);
+}
+
+void benchStateHandler() {
+    bool send = true;
+    bench::SINK = (uint64_t) stateHandler(&SIGNALS[1], SIGNALS, SIGNAL_COUNT,
+            2, &send);
+}
+
+void benchTranslateSignal() {
+    can::read::translateSignal(&pipeline, &SIGNALS[0], BIG_ENDIAN_TEST_DATA,
+            SIGNALS, SIGNAL_COUNT);
+    drainOutput();
+}
+
+void benchTranslateSignalFloatHandler() {
+    can::read::translateSignal(&pipeline, &SIGNALS[0], BIG_ENDIAN_TEST_DATA,
+            passthroughHandler, SIGNALS, SIGNAL_COUNT);
+    drainOutput();
+}
+
+void benchTranslateSignalBooleanHandler() {
+    can::read::translateSignal(&pipeline, &SIGNALS[2], BIG_ENDIAN_TEST_DATA,
+            booleanHandler, SIGNALS, SIGNAL_COUNT);
+    drainOutput();
+}
+
+void benchTranslateSignalStateHandler() {
+    can::read::translateSignal(&pipeline, &SIGNALS[1], BIG_ENDIAN_TEST_DATA,
+            stateHandler, SIGNALS, SIGNAL_COUNT);
+    drainOutput();
+}
+
+void benchSendJson() {
+    // sendJSON is private, this is its thinnest caller
+    can::read::sendNumericalMessage("vehicle_speed", 42.0, &pipeline);
+    drainOutput();
+}
+
+void benchPassthroughMessage() {
+    can::read::passthroughMessage(&pipeline, 42, 0x123456789ABCDEF1LLU);
+    drainOutput();
+}
+
+int main(void) {
+    pipeline.usb = &usbDevice;
+    usb::initialize(&usbDevice);
+    usbDevice.configured = true;
+
+    bench::run("canread/decodeSignal", benchDecodeSignal);
+    bench::run("canread/stateHandler", benchStateHandler);
+    bench::run("canread/translateSignal", benchTranslateSignal);
+    bench::run("canread/translateSignal_float_handler",
+            benchTranslateSignalFloatHandler);
+    bench::run("canread/translateSignal_boolean_handler",
+            benchTranslateSignalBooleanHandler);
+    bench::run("canread/translateSignal_state_handler",
+            benchTranslateSignalStateHandler);
+    bench::run("canread/sendJSON", benchSendJson);
+    bench::run("canread/passthroughMessage", benchPassthroughMessage);
+    return 0;
+}
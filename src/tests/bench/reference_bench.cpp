@@ -0,0 +1,28 @@
+#include "bench.h"
+
+namespace bench = openxc::bench;
+
+#define REFERENCE_BUFFER_SIZE 256
+
+uint8_t buffer[REFERENCE_BUFFER_SIZE];
+
+/* Private: A fixed amount of plain integer work on a buffer in the cache,
+ * which no change to the firmware can make faster or slower. The regression
+ * check in make test compares the other benchmarks to this one, so the speed
+ * of the computer cancels out.
+ */
+void benchChecksum() {
+    uint32_t checksum = 0;
+    for(int i = 0; i < REFERENCE_BUFFER_SIZE; i++) {
+        checksum = (checksum << 1 | checksum >> 31) ^ buffer[i];
+    }
+    bench::SINK = checksum;
+}
+
+int main(void) {
+    for(int i = 0; i < REFERENCE_BUFFER_SIZE; i++) {
+        buffer[i] = i * 7;
+    }
+    bench::run("reference/checksum", benchChecksum);
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include "bench.h"
+#include "synthetic.h"
+#include "can/canutil.h"
+
+namespace bench = openxc::bench;
+namespace synthetic = openxc::bench::synthetic;
+namespace usb = openxc::interface::usb;
+namespace can = openxc::can;
+
+using openxc::bench::synthetic::SyntheticConfiguration;
+using openxc::bench::synthetic::SyntheticMessageSet;
+
+// Cycle through this many generated frames, enough that the frames touch every
+// message in the largest set
+#define FRAME_COUNT 4096
+#define SIGNALS_PER_MESSAGE 5
+// Step through the signals in an order that isn't sequential, so lookups hit
+// every part of the table
+#define SIGNAL_STRIDE 7919
+
+const int SIGNAL_COUNTS[] = {10, 100, 1000, 10000};
+
+SyntheticMessageSet messageSet;
+CanMessage frames[FRAME_COUNT];
+int frameIndex;
+int signalIndex;
+
+Pipeline pipeline;
+UsbDevice usbDevice;
+
+/* Private: Throw away queued output before it fills up, so every operation
+ * does the full amount of work.
+ */
+void drainOutput() {
+    if(QUEUE_AVAILABLE(uint8_t, &usbDevice.sendQueue) < 512) {
+        QUEUE_INIT(uint8_t, &usbDevice.sendQueue);
+    }
+}
+
+CanMessage* nextFrame() {
+    frameIndex = (frameIndex + 1) % FRAME_COUNT;
+    return &frames[frameIndex];
+}
+
+CanSignal* nextSignal() {
+    signalIndex = (signalIndex + SIGNAL_STRIDE) %
+            messageSet.messageSet.signalCount;
+    return &messageSet.signals[signalIndex];
+}
+
+void benchLookupMessage() {
+    bench::SINK = (uint64_t) synthetic::lookupMessage(&messageSet,
+            nextFrame()->id);
+}
+
+void benchLookupSignal() {
+    bench::SINK = (uint64_t) can::lookupSignal(nextSignal()->genericName,
+            messageSet.signals, messageSet.messageSet.signalCount);
+}
+
+void benchDecodeFrame() {
+    synthetic::decodeFrame(&pipeline, &messageSet, nextFrame());
+    drainOutput();
+}
+
+/* Private: Run the benchmarks with a message set of the given size. A tenth of
+ * the signals are state based, a tenth have a custom handler and a tenth are
+ * writable, about the mix in a real vehicle's signals.cpp.
+ */
+void benchSignalCount(int signalCount) {
+    SyntheticConfiguration configuration = {
+        2, signalCount / SIGNALS_PER_MESSAGE, SIGNALS_PER_MESSAGE,
+        signalCount / 10, signalCount / 10, signalCount / 10, signalCount
+    };
+    if(!synthetic::generate(&configuration, &messageSet)) {
+        fprintf(stderr, "Unable to generate %d synthetic signals\n",
+                signalCount);
+        return;
+    }
+    synthetic::generateFrames(&messageSet, frames, FRAME_COUNT);
+    frameIndex = 0;
+    signalIndex = 0;
+
+    char name[48];
+    snprintf(name, sizeof(name), "scaling/lookupMessage_%d", signalCount);
+    bench::run(name, benchLookupMessage);
+    snprintf(name, sizeof(name), "scaling/lookupSignal_%d", signalCount);
+    bench::run(name, benchLookupSignal);
+    snprintf(name, sizeof(name), "scaling/decodeFrame_%d", signalCount);
+    bench::run(name, benchDecodeFrame);
+
+    synthetic::destroy(&messageSet);
+}
+
+int main(void) {
+    pipeline.usb = &usbDevice;
+    usb::initialize(&usbDevice);
+    usbDevice.configured = true;
+
+    for(unsigned int i = 0; i < sizeof(SIGNAL_COUNTS) / sizeof(int); i++) {
+        benchSignalCount(SIGNAL_COUNTS[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,221 @@
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "can/canread.h"
+
+namespace synthetic = openxc::bench::synthetic;
+
+using openxc::bench::synthetic::SyntheticConfiguration;
+using openxc::bench::synthetic::SyntheticMessageSet;
+using openxc::can::read::stateHandler;
+using openxc::can::read::translateSignal;
+
+const char* SYNTHETIC_STATE_NAMES[SYNTHETIC_STATE_COUNT] = {
+    "off", "accessory", "run", "start", "park", "reverse", "neutral", "drive"
+};
+
+/* Private: Returns true if the item at index is one of the selectedCount items
+ * picked evenly from a list of totalCount.
+ */
+static bool selected(int index, int selectedCount, int totalCount) {
+    return ((long)index * selectedCount) / totalCount !=
+            ((long)(index + 1) * selectedCount) / totalCount;
+}
+
+/* Private: A stand-in for a custom float handler from a vehicle's signals.cpp.
+ */
+static float syntheticHandler(CanSignal* signal, CanSignal* signals,
+        int signalCount, float value, bool* send) {
+    return value * 2 + 1;
+}
+
+/* Private: Returns the next 32 bits from a xorshift generator, so the frames
+ * are the same on every computer.
+ */
+static uint32_t nextRandom(uint32_t* state) {
+    uint32_t value = *state;
+    value ^= value << 13;
+    value ^= value >> 17;
+    value ^= value << 5;
+    *state = value;
+    return value;
+}
+
+bool openxc::bench::synthetic::generate(
+        SyntheticConfiguration* configuration,
+        SyntheticMessageSet* messageSet) {
+    memset(messageSet, 0, sizeof(SyntheticMessageSet));
+    int signalCount = configuration->messageCount *
+            configuration->signalsPerMessage;
+    if(configuration->busCount < 1 || configuration->messageCount < 1 ||
+            configuration->signalsPerMessage < 1 ||
+            configuration->signalsPerMessage > 64 ||
+            configuration->stateSignalCount > signalCount ||
+            configuration->handlerSignalCount >
+                signalCount - configuration->stateSignalCount ||
+            configuration->writableSignalCount > signalCount) {
+        return false;
+    }
+
+    messageSet->messageSet.name = "synthetic";
+    messageSet->messageSet.busCount = configuration->busCount;
+    messageSet->messageSet.messageCount = configuration->messageCount;
+    messageSet->messageSet.signalCount = signalCount;
+    messageSet->signalsPerMessage = configuration->signalsPerMessage;
+    // xorshift never leaves 0
+    messageSet->randomState = configuration->seed != 0 ?
+            configuration->seed : 1;
+
+    messageSet->buses = (CanBus*) calloc(configuration->busCount,
+            sizeof(CanBus));
+    messageSet->messages = (CanMessage*) calloc(configuration->messageCount,
+            sizeof(CanMessage));
+    messageSet->signals = (CanSignal*) calloc(signalCount, sizeof(CanSignal));
+    messageSet->signalTypes = (synthetic::SyntheticSignalType*) calloc(
+            signalCount, sizeof(synthetic::SyntheticSignalType));
+    messageSet->names = (char*) calloc(signalCount,
+            SYNTHETIC_MAX_NAME_LENGTH);
+    if(messageSet->buses == NULL || messageSet->messages == NULL ||
+            messageSet->signals == NULL || messageSet->signalTypes == NULL ||
+            messageSet->names == NULL) {
+        destroy(messageSet);
+        return false;
+    }
+
+    for(int i = 0; i < configuration->busCount; i++) {
+        messageSet->buses[i].speed = 500000;
+        messageSet->buses[i].address = i + 1;
+        QUEUE_INIT(CanMessage, &messageSet->buses[i].receiveQueue);
+        QUEUE_INIT(CanMessage, &messageSet->buses[i].sendQueue);
+    }
+
+    for(int i = 0; i < SYNTHETIC_STATE_COUNT; i++) {
+        messageSet->states[i].value = i;
+        messageSet->states[i].name = SYNTHETIC_STATE_NAMES[i];
+    }
+
+    for(int i = 0; i < configuration->messageCount; i++) {
+        messageSet->messages[i].bus =
+                &messageSet->buses[i % configuration->busCount];
+        messageSet->messages[i].id = SYNTHETIC_FIRST_MESSAGE_ID + i;
+    }
+
+    int fieldWidth = 64 / configuration->signalsPerMessage;
+    int numericalSignalIndex = 0;
+    for(int i = 0; i < signalCount; i++) {
+        CanSignal* signal = &messageSet->signals[i];
+        char* name = &messageSet->names[i * SYNTHETIC_MAX_NAME_LENGTH];
+        snprintf(name, SYNTHETIC_MAX_NAME_LENGTH, "synthetic_signal_%d", i);
+
+        signal->message = &messageSet->messages[
+                i / configuration->signalsPerMessage];
+        signal->genericName = name;
+        signal->bitPosition = (i % configuration->signalsPerMessage) *
+                fieldWidth;
+        signal->bitSize = fieldWidth < SYNTHETIC_MAX_SIGNAL_BIT_SIZE ?
+                fieldWidth : SYNTHETIC_MAX_SIGNAL_BIT_SIZE;
+        signal->factor = 0.5;
+        signal->offset = -10;
+        signal->minValue = -10;
+        signal->maxValue = (1 << signal->bitSize) * 0.5 - 10;
+        // The worst case - every decoded value is sent
+        signal->sendFrequency = 1;
+        signal->sendSame = true;
+        // Counted from the other end, so the writable signals aren't all
+        // also state signals when the counts are the same
+        signal->writable = selected(signalCount - 1 - i,
+                configuration->writableSignalCount, signalCount);
+
+        if(selected(i, configuration->stateSignalCount, signalCount)) {
+            messageSet->signalTypes[i] = synthetic::SYNTHETIC_STATE;
+            signal->factor = 1;
+            signal->offset = 0;
+            signal->minValue = 0;
+            signal->maxValue = SYNTHETIC_STATE_COUNT - 1;
+            if(signal->bitSize > SYNTHETIC_MAX_STATE_BIT_SIZE) {
+                signal->bitSize = SYNTHETIC_MAX_STATE_BIT_SIZE;
+            }
+            signal->states = messageSet->states;
+            signal->stateCount = SYNTHETIC_STATE_COUNT;
+        } else if(selected(numericalSignalIndex++,
+                    configuration->handlerSignalCount,
+                    signalCount - configuration->stateSignalCount)) {
+            messageSet->signalTypes[i] = synthetic::SYNTHETIC_HANDLER;
+        } else {
+            messageSet->signalTypes[i] = synthetic::SYNTHETIC_NUMERICAL;
+        }
+    }
+    return true;
+}
+
+void openxc::bench::synthetic::destroy(SyntheticMessageSet* messageSet) {
+    free(messageSet->buses);
+    free(messageSet->messages);
+    free(messageSet->signals);
+    free(messageSet->signalTypes);
+    free(messageSet->names);
+    memset(messageSet, 0, sizeof(SyntheticMessageSet));
+}
+
+void openxc::bench::synthetic::generateFrames(SyntheticMessageSet* messageSet,
+        CanMessage* frames, int frameCount) {
+    for(int i = 0; i < frameCount; i++) {
+        CanMessage* message = &messageSet->messages[
+                nextRandom(&messageSet->randomState) %
+                messageSet->messageSet.messageCount];
+        frames[i].bus = message->bus;
+        frames[i].id = message->id;
+        frames[i].data = ((uint64_t)nextRandom(&messageSet->randomState) << 32)
+                | nextRandom(&messageSet->randomState);
+    }
+}
+
+CanMessage* openxc::bench::synthetic::lookupMessage(
+        SyntheticMessageSet* messageSet, uint32_t id) {
+    int low = 0;
+    int high = messageSet->messageSet.messageCount - 1;
+    while(low <= high) {
+        int middle = (low + high) / 2;
+        uint32_t candidate = messageSet->messages[middle].id;
+        if(candidate == id) {
+            return &messageSet->messages[middle];
+        } else if(candidate < id) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return NULL;
+}
+
+bool openxc::bench::synthetic::decodeFrame(Pipeline* pipeline,
+        SyntheticMessageSet* messageSet, CanMessage* frame) {
+    CanMessage* message = lookupMessage(messageSet, frame->id);
+    if(message == NULL) {
+        return false;
+    }
+
+    int signalCount = messageSet->messageSet.signalCount;
+    int firstSignal = (message - messageSet->messages) *
+            messageSet->signalsPerMessage;
+    for(int i = firstSignal; i < firstSignal + messageSet->signalsPerMessage;
+            i++) {
+        CanSignal* signal = &messageSet->signals[i];
+        switch(messageSet->signalTypes[i]) {
+        case synthetic::SYNTHETIC_STATE:
+            translateSignal(pipeline, signal, frame->data, stateHandler,
+                    messageSet->signals, signalCount);
+            break;
+        case synthetic::SYNTHETIC_HANDLER:
+            translateSignal(pipeline, signal, frame->data, syntheticHandler,
+                    messageSet->signals, signalCount);
+            break;
+        default:
+            translateSignal(pipeline, signal, frame->data,
+                    messageSet->signals, signalCount);
+            break;
+        }
+    }
+    return true;
+}
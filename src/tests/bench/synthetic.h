@@ -0,0 +1,132 @@
+#ifndef _SYNTHETIC_H_
+#define _SYNTHETIC_H_
+
+#include <stdint.h>
+#include "can/canutil.h"
+#include "pipeline.h"
+
+// Every generated state signal uses the same table, with a state for every
+// possible raw value of a 3 bit field, so random frame data always decodes to
+// a valid state
+#define SYNTHETIC_STATE_COUNT 8
+#define SYNTHETIC_MAX_STATE_BIT_SIZE 3
+#define SYNTHETIC_MAX_SIGNAL_BIT_SIZE 16
+#define SYNTHETIC_MAX_NAME_LENGTH 32
+#define SYNTHETIC_FIRST_MESSAGE_ID 0x100
+
+using openxc::pipeline::Pipeline;
+
+namespace openxc {
+namespace bench {
+namespace synthetic {
+
+/* Public: The shape of a synthetic message set.
+ *
+ * busCount - The number of CAN buses. Messages are spread evenly across them.
+ * messageCount - The number of CAN messages, i.e. distinct arbitration IDs.
+ * signalsPerMessage - The number of signals packed into each message, from 1
+ *      to 64. The payload is split evenly between them, up to
+ *      SYNTHETIC_MAX_SIGNAL_BIT_SIZE bits each.
+ * stateSignalCount - How many of the signals are state based, decoded with the
+ *      stateHandler.
+ * handlerSignalCount - How many of the numerical signals are decoded with a
+ *      custom float handler, instead of the default one.
+ * writableSignalCount - How many of the signals are writable.
+ * seed - The seed for the frame data. The same seed always generates the same
+ *      frames.
+ */
+typedef struct {
+    int busCount;
+    int messageCount;
+    int signalsPerMessage;
+    int stateSignalCount;
+    int handlerSignalCount;
+    int writableSignalCount;
+    uint32_t seed;
+} SyntheticConfiguration;
+
+/* Public: How a synthetic signal is decoded. */
+typedef enum {
+    SYNTHETIC_NUMERICAL,
+    SYNTHETIC_STATE,
+    SYNTHETIC_HANDLER
+} SyntheticSignalType;
+
+/* Public: A generated message set, laid out the same way as the tables in a
+ * generated signals.cpp - signals are grouped by message, and messages are
+ * sorted by ID.
+ *
+ * messageSet - The message set metadata, with the counts below.
+ * buses - The array of buses.
+ * messages - The array of messages, sorted by ID.
+ * signals - The array of signals. The signals of messages[i] start at
+ *      signals[i * signalsPerMessage].
+ * signalTypes - How to decode each signal, parallel to the signals array.
+ * signalsPerMessage - The number of signals in each message.
+ * states - The state table shared by all state based signals.
+ * names - Storage for the signal names.
+ * randomState - The state of the frame data generator.
+ */
+typedef struct {
+    CanMessageSet messageSet;
+    CanBus* buses;
+    CanMessage* messages;
+    CanSignal* signals;
+    SyntheticSignalType* signalTypes;
+    int signalsPerMessage;
+    CanSignalState states[SYNTHETIC_STATE_COUNT];
+    char* names;
+    uint32_t randomState;
+} SyntheticMessageSet;
+
+/* Public: Allocate and fill in the tables for a synthetic message set. Signals
+ * are named "synthetic_signal_<index>", and the state, handler and writable
+ * signals are spread evenly through the signal array.
+ *
+ * configuration - The shape of the message set.
+ * messageSet - The message set to fill in. Release it with destroy().
+ *
+ * Returns true if the configuration was valid and the tables were allocated.
+ */
+bool generate(SyntheticConfiguration* configuration,
+        SyntheticMessageSet* messageSet);
+
+/* Public: Release the tables allocated by generate().
+ */
+void destroy(SyntheticMessageSet* messageSet);
+
+/* Public: Generate a stream of frames for the message set. Each frame is for a
+ * randomly chosen message, on that message's bus, with random data that
+ * decodes to a valid value for every signal.
+ *
+ * messageSet - The message set to generate frames for.
+ * frames - The array to fill in.
+ * frameCount - The number of frames to generate.
+ */
+void generateFrames(SyntheticMessageSet* messageSet, CanMessage* frames,
+        int frameCount);
+
+/* Public: Find the message with an ID, the way the switch statement in a
+ * generated decodeCanMessage() does.
+ *
+ * Returns a pointer to the message, or NULL if the ID isn't in the set.
+ */
+CanMessage* lookupMessage(SyntheticMessageSet* messageSet, uint32_t id);
+
+/* Public: Decode every signal in a frame and send the values to the pipeline,
+ * the same way a generated decodeCanMessage() does.
+ *
+ * pipeline - The pipeline to send the translated values to.
+ * messageSet - The message set the frame belongs to.
+ * frame - The frame to decode.
+ *
+ * Returns true if the frame's ID was in the message set.
+ */
+bool decodeFrame(Pipeline* pipeline, SyntheticMessageSet* messageSet,
+        CanMessage* frame);
+
+} // namespace synthetic
+} // namespace bench
+} // namespace openxc
+
+#endif // _SYNTHETIC_H_
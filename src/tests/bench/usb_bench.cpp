@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "interface/usb.h"
+
+namespace bench = openxc::bench;
+namespace usb = openxc::interface::usb;
+
+using openxc::interface::usb::UsbDevice;
+using openxc::util::bytebuffer::conditionalEnqueue;
+
+// The sizes of the simulated host's reads from the IN endpoint - one packet,
+// a typical libusb bulk read, and the whole send queue
+const int READ_SIZES[] = {64, 512, 1024};
+
+const char* MESSAGE = "{\"name\":\"vehicle_speed\",\"value\":42.000000}";
+
+UsbDevice usbDevice;
+uint8_t hostBuffer[QUEUE_MAX_LENGTH(uint8_t)];
+int readSize;
+unsigned long long bytesSent;
+unsigned long long transfers;
+int messageLength = strlen(MESSAGE);
+
+/* Private: Send one IN transfer the way the controllers do: keep both buffers
+ * prepared straight from the send queue, and let the host read the oldest.
+ * The queue is kept full so there's always a whole read waiting - it's filled
+ * with messages once, and then by moving its head back over the bytes already
+ * sent, so filling it isn't part of the measurement.
+ */
+void benchInTransfer() {
+    usbDevice.sendQueue.head = (usbDevice.sendQueue.tail +
+            QUEUE_MAX_LENGTH(uint8_t)) % queue_uint8_t_max_internal_length;
+
+    uint8_t* data;
+    int length;
+    while(usb::startInTransfer(&usbDevice, readSize, &data, &length) != -1);
+
+    int index = usb::oldestInTransfer(&usbDevice);
+    memcpy(hostBuffer, &usbDevice.sendQueue.elements[
+            usbDevice.sendQueue.tail], usbDevice.inTransferLengths[index]);
+    bytesSent += usbDevice.inTransferLengths[index];
+    ++transfers;
+    bench::SINK += hostBuffer[0];
+    usb::finishInTransfer(&usbDevice);
+}
+
+int main(void) {
+    for(unsigned int i = 0; i < sizeof(READ_SIZES) / sizeof(int); i++) {
+        usb::initializeCommon(&usbDevice);
+        readSize = READ_SIZES[i];
+        while(conditionalEnqueue(&usbDevice.sendQueue, (uint8_t*)MESSAGE,
+                    messageLength));
+
+        char name[48];
+        snprintf(name, sizeof(name), "usb/inTransfer_%d", readSize);
+        bytesSent = 0;
+        transfers = 0;
+        double nsPerTransfer = bench::run(name, benchInTransfer);
+        // A transfer stops at the end of the queue's storage, so it can be
+        // shorter than a read
+        double bytesPerTransfer = (double) bytesSent / transfers;
+        printf("%-48s %12.1f %14s\n", "", bytesPerTransfer / nsPerTransfer *
+                1000, "MB/s");
+    }
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include "bench.h"
+#include "can/canutil.h"
+#include "signals.h"
+#include "platform/platform.h"
+#include "statistics.h"
+#include "util/writeparser.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace bench = openxc::bench;
+namespace usb = openxc::interface::usb;
+namespace writeparser = openxc::util::writeparser;
+
+using openxc::statistics::STATISTICS;
+
+// receiveWriteRequest is defined in cantranslator.cpp, which expects the
+// generated signal definitions - these stand in for them
+extern bool receiveWriteRequest(uint8_t*, int);
+
+CanBus CAN_BUSES[1] = {
+    {500000, 1, NULL},
+};
+
+CanMessage MESSAGES[1] = {
+    {&CAN_BUSES[0], 0x29},
+};
+
+const int SIGNAL_COUNT = 1;
+CanSignal SIGNALS[SIGNAL_COUNT] = {
+    {&MESSAGES[0], "steering_wheel_angle", 2, 4, 1001.0, -30000.000000,
+        -5000.000000, 33522.000000, 1, true, false, NULL, 0, true},
+};
+
+CanMessageSet MESSAGE_SET = {0, "bench", 1, 1, SIGNAL_COUNT, 0};
+
+Pipeline pipeline;
+UsbDevice usbDevice;
+
+CanMessageSet* openxc::signals::getActiveMessageSet() {
+    return &MESSAGE_SET;
+}
+
+void openxc::signals::initialize() { }
+
+void openxc::signals::loop() { }
+
+int openxc::signals::getCanBusCount() {
+    return 1;
+}
+
+CanBus* openxc::signals::getCanBuses() {
+    return CAN_BUSES;
+}
+
+CanSignal* openxc::signals::getSignals() {
+    return SIGNALS;
+}
+
+int openxc::signals::getSignalCount() {
+    return SIGNAL_COUNT;
+}
+
+CanCommand* openxc::signals::getCommands() {
+    return NULL;
+}
+
+int openxc::signals::getCommandCount() {
+    return 0;
+}
+
+void openxc::signals::decodeCanMessage(Pipeline* pipeline, CanBus* bus,
+        int id, uint64_t data) { }
+
+void openxc::can::initialize(CanBus* bus) {
+    openxc::can::initializeCommon(bus);
+}
+
+void openxc::platform::suspend(Pipeline* pipeline) { }
+
+uint8_t RAW_WRITE_REQUEST[] = "{\"id\": 42, \"data\": \"0x1234\"}";
+uint8_t TRANSLATED_WRITE_REQUEST[] =
+        "{\"name\": \"steering_wheel_angle\", \"value\": 5000}";
+uint8_t BATCH_WRITE_REQUEST[] =
+        "[{\"name\": \"steering_wheel_angle\", \"value\": 5000}, "
+        "{\"id\": 42, \"data\": \"0x1234\"}, "
+        "{\"name\": \"steering_wheel_angle\", \"value\": -200.5}]";
+
+writeparser::WriteParser parser;
+int parserOffset;
+
+/* Private: Throw away queued CAN writes before the queue fills up, so every
+ * request does the full amount of work.
+ */
+void drainWriteQueue() {
+    if(QUEUE_FULL(CanMessage, &CAN_BUSES[0].sendQueue)) {
+        QUEUE_INIT(CanMessage, &CAN_BUSES[0].sendQueue);
+    }
+}
+
+void benchRawWriteRequest() {
+    bench::SINK = receiveWriteRequest(RAW_WRITE_REQUEST,
+            sizeof(RAW_WRITE_REQUEST) - 1);
+    drainWriteQueue();
+}
+
+void benchTranslatedWriteRequest() {
+    bench::SINK = receiveWriteRequest(TRANSLATED_WRITE_REQUEST,
+            sizeof(TRANSLATED_WRITE_REQUEST) - 1);
+    drainWriteQueue();
+}
+
+void benchBatchWriteRequest() {
+    bench::SINK = receiveWriteRequest(BATCH_WRITE_REQUEST,
+            sizeof(BATCH_WRITE_REQUEST) - 1);
+    drainWriteQueue();
+}
+
+/* Private: Parse a batch one byte per operation, starting over at the end, so
+ * the result is the parse cost per byte.
+ */
+void benchParseByte() {
+    bench::SINK = writeparser::parse(&parser,
+            &BATCH_WRITE_REQUEST[parserOffset++], 1);
+    if(parserOffset == sizeof(BATCH_WRITE_REQUEST) - 1) {
+        writeparser::initialize(&parser);
+        parserOffset = 0;
+    }
+}
+
+int main(void) {
+    openxc::statistics::initialize();
+    pipeline.usb = &usbDevice;
+    usb::initialize(&usbDevice);
+    openxc::can::initialize(&CAN_BUSES[0]);
+    writeparser::initialize(&parser);
+
+    bench::run("cantranslator/receiveWriteRequest_raw", benchRawWriteRequest);
+    bench::run("cantranslator/receiveWriteRequest_translated",
+            benchTranslatedWriteRequest);
+    bench::run("cantranslator/receiveWriteRequest_batch",
+            benchBatchWriteRequest);
+    bench::run("writeparser/parse_per_byte", benchParseByte);
+
+    // Writes are parsed without the JSON library, so nothing should ever have
+    // been allocated
+    if(STATISTICS.heapPeak != 0) {
+        fprintf(stderr, "Write requests used %u bytes of heap\n",
+                STATISTICS.heapPeak);
+        return 1;
+    }
+    return 0;
+}
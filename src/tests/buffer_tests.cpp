@@ -1,40 +1,63 @@
 #include <check.h>
 #include <stdint.h>
+#include <string.h>
 #include "util/bytebuffer.h"
 
 using openxc::util::bytebuffer::conditionalEnqueue;
 using openxc::util::bytebuffer::processQueue;
+using openxc::util::bytebuffer::Framer;
+using openxc::util::bytebuffer::peekContiguous;
+using openxc::util::bytebuffer::peekContiguousAfter;
+using openxc::util::bytebuffer::discardFront;
+using openxc::util::bytebuffer::drainQueue;
 
 QUEUE_TYPE(uint8_t) queue;
-bool called;
+Framer framer;
+int callCount;
 bool callbackStatus;
+int calledLength;
+char lastMessage[QUEUE_MAX_LENGTH(uint8_t) + 1];
 
 void setup() {
     QUEUE_INIT(uint8_t, &queue);
-    called = false;
+    openxc::util::bytebuffer::initializeFramer(&framer);
+    callCount = 0;
     callbackStatus = false;
+    calledLength = 0;
 }
 
 void teardown() {
 }
 
-bool callback(uint8_t* message) {
-    called = true;
+bool callback(uint8_t* message, int length) {
+    ++callCount;
+    calledLength = length;
+    memcpy(lastMessage, message, length + 1);
     return callbackStatus;
 }
 
+void pushString(const char* string) {
+    for(unsigned int i = 0; i < strlen(string); i++) {
+        QUEUE_PUSH(uint8_t, &queue, (uint8_t) string[i]);
+    }
+}
+
+void pushNull() {
+    QUEUE_PUSH(uint8_t, &queue, (uint8_t) '\0');
+}
+
 START_TEST (test_empty_doesnt_call)
 {
-    processQueue(&queue, callback);
-    fail_if(called);
+    processQueue(&queue, &framer, callback);
+    ck_assert_int_eq(callCount, 0);
 }
 END_TEST
 
 START_TEST (test_missing_callback)
 {
-    QUEUE_PUSH(uint8_t, &queue, (uint8_t) 128);
-    processQueue(&queue, NULL);
-    fail_if(called);
+    pushString("abc");
+    pushNull();
+    processQueue(&queue, &framer, NULL);
     fail_if(QUEUE_EMPTY(uint8_t, &queue));
 }
 END_TEST
@@ -42,44 +65,174 @@ END_TEST
 START_TEST (test_success_clears)
 {
     callbackStatus = true;
-    QUEUE_PUSH(uint8_t, &queue, (uint8_t) 128);
-    processQueue(&queue, callback);
-    fail_unless(called);
+    pushString("abc");
+    pushNull();
+    processQueue(&queue, &framer, callback);
+    ck_assert_int_eq(callCount, 1);
+    ck_assert_int_eq(calledLength, 3);
+    ck_assert_str_eq(lastMessage, "abc");
     fail_unless(QUEUE_EMPTY(uint8_t, &queue));
+    ck_assert_int_eq(framer.framesReceived, 1);
+    ck_assert_int_eq(framer.framesRejected, 0);
 }
 END_TEST
 
-START_TEST (test_failure_preserves)
+START_TEST (test_failure_clears_message)
 {
     callbackStatus = false;
-    QUEUE_PUSH(uint8_t, &queue, (uint8_t) 128);
-    processQueue(&queue, callback);
-    fail_unless(called);
-    fail_if(QUEUE_EMPTY(uint8_t, &queue));
+    pushString("abc");
+    pushNull();
+    pushString("de");
+    processQueue(&queue, &framer, callback);
+    ck_assert_int_eq(callCount, 1);
+    ck_assert_int_eq(framer.framesRejected, 1);
+    // Only the rejected message is removed
+    ck_assert_int_eq(QUEUE_LENGTH(uint8_t, &queue), 2);
 }
 END_TEST
 
-START_TEST (test_clear_corrupted)
+START_TEST (test_partial_preserved)
 {
-    callbackStatus = false;
-    QUEUE_PUSH(uint8_t, &queue, (uint8_t) 128);
-    QUEUE_PUSH(uint8_t, &queue, (uint8_t) '\0');
-    processQueue(&queue, callback);
-    fail_unless(called);
+    pushString("{\"id\": ");
+    processQueue(&queue, &framer, callback);
+    ck_assert_int_eq(callCount, 0);
+    ck_assert_int_eq(QUEUE_LENGTH(uint8_t, &queue), 7);
+    ck_assert_int_eq(framer.scanned, 7);
+
+    pushString("1}");
+    pushNull();
+    processQueue(&queue, &framer, callback);
+    ck_assert_int_eq(callCount, 1);
+    ck_assert_str_eq(lastMessage, "{\"id\": 1}");
+    fail_unless(QUEUE_EMPTY(uint8_t, &queue));
+    ck_assert_int_eq(framer.scanned, 0);
+}
+END_TEST
+
+START_TEST (test_many_messages)
+{
+    callbackStatus = true;
+    pushString("one");
+    pushNull();
+    pushString("two\nthree");
+    pushNull();
+    pushNull();
+    pushString("fo");
+    processQueue(&queue, &framer, callback);
+    ck_assert_int_eq(callCount, 3);
+    ck_assert_str_eq(lastMessage, "three");
+    ck_assert_int_eq(QUEUE_LENGTH(uint8_t, &queue), 2);
+}
+END_TEST
+
+START_TEST (test_newline_separator)
+{
+    pushString("abc\r\n");
+    processQueue(&queue, &framer, callback);
+    ck_assert_int_eq(callCount, 1);
+    ck_assert_str_eq(lastMessage, "abc\r");
+    fail_unless(QUEUE_EMPTY(uint8_t, &queue));
+}
+END_TEST
+
+START_TEST (test_wrapped_message)
+{
+    callbackStatus = true;
+    // Move the front of the queue close to the end of its storage
+    for(int i = 0; i < QUEUE_MAX_LENGTH(uint8_t) - 2; i++) {
+        QUEUE_PUSH(uint8_t, &queue, (uint8_t) 'x');
+        QUEUE_POP(uint8_t, &queue);
+    }
+
+    pushString("abcdef");
+    pushNull();
+    processQueue(&queue, &framer, callback);
+    ck_assert_int_eq(callCount, 1);
+    ck_assert_str_eq(lastMessage, "abcdef");
     fail_unless(QUEUE_EMPTY(uint8_t, &queue));
 }
 END_TEST
 
-START_TEST (test_full_clears)
+START_TEST (test_full_discards_until_separator)
 {
     for(int i = 0; i < QUEUE_MAX_LENGTH(uint8_t) + 1; i++) {
-        QUEUE_PUSH(uint8_t, &queue, (uint8_t) 128);
+        QUEUE_PUSH(uint8_t, &queue, (uint8_t) 'x');
     }
     fail_unless(QUEUE_FULL(uint8_t, &queue));
 
+    processQueue(&queue, &framer, callback);
+    ck_assert_int_eq(callCount, 0);
+    fail_unless(QUEUE_EMPTY(uint8_t, &queue));
+    ck_assert_int_eq(framer.framesOversize, 1);
+    fail_unless(framer.discarding);
+
+    // The rest of the message is dropped, but not the one after it
+    pushString("xxxx");
+    pushNull();
+    pushString("abc");
+    pushNull();
+    processQueue(&queue, &framer, callback);
+    ck_assert_int_eq(callCount, 1);
+    ck_assert_str_eq(lastMessage, "abc");
+    fail_if(framer.discarding);
+    ck_assert_int_eq(framer.bytesDiscarded, QUEUE_MAX_LENGTH(uint8_t) + 5);
+    ck_assert_int_eq(framer.framesOversize, 1);
+}
+END_TEST
+
+void pushBinaryRecord(int payloadLength, int pushed) {
+    QUEUE_PUSH(uint8_t, &queue, (uint8_t) BINARY_RECORD_MARKER);
+    QUEUE_PUSH(uint8_t, &queue, (uint8_t) payloadLength);
+    for(int i = 0; i < pushed; i++) {
+        pushNull();
+    }
+}
+
+START_TEST (test_binary_waits_for_record)
+{
+    callbackStatus = true;
+    pushBinaryRecord(4, 3);
+    processQueue(&queue, &framer, callback);
+    ck_assert_int_eq(callCount, 0);
+    ck_assert_int_eq(QUEUE_LENGTH(uint8_t, &queue), 5);
+
+    pushNull();
+    processQueue(&queue, &framer, callback);
+    ck_assert_int_eq(callCount, 1);
+    ck_assert_int_eq(calledLength, 6);
+    fail_unless(QUEUE_EMPTY(uint8_t, &queue));
+}
+END_TEST
+
+START_TEST (test_binary_header_only)
+{
+    QUEUE_PUSH(uint8_t, &queue, (uint8_t) BINARY_RECORD_MARKER);
+    processQueue(&queue, &framer, callback);
+    ck_assert_int_eq(callCount, 0);
+    fail_if(QUEUE_EMPTY(uint8_t, &queue));
+}
+END_TEST
+
+START_TEST (test_binary_unhandled_clears)
+{
     callbackStatus = false;
-    processQueue(&queue, callback);
-    fail_unless(called);
+    pushBinaryRecord(4, 4);
+    processQueue(&queue, &framer, callback);
+    ck_assert_int_eq(callCount, 1);
+    fail_unless(QUEUE_EMPTY(uint8_t, &queue));
+    ck_assert_int_eq(framer.framesRejected, 1);
+}
+END_TEST
+
+START_TEST (test_binary_then_message)
+{
+    callbackStatus = true;
+    pushBinaryRecord(2, 2);
+    pushString("abc");
+    pushNull();
+    processQueue(&queue, &framer, callback);
+    ck_assert_int_eq(callCount, 2);
+    ck_assert_str_eq(lastMessage, "abc");
     fail_unless(QUEUE_EMPTY(uint8_t, &queue));
 }
 END_TEST
@@ -153,18 +306,196 @@ START_TEST (test_enqueue_adds_crlf)
 }
 END_TEST
 
+/* Private: Move the front of the empty queue to the given index in its
+ * storage, so the next bytes pushed wrap around the end.
+ */
+void startQueueAt(int index) {
+    for(int i = 0; i < index; i++) {
+        QUEUE_PUSH(uint8_t, &queue, (uint8_t) 0);
+        QUEUE_POP(uint8_t, &queue);
+    }
+}
+
+START_TEST (test_peek_contiguous)
+{
+    int length;
+    peekContiguous(&queue, &length);
+    ck_assert_int_eq(length, 0);
+
+    pushString("abc");
+    uint8_t* bytes = peekContiguous(&queue, &length);
+    ck_assert_int_eq(length, 3);
+    ck_assert_int_eq(bytes[0], 'a');
+
+    discardFront(&queue, 2);
+    bytes = peekContiguous(&queue, &length);
+    ck_assert_int_eq(length, 1);
+    ck_assert_int_eq(bytes[0], 'c');
+}
+END_TEST
+
+START_TEST (test_peek_contiguous_wrapped)
+{
+    startQueueAt(QUEUE_MAX_LENGTH(uint8_t) - 1);
+    pushString("abcdef");
+    int length;
+    uint8_t* bytes = peekContiguous(&queue, &length);
+    ck_assert_int_eq(length, 2);
+    ck_assert_int_eq(bytes[0], 'a');
+
+    discardFront(&queue, length);
+    bytes = peekContiguous(&queue, &length);
+    ck_assert_int_eq(length, 4);
+    ck_assert_int_eq(bytes[0], 'c');
+}
+END_TEST
+
+START_TEST (test_peek_contiguous_after)
+{
+    startQueueAt(QUEUE_MAX_LENGTH(uint8_t) - 1);
+    pushString("abcdef");
+    int length;
+    uint8_t* bytes = peekContiguousAfter(&queue, 1, &length);
+    ck_assert_int_eq(length, 1);
+    ck_assert_int_eq(bytes[0], 'b');
+
+    // Past the wrap, the rest of the queue is contiguous
+    bytes = peekContiguousAfter(&queue, 3, &length);
+    ck_assert_int_eq(length, 3);
+    ck_assert_int_eq(bytes[0], 'd');
+
+    peekContiguousAfter(&queue, 6, &length);
+    ck_assert_int_eq(length, 0);
+}
+END_TEST
+
+// A model of a UART transmit FIFO, for the drainQueue() tests
+#define FIFO_SIZE 16
+uint8_t fifo[FIFO_SIZE];
+int fifoLength;
+int fifoWrites;
+
+int writeToFifo(const uint8_t* bytes, int length) {
+    ++fifoWrites;
+    int written = 0;
+    while(written < length && fifoLength < FIFO_SIZE) {
+        fifo[fifoLength++] = bytes[written++];
+    }
+    return written;
+}
+
+START_TEST (test_drain_fills_fifo)
+{
+    fifoLength = 0;
+    fifoWrites = 0;
+    startQueueAt(QUEUE_MAX_LENGTH(uint8_t) - 4);
+    pushString("abcdefghijklmnopqrstuvwxyz");
+
+    // The queue wraps after 5 bytes, but the FIFO is still filled in one go
+    ck_assert_int_eq(drainQueue(&queue, FIFO_SIZE, writeToFifo), FIFO_SIZE);
+    ck_assert_int_eq(fifoWrites, 2);
+    ck_assert_int_eq(fifoLength, FIFO_SIZE);
+    ck_assert_int_eq(fifo[0], 'a');
+    ck_assert_int_eq(fifo[FIFO_SIZE - 1], 'p');
+    ck_assert_int_eq(QUEUE_LENGTH(uint8_t, &queue), 10);
+    ck_assert_int_eq(QUEUE_PEEK(uint8_t, &queue), 'q');
+}
+END_TEST
+
+START_TEST (test_drain_partial_write)
+{
+    fifoLength = FIFO_SIZE - 3;
+    pushString("abcdef");
+    ck_assert_int_eq(drainQueue(&queue, FIFO_SIZE, writeToFifo), 3);
+    // The rest is left for later
+    ck_assert_int_eq(QUEUE_LENGTH(uint8_t, &queue), 3);
+    ck_assert_int_eq(QUEUE_PEEK(uint8_t, &queue), 'd');
+}
+END_TEST
+
+START_TEST (test_drain_empty)
+{
+    fifoLength = 0;
+    fifoWrites = 0;
+    ck_assert_int_eq(drainQueue(&queue, FIFO_SIZE, writeToFifo), 0);
+    ck_assert_int_eq(fifoWrites, 0);
+}
+END_TEST
+
+START_TEST (test_fifo_keeps_line_busy)
+{
+    // Run the UART one character time at a time: the shift register takes the
+    // next byte from the FIFO, and the transmit interrupt refills the FIFO
+    // each time it empties. The queue is kept topped up, as it would be while
+    // streaming vehicle data.
+    const int characterTimes = 20000;
+    fifoLength = 0;
+    int fifoStart = 0;
+    int interrupts = 0;
+    int idleTimes = 0;
+    uint8_t nextPushed = 0;
+    uint8_t nextSent = 0;
+    bool outOfOrder = false;
+
+    for(int i = 0; i < characterTimes; i++) {
+        while(QUEUE_AVAILABLE(uint8_t, &queue) > 0) {
+            QUEUE_PUSH(uint8_t, &queue, nextPushed++);
+        }
+
+        if(fifoStart < fifoLength) {
+            if(fifo[fifoStart++] != nextSent++) {
+                outOfOrder = true;
+            }
+        } else {
+            ++idleTimes;
+        }
+
+        if(fifoStart == fifoLength) {
+            ++interrupts;
+            fifoStart = 0;
+            fifoLength = 0;
+            drainQueue(&queue, FIFO_SIZE, writeToFifo);
+        }
+    }
+
+    fail_if(outOfOrder);
+    // Only the first character time, before the first interrupt
+    ck_assert_int_eq(idleTimes, 1);
+    // One interrupt per FIFO full, instead of one per byte
+    ck_assert_int_eq(interrupts, 1 + (characterTimes - 1) / FIFO_SIZE);
+}
+END_TEST
+
 Suite* buffersSuite(void) {
     Suite* s = suite_create("buffers");
     TCase *tc_core = tcase_create("core");
     tcase_add_checked_fixture (tc_core, setup, teardown);
     tcase_add_test(tc_core, test_empty_doesnt_call);
     tcase_add_test(tc_core, test_success_clears);
-    tcase_add_test(tc_core, test_failure_preserves);
-    tcase_add_test(tc_core, test_clear_corrupted);
-    tcase_add_test(tc_core, test_full_clears);
+    tcase_add_test(tc_core, test_failure_clears_message);
+    tcase_add_test(tc_core, test_partial_preserved);
+    tcase_add_test(tc_core, test_many_messages);
+    tcase_add_test(tc_core, test_newline_separator);
+    tcase_add_test(tc_core, test_wrapped_message);
+    tcase_add_test(tc_core, test_full_discards_until_separator);
     tcase_add_test(tc_core, test_missing_callback);
+    tcase_add_test(tc_core, test_binary_waits_for_record);
+    tcase_add_test(tc_core, test_binary_header_only);
+    tcase_add_test(tc_core, test_binary_unhandled_clears);
+    tcase_add_test(tc_core, test_binary_then_message);
     suite_add_tcase(s, tc_core);
 
+    TCase *tc_drain = tcase_create("drain");
+    tcase_add_checked_fixture (tc_drain, setup, teardown);
+    tcase_add_test(tc_drain, test_peek_contiguous);
+    tcase_add_test(tc_drain, test_peek_contiguous_wrapped);
+    tcase_add_test(tc_drain, test_peek_contiguous_after);
+    tcase_add_test(tc_drain, test_drain_fills_fifo);
+    tcase_add_test(tc_drain, test_drain_partial_write);
+    tcase_add_test(tc_drain, test_drain_empty);
+    tcase_add_test(tc_drain, test_fifo_keeps_line_busy);
+    suite_add_tcase(s, tc_drain);
+
     TCase *tc_conditional = tcase_create("conditional");
     tcase_add_checked_fixture (tc_conditional, setup, teardown);
     tcase_add_test(tc_conditional, test_null_queue);
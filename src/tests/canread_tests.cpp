@@ -59,6 +59,12 @@ void setup() {
         SIGNALS[i].sendSame = true;
         SIGNALS[i].sendFrequency = 1;
         SIGNALS[i].sendClock = 0;
+#ifdef __SIGNAL_STATISTICS__
+        SIGNALS[i].framesDecoded = 0;
+        SIGNALS[i].messagesSent = 0;
+        SIGNALS[i].messagesSuppressed = 0;
+        SIGNALS[i].bytesSerialized = 0;
+#endif // __SIGNAL_STATISTICS__
     }
 }
 
@@ -124,6 +130,13 @@ START_TEST (test_send_numerical)
 }
 END_TEST
 
+START_TEST (test_send_returns_length)
+{
+    ck_assert_int_eq(sendNumericalMessage("test", 42, &pipeline),
+            strlen("{\"name\":\"test\",\"value\":42}"));
+}
+END_TEST
+
 START_TEST (test_preserve_float_precision)
 {
     fail_unless(QUEUE_EMPTY(uint8_t, &pipeline.usb->sendQueue));
@@ -390,6 +403,35 @@ START_TEST (test_limited_frequency)
 }
 END_TEST
 
+#ifdef __SIGNAL_STATISTICS__
+START_TEST (test_signal_statistics)
+{
+    SIGNALS[0].sendFrequency = 2;
+    for(int i = 0; i < 4; i++) {
+        can::read::translateSignal(&pipeline, &SIGNALS[0],
+                BIG_ENDIAN_TEST_DATA, SIGNALS, SIGNAL_COUNT);
+    }
+
+    ck_assert_int_eq(SIGNALS[0].framesDecoded, 4);
+    ck_assert_int_eq(SIGNALS[0].messagesSent, 2);
+    ck_assert_int_eq(SIGNALS[0].messagesSuppressed, 2);
+    ck_assert_int_eq(SIGNALS[0].bytesSerialized,
+            QUEUE_LENGTH(uint8_t, &pipeline.usb->sendQueue) - 2 * 2);
+}
+END_TEST
+
+START_TEST (test_signal_statistics_handler_suppressed)
+{
+    can::read::translateSignal(&pipeline, &SIGNALS[0], BIG_ENDIAN_TEST_DATA,
+            ignoreHandler, SIGNALS, SIGNAL_COUNT);
+    ck_assert_int_eq(SIGNALS[0].framesDecoded, 1);
+    ck_assert_int_eq(SIGNALS[0].messagesSent, 0);
+    ck_assert_int_eq(SIGNALS[0].messagesSuppressed, 1);
+    ck_assert_int_eq(SIGNALS[0].bytesSerialized, 0);
+}
+END_TEST
+#endif // __SIGNAL_STATISTICS__
+
 float preserveHandler(CanSignal* signal, CanSignal* signals, int signalCount,
         float value, bool* send) {
     return signal->lastValue;
@@ -445,6 +487,7 @@ Suite* canreadSuite(void) {
     TCase *tc_sending = tcase_create("sending");
     tcase_add_checked_fixture(tc_sending, setup, NULL);
     tcase_add_test(tc_sending, test_send_numerical);
+    tcase_add_test(tc_sending, test_send_returns_length);
     tcase_add_test(tc_sending, test_preserve_float_precision);
     tcase_add_test(tc_sending, test_send_boolean);
     tcase_add_test(tc_sending, test_send_string);
@@ -468,6 +511,10 @@ Suite* canreadSuite(void) {
     tcase_add_test(tc_translate, test_translate_float_handler_called_every_time);
     tcase_add_test(tc_translate, test_translate_bool_handler_called_every_time);
     tcase_add_test(tc_translate, test_translate_str_handler_called_every_time);
+#ifdef __SIGNAL_STATISTICS__
+    tcase_add_test(tc_translate, test_signal_statistics);
+    tcase_add_test(tc_translate, test_signal_statistics_handler_suppressed);
+#endif // __SIGNAL_STATISTICS__
     suite_add_tcase(s, tc_translate);
 
     return s;
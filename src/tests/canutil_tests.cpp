@@ -3,12 +3,15 @@
 #include "can/canutil.h"
 #include "can/canread.h"
 #include "can/canwrite.h"
+#include "util/timer.h"
 #include "cJSON.h"
 
 namespace can = openxc::can;
+namespace time = openxc::util::time;
 
 using openxc::can::lookupSignal;
 using openxc::can::lookupSignalState;
+using openxc::can::BusActivity;
 
 CanMessage MESSAGES[3] = {
     {NULL, 0},
@@ -126,6 +129,95 @@ START_TEST (test_initialize)
 }
 END_TEST
 
+CanBus BUSES[2] = {
+    {500, 0x101},
+    {125, 0x102},
+};
+
+BusActivity activity;
+
+void setup() {
+    time::useVirtualClock(0);
+    for(int i = 0; i < 2; i++) {
+        can::initializeCommon(&BUSES[i]);
+    }
+    can::initializeBusActivity(&activity);
+}
+
+void receiveMessage(CanBus* bus) {
+    bus->lastMessageReceived = time::systemTimeMs();
+}
+
+START_TEST (test_bus_inactive_at_start)
+{
+    fail_if(can::busActive(&BUSES[0]));
+    time::advanceVirtualTimeUs(5000000);
+    fail_if(can::busActive(&BUSES[0]));
+}
+END_TEST
+
+START_TEST (test_bus_active_until_timeout)
+{
+    time::advanceVirtualTimeUs(1000000);
+    receiveMessage(&BUSES[0]);
+    fail_unless(can::busActive(&BUSES[0]));
+    fail_if(can::busActive(&BUSES[1]));
+
+    time::advanceVirtualTimeUs(can::CAN_ACTIVE_TIMEOUT_S * 1000000ULL - 1000);
+    fail_unless(can::busActive(&BUSES[0]));
+    time::advanceVirtualTimeUs(1000);
+    fail_if(can::busActive(&BUSES[0]));
+}
+END_TEST
+
+START_TEST (test_activity_awake_after_startup)
+{
+    time::advanceVirtualTimeUs(can::CAN_ACTIVE_TIMEOUT_S * 1000000ULL);
+    ck_assert_int_eq(can::updateBusActivity(&activity, BUSES, 2),
+            can::BUS_ACTIVITY_UNCHANGED);
+    time::advanceVirtualTimeUs(1000);
+    ck_assert_int_eq(can::updateBusActivity(&activity, BUSES, 2),
+            can::BUS_ACTIVITY_SILENT);
+    // and stays silent
+    ck_assert_int_eq(can::updateBusActivity(&activity, BUSES, 2),
+            can::BUS_ACTIVITY_SILENT);
+}
+END_TEST
+
+START_TEST (test_activity_wakes_once)
+{
+    time::advanceVirtualTimeUs(1000000);
+    receiveMessage(&BUSES[1]);
+    ck_assert_int_eq(can::updateBusActivity(&activity, BUSES, 2),
+            can::BUS_ACTIVITY_WOKE);
+    ck_assert_int_eq(can::updateBusActivity(&activity, BUSES, 2),
+            can::BUS_ACTIVITY_UNCHANGED);
+}
+END_TEST
+
+START_TEST (test_activity_silent_after_timeout)
+{
+    time::advanceVirtualTimeUs(1000000);
+    receiveMessage(&BUSES[0]);
+    can::updateBusActivity(&activity, BUSES, 2);
+
+    // the other bus keeps it awake
+    time::advanceVirtualTimeUs(20000000);
+    receiveMessage(&BUSES[1]);
+    time::advanceVirtualTimeUs(20000000);
+    ck_assert_int_eq(can::updateBusActivity(&activity, BUSES, 2),
+            can::BUS_ACTIVITY_UNCHANGED);
+
+    time::advanceVirtualTimeUs(10000000);
+    ck_assert_int_eq(can::updateBusActivity(&activity, BUSES, 2),
+            can::BUS_ACTIVITY_SILENT);
+
+    receiveMessage(&BUSES[0]);
+    ck_assert_int_eq(can::updateBusActivity(&activity, BUSES, 2),
+            can::BUS_ACTIVITY_WOKE);
+}
+END_TEST
+
 Suite* canutilSuite(void) {
     Suite* s = suite_create("canutil");
     TCase *tc_core = tcase_create("core");
@@ -139,6 +231,15 @@ Suite* canutilSuite(void) {
     tcase_add_test(tc_core, test_lookup_command);
     suite_add_tcase(s, tc_core);
 
+    TCase *tc_activity = tcase_create("activity");
+    tcase_add_checked_fixture(tc_activity, setup, NULL);
+    tcase_add_test(tc_activity, test_bus_inactive_at_start);
+    tcase_add_test(tc_activity, test_bus_active_until_timeout);
+    tcase_add_test(tc_activity, test_activity_awake_after_startup);
+    tcase_add_test(tc_activity, test_activity_wakes_once);
+    tcase_add_test(tc_activity, test_activity_silent_after_timeout);
+    suite_add_tcase(s, tc_activity);
+
     return s;
 }
 
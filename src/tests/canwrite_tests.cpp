@@ -48,7 +48,22 @@ void setup() {
         SIGNALS[i].sendFrequency = 1;
         SIGNALS[i].sendClock = 0;
     }
+    for(int i = 0; i < 3; i++) {
+        MESSAGES[i].data = 0;
+    }
     QUEUE_INIT(CanMessage, &bus.sendQueue);
+    bus.dirtyMessageCount = 0;
+    bus.framesCoalesced = 0;
+    memset(bus.rawWriteWhitelist, 0, sizeof(bus.rawWriteWhitelist));
+    bus.rawWriteExtendedIdCount = 0;
+    bus.rawWriteWhitelistCount = 0;
+    bus.rawWritesRejected = 0;
+    bus.writesDropped = 0;
+}
+
+CanMessage flushAndPop() {
+    can::write::flushDirtyMessages(&bus);
+    return QUEUE_POP(CanMessage, &bus.sendQueue);
 }
 
 START_TEST (test_number_writer)
@@ -158,7 +173,7 @@ START_TEST (test_send_with_null_writer)
 {
     fail_unless(can::write::sendSignal(&SIGNALS[0], cJSON_CreateNumber(0xa),
                 NULL, SIGNALS, SIGNAL_COUNT));
-    CanMessage queuedMessage = QUEUE_POP(CanMessage, &SIGNALS[0].message->bus->sendQueue);
+    CanMessage queuedMessage = flushAndPop();
     ck_assert_int_eq(queuedMessage.data, 0x1e);
 }
 END_TEST
@@ -167,7 +182,7 @@ START_TEST (test_send_using_default)
 {
     fail_unless(can::write::sendSignal(&SIGNALS[0], cJSON_CreateNumber(0xa), SIGNALS,
                 SIGNAL_COUNT));
-    CanMessage queuedMessage = QUEUE_POP(CanMessage, &SIGNALS[0].message->bus->sendQueue);
+    CanMessage queuedMessage = flushAndPop();
     ck_assert_int_eq(queuedMessage.data, 0x1e);
 }
 END_TEST
@@ -177,7 +192,7 @@ START_TEST (test_send_with_custom_with_states)
     fail_unless(can::write::sendSignal(&SIGNALS[1],
                 cJSON_CreateString(SIGNAL_STATES[0][1].name), SIGNALS,
                 SIGNAL_COUNT));
-    CanMessage queuedMessage = QUEUE_POP(CanMessage, &SIGNALS[1].message->bus->sendQueue);
+    CanMessage queuedMessage = flushAndPop();
     ck_assert_int_eq(queuedMessage.data, 0x20);
 }
 END_TEST
@@ -193,6 +208,7 @@ START_TEST (test_send_with_custom_says_no_send)
     fail_if(can::write::sendSignal(&SIGNALS[1],
                 cJSON_CreateString(SIGNAL_STATES[0][1].name), customStateWriter,
                 SIGNALS, SIGNAL_COUNT));
+    can::write::flushDirtyMessages(&bus);
     fail_unless(QUEUE_EMPTY(CanMessage, &SIGNALS[1].message->bus->sendQueue));
 }
 END_TEST
@@ -202,10 +218,133 @@ START_TEST (test_force_send)
     fail_if(can::write::sendSignal(&SIGNALS[1],
                 cJSON_CreateString(SIGNAL_STATES[0][1].name), customStateWriter,
                 SIGNALS, SIGNAL_COUNT, true));
+    can::write::flushDirtyMessages(&bus);
     ck_assert_int_eq(1, QUEUE_LENGTH(CanMessage, &SIGNALS[1].message->bus->sendQueue));
 }
 END_TEST
 
+START_TEST (test_send_waits_for_flush)
+{
+    fail_unless(can::write::sendSignal(&SIGNALS[0], cJSON_CreateNumber(0xa),
+                SIGNALS, SIGNAL_COUNT));
+    fail_unless(QUEUE_EMPTY(CanMessage, &bus.sendQueue));
+    ck_assert_int_eq(bus.dirtyMessageCount, 1);
+
+    can::write::flushDirtyMessages(&bus);
+    ck_assert_int_eq(QUEUE_LENGTH(CanMessage, &bus.sendQueue), 1);
+    ck_assert_int_eq(bus.dirtyMessageCount, 0);
+}
+END_TEST
+
+START_TEST (test_signals_in_same_message_combined)
+{
+    CanSignal brake = SIGNALS[2];
+    brake.message = &MESSAGES[0];
+    fail_unless(can::write::sendSignal(&SIGNALS[0], cJSON_CreateNumber(0xa),
+                SIGNALS, SIGNAL_COUNT));
+    fail_unless(can::write::sendSignal(&brake, cJSON_CreateBool(true),
+                can::write::booleanWriter, SIGNALS, SIGNAL_COUNT));
+
+    CanMessage queuedMessage = flushAndPop();
+    ck_assert_int_eq(queuedMessage.data, 0x9e);
+    fail_unless(QUEUE_EMPTY(CanMessage, &bus.sendQueue));
+    ck_assert_int_eq(bus.framesCoalesced, 1);
+}
+END_TEST
+
+START_TEST (test_rewrite_keeps_last_value)
+{
+    fail_unless(can::write::sendSignal(&SIGNALS[1],
+                cJSON_CreateString(SIGNAL_STATES[0][1].name), SIGNALS,
+                SIGNAL_COUNT));
+    fail_unless(can::write::sendSignal(&SIGNALS[1],
+                cJSON_CreateString(SIGNAL_STATES[0][4].name), SIGNALS,
+                SIGNAL_COUNT));
+
+    CanMessage queuedMessage = flushAndPop();
+    ck_assert_int_eq(queuedMessage.data, 0x50);
+    fail_unless(QUEUE_EMPTY(CanMessage, &bus.sendQueue));
+}
+END_TEST
+
+START_TEST (test_shadow_kept_after_flush)
+{
+    CanSignal brake = SIGNALS[2];
+    brake.message = &MESSAGES[0];
+    can::write::sendSignal(&SIGNALS[0], cJSON_CreateNumber(0xa), SIGNALS,
+            SIGNAL_COUNT);
+    flushAndPop();
+
+    can::write::sendSignal(&brake, cJSON_CreateBool(true),
+            can::write::booleanWriter, SIGNALS, SIGNAL_COUNT);
+    CanMessage queuedMessage = flushAndPop();
+    ck_assert_int_eq(queuedMessage.data, 0x9e);
+}
+END_TEST
+
+uint64_t flagWriter(CanSignal* signal, CanSignal* signals, int signalCount,
+        cJSON* value, bool* send) {
+    uint64_t data = can::write::encodeSignal(signal, 0xa);
+    if(value->type == cJSON_True) {
+        data |= 0x1;
+    }
+    return data;
+}
+
+START_TEST (test_custom_writer_clears_bits)
+{
+    fail_unless(can::write::sendSignal(&SIGNALS[0], cJSON_CreateBool(true),
+                flagWriter, SIGNALS, SIGNAL_COUNT));
+    CanMessage queuedMessage = flushAndPop();
+    ck_assert_int_eq(queuedMessage.data, 0x010000000000001eLLU);
+
+    fail_unless(can::write::sendSignal(&SIGNALS[0], cJSON_CreateBool(false),
+                flagWriter, SIGNALS, SIGNAL_COUNT));
+    queuedMessage = flushAndPop();
+    ck_assert_int_eq(queuedMessage.data, 0x1e);
+}
+END_TEST
+
+START_TEST (test_flush_full_queue_stays_dirty)
+{
+    CanMessage message = {&bus, 42};
+    while(!QUEUE_FULL(CanMessage, &bus.sendQueue)) {
+        can::write::enqueueMessage(&message, 0);
+    }
+    can::write::sendSignal(&SIGNALS[0], cJSON_CreateNumber(0xa), SIGNALS,
+            SIGNAL_COUNT);
+    can::write::flushDirtyMessages(&bus);
+    ck_assert_int_eq(bus.dirtyMessageCount, 1);
+
+    QUEUE_INIT(CanMessage, &bus.sendQueue);
+    CanMessage queuedMessage = flushAndPop();
+    ck_assert_int_eq(queuedMessage.id, 0);
+    ck_assert_int_eq(bus.dirtyMessageCount, 0);
+}
+END_TEST
+
+START_TEST (test_too_many_dirty_messages)
+{
+    CanMessage messages[MAX_DIRTY_MESSAGES + 1];
+    CanSignal signal = SIGNALS[2];
+    for(int i = 0; i < MAX_DIRTY_MESSAGES + 1; i++) {
+        messages[i].bus = &bus;
+        messages[i].id = 0x100 + i;
+        messages[i].data = 0;
+        signal.message = &messages[i];
+        fail_unless(can::write::sendSignal(&signal, cJSON_CreateBool(true),
+                    can::write::booleanWriter, SIGNALS, SIGNAL_COUNT));
+    }
+
+    // The one that didn't fit is sent right away
+    ck_assert_int_eq(bus.dirtyMessageCount, MAX_DIRTY_MESSAGES);
+    ck_assert_int_eq(QUEUE_LENGTH(CanMessage, &bus.sendQueue), 1);
+    can::write::flushDirtyMessages(&bus);
+    ck_assert_int_eq(QUEUE_LENGTH(CanMessage, &bus.sendQueue),
+            MAX_DIRTY_MESSAGES + 1);
+}
+END_TEST
+
 START_TEST (test_write_empty)
 {
     can::write::processWriteQueue(&bus);
@@ -251,6 +390,178 @@ START_TEST (test_write_multiples)
 }
 END_TEST
 
+START_TEST (test_raw_write_without_whitelist)
+{
+    fail_unless(can::write::enqueueRawWrite(&bus, 0x123, 0x1234));
+    fail_unless(can::write::enqueueRawWrite(&bus, 0x12345678, 0x1234));
+    ck_assert_int_eq(QUEUE_LENGTH(CanMessage, &bus.sendQueue), 2);
+}
+END_TEST
+
+START_TEST (test_raw_write_whitelist)
+{
+    fail_unless(can::write::allowRawWrite(&bus, 0x42));
+    fail_unless(can::write::allowRawWrite(&bus, 0x42));
+    ck_assert_int_eq(bus.rawWriteWhitelistCount, 1);
+
+    fail_unless(can::write::enqueueRawWrite(&bus, 0x42, 0x1234));
+    fail_if(can::write::enqueueRawWrite(&bus, 0x43, 0x1234));
+    fail_if(can::write::enqueueRawWrite(&bus, 0x10042, 0x1234));
+    ck_assert_int_eq(QUEUE_LENGTH(CanMessage, &bus.sendQueue), 1);
+    ck_assert_int_eq(bus.rawWritesRejected, 2);
+}
+END_TEST
+
+START_TEST (test_whitelist_extended_ids)
+{
+    fail_unless(can::write::allowRawWrite(&bus, CAN_STANDARD_ID_COUNT - 1));
+    fail_unless(can::write::allowRawWrite(&bus, 0x12345678));
+    fail_unless(can::write::allowRawWrite(&bus, 0x12345678));
+    fail_if(can::write::allowRawWrite(&bus, CAN_MAX_EXTENDED_ID + 1));
+    ck_assert_int_eq(bus.rawWriteWhitelistCount, 2);
+
+    fail_unless(can::write::rawWriteAllowed(&bus, CAN_STANDARD_ID_COUNT - 1));
+    fail_unless(can::write::rawWriteAllowed(&bus, 0x12345678));
+    fail_if(can::write::rawWriteAllowed(&bus, 0x12345679));
+    fail_unless(can::write::enqueueRawWrite(&bus, 0x12345678, 0x1234));
+}
+END_TEST
+
+START_TEST (test_whitelist_extended_ids_full)
+{
+    for(int i = 0; i < MAX_RAW_WRITE_EXTENDED_IDS; i++) {
+        fail_unless(can::write::allowRawWrite(&bus,
+                    CAN_STANDARD_ID_COUNT + i));
+    }
+    fail_if(can::write::allowRawWrite(&bus,
+                CAN_STANDARD_ID_COUNT + MAX_RAW_WRITE_EXTENDED_IDS));
+    ck_assert_int_eq(bus.rawWriteWhitelistCount, MAX_RAW_WRITE_EXTENDED_IDS);
+}
+END_TEST
+
+START_TEST (test_whitelist_writable_signals)
+{
+    SIGNALS[1].writable = false;
+    can::write::allowRawWritesForSignals(SIGNALS, 3);
+    ck_assert_int_eq(bus.rawWriteWhitelistCount, 2);
+    fail_unless(can::write::rawWriteAllowed(&bus, MESSAGES[0].id));
+    fail_if(can::write::rawWriteAllowed(&bus, MESSAGES[1].id));
+    fail_unless(can::write::rawWriteAllowed(&bus, MESSAGES[2].id));
+}
+END_TEST
+
+START_TEST (test_raw_write_record)
+{
+    uint8_t record[RAW_WRITE_RECORD_SIZE] = {RAW_WRITE_RECORD_TYPE, 1,
+        0, 0, 0x1, 0x23, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0x8};
+    fail_unless(can::write::sendRawWriteRecord(record, sizeof(record), &bus,
+                1));
+
+    CanMessage message = QUEUE_POP(CanMessage, &bus.sendQueue);
+    ck_assert_int_eq(message.id, 0x123);
+    uint8_t* data = (uint8_t*)&message.data;
+    for(int i = 0; i < 8; i++) {
+        ck_assert_int_eq(data[i], i + 1);
+    }
+}
+END_TEST
+
+START_TEST (test_raw_write_record_malformed)
+{
+    uint8_t record[RAW_WRITE_RECORD_SIZE] = {RAW_WRITE_RECORD_TYPE, 2,
+        0, 0, 0x1, 0x23};
+    // No bus 2
+    fail_if(can::write::sendRawWriteRecord(record, sizeof(record), &bus, 1));
+    record[1] = 0;
+    fail_if(can::write::sendRawWriteRecord(record, sizeof(record), &bus, 1));
+    record[1] = 1;
+    fail_if(can::write::sendRawWriteRecord(record, sizeof(record) - 1, &bus,
+                1));
+    record[0] = RAW_WRITE_RECORD_TYPE + 1;
+    fail_if(can::write::sendRawWriteRecord(record, sizeof(record), &bus, 1));
+    fail_unless(QUEUE_EMPTY(CanMessage, &bus.sendQueue));
+}
+END_TEST
+
+START_TEST (test_raw_write_record_whitelist)
+{
+    can::write::allowRawWrite(&bus, 0x42);
+    uint8_t record[RAW_WRITE_RECORD_SIZE] = {RAW_WRITE_RECORD_TYPE, 1,
+        0, 0, 0x1, 0x23};
+    fail_if(can::write::sendRawWriteRecord(record, sizeof(record), &bus, 1));
+    ck_assert_int_eq(bus.rawWritesRejected, 1);
+}
+END_TEST
+
+START_TEST (test_raw_write_full_queue)
+{
+    while(!QUEUE_FULL(CanMessage, &bus.sendQueue)) {
+        fail_unless(can::write::enqueueRawWrite(&bus, 0x42, 0));
+    }
+    fail_if(can::write::enqueueRawWrite(&bus, 0x42, 0));
+    ck_assert_int_eq(bus.writesDropped, 1);
+
+    uint8_t record[RAW_WRITE_RECORD_SIZE] = {RAW_WRITE_RECORD_TYPE, 1,
+        0, 0, 0, 0x42};
+    fail_if(can::write::sendRawWriteRecord(record, sizeof(record), &bus, 1));
+    ck_assert_int_eq(bus.writesDropped, 2);
+    ck_assert_int_eq(bus.rawWritesRejected, 0);
+}
+END_TEST
+
+START_TEST (test_write_record_size)
+{
+    uint8_t raw[RAW_WRITE_RECORD_SIZE + 1] = {RAW_WRITE_RECORD_TYPE};
+    ck_assert_int_eq(can::write::writeRecordSize(raw, sizeof(raw)),
+            RAW_WRITE_RECORD_SIZE);
+    ck_assert_int_eq(can::write::writeRecordSize(raw,
+                RAW_WRITE_RECORD_SIZE - 1), 0);
+
+    uint8_t named[] = {NAMED_WRITE_RECORD_TYPE, 3, 'f', 'o', 'o',
+        0x3f, 0xc0, 0, 0};
+    ck_assert_int_eq(can::write::writeRecordSize(named, sizeof(named)), 9);
+    ck_assert_int_eq(can::write::writeRecordSize(named, sizeof(named) - 1), 0);
+
+    uint8_t unknown[] = {0x7f, 0, 0, 0};
+    ck_assert_int_eq(can::write::writeRecordSize(unknown, sizeof(unknown)), 0);
+}
+END_TEST
+
+START_TEST (test_decode_named_write_record)
+{
+    uint8_t record[] = {NAMED_WRITE_RECORD_TYPE, 3, 'f', 'o', 'o',
+        0x3f, 0xc0, 0, 0};
+    char name[8];
+    float value = 0;
+    fail_unless(can::write::decodeNamedWriteRecord(record, sizeof(record),
+                name, sizeof(name), &value));
+    ck_assert_str_eq(name, "foo");
+    ck_assert(value == 1.5);
+}
+END_TEST
+
+START_TEST (test_decode_named_write_record_malformed)
+{
+    char name[4];
+    float value;
+    uint8_t empty[] = {NAMED_WRITE_RECORD_TYPE, 0, 0x3f, 0xc0, 0, 0};
+    fail_if(can::write::decodeNamedWriteRecord(empty, sizeof(empty),
+                name, sizeof(name), &value));
+
+    // No room for the NULL character
+    uint8_t tooLong[] = {NAMED_WRITE_RECORD_TYPE, 4, 'a', 'b', 'c', 'd',
+        0x3f, 0xc0, 0, 0};
+    fail_if(can::write::decodeNamedWriteRecord(tooLong, sizeof(tooLong),
+                name, sizeof(name), &value));
+
+    // Trailing bytes that aren't part of the record
+    uint8_t trailing[] = {NAMED_WRITE_RECORD_TYPE, 1, 'a', 0x3f, 0xc0, 0, 0,
+        0};
+    fail_if(can::write::decodeNamedWriteRecord(trailing, sizeof(trailing),
+                name, sizeof(name), &value));
+}
+END_TEST
+
 Suite* canwriteSuite(void) {
     Suite* s = suite_create("canwrite");
     TCase *tc_core = tcase_create("core");
@@ -274,8 +585,31 @@ Suite* canwriteSuite(void) {
     tcase_add_test(tc_enqueue, test_send_with_custom_with_states);
     tcase_add_test(tc_enqueue, test_send_with_custom_says_no_send);
     tcase_add_test(tc_enqueue, test_force_send);
+    tcase_add_test(tc_enqueue, test_send_waits_for_flush);
+    tcase_add_test(tc_enqueue, test_signals_in_same_message_combined);
+    tcase_add_test(tc_enqueue, test_rewrite_keeps_last_value);
+    tcase_add_test(tc_enqueue, test_shadow_kept_after_flush);
+    tcase_add_test(tc_enqueue, test_custom_writer_clears_bits);
+    tcase_add_test(tc_enqueue, test_flush_full_queue_stays_dirty);
+    tcase_add_test(tc_enqueue, test_too_many_dirty_messages);
     suite_add_tcase(s, tc_enqueue);
 
+    TCase *tc_raw = tcase_create("raw");
+    tcase_add_checked_fixture(tc_raw, setup, NULL);
+    tcase_add_test(tc_raw, test_raw_write_without_whitelist);
+    tcase_add_test(tc_raw, test_raw_write_whitelist);
+    tcase_add_test(tc_raw, test_whitelist_extended_ids);
+    tcase_add_test(tc_raw, test_whitelist_extended_ids_full);
+    tcase_add_test(tc_raw, test_whitelist_writable_signals);
+    tcase_add_test(tc_raw, test_raw_write_record);
+    tcase_add_test(tc_raw, test_raw_write_record_malformed);
+    tcase_add_test(tc_raw, test_raw_write_record_whitelist);
+    tcase_add_test(tc_raw, test_raw_write_full_queue);
+    tcase_add_test(tc_raw, test_write_record_size);
+    tcase_add_test(tc_raw, test_decode_named_write_record);
+    tcase_add_test(tc_raw, test_decode_named_write_record_malformed);
+    suite_add_tcase(s, tc_raw);
+
     TCase *tc_write = tcase_create("write");
     tcase_add_checked_fixture(tc_write, setup, NULL);
     tcase_add_test(tc_write, test_write_empty);
@@ -0,0 +1,234 @@
+#include <check.h>
+#include <stdint.h>
+#include "can/emulator.h"
+#include "can/canread.h"
+
+namespace emulator = openxc::can::emulator;
+namespace can = openxc::can;
+
+using openxc::can::emulator::FrameEmulator;
+
+const char* TEST_TRACE =
+    "(1.000000) can0 029#0102030405060708\n"
+    "not a frame\n"
+    "(1.010000) can1 065#ff\n"
+    "{\"bus\": 2, \"id\": 82, \"data\": \"0x12\"}";
+
+CanBus BUSES[2] = {
+    {500000, 1},
+    {125000, 2},
+};
+
+CanMessage MESSAGES[2] = {
+    {&BUSES[0], 0x29},
+    {&BUSES[1], 0x52},
+};
+
+CanSignalState SIGNAL_STATES[1][3] = {
+    { {1, "first"}, {2, "second"}, {3, "third"}, },
+};
+
+const int SIGNAL_COUNT = 2;
+CanSignal SIGNALS[SIGNAL_COUNT] = {
+    {&MESSAGES[0], "steering_wheel_angle", 16, 16, 1.2, -1000, -400, 400},
+    {&MESSAGES[1], "transmission_gear_position", 12, 4, 1.0, 0.0, 0.0, 15.0,
+        0, false, false, SIGNAL_STATES[0], 3},
+};
+
+FrameEmulator frameEmulator;
+
+void setup() {
+    for(int i = 0; i < 2; i++) {
+        QUEUE_INIT(CanMessage, &BUSES[i].receiveQueue);
+        BUSES[i].messagesDropped = 0;
+    }
+    emulator::initialize(&frameEmulator, emulator::EMULATOR_SYNTHETIC, 1000,
+            NULL);
+}
+
+int update(unsigned long nowUs) {
+    return emulator::update(&frameEmulator, BUSES, 2, SIGNALS, SIGNAL_COUNT,
+            nowUs);
+}
+
+int queued() {
+    return QUEUE_LENGTH(CanMessage, &BUSES[0].receiveQueue) +
+        QUEUE_LENGTH(CanMessage, &BUSES[1].receiveQueue);
+}
+
+START_TEST (test_first_update_starts_clock)
+{
+    ck_assert_int_eq(update(123456), 0);
+    ck_assert_int_eq(queued(), 0);
+}
+END_TEST
+
+START_TEST (test_generates_at_rate)
+{
+    update(1000);
+    ck_assert_int_eq(update(6000), 5);
+    ck_assert_int_eq(queued(), 5);
+    ck_assert_int_eq(frameEmulator.framesGenerated, 5);
+}
+END_TEST
+
+START_TEST (test_partial_frames_carry_over)
+{
+    update(0);
+    ck_assert_int_eq(update(500), 0);
+    ck_assert_int_eq(update(1000), 1);
+    ck_assert_int_eq(update(1250), 0);
+    ck_assert_int_eq(update(2000), 1);
+}
+END_TEST
+
+START_TEST (test_system_time_wraps)
+{
+    update((unsigned long) -1000);
+    ck_assert_int_eq(update(2000), 3);
+}
+END_TEST
+
+START_TEST (test_burst_limited)
+{
+    update(0);
+    update(10000000);
+    ck_assert_int_eq(frameEmulator.framesGenerated +
+            frameEmulator.framesDropped, EMULATOR_MAX_BURST_FRAMES);
+}
+END_TEST
+
+START_TEST (test_full_queue_drops)
+{
+    emulator::initialize(&frameEmulator, emulator::EMULATOR_TRACE, 1000,
+            "(1.000000) can0 029#01\n");
+    CanMessage message = {&BUSES[0], 0x29};
+    while(!QUEUE_FULL(CanMessage, &BUSES[0].receiveQueue)) {
+        QUEUE_PUSH(CanMessage, &BUSES[0].receiveQueue, message);
+    }
+    update(0);
+    ck_assert_int_eq(update(2000), 0);
+    ck_assert_int_eq(frameEmulator.framesDropped, 2);
+    ck_assert_int_eq(BUSES[0].messagesDropped, 2);
+}
+END_TEST
+
+START_TEST (test_stopped)
+{
+    openxc::util::tokenbucket::setRate(&frameEmulator.pacing, 0);
+    update(0);
+    ck_assert_int_eq(update(1000000), 0);
+}
+END_TEST
+
+START_TEST (test_synthetic_frames_match_signals)
+{
+    CanMessage frame;
+    for(int i = 0; i < 100; i++) {
+        fail_unless(emulator::nextFrame(&frameEmulator, BUSES, 2, SIGNALS,
+                    SIGNAL_COUNT, &frame));
+        if(frame.id == 0x52) {
+            ck_assert(frame.bus == &BUSES[1]);
+            int value = can::read::decodeSignal(&SIGNALS[1], frame.data);
+            fail_if(can::lookupSignalState(value, &SIGNALS[1], SIGNALS,
+                        SIGNAL_COUNT) == NULL);
+        } else {
+            ck_assert_int_eq(frame.id, 0x29);
+            ck_assert(frame.bus == &BUSES[0]);
+        }
+    }
+}
+END_TEST
+
+START_TEST (test_synthetic_no_signals)
+{
+    CanMessage frame;
+    fail_if(emulator::nextFrame(&frameEmulator, BUSES, 2, SIGNALS, 0,
+                &frame));
+}
+END_TEST
+
+START_TEST (test_trace_frames_in_order)
+{
+    emulator::initialize(&frameEmulator, emulator::EMULATOR_TRACE, 1000,
+            TEST_TRACE);
+    CanMessage frame;
+    fail_unless(emulator::nextFrame(&frameEmulator, BUSES, 2, SIGNALS,
+                SIGNAL_COUNT, &frame));
+    ck_assert_int_eq(frame.id, 0x29);
+    ck_assert(frame.bus == &BUSES[0]);
+    ck_assert(frame.data == 0x0807060504030201LL);
+
+    // the invalid line is skipped, and can1 is the second bus
+    fail_unless(emulator::nextFrame(&frameEmulator, BUSES, 2, SIGNALS,
+                SIGNAL_COUNT, &frame));
+    ck_assert_int_eq(frame.id, 0x65);
+    ck_assert(frame.bus == &BUSES[1]);
+
+    fail_unless(emulator::nextFrame(&frameEmulator, BUSES, 2, SIGNALS,
+                SIGNAL_COUNT, &frame));
+    ck_assert_int_eq(frame.id, 0x52);
+    ck_assert(frame.bus == &BUSES[1]);
+
+    // and then starts again
+    fail_unless(emulator::nextFrame(&frameEmulator, BUSES, 2, SIGNALS,
+                SIGNAL_COUNT, &frame));
+    ck_assert_int_eq(frame.id, 0x29);
+}
+END_TEST
+
+START_TEST (test_trace_without_frames)
+{
+    emulator::initialize(&frameEmulator, emulator::EMULATOR_TRACE, 1000,
+            "not a frame\n\n");
+    CanMessage frame;
+    fail_if(emulator::nextFrame(&frameEmulator, BUSES, 2, SIGNALS,
+                SIGNAL_COUNT, &frame));
+    update(0);
+    ck_assert_int_eq(update(5000), 0);
+}
+END_TEST
+
+START_TEST (test_discard_write)
+{
+    CanMessage message = {&BUSES[0], 0x29};
+    fail_unless(emulator::discardWrite(&BUSES[0], message));
+}
+END_TEST
+
+Suite* emulatorSuite(void) {
+    Suite* s = suite_create("emulator");
+    TCase *tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, NULL);
+    tcase_add_test(tc_core, test_first_update_starts_clock);
+    tcase_add_test(tc_core, test_generates_at_rate);
+    tcase_add_test(tc_core, test_partial_frames_carry_over);
+    tcase_add_test(tc_core, test_system_time_wraps);
+    tcase_add_test(tc_core, test_burst_limited);
+    tcase_add_test(tc_core, test_full_queue_drops);
+    tcase_add_test(tc_core, test_stopped);
+    tcase_add_test(tc_core, test_discard_write);
+    suite_add_tcase(s, tc_core);
+
+    TCase *tc_sources = tcase_create("sources");
+    tcase_add_checked_fixture(tc_sources, setup, NULL);
+    tcase_add_test(tc_sources, test_synthetic_frames_match_signals);
+    tcase_add_test(tc_sources, test_synthetic_no_signals);
+    tcase_add_test(tc_sources, test_trace_frames_in_order);
+    tcase_add_test(tc_sources, test_trace_without_frames);
+    suite_add_tcase(s, tc_sources);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = emulatorSuite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
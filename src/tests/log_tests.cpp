@@ -0,0 +1,79 @@
+#include <check.h>
+#include <stdint.h>
+#include "util/log.h"
+
+namespace log = openxc::util::log;
+
+void setup() {
+    log::flush();
+}
+
+START_TEST (test_defer_queues_message)
+{
+    ck_assert_int_eq(log::deferredMessagesPending(), 0);
+    log::deferDebug("No arguments");
+    log::deferDebug("One argument: %d", 1);
+    log::deferDebug("Four arguments: %d %d %d %d", 1, 2, 3, 4);
+    ck_assert_int_eq(log::deferredMessagesPending(), 3);
+}
+END_TEST
+
+START_TEST (test_flush_empties_ring)
+{
+    log::deferDebug("One argument: %d", 1);
+    log::flush();
+    ck_assert_int_eq(log::deferredMessagesPending(), 0);
+}
+END_TEST
+
+START_TEST (test_full_ring_counts_drops)
+{
+    unsigned int droppedBefore = log::deferredMessagesDropped();
+    for(int i = 0; i < DEFERRED_LOG_RING_SIZE + 2; i++) {
+        log::deferDebug("Message %d", i);
+    }
+    ck_assert_int_eq(log::deferredMessagesPending(), DEFERRED_LOG_RING_SIZE);
+    ck_assert_int_eq(log::deferredMessagesDropped() - droppedBefore, 2);
+
+    log::flush();
+    ck_assert_int_eq(log::deferredMessagesPending(), 0);
+    log::deferDebug("Message after flush");
+    ck_assert_int_eq(log::deferredMessagesPending(), 1);
+    ck_assert_int_eq(log::deferredMessagesDropped() - droppedBefore, 2);
+}
+END_TEST
+
+START_TEST (test_ring_wraps)
+{
+    for(int i = 0; i < DEFERRED_LOG_RING_SIZE * 3; i++) {
+        log::deferDebug("Message %d", i);
+        log::flush();
+    }
+    ck_assert_int_eq(log::deferredMessagesPending(), 0);
+}
+END_TEST
+
+Suite* logSuite(void) {
+    Suite* s = suite_create("log");
+    TCase *tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, NULL);
+    tcase_add_test(tc_core, test_defer_queues_message);
+    tcase_add_test(tc_core, test_flush_empties_ring);
+    tcase_add_test(tc_core, test_full_ring_counts_drops);
+    tcase_add_test(tc_core, test_ring_wraps);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = logSuite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
@@ -0,0 +1,267 @@
+#include <check.h>
+#include <stdint.h>
+#include "can/loopback.h"
+#include "can/canwrite.h"
+#include "util/timer.h"
+
+namespace loopback = openxc::can::loopback;
+namespace time = openxc::util::time;
+
+using openxc::can::loopback::LOOPBACK;
+
+CanBus BUSES[2] = {
+    {500000, 1},
+    {125000, 2},
+};
+
+void setup() {
+    time::useVirtualClock(0);
+    for(int i = 0; i < 2; i++) {
+        openxc::can::initializeCommon(&BUSES[i]);
+        BUSES[i].messagesDropped = 0;
+    }
+    loopback::initialize(false);
+    loopback::attach(&BUSES[0], &BUSES[0]);
+}
+
+/* Private: Write a frame to the first bus, the same as processWriteQueue(). */
+bool writeFrame(uint32_t id, uint64_t data) {
+    CanMessage message = {&BUSES[0], id, data};
+    return BUSES[0].writeHandler(&BUSES[0], message);
+}
+
+/* Private: Pop and record a frame from the bus's receive queue, the same as
+ * receiveCan().
+ */
+bool receiveFrame(CanBus* bus) {
+    CanMessage message = QUEUE_POP(CanMessage, &bus->receiveQueue);
+    return loopback::recordReceive(bus, &message, time::systemTimeUs());
+}
+
+START_TEST (test_attach_replaces_write_handler)
+{
+    ck_assert(BUSES[0].writeHandler == loopback::write);
+    ck_assert(BUSES[1].writeHandler == openxc::can::write::sendMessage);
+}
+END_TEST
+
+START_TEST (test_echo_without_delay)
+{
+    fail_unless(writeFrame(0x42, 0x1234));
+    ck_assert_int_eq(loopback::update(time::systemTimeUs()), 1);
+    CanMessage message = QUEUE_POP(CanMessage, &BUSES[0].receiveQueue);
+    ck_assert_int_eq(message.id, 0x42);
+    ck_assert(message.data == 0x1234);
+    ck_assert(message.bus == &BUSES[0]);
+}
+END_TEST
+
+START_TEST (test_echo_waits_for_delay)
+{
+    loopback::configure(500, 0);
+    writeFrame(0x42, 0x1234);
+    fail_unless(loopback::framesWaiting());
+    time::advanceVirtualTimeUs(499);
+    ck_assert_int_eq(loopback::update(time::systemTimeUs()), 0);
+    time::advanceVirtualTimeUs(1);
+    ck_assert_int_eq(loopback::update(time::systemTimeUs()), 1);
+    fail_if(loopback::framesWaiting());
+}
+END_TEST
+
+START_TEST (test_echo_to_other_bus)
+{
+    loopback::setTarget(&BUSES[1]);
+    writeFrame(0x42, 0x1234);
+    loopback::update(time::systemTimeUs());
+    fail_unless(QUEUE_EMPTY(CanMessage, &BUSES[0].receiveQueue));
+    ck_assert_int_eq(QUEUE_LENGTH(CanMessage, &BUSES[1].receiveQueue), 1);
+    fail_unless(receiveFrame(&BUSES[1]));
+}
+END_TEST
+
+START_TEST (test_latency)
+{
+    loopback::configure(300, 0);
+    loopback::recordRequest(time::systemTimeUs());
+    time::advanceVirtualTimeUs(100);
+    writeFrame(0x42, 0x1234);
+    time::advanceVirtualTimeUs(300);
+    loopback::update(time::systemTimeUs());
+    time::advanceVirtualTimeUs(50);
+    fail_unless(receiveFrame(&BUSES[0]));
+
+    ck_assert_int_eq(LOOPBACK.framesEchoed, 1);
+    ck_assert_int_eq(LOOPBACK.writeLatency.count, 1);
+    ck_assert_int_eq(LOOPBACK.writeLatency.maximum, 350);
+    ck_assert_int_eq(LOOPBACK.requestLatency.maximum, 450);
+    ck_assert_int_eq(LOOPBACK.frameCount, 0);
+}
+END_TEST
+
+START_TEST (test_other_frames_ignored)
+{
+    writeFrame(0x42, 0x1234);
+    CanMessage other = {&BUSES[0], 0x99, 0};
+    QUEUE_PUSH(CanMessage, &BUSES[0].receiveQueue, other);
+    loopback::update(time::systemTimeUs());
+
+    fail_if(receiveFrame(&BUSES[0]));
+    fail_unless(receiveFrame(&BUSES[0]));
+    ck_assert_int_eq(LOOPBACK.framesEchoed, 1);
+}
+END_TEST
+
+START_TEST (test_all_lost)
+{
+    loopback::configure(0, 100);
+    for(int i = 0; i < 10; i++) {
+        fail_unless(writeFrame(0x42, i));
+    }
+    ck_assert_int_eq(loopback::update(time::systemTimeUs()), 0);
+    ck_assert_int_eq(LOOPBACK.framesWritten, 10);
+    ck_assert_int_eq(LOOPBACK.framesLost, 10);
+}
+END_TEST
+
+START_TEST (test_some_lost)
+{
+    loopback::configure(0, 50);
+    for(int i = 0; i < 200; i++) {
+        writeFrame(0x42, i);
+        loopback::update(time::systemTimeUs());
+        if(!QUEUE_EMPTY(CanMessage, &BUSES[0].receiveQueue)) {
+            receiveFrame(&BUSES[0]);
+        }
+    }
+    ck_assert_int_eq(LOOPBACK.framesLost + LOOPBACK.framesEchoed, 200);
+    fail_unless(LOOPBACK.framesLost > 50 && LOOPBACK.framesLost < 150);
+}
+END_TEST
+
+START_TEST (test_full_receive_queue_drops)
+{
+    while(!QUEUE_FULL(CanMessage, &BUSES[0].receiveQueue)) {
+        CanMessage message = {&BUSES[0], 0x99};
+        QUEUE_PUSH(CanMessage, &BUSES[0].receiveQueue, message);
+    }
+    writeFrame(0x42, 0x1234);
+    ck_assert_int_eq(loopback::update(time::systemTimeUs()), 0);
+    ck_assert_int_eq(LOOPBACK.framesDropped, 1);
+    ck_assert_int_eq(BUSES[0].messagesDropped, 1);
+    ck_assert_int_eq(LOOPBACK.frameCount, 0);
+}
+END_TEST
+
+START_TEST (test_too_many_in_flight)
+{
+    loopback::configure(1000, 0);
+    for(int i = 0; i < LOOPBACK_MAX_FRAMES; i++) {
+        fail_unless(writeFrame(0x42, i));
+    }
+    fail_if(writeFrame(0x42, 0));
+    ck_assert_int_eq(LOOPBACK.framesDropped, 1);
+}
+END_TEST
+
+START_TEST (test_self_test)
+{
+    loopback::initialize(true);
+    loopback::attach(&BUSES[0], &BUSES[1]);
+    loopback::configure(1000, 100);
+    fail_unless(writeFrame(0x42, 0x1234));
+    ck_assert_int_eq(LOOPBACK.framesLost, 0);
+    // the controller delivers the frame itself
+    ck_assert_int_eq(loopback::update(time::systemTimeUs()), 0);
+    fail_if(loopback::framesWaiting());
+
+    CanMessage message = {&BUSES[0], 0x42, 0x1234};
+    time::advanceVirtualTimeUs(200);
+    fail_unless(loopback::recordReceive(&BUSES[0], &message,
+                time::systemTimeUs()));
+    ck_assert_int_eq(LOOPBACK.writeLatency.maximum, 200);
+}
+END_TEST
+
+START_TEST (test_lost_echo_skipped)
+{
+    loopback::initialize(true);
+    loopback::attach(&BUSES[0], &BUSES[0]);
+    for(int i = 0; i < 3; i++) {
+        fail_unless(writeFrame(0x42, i));
+    }
+
+    // The receive interrupt dropped the first echo, but the later ones still
+    // match
+    CanMessage message = {&BUSES[0], 0x42, 1};
+    fail_unless(loopback::recordReceive(&BUSES[0], &message,
+                time::systemTimeUs()));
+    message.data = 2;
+    fail_unless(loopback::recordReceive(&BUSES[0], &message,
+                time::systemTimeUs()));
+    ck_assert_int_eq(LOOPBACK.framesEchoed, 2);
+    ck_assert_int_eq(LOOPBACK.framesDropped, 1);
+    ck_assert_int_eq(LOOPBACK.frameCount, 0);
+}
+END_TEST
+
+START_TEST (test_echo_timeout)
+{
+    loopback::initialize(true);
+    loopback::attach(&BUSES[0], &BUSES[0]);
+    fail_unless(writeFrame(0x42, 0x1234));
+
+    time::advanceVirtualTimeUs(LOOPBACK_ECHO_TIMEOUT_US - 1);
+    loopback::update(time::systemTimeUs());
+    ck_assert_int_eq(LOOPBACK.frameCount, 1);
+
+    time::advanceVirtualTimeUs(1);
+    loopback::update(time::systemTimeUs());
+    ck_assert_int_eq(LOOPBACK.frameCount, 0);
+    ck_assert_int_eq(LOOPBACK.framesDropped, 1);
+
+    // The ring buffer doesn't fill up with frames that never came back
+    for(int i = 0; i < LOOPBACK_MAX_FRAMES; i++) {
+        fail_unless(writeFrame(0x42, i));
+    }
+    ck_assert_int_eq(LOOPBACK.framesDropped, 1);
+}
+END_TEST
+
+Suite* loopbackSuite(void) {
+    Suite* s = suite_create("loopback");
+    TCase *tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, NULL);
+    tcase_add_test(tc_core, test_attach_replaces_write_handler);
+    tcase_add_test(tc_core, test_echo_without_delay);
+    tcase_add_test(tc_core, test_echo_waits_for_delay);
+    tcase_add_test(tc_core, test_echo_to_other_bus);
+    tcase_add_test(tc_core, test_latency);
+    tcase_add_test(tc_core, test_other_frames_ignored);
+    tcase_add_test(tc_core, test_self_test);
+    suite_add_tcase(s, tc_core);
+
+    TCase *tc_faults = tcase_create("faults");
+    tcase_add_checked_fixture(tc_faults, setup, NULL);
+    tcase_add_test(tc_faults, test_all_lost);
+    tcase_add_test(tc_faults, test_some_lost);
+    tcase_add_test(tc_faults, test_full_receive_queue_drops);
+    tcase_add_test(tc_faults, test_too_many_in_flight);
+    tcase_add_test(tc_faults, test_lost_echo_skipped);
+    tcase_add_test(tc_faults, test_echo_timeout);
+    suite_add_tcase(s, tc_faults);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = loopbackSuite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
@@ -0,0 +1,256 @@
+#include <check.h>
+#include <stdint.h>
+#include "can/periodic.h"
+#include "can/canwrite.h"
+#include "util/timer.h"
+
+namespace periodic = openxc::can::periodic;
+namespace time = openxc::util::time;
+
+CanBus BUSES[2] = {
+    {500000, 1},
+    {125000, 2},
+};
+
+int framesWritten;
+
+bool countingWriteHandler(CanBus* bus, CanMessage message) {
+    ++framesWritten;
+    return true;
+}
+
+void setup() {
+    time::useVirtualClock(0);
+    for(int i = 0; i < 2; i++) {
+        openxc::can::initializeCommon(&BUSES[i]);
+    }
+    periodic::initialize();
+    framesWritten = 0;
+}
+
+/* Private: Empty the send queue of a bus, returning the number of frames that
+ * were in it.
+ */
+int drain(CanBus* bus) {
+    int count = 0;
+    while(!QUEUE_EMPTY(CanMessage, &bus->sendQueue)) {
+        QUEUE_POP(CanMessage, &bus->sendQueue);
+        ++count;
+    }
+    return count;
+}
+
+START_TEST (test_start_sends_right_away)
+{
+    fail_unless(periodic::start(&BUSES[0], 0x42, 0x1234, 10, 0));
+    ck_assert_int_eq(QUEUE_LENGTH(CanMessage, &BUSES[0].sendQueue), 1);
+    CanMessage message = QUEUE_POP(CanMessage, &BUSES[0].sendQueue);
+    ck_assert_int_eq(message.id, 0x42);
+    ck_assert(message.data == __builtin_bswap64(0x1234));
+}
+END_TEST
+
+START_TEST (test_sent_every_period)
+{
+    periodic::start(&BUSES[0], 0x42, 0x1234, 10, 0);
+    drain(&BUSES[0]);
+    ck_assert_int_eq(periodic::update(&BUSES[0], 5), 0);
+    ck_assert_int_eq(periodic::update(&BUSES[0], 9), 0);
+    ck_assert_int_eq(periodic::update(&BUSES[0], 10), 1);
+    ck_assert_int_eq(periodic::update(&BUSES[0], 19), 0);
+    ck_assert_int_eq(periodic::update(&BUSES[0], 20), 1);
+    ck_assert_int_eq(drain(&BUSES[0]), 2);
+}
+END_TEST
+
+START_TEST (test_period_longer_than_wheel)
+{
+    periodic::start(&BUSES[0], 0x42, 0x1234, 150, 0);
+    drain(&BUSES[0]);
+    for(unsigned long now = 1; now <= 450; now++) {
+        int queued = periodic::update(&BUSES[0], now);
+        ck_assert_int_eq(queued, now % 150 == 0 ? 1 : 0);
+        drain(&BUSES[0]);
+    }
+    ck_assert_int_eq(periodic::lookup(&BUSES[0], 0x42)->sent, 4);
+}
+END_TEST
+
+START_TEST (test_late_update_does_not_drift)
+{
+    periodic::start(&BUSES[0], 0x42, 0x1234, 10, 0);
+    drain(&BUSES[0]);
+    // Both the frames due at 10 and 20 are sent late
+    ck_assert_int_eq(periodic::update(&BUSES[0], 25), 2);
+    // and the next is still due at 30, not 35
+    ck_assert_int_eq(periodic::update(&BUSES[0], 30), 1);
+}
+END_TEST
+
+START_TEST (test_far_behind_skips_turns)
+{
+    periodic::start(&BUSES[0], 0x42, 0x1234, 10, 0);
+    drain(&BUSES[0]);
+    int queued = periodic::update(&BUSES[0], 100000);
+    fail_unless(queued > 0);
+    fail_unless(queued <= PERIODIC_WHEEL_SLOTS / 10 + 1);
+    drain(&BUSES[0]);
+    ck_assert_int_eq(periodic::update(&BUSES[0], 100010), 1);
+}
+END_TEST
+
+START_TEST (test_start_in_between_updates)
+{
+    periodic::start(&BUSES[0], 0x1, 0x1, 100, 0);
+    periodic::update(&BUSES[0], 10);
+    drain(&BUSES[0]);
+    // The wheel is still at 10, but the new frame is due 10ms from now
+    periodic::start(&BUSES[0], 0x2, 0x2, 10, 15);
+    drain(&BUSES[0]);
+    ck_assert_int_eq(periodic::update(&BUSES[0], 24), 0);
+    ck_assert_int_eq(periodic::update(&BUSES[0], 25), 1);
+}
+END_TEST
+
+START_TEST (test_stop)
+{
+    periodic::start(&BUSES[0], 0x42, 0x1234, 10, 0);
+    drain(&BUSES[0]);
+    fail_unless(periodic::stop(&BUSES[0], 0x42));
+    ck_assert_int_eq(periodic::update(&BUSES[0], 100), 0);
+    ck_assert(periodic::lookup(&BUSES[0], 0x42) == NULL);
+    fail_if(periodic::stop(&BUSES[0], 0x42));
+}
+END_TEST
+
+START_TEST (test_stop_one_of_a_slot)
+{
+    periodic::start(&BUSES[0], 0x1, 0x1, 10, 0);
+    periodic::start(&BUSES[0], 0x2, 0x2, 10, 0);
+    periodic::start(&BUSES[0], 0x3, 0x3, 10, 0);
+    drain(&BUSES[0]);
+    fail_unless(periodic::stop(&BUSES[0], 0x2));
+    ck_assert_int_eq(periodic::update(&BUSES[0], 10), 2);
+    fail_if(periodic::lookup(&BUSES[0], 0x1) == NULL);
+    fail_if(periodic::lookup(&BUSES[0], 0x3) == NULL);
+}
+END_TEST
+
+START_TEST (test_restart_changes_frame)
+{
+    periodic::start(&BUSES[0], 0x42, 0x1234, 10, 0);
+    periodic::start(&BUSES[0], 0x42, 0x5678, 20, 5);
+    drain(&BUSES[0]);
+
+    ck_assert_int_eq(periodic::update(&BUSES[0], 24), 0);
+    ck_assert_int_eq(periodic::update(&BUSES[0], 25), 1);
+    CanMessage message = QUEUE_POP(CanMessage, &BUSES[0].sendQueue);
+    ck_assert(message.data == __builtin_bswap64(0x5678));
+    ck_assert_int_eq(periodic::lookup(&BUSES[0], 0x42)->periodMs, 20);
+}
+END_TEST
+
+START_TEST (test_period_too_short)
+{
+    fail_if(periodic::start(&BUSES[0], 0x42, 0x1234, 0, 0));
+    fail_unless(QUEUE_EMPTY(CanMessage, &BUSES[0].sendQueue));
+}
+END_TEST
+
+START_TEST (test_pool_full)
+{
+    for(int i = 0; i < PERIODIC_MAX_FRAMES; i++) {
+        fail_unless(periodic::start(&BUSES[i % 2], i, i, 10 + i, 0));
+        drain(&BUSES[i % 2]);
+    }
+    fail_if(periodic::start(&BUSES[0], 0x100, 0x1234, 10, 0));
+
+    fail_unless(periodic::stop(&BUSES[0], 0));
+    fail_unless(periodic::start(&BUSES[0], 0x100, 0x1234, 10, 0));
+}
+END_TEST
+
+START_TEST (test_full_queue_missed)
+{
+    periodic::start(&BUSES[0], 0x42, 0x1234, 10, 0);
+    CanMessage message = {&BUSES[0], 0x1};
+    while(!QUEUE_FULL(CanMessage, &BUSES[0].sendQueue)) {
+        QUEUE_PUSH(CanMessage, &BUSES[0].sendQueue, message);
+    }
+    ck_assert_int_eq(periodic::update(&BUSES[0], 10), 0);
+    ck_assert_int_eq(periodic::lookup(&BUSES[0], 0x42)->missed, 1);
+
+    drain(&BUSES[0]);
+    ck_assert_int_eq(periodic::update(&BUSES[0], 20), 1);
+}
+END_TEST
+
+START_TEST (test_buses_independent)
+{
+    periodic::start(&BUSES[0], 0x42, 0x1234, 10, 0);
+    periodic::start(&BUSES[1], 0x42, 0x5678, 30, 0);
+    drain(&BUSES[0]);
+    drain(&BUSES[1]);
+
+    ck_assert_int_eq(periodic::update(&BUSES[0], 30), 3);
+    ck_assert_int_eq(periodic::update(&BUSES[1], 30), 1);
+    fail_unless(periodic::stop(&BUSES[1], 0x42));
+    fail_if(periodic::lookup(&BUSES[0], 0x42) == NULL);
+}
+END_TEST
+
+START_TEST (test_process_write_queue_sends_periodic)
+{
+    BUSES[0].writeHandler = countingWriteHandler;
+    periodic::start(&BUSES[0], 0x42, 0x1234, 10, time::systemTimeMs());
+    openxc::can::write::processWriteQueue(&BUSES[0]);
+    ck_assert_int_eq(framesWritten, 1);
+
+    time::delayMs(5);
+    openxc::can::write::processWriteQueue(&BUSES[0]);
+    ck_assert_int_eq(framesWritten, 1);
+
+    time::delayMs(5);
+    openxc::can::write::processWriteQueue(&BUSES[0]);
+    ck_assert_int_eq(framesWritten, 2);
+}
+END_TEST
+
+Suite* periodicSuite(void) {
+    Suite* s = suite_create("periodic");
+    TCase *tc_schedule = tcase_create("schedule");
+    tcase_add_checked_fixture(tc_schedule, setup, NULL);
+    tcase_add_test(tc_schedule, test_start_sends_right_away);
+    tcase_add_test(tc_schedule, test_sent_every_period);
+    tcase_add_test(tc_schedule, test_period_longer_than_wheel);
+    tcase_add_test(tc_schedule, test_late_update_does_not_drift);
+    tcase_add_test(tc_schedule, test_far_behind_skips_turns);
+    tcase_add_test(tc_schedule, test_start_in_between_updates);
+    tcase_add_test(tc_schedule, test_full_queue_missed);
+    tcase_add_test(tc_schedule, test_buses_independent);
+    tcase_add_test(tc_schedule, test_process_write_queue_sends_periodic);
+    suite_add_tcase(s, tc_schedule);
+
+    TCase *tc_frames = tcase_create("frames");
+    tcase_add_checked_fixture(tc_frames, setup, NULL);
+    tcase_add_test(tc_frames, test_stop);
+    tcase_add_test(tc_frames, test_stop_one_of_a_slot);
+    tcase_add_test(tc_frames, test_restart_changes_frame);
+    tcase_add_test(tc_frames, test_period_too_short);
+    tcase_add_test(tc_frames, test_pool_full);
+    suite_add_tcase(s, tc_frames);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = periodicSuite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
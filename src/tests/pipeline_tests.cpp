@@ -1,5 +1,6 @@
 #include <check.h>
 #include <stdint.h>
+#include <string.h>
 #include "pipeline.h"
 #include "emqueue.h"
 #include "cJSON.h"
@@ -30,6 +31,7 @@ void setup() {
     USB_PROCESSED = false;
     UART_PROCESSED = false;
     NETWORK_PROCESSED = false;
+    memset(pipeline.statistics, 0, sizeof(pipeline.statistics));
 }
 
 START_TEST (test_only_usb)
@@ -81,6 +83,42 @@ START_TEST (test_full_usb)
 }
 END_TEST
 
+START_TEST (test_full_usb_counts_drops)
+{
+    for(int i = 0; i < QUEUE_MAX_LENGTH(uint8_t) + 1; i++) {
+        QUEUE_PUSH(uint8_t, &pipeline.usb->sendQueue, (uint8_t) 128);
+    }
+
+    const char* message = "message";
+    sendMessage(&pipeline, (uint8_t*)message, 8);
+    sendMessage(&pipeline, (uint8_t*)message, 8);
+    ck_assert_int_eq(pipeline.statistics[openxc::pipeline::USB].messagesDropped,
+            2);
+    ck_assert_int_eq(pipeline.statistics[openxc::pipeline::USB].messagesSent,
+            0);
+}
+END_TEST
+
+START_TEST (test_send_counts_bytes)
+{
+    pipeline.uart = &uartDevice;
+    const char* message = "message";
+    sendMessage(&pipeline, (uint8_t*)message, 8);
+    sendMessage(&pipeline, (uint8_t*)message, 8);
+
+    ck_assert_int_eq(pipeline.statistics[openxc::pipeline::USB].messagesSent,
+            2);
+    ck_assert_int_eq(pipeline.statistics[openxc::pipeline::USB].bytesSent, 20);
+    ck_assert_int_eq(
+            pipeline.statistics[openxc::pipeline::USB].queueHighWatermark,
+            QUEUE_LENGTH(uint8_t, &pipeline.usb->sendQueue));
+    ck_assert_int_eq(pipeline.statistics[openxc::pipeline::UART].messagesSent,
+            2);
+    ck_assert_int_eq(
+            pipeline.statistics[openxc::pipeline::NETWORK].messagesSent, 0);
+}
+END_TEST
+
 START_TEST (test_with_uart)
 {
     pipeline.uart = &uartDevice;
@@ -158,6 +196,8 @@ Suite* pipelineSuite(void) {
     tcase_add_test(tc_core, test_full_usb);
     tcase_add_test(tc_core, test_full_uart);
     tcase_add_test(tc_core, test_full_network);
+    tcase_add_test(tc_core, test_full_usb_counts_drops);
+    tcase_add_test(tc_core, test_send_counts_bytes);
     tcase_add_test(tc_core, test_process_all);
     tcase_add_test(tc_core, test_process_usb_and_uart);
     tcase_add_test(tc_core, test_process_usb);
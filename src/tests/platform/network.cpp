@@ -9,3 +9,6 @@ void openxc::interface::network::processSendQueue(NetworkDevice* device) {
 void openxc::interface::network::initialize(NetworkDevice* device) {
     network::initializeCommon(device);
 }
+
+void openxc::interface::network::read(NetworkDevice* device,
+        bool (*callback)(uint8_t*, int)) { }
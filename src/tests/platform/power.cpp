@@ -0,0 +1,34 @@
+#include "power.h"
+#include <pthread.h>
+
+// Simulated interrupts run with this mutex held, which stands in for
+// disabling interrupts on the microcontroller
+static pthread_mutex_t interruptMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t interruptCondition = PTHREAD_COND_INITIALIZER;
+static bool interruptPending;
+
+int WAIT_FOR_INTERRUPT_COUNT = 0;
+
+void simulateInterrupt(void (*handler)()) {
+    pthread_mutex_lock(&interruptMutex);
+    if(handler != NULL) {
+        handler();
+    }
+    interruptPending = true;
+    pthread_cond_signal(&interruptCondition);
+    pthread_mutex_unlock(&interruptMutex);
+}
+
+bool openxc::power::waitForInterrupt(bool (*idle)()) {
+    pthread_mutex_lock(&interruptMutex);
+    bool sleep = idle();
+    if(sleep) {
+        ++WAIT_FOR_INTERRUPT_COUNT;
+        interruptPending = false;
+        while(!interruptPending) {
+            pthread_cond_wait(&interruptCondition, &interruptMutex);
+        }
+    }
+    pthread_mutex_unlock(&interruptMutex);
+    return sleep;
+}
@@ -1,9 +1,28 @@
 #include "util/timer.h"
 
-void openxc::util::time::delayMs(int delayInMs) { }
+// The tests always run on the virtual clock, which starts at 0 and only moves
+// when a test moves it
+
+void openxc::util::time::delayMs(int delayInMs) {
+    advanceVirtualTimeUs(delayInMs * 1000ULL);
+}
 
 unsigned long openxc::util::time::systemTimeMs() {
-    return 0;
+    return virtualTimeUs() / 1000;
+}
+
+unsigned long openxc::util::time::systemTimeUs() {
+    return virtualTimeUs();
+}
+
+// One count per microsecond of the virtual clock, so tests can time code by
+// moving the clock
+uint32_t openxc::util::time::cycleCount() {
+    return virtualTimeUs();
+}
+
+uint32_t openxc::util::time::cyclesPerUs() {
+    return 1;
 }
 
 void openxc::util::time::initialize() { }
@@ -11,7 +11,7 @@ void openxc::interface::uart::processSendQueue(UartDevice* device) {
     UART_PROCESSED = true;
 }
 
-void openxc::interface::uart::read(UartDevice* uart, bool (*callback)(uint8_t*)) { }
+void openxc::interface::uart::read(UartDevice* uart, bool (*callback)(uint8_t*, int)) { }
 
 void openxc::interface::uart::initialize(UartDevice* uart) {
     uart::initializeCommon(uart);
@@ -0,0 +1,85 @@
+#include <check.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "power.h"
+#include "emqueue.h"
+#include "util/bytebuffer.h"
+
+namespace power = openxc::power;
+
+extern int WAIT_FOR_INTERRUPT_COUNT;
+extern void simulateInterrupt(void (*handler)());
+
+QUEUE_TYPE(uint8_t) queue;
+
+void setup() {
+    QUEUE_INIT(uint8_t, &queue);
+    WAIT_FOR_INTERRUPT_COUNT = 0;
+}
+
+bool queueEmpty() {
+    return QUEUE_EMPTY(uint8_t, &queue);
+}
+
+void receiveByteHandler() {
+    QUEUE_PUSH(uint8_t, &queue, (uint8_t) 42);
+}
+
+void* interruptThread(void* arg) {
+    usleep(10000);
+    simulateInterrupt(receiveByteHandler);
+    return NULL;
+}
+
+START_TEST (test_no_wait_with_work)
+{
+    QUEUE_PUSH(uint8_t, &queue, (uint8_t) 1);
+    fail_if(power::waitForInterrupt(queueEmpty));
+    ck_assert_int_eq(WAIT_FOR_INTERRUPT_COUNT, 0);
+}
+END_TEST
+
+START_TEST (test_interrupt_before_wait_not_missed)
+{
+    simulateInterrupt(receiveByteHandler);
+    fail_if(power::waitForInterrupt(queueEmpty));
+    ck_assert_int_eq(WAIT_FOR_INTERRUPT_COUNT, 0);
+}
+END_TEST
+
+START_TEST (test_wake_on_interrupt)
+{
+    pthread_t thread;
+    pthread_create(&thread, NULL, interruptThread, NULL);
+    fail_unless(power::waitForInterrupt(queueEmpty));
+    pthread_join(thread, NULL);
+
+    ck_assert_int_eq(WAIT_FOR_INTERRUPT_COUNT, 1);
+    fail_if(queueEmpty());
+}
+END_TEST
+
+Suite* powerSuite(void) {
+    Suite* s = suite_create("power");
+    TCase *tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, NULL);
+    tcase_add_test(tc_core, test_no_wait_with_work);
+    tcase_add_test(tc_core, test_interrupt_before_wait_not_missed);
+    tcase_add_test(tc_core, test_wake_on_interrupt);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = powerSuite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
@@ -0,0 +1,245 @@
+#include <check.h>
+#include <stdint.h>
+#include "profiler.h"
+#include "scheduler.h"
+#include "util/timer.h"
+
+namespace profiler = openxc::profiler;
+namespace scheduler = openxc::scheduler;
+namespace time = openxc::util::time;
+
+using openxc::profiler::PROFILE;
+using openxc::scheduler::registerTask;
+
+unsigned int readTimeUs;
+unsigned int sendTimeUs;
+
+bool readTask() {
+    time::advanceVirtualTimeUs(readTimeUs);
+    return false;
+}
+
+bool sendTask() {
+    time::advanceVirtualTimeUs(sendTimeUs);
+    return false;
+}
+
+void setup() {
+    time::useVirtualClock(0);
+    scheduler::initialize();
+    profiler::initialize();
+    readTimeUs = 0;
+    sendTimeUs = 0;
+    registerTask("read", readTask, scheduler::PRIORITY_CRITICAL, 0, 0);
+    registerTask("send", sendTask, scheduler::PRIORITY_NORMAL, 0, 0);
+}
+
+void runIteration(unsigned int durationUs) {
+    profiler::beginIteration();
+    time::advanceVirtualTimeUs(durationUs);
+    profiler::endIteration();
+}
+
+void runTasks(unsigned int readUs, unsigned int sendUs) {
+    readTimeUs = readUs;
+    sendTimeUs = sendUs;
+    profiler::beginIteration();
+    scheduler::run();
+    profiler::endIteration();
+}
+
+START_TEST (test_small_buckets_exact)
+{
+    for(uint32_t i = 0; i < PROFILER_LINEAR_BUCKETS; i++) {
+        ck_assert_int_eq(profiler::bucketFor(i), i);
+        ck_assert_int_eq(profiler::bucketLimit(i), i);
+    }
+}
+END_TEST
+
+START_TEST (test_large_buckets_within_an_eighth)
+{
+    int lastBucket = profiler::bucketFor(PROFILER_LINEAR_BUCKETS);
+    for(uint32_t i = PROFILER_LINEAR_BUCKETS; i < 1000000; i += 7) {
+        int bucket = profiler::bucketFor(i);
+        fail_unless(bucket >= lastBucket);
+        fail_unless(bucket < PROFILER_HISTOGRAM_BUCKETS);
+        uint32_t limit = profiler::bucketLimit(bucket);
+        fail_unless(limit >= i);
+        fail_unless(limit - i <= i / PROFILER_SUB_BUCKETS);
+        lastBucket = bucket;
+    }
+}
+END_TEST
+
+START_TEST (test_huge_times_in_last_bucket)
+{
+    ck_assert_int_eq(profiler::bucketFor(0xffffffff),
+            PROFILER_HISTOGRAM_BUCKETS - 1);
+}
+END_TEST
+
+START_TEST (test_no_iterations)
+{
+    ck_assert_int_eq(profiler::percentile(0.99), 0);
+    profiler::endIteration();
+    ck_assert_int_eq(PROFILE.iterations, 0);
+}
+END_TEST
+
+START_TEST (test_percentiles)
+{
+    for(int i = 0; i < 990; i++) {
+        runIteration(10);
+    }
+    for(int i = 0; i < 9; i++) {
+        runIteration(200);
+    }
+    runIteration(3000);
+
+    ck_assert_int_eq(PROFILE.iterations, 1000);
+    ck_assert_int_eq(PROFILE.maxUs, 3000);
+    ck_assert_int_eq(profiler::percentile(0.99), 10);
+    // 200us is counted in the bucket up to 207us
+    ck_assert_int_eq(profiler::percentile(0.999), 207);
+    ck_assert_int_eq(profiler::percentile(1.0), 3000);
+}
+END_TEST
+
+START_TEST (test_percentile_capped_at_max)
+{
+    runIteration(100);
+    ck_assert_int_eq(profiler::percentile(0.999), 100);
+}
+END_TEST
+
+START_TEST (test_idle_iterations_not_counted)
+{
+    runIteration(10);
+    // Time between iterations, e.g. waiting for an interrupt
+    time::advanceVirtualTimeUs(50000);
+    runIteration(20);
+    ck_assert_int_eq(PROFILE.maxUs, 20);
+    ck_assert_int_eq(PROFILE.totalUs, 30);
+}
+END_TEST
+
+START_TEST (test_task_outside_iteration_ignored)
+{
+    readTimeUs = 100;
+    scheduler::run();
+    ck_assert_int_eq(PROFILE.taskMaxUs[0], 0);
+    ck_assert_int_eq(PROFILE.eventCount, 0);
+}
+END_TEST
+
+START_TEST (test_worst_iteration_events)
+{
+    runTasks(5, 5);
+    runTasks(300, 40);
+    runTasks(5, 5);
+
+    ck_assert_int_eq(PROFILE.worst.iteration, 1);
+    ck_assert_int_eq(PROFILE.worst.durationUs, 340);
+    ck_assert_int_eq(PROFILE.worst.eventCount, 2);
+    ck_assert_int_eq(PROFILE.worst.events[0].task, 0);
+    ck_assert_int_eq(PROFILE.worst.events[0].startUs, 0);
+    ck_assert_int_eq(PROFILE.worst.events[0].durationUs, 300);
+    ck_assert_int_eq(PROFILE.worst.events[1].task, 1);
+    ck_assert_int_eq(PROFILE.worst.events[1].startUs, 300);
+    ck_assert_int_eq(PROFILE.worst.events[1].durationUs, 40);
+}
+END_TEST
+
+START_TEST (test_worst_iteration_history)
+{
+    for(int i = 1; i <= 10; i++) {
+        runIteration(i);
+    }
+    runIteration(1000);
+    runIteration(7);
+    runIteration(8);
+
+    ck_assert_int_eq(PROFILE.worst.iteration, 10);
+    ck_assert_int_eq(PROFILE.worst.beforeCount, PROFILER_HISTORY_LENGTH);
+    ck_assert_int_eq(PROFILE.worst.before[0], 3);
+    ck_assert_int_eq(PROFILE.worst.before[PROFILER_HISTORY_LENGTH - 1], 10);
+    ck_assert_int_eq(PROFILE.worst.afterCount, 2);
+    ck_assert_int_eq(PROFILE.worst.after[0], 7);
+    ck_assert_int_eq(PROFILE.worst.after[1], 8);
+}
+END_TEST
+
+START_TEST (test_worst_iteration_early)
+{
+    runIteration(5);
+    runIteration(50);
+    ck_assert_int_eq(PROFILE.worst.beforeCount, 1);
+    ck_assert_int_eq(PROFILE.worst.before[0], 5);
+}
+END_TEST
+
+START_TEST (test_slow_task_time)
+{
+    profiler::setSlowIterationThreshold(100);
+    runTasks(10, 20);
+    runTasks(150, 20);
+    runTasks(10, 200);
+
+    ck_assert_int_eq(PROFILE.slowIterations, 2);
+    ck_assert_int_eq(PROFILE.taskSlowUs[0], 160);
+    ck_assert_int_eq(PROFILE.taskSlowUs[1], 220);
+    ck_assert_int_eq(PROFILE.taskMaxUs[0], 150);
+    ck_assert_int_eq(PROFILE.taskMaxUs[1], 200);
+}
+END_TEST
+
+START_TEST (test_reset_keeps_threshold)
+{
+    profiler::setSlowIterationThreshold(100);
+    runIteration(500);
+    profiler::reset();
+    ck_assert_int_eq(PROFILE.iterations, 0);
+    ck_assert_int_eq(PROFILE.maxUs, 0);
+    ck_assert_int_eq(PROFILE.slowIterations, 0);
+    ck_assert_int_eq(PROFILE.slowIterationUs, 100);
+}
+END_TEST
+
+Suite* profilerSuite(void) {
+    Suite* s = suite_create("profiler");
+    TCase *tc_histogram = tcase_create("histogram");
+    tcase_add_checked_fixture(tc_histogram, setup, NULL);
+    tcase_add_test(tc_histogram, test_small_buckets_exact);
+    tcase_add_test(tc_histogram, test_large_buckets_within_an_eighth);
+    tcase_add_test(tc_histogram, test_huge_times_in_last_bucket);
+    tcase_add_test(tc_histogram, test_no_iterations);
+    tcase_add_test(tc_histogram, test_percentiles);
+    tcase_add_test(tc_histogram, test_percentile_capped_at_max);
+    tcase_add_test(tc_histogram, test_idle_iterations_not_counted);
+    suite_add_tcase(s, tc_histogram);
+
+    TCase *tc_tasks = tcase_create("tasks");
+    tcase_add_checked_fixture(tc_tasks, setup, NULL);
+    tcase_add_test(tc_tasks, test_task_outside_iteration_ignored);
+    tcase_add_test(tc_tasks, test_worst_iteration_events);
+    tcase_add_test(tc_tasks, test_worst_iteration_history);
+    tcase_add_test(tc_tasks, test_worst_iteration_early);
+    tcase_add_test(tc_tasks, test_slow_task_time);
+    tcase_add_test(tc_tasks, test_reset_keeps_threshold);
+    suite_add_tcase(s, tc_tasks);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = profilerSuite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
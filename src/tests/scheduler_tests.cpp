@@ -0,0 +1,177 @@
+#include <check.h>
+#include <stdint.h>
+#include "scheduler.h"
+
+namespace scheduler = openxc::scheduler;
+
+using openxc::scheduler::Task;
+using openxc::scheduler::registerTask;
+
+int pendingWork;
+int criticalRuns;
+int lowRuns;
+int order[4];
+int orderCount;
+
+bool criticalTask() {
+    ++criticalRuns;
+    order[orderCount++ % 4] = 0;
+    if(pendingWork > 0) {
+        --pendingWork;
+    }
+    return pendingWork > 0;
+}
+
+bool normalTask() {
+    order[orderCount++ % 4] = 2;
+    return false;
+}
+
+bool lowTask() {
+    ++lowRuns;
+    order[orderCount++ % 4] = 3;
+    return false;
+}
+
+void setup() {
+    scheduler::initialize();
+    pendingWork = 0;
+    criticalRuns = 0;
+    lowRuns = 0;
+    orderCount = 0;
+}
+
+START_TEST (test_register)
+{
+    fail_if(registerTask("critical", criticalTask,
+                scheduler::PRIORITY_CRITICAL, 0, 0) == NULL);
+    ck_assert_int_eq(scheduler::getTaskCount(), 1);
+    ck_assert_str_eq(scheduler::getTasks()[0].name, "critical");
+}
+END_TEST
+
+START_TEST (test_register_full)
+{
+    for(int i = 0; i < MAX_TASK_COUNT; i++) {
+        fail_if(registerTask("low", lowTask, scheduler::PRIORITY_LOW, 0, 0)
+                == NULL);
+    }
+    fail_unless(registerTask("low", lowTask, scheduler::PRIORITY_LOW, 0, 0)
+            == NULL);
+}
+END_TEST
+
+START_TEST (test_priority_order)
+{
+    registerTask("low", lowTask, scheduler::PRIORITY_LOW, 0, 0);
+    registerTask("normal", normalTask, scheduler::PRIORITY_NORMAL, 0, 0);
+    registerTask("critical", criticalTask, scheduler::PRIORITY_CRITICAL, 0, 0);
+
+    fail_if(scheduler::run());
+    ck_assert_int_eq(orderCount, 3);
+    ck_assert_int_eq(order[0], 0);
+    ck_assert_int_eq(order[1], 2);
+    ck_assert_int_eq(order[2], 3);
+}
+END_TEST
+
+START_TEST (test_task_pointer_stable)
+{
+    Task* low = registerTask("low", lowTask, scheduler::PRIORITY_LOW, 0, 0);
+    registerTask("critical", criticalTask, scheduler::PRIORITY_CRITICAL, 0, 0);
+    ck_assert_str_eq(low->name, "low");
+    ck_assert_str_eq(scheduler::getTasks()[0].name, "low");
+
+    scheduler::run();
+    ck_assert_int_eq(low->runs, 1);
+    ck_assert_int_eq(order[0], 0);
+    ck_assert_int_eq(order[1], 3);
+}
+END_TEST
+
+START_TEST (test_budget_repeats_task)
+{
+    registerTask("critical", criticalTask, scheduler::PRIORITY_CRITICAL, 0,
+            1000);
+    pendingWork = 5;
+    fail_if(scheduler::run());
+    ck_assert_int_eq(criticalRuns, 5);
+    ck_assert_int_eq(scheduler::getTasks()[0].runs, 5);
+}
+END_TEST
+
+START_TEST (test_no_budget_runs_once)
+{
+    registerTask("critical", criticalTask, scheduler::PRIORITY_CRITICAL, 0, 0);
+    pendingWork = 5;
+    fail_unless(scheduler::run());
+    ck_assert_int_eq(criticalRuns, 1);
+}
+END_TEST
+
+START_TEST (test_low_priority_shed_under_load)
+{
+    registerTask("critical", criticalTask, scheduler::PRIORITY_CRITICAL, 0, 0);
+    Task* low = registerTask("low", lowTask, scheduler::PRIORITY_LOW, 0, 0);
+    pendingWork = 3;
+    fail_unless(scheduler::run());
+    ck_assert_int_eq(lowRuns, 0);
+    ck_assert_int_eq(low->skipped, 1);
+
+    scheduler::run();
+    fail_if(scheduler::run());
+    ck_assert_int_eq(lowRuns, 1);
+}
+END_TEST
+
+START_TEST (test_low_priority_not_starved)
+{
+    registerTask("critical", criticalTask, scheduler::PRIORITY_CRITICAL, 0, 0);
+    registerTask("low", lowTask, scheduler::PRIORITY_LOW, 0, 0);
+    pendingWork = 1000;
+    for(int i = 0; i < MAX_CONSECUTIVE_SKIPS + 1; i++) {
+        scheduler::run();
+    }
+    ck_assert_int_eq(lowRuns, 1);
+}
+END_TEST
+
+START_TEST (test_periodic)
+{
+    // The test timer is always at 0, so a periodic task only runs once
+    registerTask("low", lowTask, scheduler::PRIORITY_LOW, 100, 0);
+    scheduler::run();
+    scheduler::run();
+    ck_assert_int_eq(lowRuns, 1);
+}
+END_TEST
+
+Suite* schedulerSuite(void) {
+    Suite* s = suite_create("scheduler");
+    TCase *tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, NULL);
+    tcase_add_test(tc_core, test_register);
+    tcase_add_test(tc_core, test_register_full);
+    tcase_add_test(tc_core, test_priority_order);
+    tcase_add_test(tc_core, test_task_pointer_stable);
+    tcase_add_test(tc_core, test_budget_repeats_task);
+    tcase_add_test(tc_core, test_no_budget_runs_once);
+    tcase_add_test(tc_core, test_low_priority_shed_under_load);
+    tcase_add_test(tc_core, test_low_priority_not_starved);
+    tcase_add_test(tc_core, test_periodic);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = schedulerSuite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
@@ -0,0 +1,263 @@
+#include <check.h>
+#include <stdint.h>
+#include <string.h>
+#include "statistics.h"
+#include "cJSON.h"
+
+namespace statistics = openxc::statistics;
+
+using openxc::statistics::STATISTICS;
+
+const int BUS_COUNT = 2;
+CanBus buses[BUS_COUNT];
+Pipeline pipeline;
+UsbDevice usbDevice;
+
+void setup() {
+    memset(buses, 0, sizeof(buses));
+    memset(&pipeline, 0, sizeof(pipeline));
+    memset(&STATISTICS, 0, sizeof(STATISTICS));
+    buses[0].address = 1;
+    buses[1].address = 2;
+    pipeline.usb = &usbDevice;
+    statistics::initialize();
+}
+
+START_TEST (test_serialize_buses)
+{
+    buses[0].messagesReceived = 10;
+    buses[0].messagesDropped = 2;
+    buses[1].receiveQueueHighWatermark = 7;
+
+    cJSON* root = statistics::serialize(buses, BUS_COUNT, &pipeline);
+    fail_if(root == NULL);
+    ck_assert_str_eq(cJSON_GetObjectItem(root, "command_response")->valuestring,
+            "statistics");
+
+    cJSON* busArray = cJSON_GetObjectItem(root, "can");
+    ck_assert_int_eq(cJSON_GetArraySize(busArray), BUS_COUNT);
+    cJSON* bus = cJSON_GetArrayItem(busArray, 0);
+    ck_assert_int_eq(cJSON_GetObjectItem(bus, "bus")->valueint, 1);
+    ck_assert_int_eq(cJSON_GetObjectItem(bus, "received")->valueint, 10);
+    ck_assert_int_eq(cJSON_GetObjectItem(bus, "dropped")->valueint, 2);
+    bus = cJSON_GetArrayItem(busArray, 1);
+    ck_assert_int_eq(cJSON_GetObjectItem(bus, "queue_max")->valueint, 7);
+    cJSON_Delete(root);
+}
+END_TEST
+
+START_TEST (test_serialize_interfaces)
+{
+    pipeline.statistics[openxc::pipeline::UART].messagesSent = 3;
+    pipeline.statistics[openxc::pipeline::UART].bytesSent = 42;
+    pipeline.statistics[openxc::pipeline::NETWORK].messagesDropped = 5;
+
+    cJSON* root = statistics::serialize(buses, BUS_COUNT, &pipeline);
+    cJSON* interfaces = cJSON_GetObjectItem(root, "interfaces");
+    cJSON* uart = cJSON_GetObjectItem(interfaces, "UART");
+    fail_if(uart == NULL);
+    ck_assert_int_eq(cJSON_GetObjectItem(uart, "sent")->valueint, 3);
+    ck_assert_int_eq(cJSON_GetObjectItem(uart, "bytes")->valueint, 42);
+    cJSON* network = cJSON_GetObjectItem(interfaces, "Network");
+    ck_assert_int_eq(cJSON_GetObjectItem(network, "dropped")->valueint, 5);
+    cJSON_Delete(root);
+}
+END_TEST
+
+START_TEST (test_serialize_receive_framing)
+{
+    openxc::util::bytebuffer::initializeFramer(&usbDevice.framer);
+    usbDevice.framer.framesReceived = 4;
+    usbDevice.framer.framesRejected = 1;
+    usbDevice.framer.framesOversize = 2;
+
+    cJSON* root = statistics::serialize(buses, BUS_COUNT, &pipeline);
+    cJSON* interfaces = cJSON_GetObjectItem(root, "interfaces");
+    cJSON* usb = cJSON_GetObjectItem(interfaces, "USB");
+    ck_assert_int_eq(cJSON_GetObjectItem(usb, "received")->valueint, 4);
+    ck_assert_int_eq(cJSON_GetObjectItem(usb, "rejected")->valueint, 1);
+    ck_assert_int_eq(cJSON_GetObjectItem(usb, "oversize")->valueint, 2);
+    // The pipeline has no UART, so it has nothing to count
+    cJSON* uart = cJSON_GetObjectItem(interfaces, "UART");
+    fail_unless(cJSON_GetObjectItem(uart, "received") == NULL);
+    cJSON_Delete(root);
+}
+END_TEST
+
+START_TEST (test_heap_accounting)
+{
+    cJSON* root = statistics::serialize(buses, BUS_COUNT, &pipeline);
+    fail_unless(STATISTICS.heapUsed > 0);
+    fail_unless(STATISTICS.heapPeak >= STATISTICS.heapUsed);
+    cJSON_Delete(root);
+    ck_assert_int_eq(STATISTICS.heapUsed, 0);
+    fail_unless(STATISTICS.heapPeak > 0);
+}
+END_TEST
+
+START_TEST (test_loop_iterations_since_report)
+{
+    STATISTICS.loopIterations = 100;
+    cJSON* root = statistics::serialize(buses, BUS_COUNT, &pipeline);
+    ck_assert_int_eq(cJSON_GetObjectItem(root, "loops")->valueint, 100);
+    ck_assert_int_eq(STATISTICS.lastReportLoopIterations, 100);
+    cJSON_Delete(root);
+}
+END_TEST
+
+START_TEST (test_serialize_to_buffer)
+{
+    // The size of the USB control request response
+    char buffer[1024];
+    int length = statistics::serialize(buses, BUS_COUNT, &pipeline, buffer,
+            sizeof(buffer));
+    fail_unless(length > 0);
+    ck_assert_int_eq(length, strlen(buffer));
+
+    cJSON* root = cJSON_Parse(buffer);
+    fail_if(root == NULL);
+    cJSON_Delete(root);
+    ck_assert_int_eq(STATISTICS.heapUsed, 0);
+}
+END_TEST
+
+START_TEST (test_serialize_to_small_buffer)
+{
+    char buffer[16];
+    int length = statistics::serialize(buses, BUS_COUNT, &pipeline, buffer,
+            sizeof(buffer));
+    // Never cut off in the middle of the JSON
+    ck_assert_int_eq(length, -1);
+    ck_assert_int_eq(strlen(buffer), 0);
+    ck_assert_int_eq(STATISTICS.heapUsed, 0);
+}
+END_TEST
+
+START_TEST (test_wake_latency)
+{
+    statistics::recordDecode();
+    ck_assert_int_eq(STATISTICS.wakeLatencySamples, 0);
+
+    statistics::recordWake();
+    ck_assert_int_eq(STATISTICS.wakeups, 1);
+    fail_unless(STATISTICS.wakePending);
+    statistics::recordDecode();
+    statistics::recordDecode();
+    fail_if(STATISTICS.wakePending);
+    ck_assert_int_eq(STATISTICS.wakeLatencySamples, 1);
+}
+END_TEST
+
+START_TEST (test_serialize_task)
+{
+    Task task = {"can_read", NULL, openxc::scheduler::PRIORITY_CRITICAL, 0, 0};
+    task.runs = 12;
+    task.totalTimeUs = 3400;
+    task.maxTimeUs = 500;
+    cJSON* root = statistics::serialize(&task);
+    ck_assert_str_eq(cJSON_GetObjectItem(root, "command_response")->valuestring,
+            "task_statistics");
+    ck_assert_str_eq(cJSON_GetObjectItem(root, "name")->valuestring,
+            "can_read");
+    ck_assert_int_eq(cJSON_GetObjectItem(root, "runs")->valueint, 12);
+    ck_assert_int_eq(cJSON_GetObjectItem(root, "time_us")->valueint, 3400);
+    ck_assert_int_eq(cJSON_GetObjectItem(root, "max_us")->valueint, 500);
+    cJSON_Delete(root);
+}
+END_TEST
+
+#ifdef __SIGNAL_STATISTICS__
+const int SIGNAL_COUNT = 4;
+CanSignal SIGNALS[SIGNAL_COUNT] = {
+    {NULL, "quiet"},
+    {NULL, "loud"},
+    {NULL, "never_received"},
+    {NULL, "busy_but_suppressed"},
+};
+
+void setupSignals() {
+    for(int i = 0; i < SIGNAL_COUNT; i++) {
+        SIGNALS[i].framesDecoded = 0;
+        SIGNALS[i].bytesSerialized = 0;
+    }
+    SIGNALS[0].framesDecoded = 10;
+    SIGNALS[0].bytesSerialized = 100;
+    SIGNALS[1].framesDecoded = 10;
+    SIGNALS[1].bytesSerialized = 1000;
+    SIGNALS[3].framesDecoded = 500;
+}
+
+START_TEST (test_sort_signals_by_traffic)
+{
+    setupSignals();
+    CanSignal* sorted[SIGNAL_COUNT];
+    int count = statistics::sortSignalsByTraffic(SIGNALS, SIGNAL_COUNT,
+            sorted, SIGNAL_COUNT);
+    ck_assert_int_eq(count, 3);
+    fail_unless(sorted[0] == &SIGNALS[1]);
+    fail_unless(sorted[1] == &SIGNALS[0]);
+    fail_unless(sorted[2] == &SIGNALS[3]);
+}
+END_TEST
+
+START_TEST (test_sort_signals_limited)
+{
+    setupSignals();
+    CanSignal* sorted[1];
+    int count = statistics::sortSignalsByTraffic(SIGNALS, SIGNAL_COUNT,
+            sorted, 1);
+    ck_assert_int_eq(count, 1);
+    fail_unless(sorted[0] == &SIGNALS[1]);
+}
+END_TEST
+
+START_TEST (test_serialize_signal)
+{
+    setupSignals();
+    cJSON* root = statistics::serialize(&SIGNALS[1], 1);
+    ck_assert_str_eq(cJSON_GetObjectItem(root, "name")->valuestring, "loud");
+    ck_assert_int_eq(cJSON_GetObjectItem(root, "rank")->valueint, 1);
+    ck_assert_int_eq(cJSON_GetObjectItem(root, "bytes")->valueint, 1000);
+    cJSON_Delete(root);
+}
+END_TEST
+#endif // __SIGNAL_STATISTICS__
+
+Suite* statisticsSuite(void) {
+    Suite* s = suite_create("statistics");
+    TCase *tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, NULL);
+    tcase_add_test(tc_core, test_serialize_buses);
+    tcase_add_test(tc_core, test_serialize_interfaces);
+    tcase_add_test(tc_core, test_serialize_receive_framing);
+    tcase_add_test(tc_core, test_heap_accounting);
+    tcase_add_test(tc_core, test_loop_iterations_since_report);
+    tcase_add_test(tc_core, test_serialize_to_buffer);
+    tcase_add_test(tc_core, test_serialize_to_small_buffer);
+    tcase_add_test(tc_core, test_serialize_task);
+    tcase_add_test(tc_core, test_wake_latency);
+    suite_add_tcase(s, tc_core);
+
+#ifdef __SIGNAL_STATISTICS__
+    TCase *tc_signals = tcase_create("signals");
+    tcase_add_checked_fixture(tc_signals, setup, NULL);
+    tcase_add_test(tc_signals, test_sort_signals_by_traffic);
+    tcase_add_test(tc_signals, test_sort_signals_limited);
+    tcase_add_test(tc_signals, test_serialize_signal);
+    suite_add_tcase(s, tc_signals);
+#endif // __SIGNAL_STATISTICS__
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = statisticsSuite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
@@ -4,7 +4,14 @@
 OSTYPE := $(shell uname)
 
 TEST_DIR = tests
+# The optional per-signal statistics change what is compiled, so the tests
+# built with them (see signal_statistics_unit_tests) get their own folder
+ifdef SIGNAL_STATISTICS
+TEST_OBJDIR = build/$(TEST_DIR)-signal-statistics
+TEST_SYMBOLS = -D__SIGNAL_STATISTICS__
+else
 TEST_OBJDIR = build/$(TEST_DIR)
+endif
 
 LIBS_PATH = libs
 TEST_SRC=$(wildcard $(TEST_DIR)/*_tests.cpp)
@@ -22,22 +29,41 @@ TEST_CPP_SRCS := $(filter-out $(NON_TESTABLE_SRCS),$(TEST_CPP_SRCS))
 TEST_OBJ_FILES = $(TEST_C_SRCS:.c=.o) $(TEST_CPP_SRCS:.cpp=.o)
 TEST_OBJS = $(patsubst %,$(TEST_OBJDIR)/%,$(TEST_OBJ_FILES))
 
+# Benchmarks run on the development computer with the same platform stubs as the
+# unit tests, but optimized and without coverage, in their own build folder
+BENCH_DIR = $(TEST_DIR)/bench
+BENCH_OBJDIR = build/bench
+BENCH_SRC = $(wildcard $(BENCH_DIR)/*_bench.cpp)
+BENCHES = $(patsubst %.cpp,$(BENCH_OBJDIR)/%.bin,$(BENCH_SRC))
+BENCH_SUPPORT_SRC = $(filter-out $(BENCH_SRC),$(wildcard $(BENCH_DIR)/*.cpp))
+BENCH_OBJS = $(patsubst %,$(BENCH_OBJDIR)/%,$(TEST_OBJ_FILES)) \
+		$(patsubst %.cpp,$(BENCH_OBJDIR)/%.o,$(BENCH_SUPPORT_SRC))
+BENCH_RESULTS = $(BENCH_OBJDIR)/results.json
+BENCH_BASELINE = $(BENCH_DIR)/baseline.json
+BENCH_COMPARE = ../script/compare_benchmarks.py
+
 GENERATOR = openxc-generate-firmware-code
-.PRECIOUS: $(TEST_OBJS) $(TESTS:.bin=.o)
+.PRECIOUS: $(TEST_OBJS) $(TESTS:.bin=.o) $(BENCH_OBJS) $(BENCHES:.bin=.o)
 
 RED="$${txtbld}$$(tput setaf 1)"
 GREEN="$${txtbld}$$(tput setaf 2)"
 COLOR_RESET=$$(tput sgr0)
 
 test: unit_tests
+	@make signal_statistics_unit_tests
+	@make bench_test
 	@make default_pic32_compile_test
 	@make chipkit_compile_test
 	@make c5_compile_test
 	@make lpc17xx_compile_test
 	@make ford_test
 	@make emulator_test
+	@make frame_emulator_test
+	@make loopback_compile_test
 	@make debug_compile_test
 	@make network_compile_test
+	@make signal_statistics_compile_test
+	@make host_compile_test
 	@echo "$(GREEN)All tests passed.$(COLOR_RESET)"
 
 ifeq ($(OSTYPE),Darwin)
@@ -70,14 +96,51 @@ unit_tests: LD = $(TEST_LD)
 unit_tests: CC = $(TEST_CC)
 unit_tests: CPP = $(TEST_CPP)
 unit_tests: CC_FLAGS = -I. -c -w -Wall -Werror -g -ggdb -coverage
-unit_tests: CC_SYMBOLS = -D__TESTS__
+unit_tests: CC_SYMBOLS = -D__TESTS__ $(TEST_SYMBOLS)
 unit_tests: LDFLAGS = -lm -coverage
-unit_tests: LDLIBS = $(TEST_LIBS)
+unit_tests: LDLIBS = $(TEST_LIBS) -lpthread
 unit_tests: $(TESTS)
 	@set -o $(TEST_SET_OPTS) >/dev/null 2>&1
 	@export SHELLOPTS
 	@sh tests/runtests.sh $(TEST_OBJDIR)/$(TEST_DIR)
 
+signal_statistics_unit_tests:
+	@echo "Running unit tests with SIGNAL_STATISTICS=1:"
+	@SIGNAL_STATISTICS=1 make unit_tests
+
+bench: LD = $(TEST_LD)
+bench: CC = $(TEST_CC)
+bench: CPP = $(TEST_CPP)
+bench: CC_FLAGS = -I. -c -w -O2
+bench: CC_SYMBOLS = -D__TESTS__
+bench: LDFLAGS = -lm
+bench: LDLIBS = -lpthread
+bench: $(BENCHES)
+	@rm -f $(BENCH_RESULTS)
+	@for benchmark in $(BENCHES); do \
+		BENCH_RESULTS=$(BENCH_RESULTS) ./$$benchmark || exit 1; \
+	done
+
+# Fail if any benchmark got slower compared to reference/checksum, measured in
+# the same run, than it was in the committed baseline. That holds on any
+# computer, so it's part of test, but the tolerance is wide.
+bench_test: bench
+	@python3 $(BENCH_COMPARE) --relative $(BENCH_BASELINE) $(BENCH_RESULTS)
+	@echo "$(GREEN)No benchmark regressions.$(COLOR_RESET)"
+
+# Fail if any benchmark is slower than the baseline by more than its tolerance.
+# Absolute times are only meaningful on the computer the baseline was recorded
+# on - run bench_baseline there first.
+bench_check: bench
+	@python3 $(BENCH_COMPARE) $(BENCH_BASELINE) $(BENCH_RESULTS)
+	@echo "$(GREEN)No benchmark regressions.$(COLOR_RESET)"
+
+bench_baseline: bench
+	@python3 $(BENCH_COMPARE) --update $(BENCH_BASELINE) $(BENCH_RESULTS)
+
+# receiveWriteRequest is only in the translator itself
+$(BENCH_OBJDIR)/$(BENCH_DIR)/write_bench.bin: $(BENCH_OBJDIR)/cantranslator.o
+
 emulator_test:
 	@echo -n "Testing CAN emulator build for chipKIT..."
 	@make clean
@@ -89,6 +152,32 @@ emulator_test:
 	@make clean
 	@echo "$(GREEN)passed.$(COLOR_RESET)"
 
+frame_emulator_test: code_generation_test
+	@echo -n "Testing CAN frame emulator build for chipKIT..."
+	@make -j4 frame_emulator
+	@make clean
+	@echo "$(GREEN)passed.$(COLOR_RESET)"
+	@echo -n "Testing CAN frame emulator build with a trace for Blueboard ARM board..."
+	@cp emulator_trace.cpp.example emulator_trace.cpp
+	@FRAME_EMULATOR_TRACE=1 PLATFORM=BLUEBOARD make -j4 frame_emulator
+	@rm emulator_trace.cpp
+	@make clean
+	@echo "$(GREEN)passed.$(COLOR_RESET)"
+
+loopback_compile_test: code_generation_test
+	@echo -n "Testing build with CAN_LOOPBACK=1 flag on the host..."
+	@CAN_LOOPBACK=1 PLATFORM=HOST make -j4
+	@make clean
+	@echo "$(GREEN)passed.$(COLOR_RESET)"
+	@echo -n "Testing build with CAN_LOOPBACK_SELF_TEST=1 flag for chipKIT..."
+	@CAN_LOOPBACK_SELF_TEST=1 make -j4
+	@make clean
+	@echo "$(GREEN)passed.$(COLOR_RESET)"
+	@echo -n "Testing build with CAN_LOOPBACK_SELF_TEST=1 flag for Blueboard ARM board..."
+	@CAN_LOOPBACK_SELF_TEST=1 CAN_LOOPBACK_SELF_TEST_ON_BUS=1 PLATFORM=BLUEBOARD make -j4
+	@make clean
+	@echo "$(GREEN)passed.$(COLOR_RESET)"
+
 debug_compile_test: code_generation_test
 	@echo -n "Testing build with DEBUG=1 flag..."
 	@DEBUG=1 make -j4
@@ -101,6 +190,12 @@ network_compile_test: code_generation_test
 	@make clean
 	@echo "$(GREEN)passed.$(COLOR_RESET)"
 
+signal_statistics_compile_test: code_generation_test
+	@echo -n "Testing build with SIGNAL_STATISTICS=1 flag..."
+	@SIGNAL_STATISTICS=1 make -j4
+	@make clean
+	@echo "$(GREEN)passed.$(COLOR_RESET)"
+
 default_pic32_compile_test: code_generation_test
 	@echo -n "Testing default platform build (chipKIT) with example vehicle signals..."
 	@make -j4
@@ -125,6 +220,12 @@ lpc17xx_compile_test: code_generation_test
 	@make clean
 	@echo "$(GREEN)passed.$(COLOR_RESET)"
 
+host_compile_test: code_generation_test
+	@echo -n "Testing host platform build with example vehicle signals..."
+	@PLATFORM=HOST make -j4
+	@make clean
+	@echo "$(GREEN)passed.$(COLOR_RESET)"
+
 mapped_lpc17xx_compile_test: mapped_code_generation_test
 	@echo -n "Testing Blueboard board build with example mapped vehicle signals..."
 	@PLATFORM=BLUEBOARD make -j4
@@ -177,3 +278,15 @@ $(TEST_OBJDIR)/%.o: %.c
 $(TEST_OBJDIR)/%.bin: $(TEST_OBJDIR)/%.o $(TEST_OBJS)
 	@mkdir -p $(dir $@)
 	$(LD) $(LDFLAGS) $(CC_SYMBOLS) $(ONLY_CPP_FLAGS) $(INCLUDE_PATHS) -o $@ $^ $(LDLIBS)
+
+$(BENCH_OBJDIR)/%.o: %.cpp
+	@mkdir -p $(dir $@)
+	$(CPP) $(CC_FLAGS) $(CC_SYMBOLS) $(ONLY_CPP_FLAGS) $(INCLUDE_PATHS) -o $@ $<
+
+$(BENCH_OBJDIR)/%.o: %.c
+	@mkdir -p $(dir $@)
+	$(CC) $(CC_FLAGS) $(CC_SYMBOLS) $(ONLY_C_FLAGS) $(INCLUDE_PATHS) -o $@ $<
+
+$(BENCH_OBJDIR)/%.bin: $(BENCH_OBJDIR)/%.o $(BENCH_OBJS)
+	@mkdir -p $(dir $@)
+	$(LD) $(LDFLAGS) $(ONLY_CPP_FLAGS) -o $@ $^ $(LDLIBS)
@@ -0,0 +1,70 @@
+#include <check.h>
+#include <stdint.h>
+#include "util/timer.h"
+
+namespace time = openxc::util::time;
+
+void setup() {
+    time::useVirtualClock(0);
+}
+
+START_TEST (test_starts_at_given_time)
+{
+    ck_assert_int_eq(time::systemTimeUs(), 0);
+    time::useVirtualClock(2500000);
+    fail_unless(time::virtualClockEnabled());
+    ck_assert_int_eq(time::systemTimeUs(), 2500000);
+    ck_assert_int_eq(time::systemTimeMs(), 2500);
+}
+END_TEST
+
+START_TEST (test_advance)
+{
+    time::advanceVirtualTimeUs(1500);
+    ck_assert_int_eq(time::systemTimeUs(), 1500);
+    ck_assert_int_eq(time::systemTimeMs(), 1);
+    time::advanceVirtualTimeUs(500);
+    ck_assert_int_eq(time::systemTimeMs(), 2);
+}
+END_TEST
+
+START_TEST (test_set_never_goes_backwards)
+{
+    time::setVirtualTimeUs(10000);
+    ck_assert_int_eq(time::systemTimeUs(), 10000);
+    time::setVirtualTimeUs(9000);
+    ck_assert_int_eq(time::systemTimeUs(), 10000);
+}
+END_TEST
+
+START_TEST (test_delay_advances)
+{
+    time::delayMs(25);
+    ck_assert_int_eq(time::systemTimeMs(), 25);
+}
+END_TEST
+
+Suite* timerSuite(void) {
+    Suite* s = suite_create("timer");
+    TCase *tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, NULL);
+    tcase_add_test(tc_core, test_starts_at_given_time);
+    tcase_add_test(tc_core, test_advance);
+    tcase_add_test(tc_core, test_set_never_goes_backwards);
+    tcase_add_test(tc_core, test_delay_advances);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = timerSuite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
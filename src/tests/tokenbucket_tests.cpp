@@ -0,0 +1,127 @@
+#include <check.h>
+#include <stdint.h>
+#include "util/tokenbucket.h"
+
+namespace tokenbucket = openxc::util::tokenbucket;
+
+using openxc::util::tokenbucket::TokenBucket;
+
+TokenBucket bucket;
+
+void setup() {
+    tokenbucket::initialize(&bucket, 1000, 10);
+}
+
+int takeAll() {
+    int taken = 0;
+    while(tokenbucket::take(&bucket)) {
+        ++taken;
+    }
+    return taken;
+}
+
+START_TEST (test_starts_empty)
+{
+    fail_if(tokenbucket::take(&bucket));
+    tokenbucket::refill(&bucket, 5000000);
+    ck_assert_int_eq(tokenbucket::available(&bucket), 0);
+    fail_if(tokenbucket::take(&bucket));
+}
+END_TEST
+
+START_TEST (test_earns_at_rate)
+{
+    tokenbucket::refill(&bucket, 0);
+    tokenbucket::refill(&bucket, 3000);
+    ck_assert_int_eq(tokenbucket::available(&bucket), 3);
+    ck_assert_int_eq(takeAll(), 3);
+    ck_assert_int_eq(tokenbucket::available(&bucket), 0);
+}
+END_TEST
+
+START_TEST (test_keeps_partial_tokens)
+{
+    tokenbucket::refill(&bucket, 0);
+    tokenbucket::refill(&bucket, 600);
+    ck_assert_int_eq(takeAll(), 0);
+    tokenbucket::refill(&bucket, 1200);
+    ck_assert_int_eq(takeAll(), 1);
+    tokenbucket::refill(&bucket, 2000);
+    ck_assert_int_eq(takeAll(), 1);
+}
+END_TEST
+
+START_TEST (test_limited_to_burst)
+{
+    tokenbucket::refill(&bucket, 0);
+    tokenbucket::refill(&bucket, 60000000);
+    ck_assert_int_eq(takeAll(), 10);
+}
+END_TEST
+
+START_TEST (test_time_wraps)
+{
+    tokenbucket::refill(&bucket, (unsigned long) -2000);
+    tokenbucket::refill(&bucket, 2000);
+    ck_assert_int_eq(takeAll(), 4);
+}
+END_TEST
+
+START_TEST (test_change_rate)
+{
+    tokenbucket::refill(&bucket, 0);
+    tokenbucket::refill(&bucket, 1500);
+    tokenbucket::setRate(&bucket, 4000);
+    tokenbucket::refill(&bucket, 2000);
+    // 1.5 tokens at the old rate, 2 at the new one
+    ck_assert_int_eq(takeAll(), 3);
+}
+END_TEST
+
+START_TEST (test_zero_rate)
+{
+    tokenbucket::setRate(&bucket, 0);
+    tokenbucket::refill(&bucket, 0);
+    tokenbucket::refill(&bucket, 1000000);
+    fail_if(tokenbucket::take(&bucket));
+}
+END_TEST
+
+START_TEST (test_fill)
+{
+    tokenbucket::fill(&bucket);
+    ck_assert_int_eq(tokenbucket::available(&bucket), 10);
+    tokenbucket::refill(&bucket, 0);
+    tokenbucket::refill(&bucket, 5000);
+    ck_assert_int_eq(takeAll(), 10);
+}
+END_TEST
+
+Suite* tokenBucketSuite(void) {
+    Suite* s = suite_create("tokenbucket");
+    TCase *tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, NULL);
+    tcase_add_test(tc_core, test_starts_empty);
+    tcase_add_test(tc_core, test_earns_at_rate);
+    tcase_add_test(tc_core, test_keeps_partial_tokens);
+    tcase_add_test(tc_core, test_limited_to_burst);
+    tcase_add_test(tc_core, test_time_wraps);
+    tcase_add_test(tc_core, test_change_rate);
+    tcase_add_test(tc_core, test_zero_rate);
+    tcase_add_test(tc_core, test_fill);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = tokenBucketSuite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
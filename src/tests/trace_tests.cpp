@@ -0,0 +1,132 @@
+#include <check.h>
+#include <stdint.h>
+#include <string.h>
+#include "can/trace.h"
+
+namespace trace = openxc::can::trace;
+
+using openxc::can::trace::TraceFrame;
+
+TraceFrame frame;
+
+void setup() {
+    memset(&frame, 0, sizeof(frame));
+}
+
+bool parse(const char* line) {
+    return trace::parseLine(line, strlen(line), &frame);
+}
+
+START_TEST (test_parse_full_frame)
+{
+    fail_unless(parse("(1436509052.249713) can0 101#0011223344556677"));
+    ck_assert(frame.timestampUs == 1436509052249713LL);
+    ck_assert_str_eq(frame.interfaceName, "can0");
+    ck_assert_int_eq(frame.id, 0x101);
+    ck_assert_int_eq(frame.length, 8);
+    // same byte order as a message received from a controller
+    ck_assert(frame.data == 0x7766554433221100LL);
+}
+END_TEST
+
+START_TEST (test_parse_short_frame)
+{
+    fail_unless(parse("(0.000001) vcan1 7E8#0441"));
+    ck_assert(frame.timestampUs == 1);
+    ck_assert_str_eq(frame.interfaceName, "vcan1");
+    ck_assert_int_eq(frame.id, 0x7e8);
+    ck_assert_int_eq(frame.length, 2);
+    ck_assert(frame.data == 0x4104);
+}
+END_TEST
+
+START_TEST (test_parse_empty_payload)
+{
+    fail_unless(parse("(10.5) can0 12345678#"));
+    ck_assert(frame.timestampUs == 10500000);
+    ck_assert_int_eq(frame.id, 0x12345678);
+    ck_assert_int_eq(frame.length, 0);
+}
+END_TEST
+
+START_TEST (test_parse_ignores_trailing_whitespace)
+{
+    fail_unless(parse("(1.000000) can0 101#00\r"));
+    ck_assert_int_eq(frame.length, 1);
+}
+END_TEST
+
+START_TEST (test_reject_malformed_lines)
+{
+    fail_if(parse(""));
+    fail_if(parse("can0 101#00"));
+    fail_if(parse("(1.000000) can0 101"));
+    fail_if(parse("(1.000000) can0 #00"));
+    fail_if(parse("(1.000000) can0 101#R"));
+    fail_if(parse("(1.000000) can0 101##100112233"));
+    fail_if(parse("(1.000000) can0 101#001122334455667788"));
+    fail_if(parse("(1.000000) averyveryverylonginterface 101#00"));
+}
+END_TEST
+
+START_TEST (test_parse_json_frame)
+{
+    fail_unless(parse("{\"timestamp\": 1351176963.426318, \"bus\": 2, "
+                "\"id\": 42, \"data\": \"0x0011223344556677\"}"));
+    ck_assert(frame.timestampUs == 1351176963426318LL);
+    ck_assert_int_eq(frame.busAddress, 2);
+    ck_assert_int_eq(frame.id, 42);
+    ck_assert_int_eq(frame.length, 8);
+    ck_assert(frame.data == 0x7766554433221100LL);
+}
+END_TEST
+
+START_TEST (test_parse_json_passthrough_output)
+{
+    // the firmware's own raw output, with no bus or timestamp
+    fail_unless(parse("{\"id\":1234,\"data\":\"0x1200000000000000\"}"));
+    ck_assert_int_eq(frame.busAddress, 0);
+    ck_assert(frame.timestampUs == 0);
+    ck_assert_int_eq(frame.id, 1234);
+    ck_assert(frame.data == 0x12);
+}
+END_TEST
+
+START_TEST (test_reject_malformed_json)
+{
+    fail_if(parse("{\"id\": 42}"));
+    fail_if(parse("{\"data\": \"0x12\"}"));
+    fail_if(parse("{\"id\": 42, \"data\": 12}"));
+    fail_if(parse("{\"id\": \"x\", \"data\": \"0x12\"}"));
+    fail_if(parse("{\"name\": \"vehicle_speed\", \"value\": 42}"));
+}
+END_TEST
+
+Suite* traceSuite(void) {
+    Suite* s = suite_create("trace");
+    TCase *tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, NULL);
+    tcase_add_test(tc_core, test_parse_full_frame);
+    tcase_add_test(tc_core, test_parse_short_frame);
+    tcase_add_test(tc_core, test_parse_empty_payload);
+    tcase_add_test(tc_core, test_parse_ignores_trailing_whitespace);
+    tcase_add_test(tc_core, test_reject_malformed_lines);
+    tcase_add_test(tc_core, test_parse_json_frame);
+    tcase_add_test(tc_core, test_parse_json_passthrough_output);
+    tcase_add_test(tc_core, test_reject_malformed_json);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = traceSuite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
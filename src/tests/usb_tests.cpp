@@ -0,0 +1,143 @@
+#include <check.h>
+#include <stdint.h>
+#include <string.h>
+#include "interface/usb.h"
+
+namespace usb = openxc::interface::usb;
+
+using openxc::interface::usb::UsbDevice;
+
+UsbDevice usbDevice;
+
+void setup() {
+    usb::initializeCommon(&usbDevice);
+}
+
+void queueString(const char* string) {
+    for(unsigned int i = 0; i < strlen(string); i++) {
+        QUEUE_PUSH(uint8_t, &usbDevice.sendQueue, (uint8_t) string[i]);
+    }
+}
+
+START_TEST (test_nothing_to_send)
+{
+    uint8_t* data;
+    int length;
+    ck_assert_int_eq(usb::startInTransfer(&usbDevice, 4, &data, &length), -1);
+    ck_assert_int_eq(usb::oldestInTransfer(&usbDevice), -1);
+}
+END_TEST
+
+START_TEST (test_transfers_sent_in_place)
+{
+    queueString("abcdefghij");
+    uint8_t* data;
+    int length;
+    int first = usb::startInTransfer(&usbDevice, 4, &data, &length);
+    ck_assert_int_eq(length, 4);
+    ck_assert_int_eq(data[0], 'a');
+    // The bytes aren't copied out of the queue
+    fail_unless(data == &usbDevice.sendQueue.elements[
+            usbDevice.sendQueue.tail]);
+
+    // The second buffer is prepared while the first is in flight
+    int second = usb::startInTransfer(&usbDevice, 4, &data, &length);
+    fail_if(second == first);
+    ck_assert_int_eq(length, 4);
+    ck_assert_int_eq(data[0], 'e');
+    ck_assert_int_eq(QUEUE_LENGTH(uint8_t, &usbDevice.sendQueue), 10);
+}
+END_TEST
+
+START_TEST (test_only_two_in_flight)
+{
+    queueString("abcdefghij");
+    uint8_t* data;
+    int length;
+    usb::startInTransfer(&usbDevice, 4, &data, &length);
+    usb::startInTransfer(&usbDevice, 4, &data, &length);
+    ck_assert_int_eq(usb::startInTransfer(&usbDevice, 4, &data, &length), -1);
+
+    usb::finishInTransfer(&usbDevice);
+    ck_assert_int_eq(QUEUE_LENGTH(uint8_t, &usbDevice.sendQueue), 6);
+    fail_if(usb::startInTransfer(&usbDevice, 4, &data, &length) == -1);
+    ck_assert_int_eq(length, 2);
+    ck_assert_int_eq(data[0], 'i');
+}
+END_TEST
+
+START_TEST (test_finish_in_order)
+{
+    queueString("abcdef");
+    uint8_t* data;
+    int length;
+    int first = usb::startInTransfer(&usbDevice, 4, &data, &length);
+    int second = usb::startInTransfer(&usbDevice, 4, &data, &length);
+    ck_assert_int_eq(usb::oldestInTransfer(&usbDevice), first);
+    usb::finishInTransfer(&usbDevice);
+    ck_assert_int_eq(usb::oldestInTransfer(&usbDevice), second);
+    usb::finishInTransfer(&usbDevice);
+    ck_assert_int_eq(usb::oldestInTransfer(&usbDevice), -1);
+    fail_unless(QUEUE_EMPTY(uint8_t, &usbDevice.sendQueue));
+}
+END_TEST
+
+START_TEST (test_transfer_stops_at_wrap)
+{
+    for(int i = 0; i < QUEUE_MAX_LENGTH(uint8_t) - 1; i++) {
+        QUEUE_PUSH(uint8_t, &usbDevice.sendQueue, (uint8_t) 0);
+        QUEUE_POP(uint8_t, &usbDevice.sendQueue);
+    }
+    queueString("abcdef");
+
+    uint8_t* data;
+    int length;
+    usb::startInTransfer(&usbDevice, 64, &data, &length);
+    ck_assert_int_eq(length, 2);
+    usb::startInTransfer(&usbDevice, 64, &data, &length);
+    ck_assert_int_eq(length, 4);
+    ck_assert_int_eq(data[0], 'c');
+}
+END_TEST
+
+START_TEST (test_cancel_sends_again)
+{
+    queueString("abcdef");
+    uint8_t* data;
+    int length;
+    usb::startInTransfer(&usbDevice, 4, &data, &length);
+    usb::cancelInTransfers(&usbDevice);
+    ck_assert_int_eq(usb::oldestInTransfer(&usbDevice), -1);
+    ck_assert_int_eq(QUEUE_LENGTH(uint8_t, &usbDevice.sendQueue), 6);
+
+    usb::startInTransfer(&usbDevice, 4, &data, &length);
+    ck_assert_int_eq(data[0], 'a');
+}
+END_TEST
+
+Suite* usbSuite(void) {
+    Suite* s = suite_create("usb");
+    TCase *tc_in = tcase_create("in_transfers");
+    tcase_add_checked_fixture(tc_in, setup, NULL);
+    tcase_add_test(tc_in, test_nothing_to_send);
+    tcase_add_test(tc_in, test_transfers_sent_in_place);
+    tcase_add_test(tc_in, test_only_two_in_flight);
+    tcase_add_test(tc_in, test_finish_in_order);
+    tcase_add_test(tc_in, test_transfer_stops_at_wrap);
+    tcase_add_test(tc_in, test_cancel_sends_again);
+    suite_add_tcase(s, tc_in);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = usbSuite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
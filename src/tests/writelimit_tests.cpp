@@ -0,0 +1,224 @@
+#include <check.h>
+#include <stdint.h>
+#include "can/writelimit.h"
+#include "can/canwrite.h"
+#include "util/timer.h"
+
+namespace writelimit = openxc::can::writelimit;
+namespace time = openxc::util::time;
+
+using openxc::can::writelimit::WRITE_LIMITS;
+using openxc::can::writelimit::WriteLimit;
+using openxc::can::writelimit::LIMIT_QUEUE;
+using openxc::can::writelimit::LIMIT_DROP;
+using openxc::can::writelimit::WRITE_SEND;
+using openxc::can::writelimit::WRITE_DEFER;
+using openxc::can::writelimit::WRITE_DROP;
+
+CanBus BUSES[2] = {
+    {500000, 1},
+    {125000, 2},
+};
+
+uint32_t writtenIds[32];
+int framesWritten;
+
+bool recordingWriteHandler(CanBus* bus, CanMessage message) {
+    writtenIds[framesWritten++] = message.id;
+    return true;
+}
+
+void setup() {
+    time::useVirtualClock(0);
+    for(int i = 0; i < 2; i++) {
+        openxc::can::initializeCommon(&BUSES[i]);
+        BUSES[i].writeHandler = recordingWriteHandler;
+    }
+    writelimit::initialize();
+    framesWritten = 0;
+}
+
+void queueFrame(CanBus* bus, uint32_t id) {
+    CanMessage message = {bus, id};
+    openxc::can::write::enqueueMessage(&message, 0);
+}
+
+START_TEST (test_no_limits)
+{
+    for(int i = 0; i < 100; i++) {
+        ck_assert_int_eq(writelimit::check(&BUSES[0], 0x42), WRITE_SEND);
+    }
+}
+END_TEST
+
+START_TEST (test_bus_burst_then_deferred)
+{
+    writelimit::limitBus(&BUSES[0], 100, 3, LIMIT_QUEUE);
+    for(int i = 0; i < 3; i++) {
+        ck_assert_int_eq(writelimit::check(&BUSES[0], 0x42), WRITE_SEND);
+    }
+    ck_assert_int_eq(writelimit::check(&BUSES[0], 0x42), WRITE_DEFER);
+
+    WriteLimit* limit = writelimit::lookupBus(&BUSES[0]);
+    ck_assert_int_eq(limit->sent, 3);
+    ck_assert_int_eq(limit->deferred, 1);
+    ck_assert_int_eq(limit->dropped, 0);
+
+    // The other bus isn't limited
+    ck_assert_int_eq(writelimit::check(&BUSES[1], 0x42), WRITE_SEND);
+}
+END_TEST
+
+START_TEST (test_bus_drop_policy)
+{
+    writelimit::limitBus(&BUSES[0], 100, 1, LIMIT_DROP);
+    ck_assert_int_eq(writelimit::check(&BUSES[0], 0x42), WRITE_SEND);
+    ck_assert_int_eq(writelimit::check(&BUSES[0], 0x42), WRITE_DROP);
+    ck_assert_int_eq(writelimit::lookupBus(&BUSES[0])->dropped, 1);
+}
+END_TEST
+
+START_TEST (test_earns_tokens_at_rate)
+{
+    writelimit::limitBus(&BUSES[0], 100, 1, LIMIT_QUEUE);
+    writelimit::refill(&BUSES[0], time::systemTimeUs());
+    ck_assert_int_eq(writelimit::check(&BUSES[0], 0x42), WRITE_SEND);
+    ck_assert_int_eq(writelimit::check(&BUSES[0], 0x42), WRITE_DEFER);
+
+    time::advanceVirtualTimeUs(5000);
+    writelimit::refill(&BUSES[0], time::systemTimeUs());
+    ck_assert_int_eq(writelimit::check(&BUSES[0], 0x42), WRITE_DEFER);
+
+    time::advanceVirtualTimeUs(5000);
+    writelimit::refill(&BUSES[0], time::systemTimeUs());
+    ck_assert_int_eq(writelimit::check(&BUSES[0], 0x42), WRITE_SEND);
+}
+END_TEST
+
+START_TEST (test_message_limit_only_its_id)
+{
+    writelimit::limitMessage(&BUSES[0], 0x42, 100, 1, LIMIT_DROP);
+    ck_assert_int_eq(writelimit::check(&BUSES[0], 0x42), WRITE_SEND);
+    ck_assert_int_eq(writelimit::check(&BUSES[0], 0x42), WRITE_DROP);
+    ck_assert_int_eq(writelimit::check(&BUSES[0], 0x43), WRITE_SEND);
+    ck_assert_int_eq(writelimit::check(&BUSES[1], 0x42), WRITE_SEND);
+    ck_assert_int_eq(writelimit::lookupMessage(&BUSES[0], 0x42)->dropped, 1);
+}
+END_TEST
+
+START_TEST (test_message_over_limit_keeps_bus_token)
+{
+    writelimit::limitBus(&BUSES[0], 100, 2, LIMIT_QUEUE);
+    writelimit::limitMessage(&BUSES[0], 0x42, 100, 1, LIMIT_DROP);
+    ck_assert_int_eq(writelimit::check(&BUSES[0], 0x42), WRITE_SEND);
+    ck_assert_int_eq(writelimit::check(&BUSES[0], 0x42), WRITE_DROP);
+    ck_assert_int_eq(writelimit::check(&BUSES[0], 0x43), WRITE_SEND);
+    // Now the bus is out, and its policy applies
+    ck_assert_int_eq(writelimit::check(&BUSES[0], 0x43), WRITE_DEFER);
+    ck_assert_int_eq(writelimit::lookupBus(&BUSES[0])->sent, 2);
+}
+END_TEST
+
+START_TEST (test_replace_limit)
+{
+    fail_unless(writelimit::limitBus(&BUSES[0], 100, 1, LIMIT_QUEUE));
+    writelimit::check(&BUSES[0], 0x42);
+    fail_unless(writelimit::limitBus(&BUSES[0], 100, 5, LIMIT_DROP));
+    ck_assert_int_eq(WRITE_LIMITS.busCount, 1);
+
+    WriteLimit* limit = writelimit::lookupBus(&BUSES[0]);
+    ck_assert_int_eq(limit->sent, 0);
+    ck_assert_int_eq(limit->policy, LIMIT_DROP);
+    ck_assert_int_eq(openxc::util::tokenbucket::available(&limit->bucket), 5);
+}
+END_TEST
+
+START_TEST (test_too_many_limits)
+{
+    for(int i = 0; i < WRITE_LIMIT_MAX_MESSAGES; i++) {
+        fail_unless(writelimit::limitMessage(&BUSES[0], i, 100, 1,
+                    LIMIT_QUEUE));
+    }
+    fail_if(writelimit::limitMessage(&BUSES[0], 0x100, 100, 1, LIMIT_QUEUE));
+    // Replacing one still works
+    fail_unless(writelimit::limitMessage(&BUSES[0], 0, 200, 1, LIMIT_QUEUE));
+}
+END_TEST
+
+START_TEST (test_process_queue_defers_in_order)
+{
+    writelimit::limitMessage(&BUSES[0], 0x42, 100, 1, LIMIT_QUEUE);
+    queueFrame(&BUSES[0], 0x42);
+    queueFrame(&BUSES[0], 0x1);
+    queueFrame(&BUSES[0], 0x42);
+    queueFrame(&BUSES[0], 0x2);
+    queueFrame(&BUSES[0], 0x42);
+
+    openxc::can::write::processWriteQueue(&BUSES[0]);
+    // Other IDs aren't held up behind the limited one
+    ck_assert_int_eq(framesWritten, 3);
+    ck_assert_int_eq(writtenIds[0], 0x42);
+    ck_assert_int_eq(writtenIds[1], 0x1);
+    ck_assert_int_eq(writtenIds[2], 0x2);
+    ck_assert_int_eq(QUEUE_LENGTH(CanMessage, &BUSES[0].sendQueue), 2);
+
+    time::advanceVirtualTimeUs(10000);
+    openxc::can::write::processWriteQueue(&BUSES[0]);
+    ck_assert_int_eq(framesWritten, 4);
+    ck_assert_int_eq(QUEUE_LENGTH(CanMessage, &BUSES[0].sendQueue), 1);
+
+    time::advanceVirtualTimeUs(10000);
+    openxc::can::write::processWriteQueue(&BUSES[0]);
+    ck_assert_int_eq(framesWritten, 5);
+    fail_unless(QUEUE_EMPTY(CanMessage, &BUSES[0].sendQueue));
+}
+END_TEST
+
+START_TEST (test_process_queue_drops)
+{
+    writelimit::limitBus(&BUSES[0], 100, 2, LIMIT_DROP);
+    for(int i = 0; i < 5; i++) {
+        queueFrame(&BUSES[0], i);
+    }
+
+    openxc::can::write::processWriteQueue(&BUSES[0]);
+    ck_assert_int_eq(framesWritten, 2);
+    fail_unless(QUEUE_EMPTY(CanMessage, &BUSES[0].sendQueue));
+    ck_assert_int_eq(writelimit::lookupBus(&BUSES[0])->dropped, 3);
+}
+END_TEST
+
+Suite* writeLimitSuite(void) {
+    Suite* s = suite_create("writelimit");
+    TCase *tc_limits = tcase_create("limits");
+    tcase_add_checked_fixture(tc_limits, setup, NULL);
+    tcase_add_test(tc_limits, test_no_limits);
+    tcase_add_test(tc_limits, test_bus_burst_then_deferred);
+    tcase_add_test(tc_limits, test_bus_drop_policy);
+    tcase_add_test(tc_limits, test_earns_tokens_at_rate);
+    tcase_add_test(tc_limits, test_message_limit_only_its_id);
+    tcase_add_test(tc_limits, test_message_over_limit_keeps_bus_token);
+    tcase_add_test(tc_limits, test_replace_limit);
+    tcase_add_test(tc_limits, test_too_many_limits);
+    suite_add_tcase(s, tc_limits);
+
+    TCase *tc_queue = tcase_create("queue");
+    tcase_add_checked_fixture(tc_queue, setup, NULL);
+    tcase_add_test(tc_queue, test_process_queue_defers_in_order);
+    tcase_add_test(tc_queue, test_process_queue_drops);
+    suite_add_tcase(s, tc_queue);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = writeLimitSuite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
@@ -0,0 +1,267 @@
+#include <check.h>
+#include <stdint.h>
+#include <string.h>
+#include "util/writeparser.h"
+
+namespace writeparser = openxc::util::writeparser;
+
+using openxc::util::writeparser::WriteParser;
+using openxc::util::writeparser::WriteRequest;
+using openxc::util::writeparser::PARSE_INCOMPLETE;
+using openxc::util::writeparser::PARSE_REQUEST;
+using openxc::util::writeparser::PARSE_DONE;
+using openxc::util::writeparser::PARSE_ERROR;
+using openxc::util::writeparser::VALUE_NONE;
+using openxc::util::writeparser::VALUE_NULL;
+using openxc::util::writeparser::VALUE_FALSE;
+using openxc::util::writeparser::VALUE_TRUE;
+using openxc::util::writeparser::VALUE_NUMBER;
+using openxc::util::writeparser::VALUE_STRING;
+
+WriteParser parser;
+
+void setup() {
+    writeparser::initialize(&parser);
+}
+
+/* Private: Pass the rest of a message to the parser, starting after the bytes
+ * it has already used.
+ */
+writeparser::ParseStatus parseRest(const char* message) {
+    return writeparser::parse(&parser,
+            (const uint8_t*)&message[parser.consumed],
+            strlen(message) - parser.consumed);
+}
+
+START_TEST (test_translated_write)
+{
+    const char* message = "{\"name\": \"turn_signal_status\", "
+            "\"value\": \"left\", \"event\": true}";
+    ck_assert_int_eq(parseRest(message), PARSE_REQUEST);
+    WriteRequest* request = &parser.request;
+    ck_assert_int_eq(request->name.type, VALUE_STRING);
+    ck_assert_str_eq(request->name.string, "turn_signal_status");
+    ck_assert_int_eq(request->value.type, VALUE_STRING);
+    ck_assert_str_eq(request->value.string, "left");
+    ck_assert_int_eq(request->event.type, VALUE_TRUE);
+    ck_assert_int_eq(request->id.type, VALUE_NONE);
+    fail_if(request->complex);
+
+    ck_assert_int_eq(parseRest(message), PARSE_DONE);
+    ck_assert_int_eq(parser.consumed, strlen(message));
+}
+END_TEST
+
+START_TEST (test_raw_write)
+{
+    ck_assert_int_eq(parseRest(
+                "{\"bus\":2,\"id\":291,\"data\":\"0x1234\"}"), PARSE_REQUEST);
+    WriteRequest* request = &parser.request;
+    ck_assert_int_eq(request->bus.type, VALUE_NUMBER);
+    ck_assert(request->bus.number == 2);
+    ck_assert(request->id.number == 291);
+    ck_assert_str_eq(request->data.string, "0x1234");
+    ck_assert_int_eq(request->name.type, VALUE_NONE);
+}
+END_TEST
+
+START_TEST (test_values)
+{
+    ck_assert_int_eq(parseRest("{\"value\": -1.5e2}"), PARSE_REQUEST);
+    ck_assert_int_eq(parser.request.value.type, VALUE_NUMBER);
+    ck_assert(parser.request.value.number == -150);
+
+    writeparser::initialize(&parser);
+    ck_assert_int_eq(parseRest("{\"value\": false}"), PARSE_REQUEST);
+    ck_assert_int_eq(parser.request.value.type, VALUE_FALSE);
+
+    writeparser::initialize(&parser);
+    ck_assert_int_eq(parseRest("{\"value\": null}"), PARSE_REQUEST);
+    ck_assert_int_eq(parser.request.value.type, VALUE_NULL);
+
+    writeparser::initialize(&parser);
+    ck_assert_int_eq(parseRest("{\"value\": \"a\\\"b\\\\c\\n\"}"),
+            PARSE_REQUEST);
+    ck_assert_str_eq(parser.request.value.string, "a\"b\\c\n");
+}
+END_TEST
+
+START_TEST (test_split_anywhere)
+{
+    const char* message = "{\"name\": \"steering_wheel_angle\", "
+            "\"value\": 5000.25}";
+    int length = strlen(message);
+    for(int split = 1; split < length; split++) {
+        writeparser::initialize(&parser);
+        ck_assert_int_eq(writeparser::parse(&parser, (const uint8_t*)message,
+                    split), PARSE_INCOMPLETE);
+        ck_assert_int_eq(parser.consumed, split);
+        ck_assert_int_eq(parseRest(message), PARSE_REQUEST);
+        ck_assert_str_eq(parser.request.name.string, "steering_wheel_angle");
+        ck_assert(parser.request.value.number == 5000.25);
+    }
+}
+END_TEST
+
+START_TEST (test_byte_at_a_time)
+{
+    const char* message = "[{\"id\": 1, \"data\": \"0x1\"}, {\"id\": 2}]";
+    int requests = 0;
+    for(unsigned int i = 0; i < strlen(message); i++) {
+        writeparser::ParseStatus status = writeparser::parse(&parser,
+                (const uint8_t*)&message[i], 1);
+        if(status == PARSE_REQUEST) {
+            ++requests;
+            ck_assert(parser.request.id.number == requests);
+        }
+    }
+    ck_assert_int_eq(requests, 2);
+    ck_assert_int_eq(parseRest(message), PARSE_DONE);
+}
+END_TEST
+
+START_TEST (test_batch)
+{
+    const char* message = " [{\"name\": \"a\", \"value\": 1},\n"
+            "{\"name\": \"b\", \"value\": 2}, {\"id\": 3, \"data\": \"0x3\"}]";
+    ck_assert_int_eq(parseRest(message), PARSE_REQUEST);
+    fail_unless(parser.batch);
+    ck_assert_str_eq(parser.request.name.string, "a");
+    ck_assert_int_eq(parseRest(message), PARSE_REQUEST);
+    ck_assert_str_eq(parser.request.name.string, "b");
+    // Fields from the last request don't carry over
+    ck_assert_int_eq(parseRest(message), PARSE_REQUEST);
+    ck_assert_int_eq(parser.request.name.type, VALUE_NONE);
+    ck_assert(parser.request.id.number == 3);
+    ck_assert_int_eq(parseRest(message), PARSE_DONE);
+}
+END_TEST
+
+START_TEST (test_empty_batch)
+{
+    ck_assert_int_eq(parseRest("[ ]"), PARSE_DONE);
+}
+END_TEST
+
+START_TEST (test_unknown_fields_skipped)
+{
+    ck_assert_int_eq(parseRest("{\"name\": \"a\", \"a_very_long_field\": "
+                "\"x\", \"other\": 1, \"value\": 2}"), PARSE_REQUEST);
+    ck_assert_str_eq(parser.request.name.string, "a");
+    ck_assert(parser.request.value.number == 2);
+    fail_if(parser.request.complex);
+}
+END_TEST
+
+START_TEST (test_command_is_complex)
+{
+    ck_assert_int_eq(parseRest("{\"command\": \"statistics\"}"),
+            PARSE_REQUEST);
+    fail_unless(parser.request.complex);
+}
+END_TEST
+
+START_TEST (test_nested_is_complex)
+{
+    ck_assert_int_eq(parseRest("{\"name\": \"a\", \"value\": {\"b\": "
+                "[1, \"]}\"]}, \"event\": 2}"), PARSE_REQUEST);
+    fail_unless(parser.request.complex);
+    ck_assert_int_eq(parser.request.value.type, VALUE_NONE);
+    ck_assert(parser.request.event.number == 2);
+}
+END_TEST
+
+START_TEST (test_long_string_is_complex)
+{
+    char message[WRITE_PARSER_MAX_STRING_LENGTH + 32];
+    strcpy(message, "{\"name\": \"");
+    int length = strlen(message);
+    memset(&message[length], 'a', WRITE_PARSER_MAX_STRING_LENGTH);
+    strcpy(&message[length + WRITE_PARSER_MAX_STRING_LENGTH], "\"}");
+    ck_assert_int_eq(parseRest(message), PARSE_REQUEST);
+    fail_unless(parser.request.complex);
+}
+END_TEST
+
+START_TEST (test_malformed)
+{
+    ck_assert_int_eq(parseRest("name"), PARSE_ERROR);
+    // Once failed, stays failed until reset
+    ck_assert_int_eq(writeparser::parse(&parser, (const uint8_t*)"{", 1),
+            PARSE_ERROR);
+
+    writeparser::initialize(&parser);
+    ck_assert_int_eq(parseRest("{\"value\": 12abc}"), PARSE_ERROR);
+
+    writeparser::initialize(&parser);
+    ck_assert_int_eq(parseRest("{\"value\" 1}"), PARSE_ERROR);
+
+    writeparser::initialize(&parser);
+    const uint8_t truncated[] = "{\"name\": \"a\0";
+    ck_assert_int_eq(writeparser::parse(&parser, truncated,
+                sizeof(truncated) - 1), PARSE_ERROR);
+}
+END_TEST
+
+START_TEST (test_skips_separators_before_message)
+{
+    const uint8_t message[] = "\0\r\n{\"id\": 1}";
+    ck_assert_int_eq(writeparser::parse(&parser, message, 3),
+            PARSE_INCOMPLETE);
+    fail_if(writeparser::started(&parser));
+    ck_assert_int_eq(writeparser::parse(&parser, &message[3],
+                sizeof(message) - 4), PARSE_REQUEST);
+    fail_unless(writeparser::started(&parser));
+}
+END_TEST
+
+START_TEST (test_stops_at_end_of_message)
+{
+    const char* message = "{\"id\": 1}\0{\"id\": 2}";
+    ck_assert_int_eq(writeparser::parse(&parser, (const uint8_t*)message,
+                20), PARSE_REQUEST);
+    ck_assert_int_eq(writeparser::parse(&parser,
+                (const uint8_t*)&message[parser.consumed],
+                20 - parser.consumed), PARSE_DONE);
+    ck_assert_int_eq(parser.consumed, 9);
+}
+END_TEST
+
+Suite* writeParserSuite(void) {
+    Suite* s = suite_create("writeparser");
+    TCase *tc_requests = tcase_create("requests");
+    tcase_add_checked_fixture(tc_requests, setup, NULL);
+    tcase_add_test(tc_requests, test_translated_write);
+    tcase_add_test(tc_requests, test_raw_write);
+    tcase_add_test(tc_requests, test_values);
+    tcase_add_test(tc_requests, test_unknown_fields_skipped);
+    tcase_add_test(tc_requests, test_command_is_complex);
+    tcase_add_test(tc_requests, test_nested_is_complex);
+    tcase_add_test(tc_requests, test_long_string_is_complex);
+    tcase_add_test(tc_requests, test_malformed);
+    suite_add_tcase(s, tc_requests);
+
+    TCase *tc_stream = tcase_create("stream");
+    tcase_add_checked_fixture(tc_stream, setup, NULL);
+    tcase_add_test(tc_stream, test_split_anywhere);
+    tcase_add_test(tc_stream, test_byte_at_a_time);
+    tcase_add_test(tc_stream, test_batch);
+    tcase_add_test(tc_stream, test_empty_batch);
+    tcase_add_test(tc_stream, test_skips_separators_before_message);
+    tcase_add_test(tc_stream, test_stops_at_end_of_message);
+    suite_add_tcase(s, tc_stream);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = writeParserSuite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
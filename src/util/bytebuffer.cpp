@@ -1,32 +1,145 @@
 #include "util/bytebuffer.h"
-#include "strutil.h"
 #include "util/log.h"
+#include <stddef.h>
 
 QUEUE_DEFINE(uint8_t)
 
-void openxc::util::bytebuffer::processQueue(QUEUE_TYPE(uint8_t)* queue, bool (*callback)(uint8_t*)) {
-    int length = QUEUE_LENGTH(uint8_t, queue);
-    if(length == 0) {
-        return;
+using openxc::util::bytebuffer::Framer;
+using openxc::util::bytebuffer::discardFront;
+
+/* Private: Returns the index in the queue's storage of the byte at the given
+ * offset from the front of the queue.
+ */
+static int position(QUEUE_TYPE(uint8_t)* queue, int offset) {
+    return (queue->tail + offset) % queue_uint8_t_max_internal_length;
+}
+
+static bool isSeparator(uint8_t byte) {
+    return byte == '\0' || byte == '\n';
+}
+
+/* Private: Returns the offset from the front of the queue of the first
+ * separator between start and length, or -1 if there isn't one.
+ */
+static int findSeparator(QUEUE_TYPE(uint8_t)* queue, int start, int length) {
+    int index = position(queue, start);
+    for(int i = start; i < length; i++) {
+        if(isSeparator(queue->elements[index])) {
+            return i;
+        }
+        if(++index == queue_uint8_t_max_internal_length) {
+            index = 0;
+        }
+    }
+    return -1;
+}
+
+/* Private: Pass the message at the front of the queue to the callback, in
+ * place if it doesn't wrap around the end of the queue's storage.
+ *
+ * length - The length of the message.
+ * separated - True if the message is followed by a separator, which is replaced
+ *      with a NULL character. A binary record isn't, and the byte after it may
+ *      belong to the next message.
+ *
+ * Returns the result of the callback.
+ */
+static bool dispatch(QUEUE_TYPE(uint8_t)* queue, int length, bool separated,
+        bool (*callback)(uint8_t*, int)) {
+    int start = queue->tail;
+    if(start + length + (separated ? 1 : 0) <=
+            queue_uint8_t_max_internal_length) {
+        if(separated) {
+            queue->elements[start + length] = '\0';
+        }
+        return callback(&queue->elements[start], length);
+    }
+
+    uint8_t message[length + 1];
+    for(int i = 0; i < length; i++) {
+        message[i] = queue->elements[position(queue, i)];
+    }
+    message[length] = '\0';
+    return callback(message, length);
+}
+
+static void countFrame(Framer* framer, bool handled) {
+    ++framer->framesReceived;
+    if(!handled) {
+        ++framer->framesRejected;
     }
+}
+
+void openxc::util::bytebuffer::initializeFramer(Framer* framer) {
+    framer->scanned = 0;
+    framer->discarding = false;
+    framer->framesReceived = 0;
+    framer->framesRejected = 0;
+    framer->framesOversize = 0;
+    framer->bytesDiscarded = 0;
+}
 
-    uint8_t snapshot[length];
-    QUEUE_SNAPSHOT(uint8_t, queue, snapshot);
+void openxc::util::bytebuffer::processQueue(QUEUE_TYPE(uint8_t)* queue,
+        Framer* framer, bool (*callback)(uint8_t*, int)) {
     if(callback == NULL) {
         debug("Callback is NULL (%p) -- unable to handle queue at %p",
                 callback, queue);
         return;
     }
 
-    if(callback(snapshot)) {
-        QUEUE_INIT(uint8_t, queue);
-    } else if(QUEUE_FULL(uint8_t, queue)) {
-        debug("Incoming write is too long");
-        QUEUE_INIT(uint8_t, queue);
-    } else if(strnchr((char*)snapshot, sizeof(snapshot) - 1, '\0') != NULL) {
-        debug("Incoming buffered write corrupted (%s) -- clearing buffer",
-                snapshot);
-        QUEUE_INIT(uint8_t, queue);
+    while(!QUEUE_EMPTY(uint8_t, queue)) {
+        int length = QUEUE_LENGTH(uint8_t, queue);
+        if(framer->discarding) {
+            int separator = findSeparator(queue, 0, length);
+            int count = separator == -1 ? length : separator + 1;
+            discardFront(queue, count);
+            framer->bytesDiscarded += count;
+            if(separator == -1) {
+                return;
+            }
+            framer->discarding = false;
+            continue;
+        }
+
+        uint8_t first = QUEUE_PEEK(uint8_t, queue);
+        if(isSeparator(first)) {
+            QUEUE_POP(uint8_t, queue);
+            continue;
+        }
+
+        if(first == BINARY_RECORD_MARKER) {
+            if(length < BINARY_RECORD_HEADER_SIZE) {
+                return;
+            }
+            int recordLength = BINARY_RECORD_HEADER_SIZE +
+                    queue->elements[position(queue, 1)];
+            if(length < recordLength) {
+                // Wait for the rest of the record
+                return;
+            }
+            countFrame(framer, dispatch(queue, recordLength, false, callback));
+            discardFront(queue, recordLength);
+            continue;
+        }
+
+        int separator = findSeparator(queue, framer->scanned, length);
+        if(separator == -1) {
+            if(QUEUE_FULL(uint8_t, queue)) {
+                debug("Incoming write is too long -- discarding it");
+                ++framer->framesOversize;
+                framer->bytesDiscarded += length;
+                discardFront(queue, length);
+                framer->discarding = true;
+                framer->scanned = 0;
+            } else {
+                framer->scanned = length;
+            }
+            return;
+        }
+
+        countFrame(framer, dispatch(queue, separator, true, callback));
+        discardFront(queue, separator + 1);
+        framer->scanned = 0;
     }
 }
 
@@ -44,3 +157,47 @@ bool openxc::util::bytebuffer::conditionalEnqueue(QUEUE_TYPE(uint8_t)* queue, ui
     QUEUE_PUSH(uint8_t, queue, (uint8_t)'\n');
     return true;
 }
+
+uint8_t* openxc::util::bytebuffer::peekContiguous(QUEUE_TYPE(uint8_t)* queue,
+        int* length) {
+    return peekContiguousAfter(queue, 0, length);
+}
+
+uint8_t* openxc::util::bytebuffer::peekContiguousAfter(
+        QUEUE_TYPE(uint8_t)* queue, int offset, int* length) {
+    int start = position(queue, offset);
+    if(queue->head >= start) {
+        *length = queue->head - start;
+    } else {
+        *length = queue_uint8_t_max_internal_length - start;
+    }
+    return &queue->elements[start];
+}
+
+void openxc::util::bytebuffer::discardFront(QUEUE_TYPE(uint8_t)* queue,
+        int count) {
+    queue->tail = position(queue, count);
+}
+
+int openxc::util::bytebuffer::drainQueue(QUEUE_TYPE(uint8_t)* queue, int limit,
+        int (*write)(const uint8_t*, int)) {
+    int sent = 0;
+    while(sent < limit) {
+        int length;
+        uint8_t* bytes = peekContiguous(queue, &length);
+        if(length == 0) {
+            break;
+        }
+
+        if(length > limit - sent) {
+            length = limit - sent;
+        }
+        int written = write(bytes, length);
+        discardFront(queue, written);
+        sent += written;
+        if(written < length) {
+            break;
+        }
+    }
+    return sent;
+}
@@ -5,21 +5,67 @@
 
 QUEUE_DECLARE(uint8_t, 1024)
 
+// The first byte of a binary record from the host, instead of a JSON message.
+// It never appears in UTF-8 text, so it can't start a JSON message.
+#define BINARY_RECORD_MARKER 0xfe
+// A binary record starts with the marker and the length of its payload (up to
+// 255 bytes), which follows
+#define BINARY_RECORD_HEADER_SIZE 2
+
 namespace openxc {
 namespace util {
 namespace bytebuffer {
 
-/* Public: Pass the buffer in the queue to the callback, which should return
- * true if an OpenXC message is found and processed, then reset the queue back
- * to empty. If no message is found, keep the queue intact unless the
- * queue is full or corrupted (i.e. it has a NULL character but we stil didn't
- * find an OpenXC message), reset it back to empty.
+/* Public: The framing state of a receive queue, which splits the bytes from the
+ * host into messages. Messages are separated by a NULL character or a newline.
+ *
+ * scanned - The number of bytes at the front of the queue already checked for
+ *      the end of a message, so they aren't checked again on the next read.
+ * discarding - True while throwing away the rest of a message that was too
+ *      long for the queue, up to the next separator.
+ * framesReceived - The number of messages passed to the callback.
+ * framesRejected - The number of those messages the callback didn't handle.
+ * framesOversize - The number of messages discarded because they didn't fit in
+ *      the queue.
+ * bytesDiscarded - The number of bytes thrown away from oversize messages.
+ */
+typedef struct {
+    int scanned;
+    bool discarding;
+    unsigned int framesReceived;
+    unsigned int framesRejected;
+    unsigned int framesOversize;
+    unsigned int bytesDiscarded;
+} Framer;
+
+/* Public: Reset a framer to the start of a message, and clear its counters.
+ */
+void initializeFramer(Framer* framer);
+
+/* Public: Pass each complete message in the queue to the callback, and remove
+ * it from the queue. Only the bytes that arrived since the last call are
+ * checked for a separator, and a partial message at the end of the queue is
+ * left where it is until the rest arrives.
  *
- * queue - The queue of bytes to check for a message.
- * callback - A function that will return true if an OpenXC message is found in
- *          the queue.
+ * The message is passed in place in the queue when it doesn't wrap around the
+ * end, and otherwise copied once. Either way the callback gets a NULL
+ * terminated message without its separator. Leading separators (e.g. the NULL
+ * after a message, or the newline of a CRLF) are skipped.
+ *
+ * A message that fills the queue without a separator can never be handled -
+ * it's discarded along with the rest of it up to the next separator, and
+ * counted in framer->framesOversize.
+ *
+ * If the queue starts with a binary record (see BINARY_RECORD_MARKER), the
+ * callback isn't called until the whole record has arrived. A binary record may
+ * contain NULL characters, and isn't followed by a separator.
+ *
+ * queue - The queue of bytes to check for messages.
+ * framer - The framing state of the queue.
+ * callback - A function that will return true if the message was handled.
  */
-void processQueue(QUEUE_TYPE(uint8_t)* queue, bool (*callback)(uint8_t*));
+void processQueue(QUEUE_TYPE(uint8_t)* queue, Framer* framer,
+        bool (*callback)(uint8_t*, int));
 
 /* Public: Add the message to the byte queue if there is room, including a CRLF
  * that will be appended to the message.
@@ -34,6 +80,54 @@ void processQueue(QUEUE_TYPE(uint8_t)* queue, bool (*callback)(uint8_t*));
 bool conditionalEnqueue(QUEUE_TYPE(uint8_t)* queue, uint8_t* message,
         int messageSize);
 
+/* Public: Find the bytes at the front of the queue that are stored
+ * contiguously, so they can be passed to a driver without copying them out
+ * one at a time.
+ *
+ * queue - The queue to look at.
+ * length - Set to the number of contiguous bytes, which is less than the length
+ *      of the queue if it wraps around the end of its storage.
+ *
+ * Returns a pointer to the first byte in the queue.
+ */
+uint8_t* peekContiguous(QUEUE_TYPE(uint8_t)* queue, int* length);
+
+/* Public: Find the contiguous bytes that follow the first few in the queue,
+ * e.g. the next bytes to send while the ones before them are still being sent.
+ *
+ * queue - The queue to look at.
+ * offset - The number of bytes at the front of the queue to skip, no more than
+ *      the queue's length.
+ * length - Set to the number of contiguous bytes after the offset.
+ *
+ * Returns a pointer to the first byte after the offset.
+ */
+uint8_t* peekContiguousAfter(QUEUE_TYPE(uint8_t)* queue, int offset,
+        int* length);
+
+/* Public: Remove bytes from the front of the queue, e.g. once they've been
+ * sent. Only the front of the queue moves, so this is safe while an interrupt
+ * handler pushes to the queue.
+ *
+ * queue - The queue to remove the bytes from.
+ * count - The number of bytes to remove, no more than the queue's length.
+ */
+void discardFront(QUEUE_TYPE(uint8_t)* queue, int count);
+
+/* Public: Pass the bytes at the front of the queue to a driver, one
+ * contiguous region at a time, and remove the bytes it takes. This is how a
+ * transmit interrupt fills a hardware FIFO.
+ *
+ * queue - The queue of bytes to send.
+ * limit - The most bytes to pass to the driver, e.g. the room in its FIFO.
+ * write - A function that takes as many of the bytes as it can and returns how
+ *      many it took.
+ *
+ * Returns the number of bytes sent.
+ */
+int drainQueue(QUEUE_TYPE(uint8_t)* queue, int limit,
+        int (*write)(const uint8_t*, int));
+
 } // namespace bytebuffer
 } // namespace util
 } // namespace openxc
@@ -1,3 +1,106 @@
 #include "util/log.h"
 
 const int openxc::util::log::MAX_LOG_LINE_LENGTH = 120;
+
+/* Private: A log message recorded by deferDebug(), waiting to be formatted.
+ *
+ * format - The printf-style format string.
+ * arguments - The raw integer arguments for the format string.
+ * ready - True once the producer has finished writing the entry.
+ */
+typedef struct {
+    const char* format;
+    uint32_t arguments[MAX_DEFERRED_LOG_ARGUMENTS];
+    volatile bool ready;
+} DeferredLogEntry;
+
+// head and tail are free running counters - the entry index is the counter
+// modulo the ring size. Producers (possibly in an ISR) reserve entries by
+// advancing head atomically, and only the main loop advances tail.
+static DeferredLogEntry deferredLog[DEFERRED_LOG_RING_SIZE];
+static volatile unsigned int deferredLogHead;
+static volatile unsigned int deferredLogTail;
+static volatile unsigned int deferredLogDropped;
+static unsigned int deferredLogDroppedReported;
+
+/* Private: Reserve an entry in the deferred log ring, copy the message into it
+ * and mark it ready to be flushed. If the ring is full, count the drop.
+ */
+void pushDeferred(const char* format, uint32_t arg1, uint32_t arg2,
+        uint32_t arg3, uint32_t arg4) {
+    unsigned int head;
+    do {
+        head = deferredLogHead;
+        if(head - deferredLogTail >= DEFERRED_LOG_RING_SIZE) {
+            __sync_fetch_and_add(&deferredLogDropped, 1);
+            return;
+        }
+    } while(!__sync_bool_compare_and_swap(&deferredLogHead, head, head + 1));
+
+    DeferredLogEntry* entry = &deferredLog[head % DEFERRED_LOG_RING_SIZE];
+    entry->format = format;
+    entry->arguments[0] = arg1;
+    entry->arguments[1] = arg2;
+    entry->arguments[2] = arg3;
+    entry->arguments[3] = arg4;
+    __sync_synchronize();
+    entry->ready = true;
+}
+
+void openxc::util::log::deferDebug(const char* format) {
+    pushDeferred(format, 0, 0, 0, 0);
+}
+
+void openxc::util::log::deferDebug(const char* format, uint32_t arg1) {
+    pushDeferred(format, arg1, 0, 0, 0);
+}
+
+void openxc::util::log::deferDebug(const char* format, uint32_t arg1,
+        uint32_t arg2) {
+    pushDeferred(format, arg1, arg2, 0, 0);
+}
+
+void openxc::util::log::deferDebug(const char* format, uint32_t arg1,
+        uint32_t arg2, uint32_t arg3) {
+    pushDeferred(format, arg1, arg2, arg3, 0);
+}
+
+void openxc::util::log::deferDebug(const char* format, uint32_t arg1,
+        uint32_t arg2, uint32_t arg3, uint32_t arg4) {
+    pushDeferred(format, arg1, arg2, arg3, arg4);
+}
+
+void openxc::util::log::flush() {
+    while(deferredLogTail != deferredLogHead) {
+        DeferredLogEntry* entry = &deferredLog[
+                deferredLogTail % DEFERRED_LOG_RING_SIZE];
+        if(!entry->ready) {
+            // Reserved but the producer was interrupted before finishing it
+            break;
+        }
+
+        DeferredLogEntry copy = *entry;
+        entry->ready = false;
+        __sync_synchronize();
+        ++deferredLogTail;
+
+        // Extra arguments beyond those in the format string are ignored
+        debug(copy.format, copy.arguments[0], copy.arguments[1],
+                copy.arguments[2], copy.arguments[3]);
+    }
+
+    unsigned int dropped = deferredLogDropped;
+    if(dropped != deferredLogDroppedReported) {
+        debug("Dropped %d deferred log messages",
+                dropped - deferredLogDroppedReported);
+        deferredLogDroppedReported = dropped;
+    }
+}
+
+int openxc::util::log::deferredMessagesPending() {
+    return deferredLogHead - deferredLogTail;
+}
+
+unsigned int openxc::util::log::deferredMessagesDropped() {
+    return deferredLogDropped;
+}
@@ -1,6 +1,11 @@
 #ifndef _LOG_H_
 #define _LOG_H_
 
+#include <stdint.h>
+
+#define DEFERRED_LOG_RING_SIZE 32
+#define MAX_DEFERRED_LOG_ARGUMENTS 4
+
 /* Public: Construct a string for the given format and args and output it on
  *      whatever debug interface the current platform is using. This function
  *      could be implemented in multiple ways - UART, regular printf, etc. The
@@ -15,6 +20,28 @@
  */
 #define debug(...) openxc::util::log::debugNoNewline(__VA_ARGS__); openxc::util::log::debugNoNewline("\r\n");
 
+/* Public: Record a log message to be formatted and output later by flush(),
+ *      followed by a newline.
+ *
+ *      Unlike debug(), this only copies the format string pointer and the
+ *      arguments into a lock-free ring buffer, so it is cheap enough to call
+ *      from an interrupt handler or once per CAN message. If the ring is full
+ *      the message is dropped and counted - it never blocks.
+ *
+ *      This is a macro so that the arguments aren't even evaluated unless
+ *      compiled with __DEBUG__.
+ *
+ * format - A printf-style format string. It must be a string literal (or
+ *      otherwise outlive the call to flush()).
+ * args - Up to MAX_DEFERRED_LOG_ARGUMENTS integer arguments that match the
+ *      format string. Strings and floats are not supported.
+ */
+#ifdef __DEBUG__
+#define debugDeferred(...) openxc::util::log::deferDebug(__VA_ARGS__)
+#else
+#define debugDeferred(...)
+#endif // __DEBUG__
+
 namespace openxc {
 namespace util {
 namespace log {
@@ -30,6 +57,36 @@ void initialize();
  */
 void debugNoNewline(const char* format, ...);
 
+/* Public: Record a log message to be output later - see debugDeferred(). Use
+ *      the macro instead of calling these directly so the logging is compiled
+ *      out of non-debug builds.
+ */
+void deferDebug(const char* format);
+void deferDebug(const char* format, uint32_t arg1);
+void deferDebug(const char* format, uint32_t arg1, uint32_t arg2);
+void deferDebug(const char* format, uint32_t arg1, uint32_t arg2,
+        uint32_t arg3);
+void deferDebug(const char* format, uint32_t arg1, uint32_t arg2,
+        uint32_t arg3, uint32_t arg4);
+
+/* Public: Format and output all deferred log messages recorded so far with
+ *      debugNoNewline(). This must only be called from the main loop, never
+ *      from an interrupt handler.
+ *
+ *      If any messages have been dropped since the last flush, a message with
+ *      the number of drops is also output.
+ */
+void flush();
+
+/* Public: Return the number of deferred log messages waiting to be flushed.
+ */
+int deferredMessagesPending();
+
+/* Public: Return the total number of deferred log messages dropped because
+ *      the ring buffer was full.
+ */
+unsigned int deferredMessagesDropped();
+
 } // namespace log
 } // namespace util
 } // namespace openxc
@@ -0,0 +1,29 @@
+#include "util/timer.h"
+
+// The virtual clock is set from the trace replay thread on the host build and
+// read from the main loop, so don't let it be cached in a register
+static volatile bool virtualClock;
+static volatile uint64_t virtualTime;
+
+void openxc::util::time::useVirtualClock(uint64_t startUs) {
+    virtualTime = startUs;
+    virtualClock = true;
+}
+
+bool openxc::util::time::virtualClockEnabled() {
+    return virtualClock;
+}
+
+uint64_t openxc::util::time::virtualTimeUs() {
+    return virtualTime;
+}
+
+void openxc::util::time::setVirtualTimeUs(uint64_t timeUs) {
+    if(timeUs > virtualTime) {
+        virtualTime = timeUs;
+    }
+}
+
+void openxc::util::time::advanceVirtualTimeUs(uint64_t elapsedUs) {
+    virtualTime += elapsedUs;
+}
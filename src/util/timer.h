@@ -1,6 +1,8 @@
 #ifndef __TIMER_H__
 #define __TIMER_H__
 
+#include <stdint.h>
+
 namespace openxc {
 namespace util {
 namespace time {
@@ -13,11 +15,66 @@ void delayMs(int delayInMs);
  */
 unsigned long systemTimeMs();
 
+/* Public: Return the current system time in microseconds. This wraps around
+ * about every 71 minutes, so it's only suitable for measuring short durations.
+ */
+unsigned long systemTimeUs();
+
+/* Public: Return a free running counter for timing short sections of code,
+ * more precisely and cheaply than systemTimeUs(). It's the CPU cycle counter
+ * on the LPC17xx, the core timer (every second CPU cycle) on the PIC32 and a
+ * nanosecond clock on the host. The host counter is real time even when the
+ * system time is from the virtual clock, so it measures how long the code
+ * took to run, not how far the trace moved.
+ *
+ * The count wraps around often (every few seconds), so only the difference
+ * between two nearby counts is meaningful.
+ */
+uint32_t cycleCount();
+
+/* Public: Return the number of cycleCount() counts in a microsecond.
+ */
+uint32_t cyclesPerUs();
+
 /* Public: Perform any one-time initialization required to use system times,
  * including those for system time and the delayMs function.
  */
 void initialize();
 
+/* Public: Switch the system time over to a virtual clock, which only moves
+ * when it's advanced by setVirtualTimeUs(), advanceVirtualTimeUs() or
+ * delayMs(), so anything that depends on time is reproducible. Calling this
+ * again restarts the virtual clock.
+ *
+ * The unit tests always run on the virtual clock, and the host build can use
+ * it to follow the timestamps of a replayed trace. The microcontroller
+ * platforms always use their hardware timer.
+ *
+ * startUs - The time to start the virtual clock at, in microseconds.
+ */
+void useVirtualClock(uint64_t startUs);
+
+/* Public: Returns true if the system time is from the virtual clock.
+ */
+bool virtualClockEnabled();
+
+/* Public: Returns the current time of the virtual clock in microseconds.
+ */
+uint64_t virtualTimeUs();
+
+/* Public: Move the virtual clock to the given time. The clock never goes
+ * backwards, so an earlier time is ignored.
+ *
+ * timeUs - The new time in microseconds.
+ */
+void setVirtualTimeUs(uint64_t timeUs);
+
+/* Public: Move the virtual clock forward.
+ *
+ * elapsedUs - The number of microseconds to move forward.
+ */
+void advanceVirtualTimeUs(uint64_t elapsedUs);
+
 } // namespace time
 } // namespace util
 } // namespace openxc
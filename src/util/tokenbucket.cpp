@@ -0,0 +1,53 @@
+#include "util/tokenbucket.h"
+#include <string.h>
+
+#define MICROSECONDS_PER_SECOND 1000000
+
+using openxc::util::tokenbucket::TokenBucket;
+
+void openxc::util::tokenbucket::initialize(TokenBucket* bucket,
+        unsigned int ratePerSecond, unsigned int burst) {
+    memset(bucket, 0, sizeof(TokenBucket));
+    bucket->ratePerSecond = ratePerSecond;
+    bucket->burst = burst;
+}
+
+void openxc::util::tokenbucket::fill(TokenBucket* bucket) {
+    bucket->credit = (uint64_t)bucket->burst * MICROSECONDS_PER_SECOND;
+}
+
+void openxc::util::tokenbucket::setRate(TokenBucket* bucket,
+        unsigned int ratePerSecond) {
+    bucket->ratePerSecond = ratePerSecond;
+}
+
+void openxc::util::tokenbucket::refill(TokenBucket* bucket,
+        unsigned long nowUs) {
+    if(!bucket->started) {
+        bucket->started = true;
+        bucket->lastRefillUs = nowUs;
+        return;
+    }
+
+    // Unsigned subtraction, so the system time wrapping around is harmless
+    unsigned long elapsedUs = nowUs - bucket->lastRefillUs;
+    bucket->lastRefillUs = nowUs;
+    bucket->credit += (uint64_t)elapsedUs * bucket->ratePerSecond;
+    const uint64_t maxCredit = (uint64_t)bucket->burst *
+            MICROSECONDS_PER_SECOND;
+    if(bucket->credit > maxCredit) {
+        bucket->credit = maxCredit;
+    }
+}
+
+bool openxc::util::tokenbucket::take(TokenBucket* bucket) {
+    if(bucket->credit >= MICROSECONDS_PER_SECOND) {
+        bucket->credit -= MICROSECONDS_PER_SECOND;
+        return true;
+    }
+    return false;
+}
+
+unsigned int openxc::util::tokenbucket::available(TokenBucket* bucket) {
+    return bucket->credit / MICROSECONDS_PER_SECOND;
+}
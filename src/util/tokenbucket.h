@@ -0,0 +1,69 @@
+#ifndef _TOKENBUCKET_H_
+#define _TOKENBUCKET_H_
+
+#include <stdint.h>
+
+namespace openxc {
+namespace util {
+namespace tokenbucket {
+
+/* Public: A token bucket, for pacing work to a rate from the main loop without
+ * depending on how fast the loop runs. Tokens are earned at a fixed rate as
+ * time passes, up to a limit, and each unit of work takes one.
+ *
+ * ratePerSecond - The number of tokens earned per second. If 0, no tokens are
+ *      earned.
+ * burst - The most tokens that can be saved up, so a pause in the main loop
+ *      doesn't turn into a burst of catch up work.
+ * started - True once the bucket has been refilled for the first time.
+ * credit - The tokens earned and not yet taken, in millionths of a token.
+ * lastRefillUs - The system time of the last refill, in microseconds.
+ */
+typedef struct {
+    unsigned int ratePerSecond;
+    unsigned int burst;
+    bool started;
+    uint64_t credit;
+    unsigned long lastRefillUs;
+} TokenBucket;
+
+/* Public: Set up an empty bucket. The clock starts at the first refill().
+ *
+ * bucket - The bucket to initialize.
+ * ratePerSecond - The number of tokens to earn per second.
+ * burst - The most tokens the bucket can hold.
+ */
+void initialize(TokenBucket* bucket, unsigned int ratePerSecond,
+        unsigned int burst);
+
+/* Public: Fill a bucket to its burst limit, e.g. so work can start right away
+ * instead of waiting for the first tokens to be earned.
+ */
+void fill(TokenBucket* bucket);
+
+/* Public: Change the rate of a bucket. Tokens already earned are kept.
+ */
+void setRate(TokenBucket* bucket, unsigned int ratePerSecond);
+
+/* Public: Add the tokens earned since the last refill.
+ *
+ * bucket - The bucket to refill.
+ * nowUs - The current system time in microseconds. The time may wrap around.
+ */
+void refill(TokenBucket* bucket, unsigned long nowUs);
+
+/* Public: Take a token from the bucket, if there is one.
+ *
+ * Returns true if a token was taken.
+ */
+bool take(TokenBucket* bucket);
+
+/* Public: Returns the number of whole tokens in the bucket.
+ */
+unsigned int available(TokenBucket* bucket);
+
+} // namespace tokenbucket
+} // namespace util
+} // namespace openxc
+
+#endif // _TOKENBUCKET_H_
@@ -0,0 +1,374 @@
+#include "util/writeparser.h"
+#include <stdlib.h>
+#include <string.h>
+
+using openxc::util::writeparser::ParseStatus;
+using openxc::util::writeparser::WriteParser;
+using openxc::util::writeparser::WriteRequest;
+using openxc::util::writeparser::WriteValue;
+using openxc::util::writeparser::ValueType;
+using openxc::util::writeparser::PARSE_INCOMPLETE;
+using openxc::util::writeparser::PARSE_REQUEST;
+using openxc::util::writeparser::PARSE_DONE;
+using openxc::util::writeparser::PARSE_ERROR;
+using openxc::util::writeparser::VALUE_NONE;
+using openxc::util::writeparser::VALUE_NULL;
+using openxc::util::writeparser::VALUE_FALSE;
+using openxc::util::writeparser::VALUE_TRUE;
+using openxc::util::writeparser::VALUE_NUMBER;
+using openxc::util::writeparser::VALUE_STRING;
+namespace writeparser = openxc::util::writeparser;
+
+static bool isWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool isTokenCharacter(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+        (c >= 'A' && c <= 'Z') || c == '-' || c == '+' || c == '.';
+}
+
+static ParseStatus fail(WriteParser* parser) {
+    parser->state = writeparser::PARSER_ERROR;
+    return PARSE_ERROR;
+}
+
+/* Private: Clear the fields of the request, without touching the string
+ * buffers - they're only read if the type is VALUE_STRING.
+ */
+static void startRequest(WriteParser* parser) {
+    WriteRequest* request = &parser->request;
+    request->name.type = VALUE_NONE;
+    request->value.type = VALUE_NONE;
+    request->event.type = VALUE_NONE;
+    request->id.type = VALUE_NONE;
+    request->bus.type = VALUE_NONE;
+    request->data.type = VALUE_NONE;
+    request->complex = false;
+    parser->state = writeparser::PARSER_OBJECT;
+}
+
+/* Private: Returns the field of the request for the key just parsed, or NULL
+ * if its value isn't kept.
+ */
+static WriteValue* lookupField(WriteParser* parser) {
+    WriteRequest* request = &parser->request;
+    if(parser->keyLength >= WRITE_PARSER_MAX_KEY_LENGTH) {
+        return NULL;
+    }
+
+    const char* key = parser->key;
+    if(!strcmp(key, "name")) {
+        return &request->name;
+    } else if(!strcmp(key, "value")) {
+        return &request->value;
+    } else if(!strcmp(key, "event")) {
+        return &request->event;
+    } else if(!strcmp(key, "id")) {
+        return &request->id;
+    } else if(!strcmp(key, "bus")) {
+        return &request->bus;
+    } else if(!strcmp(key, "data")) {
+        return &request->data;
+    } else if(!strcmp(key, "command")) {
+        request->complex = true;
+    }
+    return NULL;
+}
+
+/* Private: Store a number or true/false/null literal in the current field.
+ *
+ * Returns false if the token isn't a valid JSON value.
+ */
+static bool finishToken(WriteParser* parser) {
+    parser->token[parser->tokenLength] = '\0';
+    const char* token = parser->token;
+
+    ValueType type;
+    double number = 0;
+    if(!strcmp(token, "true")) {
+        type = VALUE_TRUE;
+    } else if(!strcmp(token, "false")) {
+        type = VALUE_FALSE;
+    } else if(!strcmp(token, "null")) {
+        type = VALUE_NULL;
+    } else {
+        char* end;
+        number = strtod(token, &end);
+        if(parser->tokenLength == 0 ||
+                end != &parser->token[parser->tokenLength]) {
+            return false;
+        }
+        type = VALUE_NUMBER;
+    }
+
+    if(parser->field != NULL) {
+        parser->field->type = type;
+        parser->field->number = number;
+    }
+    return true;
+}
+
+static char unescape(WriteParser* parser, char c) {
+    switch(c) {
+    case 'b':
+        return '\b';
+    case 'f':
+        return '\f';
+    case 'n':
+        return '\n';
+    case 'r':
+        return '\r';
+    case 't':
+        return '\t';
+    case 'u':
+        // Only the full JSON parser decodes unicode escapes
+        parser->request.complex = true;
+        return c;
+    default:
+        return c;
+    }
+}
+
+static void appendToField(WriteParser* parser, char c) {
+    WriteValue* field = parser->field;
+    if(field == NULL) {
+        return;
+    }
+
+    if(parser->fieldLength < WRITE_PARSER_MAX_STRING_LENGTH - 1) {
+        field->string[parser->fieldLength++] = c;
+    } else {
+        parser->request.complex = true;
+    }
+}
+
+static void appendToKey(WriteParser* parser, char c) {
+    if(parser->keyLength < WRITE_PARSER_MAX_KEY_LENGTH - 1) {
+        parser->key[parser->keyLength++] = c;
+    } else {
+        // Too long to be a known key
+        parser->keyLength = WRITE_PARSER_MAX_KEY_LENGTH;
+    }
+}
+
+/* Private: Finish the object that was just closed.
+ */
+static ParseStatus finishObject(WriteParser* parser) {
+    parser->state = parser->batch ? writeparser::PARSER_ARRAY_NEXT :
+            writeparser::PARSER_DONE;
+    return PARSE_REQUEST;
+}
+
+/* Private: Handle one byte of the message.
+ *
+ * used - Set to false if the byte ends a number or literal, and must be
+ *      handled again in the next state.
+ *
+ * Returns PARSE_INCOMPLETE unless the byte finished a request or the message.
+ */
+static ParseStatus step(WriteParser* parser, char c, bool* used) {
+    switch(parser->state) {
+    case writeparser::PARSER_START:
+        // Skip anything separating this message from the last one
+        if(c == '{') {
+            parser->batch = false;
+            startRequest(parser);
+        } else if(c == '[') {
+            parser->batch = true;
+            parser->state = writeparser::PARSER_ARRAY;
+        } else if(!isWhitespace(c) && c != '\0') {
+            return fail(parser);
+        }
+        break;
+    case writeparser::PARSER_ARRAY:
+        if(c == '{') {
+            startRequest(parser);
+        } else if(c == ']') {
+            parser->state = writeparser::PARSER_DONE;
+            return PARSE_DONE;
+        } else if(!isWhitespace(c)) {
+            return fail(parser);
+        }
+        break;
+    case writeparser::PARSER_ARRAY_NEXT:
+        if(c == ',') {
+            parser->state = writeparser::PARSER_ARRAY;
+        } else if(c == ']') {
+            parser->state = writeparser::PARSER_DONE;
+            return PARSE_DONE;
+        } else if(!isWhitespace(c)) {
+            return fail(parser);
+        }
+        break;
+    case writeparser::PARSER_OBJECT:
+        if(c == '"') {
+            parser->keyLength = 0;
+            parser->state = writeparser::PARSER_KEY;
+        } else if(c == '}') {
+            return finishObject(parser);
+        } else if(!isWhitespace(c)) {
+            return fail(parser);
+        }
+        break;
+    case writeparser::PARSER_OBJECT_NEXT:
+        if(c == ',') {
+            parser->state = writeparser::PARSER_OBJECT;
+        } else if(c == '}') {
+            return finishObject(parser);
+        } else if(!isWhitespace(c)) {
+            return fail(parser);
+        }
+        break;
+    case writeparser::PARSER_KEY:
+        if(c == '"') {
+            if(parser->keyLength < WRITE_PARSER_MAX_KEY_LENGTH) {
+                parser->key[parser->keyLength] = '\0';
+            }
+            parser->state = writeparser::PARSER_COLON;
+        } else if(c == '\\') {
+            parser->state = writeparser::PARSER_KEY_ESCAPE;
+        } else if((uint8_t)c < ' ') {
+            return fail(parser);
+        } else {
+            appendToKey(parser, c);
+        }
+        break;
+    case writeparser::PARSER_KEY_ESCAPE:
+        // An escaped key might still be a known one, so let the full JSON
+        // parser decide
+        parser->request.complex = true;
+        appendToKey(parser, unescape(parser, c));
+        parser->state = writeparser::PARSER_KEY;
+        break;
+    case writeparser::PARSER_COLON:
+        if(c == ':') {
+            parser->field = lookupField(parser);
+            parser->state = writeparser::PARSER_VALUE;
+        } else if(!isWhitespace(c)) {
+            return fail(parser);
+        }
+        break;
+    case writeparser::PARSER_VALUE:
+        if(c == '"') {
+            if(parser->field != NULL) {
+                parser->field->type = VALUE_STRING;
+            }
+            parser->fieldLength = 0;
+            parser->state = writeparser::PARSER_STRING;
+        } else if(c == '{' || c == '[') {
+            if(parser->field != NULL) {
+                parser->field->type = VALUE_NONE;
+            }
+            parser->request.complex = true;
+            parser->depth = 1;
+            parser->state = writeparser::PARSER_NESTED;
+        } else if(isTokenCharacter(c)) {
+            parser->tokenLength = 0;
+            parser->state = writeparser::PARSER_TOKEN;
+            *used = false;
+        } else if(!isWhitespace(c)) {
+            return fail(parser);
+        }
+        break;
+    case writeparser::PARSER_STRING:
+        if(c == '"') {
+            if(parser->field != NULL) {
+                parser->field->string[parser->fieldLength] = '\0';
+            }
+            parser->state = writeparser::PARSER_OBJECT_NEXT;
+        } else if(c == '\\') {
+            parser->state = writeparser::PARSER_STRING_ESCAPE;
+        } else if((uint8_t)c < ' ') {
+            return fail(parser);
+        } else {
+            appendToField(parser, c);
+        }
+        break;
+    case writeparser::PARSER_STRING_ESCAPE:
+        appendToField(parser, unescape(parser, c));
+        parser->state = writeparser::PARSER_STRING;
+        break;
+    case writeparser::PARSER_TOKEN:
+        if(isTokenCharacter(c)) {
+            if(parser->tokenLength >= WRITE_PARSER_MAX_TOKEN_LENGTH - 1) {
+                return fail(parser);
+            }
+            parser->token[parser->tokenLength++] = c;
+        } else {
+            if(!finishToken(parser)) {
+                return fail(parser);
+            }
+            parser->state = writeparser::PARSER_OBJECT_NEXT;
+            *used = false;
+        }
+        break;
+    case writeparser::PARSER_NESTED:
+        if(c == '"') {
+            parser->state = writeparser::PARSER_NESTED_STRING;
+        } else if(c == '{' || c == '[') {
+            ++parser->depth;
+        } else if(c == '}' || c == ']') {
+            if(--parser->depth == 0) {
+                parser->state = writeparser::PARSER_OBJECT_NEXT;
+            }
+        } else if(c == '\0') {
+            return fail(parser);
+        }
+        break;
+    case writeparser::PARSER_NESTED_STRING:
+        if(c == '"') {
+            parser->state = writeparser::PARSER_NESTED;
+        } else if(c == '\\') {
+            parser->state = writeparser::PARSER_NESTED_ESCAPE;
+        } else if(c == '\0') {
+            return fail(parser);
+        }
+        break;
+    case writeparser::PARSER_NESTED_ESCAPE:
+        parser->state = writeparser::PARSER_NESTED_STRING;
+        break;
+    case writeparser::PARSER_DONE:
+    case writeparser::PARSER_ERROR:
+        // parse() doesn't pass any more bytes once the message is finished
+        *used = false;
+        break;
+    }
+    return PARSE_INCOMPLETE;
+}
+
+void openxc::util::writeparser::initialize(WriteParser* parser) {
+    parser->consumed = 0;
+    parser->batch = false;
+    parser->state = PARSER_START;
+    parser->field = NULL;
+}
+
+bool openxc::util::writeparser::started(WriteParser* parser) {
+    return parser->state != PARSER_START;
+}
+
+ParseStatus openxc::util::writeparser::parse(WriteParser* parser,
+        const uint8_t* data, int length) {
+    int i = 0;
+    while(i < length && parser->state != PARSER_DONE &&
+            parser->state != PARSER_ERROR) {
+        bool used = true;
+        ParseStatus status = step(parser, (char)data[i], &used);
+        if(used) {
+            ++i;
+            ++parser->consumed;
+        }
+
+        if(status != PARSE_INCOMPLETE) {
+            return status;
+        }
+    }
+
+    if(parser->state == PARSER_DONE) {
+        return PARSE_DONE;
+    } else if(parser->state == PARSER_ERROR) {
+        return PARSE_ERROR;
+    }
+    return PARSE_INCOMPLETE;
+}
@@ -0,0 +1,156 @@
+#ifndef _WRITEPARSER_H_
+#define _WRITEPARSER_H_
+
+#include <stdint.h>
+
+// The longest string value kept from a write request, including the NULL
+// character
+#define WRITE_PARSER_MAX_STRING_LENGTH 64
+// The longest key recognized in a write request, including the NULL character.
+// Longer keys are skipped along with their values.
+#define WRITE_PARSER_MAX_KEY_LENGTH 12
+// The longest number or true/false/null literal, including the NULL character
+#define WRITE_PARSER_MAX_TOKEN_LENGTH 32
+
+namespace openxc {
+namespace util {
+namespace writeparser {
+
+/* Public: The type of a value in a write request.
+ *
+ * VALUE_NONE - The request didn't have the field.
+ */
+typedef enum {
+    VALUE_NONE,
+    VALUE_NULL,
+    VALUE_FALSE,
+    VALUE_TRUE,
+    VALUE_NUMBER,
+    VALUE_STRING,
+} ValueType;
+
+/* Public: A value from a write request.
+ *
+ * type - The type of the value.
+ * number - The value of a number.
+ * string - The value of a string.
+ */
+typedef struct {
+    ValueType type;
+    double number;
+    char string[WRITE_PARSER_MAX_STRING_LENGTH];
+} WriteValue;
+
+/* Public: The fields of one write request, e.g.:
+ *
+ *      {"name": "turn_signal_status", "value": "left"}
+ *      {"bus": 2, "id": 291, "data": "0x1234"}
+ *
+ * name, value, event - The fields of a translated write.
+ * id, bus, data - The fields of a raw write.
+ * complex - True if the request can't be represented by these fields - it's a
+ *      command, has a nested object or array, or has a string too long to
+ *      keep. It must be parsed again with the full JSON parser.
+ */
+typedef struct {
+    WriteValue name;
+    WriteValue value;
+    WriteValue event;
+    WriteValue id;
+    WriteValue bus;
+    WriteValue data;
+    bool complex;
+} WriteRequest;
+
+/* Public: The result of parsing part of a message.
+ *
+ * PARSE_INCOMPLETE - All of the bytes were used and the message isn't finished
+ *      yet. Call parse() again with the next bytes of the message.
+ * PARSE_REQUEST - A request is ready in the parser. Call parse() again with the
+ *      rest of the bytes, as a batch may have more requests.
+ * PARSE_DONE - The message is finished. Bytes after it aren't used.
+ * PARSE_ERROR - The message isn't a valid write request or batch.
+ */
+typedef enum {
+    PARSE_INCOMPLETE,
+    PARSE_REQUEST,
+    PARSE_DONE,
+    PARSE_ERROR,
+} ParseStatus;
+
+/* Private: Where the parser is in a message.
+ */
+typedef enum {
+    PARSER_START,
+    PARSER_ARRAY,
+    PARSER_ARRAY_NEXT,
+    PARSER_OBJECT,
+    PARSER_OBJECT_NEXT,
+    PARSER_KEY,
+    PARSER_KEY_ESCAPE,
+    PARSER_COLON,
+    PARSER_VALUE,
+    PARSER_STRING,
+    PARSER_STRING_ESCAPE,
+    PARSER_TOKEN,
+    PARSER_NESTED,
+    PARSER_NESTED_STRING,
+    PARSER_NESTED_ESCAPE,
+    PARSER_DONE,
+    PARSER_ERROR,
+} ParserState;
+
+/* Public: An incremental parser for write requests that uses no heap. A message
+ * can be passed to it in any number of pieces, e.g. as the USB packets arrive,
+ * and each byte is only looked at once.
+ *
+ * A message is either one JSON object or an array of objects (a batch). Only
+ * the known fields of a request are kept, and other fields are skipped.
+ *
+ * request - The request being parsed, or the last one finished.
+ * consumed - The number of bytes of the message used so far.
+ * batch - True if the message is an array of requests.
+ *
+ * The other fields are private.
+ */
+typedef struct {
+    WriteRequest request;
+    int consumed;
+    bool batch;
+    ParserState state;
+    char key[WRITE_PARSER_MAX_KEY_LENGTH];
+    int keyLength;
+    WriteValue* field;
+    int fieldLength;
+    char token[WRITE_PARSER_MAX_TOKEN_LENGTH];
+    int tokenLength;
+    int depth;
+} WriteParser;
+
+/* Public: Reset a parser to the start of a new message.
+ */
+void initialize(WriteParser* parser);
+
+/* Public: Returns true if the parser has seen the start of a message, and not
+ * only whitespace.
+ */
+bool started(WriteParser* parser);
+
+/* Public: Parse the next bytes of a message, stopping at the end of each
+ * request.
+ *
+ * parser - The parser for the message.
+ * data - The next bytes of the message, following the parser->consumed bytes
+ *      already used.
+ * length - The number of bytes in data.
+ *
+ * Returns the status of the message. After PARSE_REQUEST, the request is in
+ * parser->request until parse() is called again.
+ */
+ParseStatus parse(WriteParser* parser, const uint8_t* data, int length);
+
+} // namespace writeparser
+} // namespace util
+} // namespace openxc
+
+#endif // _WRITEPARSER_H_